@@ -0,0 +1,129 @@
+#include "espnow_aggregate.h"
+#include "espnow_mesh.h"
+#include "secure_session.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+
+static const char *TAG = "ESP-NOW-AGG";
+
+typedef struct {
+    uint8_t type;
+    espnow_record_cb callback;
+} record_handler_t;
+
+static record_handler_t handlers[ESPNOW_AGG_MAX_HANDLERS];
+static uint8_t handler_count;
+
+
+//! SENDER
+
+static void reset_frame(espnow_aggregator_t *agg) {
+    memset(&agg->message, 0, ESPNOW_HEADER_SIZE);
+    memset(agg->message.target_addr, 0xFF, sizeof(agg->message.target_addr));
+    agg->message.group_id = agg->group_id;
+    agg->message.flags = ESPNOW_FLAG_AGGREGATE | (agg->policy.secure ? ESPNOW_FLAG_SECURE : 0);
+}
+
+void espnow_agg_init(espnow_aggregator_t *agg, uint8_t group_id, espnow_agg_policy_t policy) {
+    memset(agg, 0, sizeof(*agg));
+    agg->group_id = group_id;
+    agg->policy = policy;
+    size_t capacity = ESPNOW_MAX_DATA_LEN - (policy.secure ? SECURE_SESSION_OVERHEAD : 0);
+    if (agg->policy.flush_bytes == 0 || agg->policy.flush_bytes > capacity) {
+        agg->policy.flush_bytes = capacity;
+    }
+    reset_frame(agg);
+}
+
+esp_err_t espnow_agg_flush(espnow_aggregator_t *agg, uint64_t current_time) {
+    if (agg->message.data_len == 0) return ESP_OK;
+
+    //! send a copy: sealing encrypts in place, and a failed send keeps the records for the next flush
+    espnow_message_t message = agg->message;
+    esp_err_t err = espnow_mesh_send(&message);
+    if (err != ESP_OK) return err;
+
+    agg->stats.frames++;
+    agg->stats.total_delay_us += current_time - agg->first_time;
+    reset_frame(agg);
+    return ESP_OK;
+}
+
+esp_err_t espnow_agg_add(espnow_aggregator_t *agg, uint8_t type, const void *value, uint8_t len, uint64_t current_time) {
+    size_t capacity = ESPNOW_MAX_DATA_LEN - (agg->policy.secure ? SECURE_SESSION_OVERHEAD : 0);
+    size_t record_len = ESPNOW_AGG_RECORD_HEADER + len;
+    if (record_len > capacity) return ESP_ERR_INVALID_SIZE;
+
+    if (agg->message.data_len + record_len > capacity) {
+        if (espnow_agg_flush(agg, current_time) != ESP_OK) {
+            agg->stats.dropped++;
+            return ESP_FAIL;
+        }
+        agg->stats.flush_full++;
+    }
+
+    if (agg->message.data_len == 0) agg->first_time = current_time;
+
+    uint8_t *record = agg->message.data + agg->message.data_len;
+    record[0] = type;
+    record[1] = len;
+    memcpy(record + ESPNOW_AGG_RECORD_HEADER, value, len);
+    agg->message.data_len += record_len;
+    agg->stats.records++;
+
+    if (agg->message.data_len >= agg->policy.flush_bytes && espnow_agg_flush(agg, current_time) == ESP_OK) {
+        agg->stats.flush_size++;
+    }
+    return ESP_OK;
+}
+
+void espnow_agg_task(espnow_aggregator_t *agg, uint64_t current_time) {
+    if (agg->message.data_len == 0) return;
+    if (current_time - agg->first_time < agg->policy.max_delay_us) return;
+
+    if (espnow_agg_flush(agg, current_time) == ESP_OK) agg->stats.flush_deadline++;
+}
+
+
+//! RECEIVER
+
+esp_err_t espnow_agg_register(uint8_t type, espnow_record_cb callback) {
+    for (int i = 0; i < handler_count; i++) {
+        if (handlers[i].type != type) continue;
+        handlers[i].callback = callback;
+        return ESP_OK;
+    }
+
+    if (handler_count >= ESPNOW_AGG_MAX_HANDLERS) return ESP_ERR_NO_MEM;
+    handlers[handler_count++] = (record_handler_t){ .type = type, .callback = callback };
+    return ESP_OK;
+}
+
+// returns the number of records handed out, -1 when the frame is malformed
+int espnow_agg_dispatch(const espnow_received_message_t *received) {
+    const uint8_t *ptr = received->message->data;
+    const uint8_t *end = ptr + received->data_len;
+    int count = 0;
+
+    while (ptr < end) {
+        //! a truncated record ends the frame, the records before it were already handled
+        if (end - ptr < ESPNOW_AGG_RECORD_HEADER || end - ptr - ESPNOW_AGG_RECORD_HEADER < ptr[1]) {
+            ESP_LOGW(TAG, "truncated record from " MACSTR, MAC2STR(received->src_addr));
+            return -1;
+        }
+
+        uint8_t type = ptr[0], len = ptr[1];
+        for (int i = 0; i < handler_count; i++) {
+            if (handlers[i].type == type && handlers[i].callback) {
+                handlers[i].callback(received->src_addr, type, ptr + ESPNOW_AGG_RECORD_HEADER, len);
+                break;
+            }
+        }
+
+        ptr += ESPNOW_AGG_RECORD_HEADER + len;
+        count++;
+    }
+    return count;
+}
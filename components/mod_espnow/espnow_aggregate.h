@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "mod_espnow.h"
+
+//# Packs several typed readings into one ESP-NOW frame. Each record is
+//#     type u8 | len u8 | value[len]
+//# and the frame goes out with ESPNOW_FLAG_AGGREGATE once it reaches the size
+//# threshold or its oldest record reaches the deadline. The receiver splits
+//# the frame back into records and calls the handler registered for each type.
+
+#define ESPNOW_AGG_RECORD_HEADER 2
+#define ESPNOW_AGG_MAX_HANDLERS 16
+
+typedef struct {
+    uint8_t flush_bytes;            // send as soon as data_len reaches this, max ESPNOW_MAX_DATA_LEN
+    uint32_t max_delay_us;          // longest a record waits for company
+    bool secure;                    // seal frames with the group key
+} espnow_agg_policy_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t frames;
+    uint32_t flush_size;            // frames sent by reason
+    uint32_t flush_deadline;
+    uint32_t flush_full;            // next record didn't fit
+    uint32_t dropped;               // didn't fit and the frame couldn't be sent
+    uint32_t total_delay_us;        // oldest record age at send, summed over frames
+} espnow_agg_stats_t;
+
+typedef struct {
+    espnow_agg_policy_t policy;
+    uint8_t group_id;
+    uint64_t first_time;            // when the oldest record was added
+    espnow_message_t message;
+    espnow_agg_stats_t stats;
+} espnow_aggregator_t;
+
+typedef void (*espnow_record_cb)(const uint8_t *src_addr, uint8_t type, const uint8_t *value, uint8_t len);
+
+void espnow_agg_init(espnow_aggregator_t *agg, uint8_t group_id, espnow_agg_policy_t policy);
+
+//! returns ESP_ERR_INVALID_SIZE for a record larger than a frame, ESP_FAIL when it was dropped
+esp_err_t espnow_agg_add(espnow_aggregator_t *agg, uint8_t type, const void *value, uint8_t len, uint64_t current_time);
+esp_err_t espnow_agg_flush(espnow_aggregator_t *agg, uint64_t current_time);
+
+//! flushes on the deadline, call from the main loop
+void espnow_agg_task(espnow_aggregator_t *agg, uint64_t current_time);
+
+//! receive side
+esp_err_t espnow_agg_register(uint8_t type, espnow_record_cb callback);
+int espnow_agg_dispatch(const espnow_received_message_t *received);
@@ -0,0 +1,254 @@
+#include "espnow_mesh.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_now.h"
+#include "esp_random.h"
+
+static const char *TAG = "ESP-NOW-MESH";
+
+static const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef struct {
+    uint8_t origin_addr[6];
+    uint8_t target_addr[6];         // a forged unicast can't shadow the group message with the same id
+    uint8_t msg_id;
+    uint32_t last_used;             // 0 marks a free entry
+} dedup_entry_t;
+
+typedef struct {
+    bool used;
+    uint64_t due_time;
+    espnow_message_t message;
+} forward_slot_t;
+
+static uint8_t self_addr[6];
+static uint8_t next_msg_id;
+static uint32_t groups[256 / 32];   // joined groups bitmap
+
+static dedup_entry_t dedup_cache[ESPNOW_MESH_DEDUP_SIZE];
+static uint32_t dedup_clock;
+static forward_slot_t forward_slots[ESPNOW_MESH_FORWARD_SLOTS];
+static espnow_mesh_stats_t mesh_stats;
+
+//! the receive callback runs in the WiFi task, the forwards go out from the main loop
+static portMUX_TYPE mesh_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+//! DEDUP
+// keyed on (origin, target, msg_id), call with mesh_lock held
+
+static dedup_entry_t *dedup_find(const espnow_message_t *message, dedup_entry_t **oldest) {
+    *oldest = &dedup_cache[0];
+
+    for (int i = 0; i < ESPNOW_MESH_DEDUP_SIZE; i++) {
+        dedup_entry_t *entry = &dedup_cache[i];
+
+        if (entry->last_used && entry->msg_id == message->msg_id &&
+            memcmp(entry->origin_addr, message->origin_addr, sizeof(entry->origin_addr)) == 0 &&
+            memcmp(entry->target_addr, message->target_addr, sizeof(entry->target_addr)) == 0) {
+            return entry;
+        }
+
+        if (entry->last_used < (*oldest)->last_used) *oldest = entry;
+    }
+    return NULL;
+}
+
+// returns true when the message was already seen, records it otherwise
+static bool dedup_check(const espnow_message_t *message) {
+    dedup_entry_t *oldest;
+    dedup_entry_t *entry = dedup_find(message, &oldest);
+    dedup_clock++;
+
+    if (entry) {
+        entry->last_used = dedup_clock;
+        return true;
+    }
+
+    //! evict the least recently seen entry
+    memcpy(oldest->origin_addr, message->origin_addr, sizeof(oldest->origin_addr));
+    memcpy(oldest->target_addr, message->target_addr, sizeof(oldest->target_addr));
+    oldest->msg_id = message->msg_id;
+    oldest->last_used = dedup_clock;
+    return false;
+}
+
+
+//! GROUPS
+
+static bool group_joined(uint8_t group_id) {
+    return group_id == ESPNOW_GROUP_ALL || (groups[group_id >> 5] & (1u << (group_id & 31)));
+}
+
+void espnow_mesh_join_group(uint8_t group_id) {
+    taskENTER_CRITICAL(&mesh_lock);
+    groups[group_id >> 5] |= 1u << (group_id & 31);
+    taskEXIT_CRITICAL(&mesh_lock);
+}
+
+void espnow_mesh_leave_group(uint8_t group_id) {
+    taskENTER_CRITICAL(&mesh_lock);
+    groups[group_id >> 5] &= ~(1u << (group_id & 31));
+    taskEXIT_CRITICAL(&mesh_lock);
+}
+
+
+//! MESH
+
+void espnow_mesh_setup(const uint8_t *self_mac) {
+    memcpy(self_addr, self_mac, sizeof(self_addr));
+
+    //! random start so a rebooted node doesn't replay ids still in its neighbours' caches
+    next_msg_id = esp_random();
+}
+
+esp_err_t espnow_mesh_stamp(espnow_message_t *message) {
+    taskENTER_CRITICAL(&mesh_lock);
+    memcpy(message->origin_addr, self_addr, sizeof(message->origin_addr));
+    message->msg_id = next_msg_id++;
+    message->hop_count = 0;
+    if (message->time_to_live == 0) message->time_to_live = ESPNOW_MESH_DEFAULT_TTL;
+
+    //! our own message echoed back by a neighbour is a duplicate
+    dedup_check(message);
+    mesh_stats.originated++;
+    taskEXIT_CRITICAL(&mesh_lock);
+
+    //! sealing covers the stamped header, so it comes last
+    esp_err_t err = espnow_seal_message(message);
+    if (err != ESP_OK) return err;
+
+    taskENTER_CRITICAL(&mesh_lock);
+    mesh_stats.tx_bytes += espnow_message_size(message);
+    taskEXIT_CRITICAL(&mesh_lock);
+    return ESP_OK;
+}
+
+esp_err_t espnow_mesh_send(espnow_message_t *message) {
+    esp_err_t err = espnow_mesh_stamp(message);
+    if (err != ESP_OK) return err;
+    return espnow_send((uint8_t*)message, espnow_message_size(message));
+}
+
+// call with mesh_lock held
+static bool queue_forward(const espnow_message_t *message, uint64_t current_time) {
+    if (message->time_to_live <= 1) {
+        mesh_stats.ttl_expired++;
+        return false;
+    }
+
+    forward_slot_t *slot = NULL;
+    for (int i = 0; i < ESPNOW_MESH_FORWARD_SLOTS && slot == NULL; i++) {
+        if (!forward_slots[i].used) slot = &forward_slots[i];
+    }
+
+    if (slot == NULL) {
+        mesh_stats.forward_dropped++;
+        return false;
+    }
+
+    uint32_t jitter = ESPNOW_MESH_JITTER_MIN_US +
+        esp_random() % (ESPNOW_MESH_JITTER_MAX_US - ESPNOW_MESH_JITTER_MIN_US + 1);
+    slot->used = true;
+    slot->due_time = current_time + jitter;
+    slot->message = *message;
+    slot->message.time_to_live--;
+    slot->message.hop_count++;
+    return true;
+}
+
+bool espnow_mesh_receive(const uint8_t *src_addr, const espnow_message_t *message, uint64_t current_time) {
+    bool for_self = memcmp(message->target_addr, self_addr, sizeof(self_addr)) == 0;
+    bool for_all = memcmp(message->target_addr, broadcast_mac, sizeof(broadcast_mac)) == 0;
+    bool deliver = false;
+
+    taskENTER_CRITICAL(&mesh_lock);
+    mesh_stats.received++;
+
+    if (dedup_check(message)) {
+        mesh_stats.duplicates++;
+        taskEXIT_CRITICAL(&mesh_lock);
+        return false;
+    }
+
+    if (for_self || for_all) {
+        deliver = group_joined(message->group_id);
+        if (deliver) {
+            mesh_stats.delivered++;
+            mesh_stats.hops[MIN(message->hop_count, ESPNOW_MESH_MAX_HOPS - 1)]++;
+        } else {
+            mesh_stats.group_filtered++;
+        }
+    }
+
+    //! a unicast that reached its target stops here
+    if (!for_self) {
+        queue_forward(message, current_time);
+    }
+
+    taskEXIT_CRITICAL(&mesh_lock);
+    return deliver;
+}
+
+bool espnow_mesh_seen(const espnow_message_t *message) {
+    dedup_entry_t *oldest;
+
+    taskENTER_CRITICAL(&mesh_lock);
+    bool seen = dedup_find(message, &oldest) != NULL;
+    if (seen) {
+        mesh_stats.received++;
+        mesh_stats.duplicates++;
+    }
+    taskEXIT_CRITICAL(&mesh_lock);
+    return seen;
+}
+
+bool espnow_mesh_inject(const espnow_message_t *message, uint64_t current_time) {
+    bool queued = false;
+
+    taskENTER_CRITICAL(&mesh_lock);
+    if (dedup_check(message)) {
+        mesh_stats.duplicates++;
+    } else {
+        queued = queue_forward(message, current_time);
+    }
+    taskEXIT_CRITICAL(&mesh_lock);
+    return queued;
+}
+
+void espnow_mesh_task(uint64_t current_time) {
+    for (int i = 0; i < ESPNOW_MESH_FORWARD_SLOTS; i++) {
+        espnow_message_t message;
+
+        taskENTER_CRITICAL(&mesh_lock);
+        bool ready = forward_slots[i].used && current_time >= forward_slots[i].due_time;
+        if (ready) {
+            message = forward_slots[i].message;
+            forward_slots[i].used = false;
+        }
+        taskEXIT_CRITICAL(&mesh_lock);
+
+        if (!ready) continue;
+
+        //! forwards bypass the origin rate limit, they were already admitted upstream
+        esp_err_t err = esp_now_send(broadcast_mac, (uint8_t*)&message, espnow_message_size(&message));
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "forward failed: %s", esp_err_to_name(err));
+            continue;
+        }
+
+        taskENTER_CRITICAL(&mesh_lock);
+        mesh_stats.forwarded++;
+        mesh_stats.tx_bytes += espnow_message_size(&message);
+        taskEXIT_CRITICAL(&mesh_lock);
+    }
+}
+
+void espnow_mesh_get_stats(espnow_mesh_stats_t *stats) {
+    taskENTER_CRITICAL(&mesh_lock);
+    *stats = mesh_stats;
+    taskEXIT_CRITICAL(&mesh_lock);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "mod_espnow.h"
+
+//# Flooding mesh over broadcast ESP-NOW. Every node delivers a message once,
+//# then rebroadcasts it with time_to_live - 1 after a random jitter so
+//# neighbours don't collide. Duplicates are dropped through an LRU cache keyed
+//# on (origin_addr, target_addr, msg_id). Secure frames reach the cache only
+//# once they opened, a forged copy can't suppress the real one.
+
+#ifndef ESPNOW_MESH_DEDUP_SIZE
+#define ESPNOW_MESH_DEDUP_SIZE 32
+#endif
+
+#ifndef ESPNOW_MESH_FORWARD_SLOTS
+#define ESPNOW_MESH_FORWARD_SLOTS 8
+#endif
+
+#ifndef ESPNOW_MESH_JITTER_MIN_US
+#define ESPNOW_MESH_JITTER_MIN_US 2000
+#endif
+
+#ifndef ESPNOW_MESH_JITTER_MAX_US
+#define ESPNOW_MESH_JITTER_MAX_US 20000
+#endif
+
+#define ESPNOW_MESH_DEFAULT_TTL 5
+#define ESPNOW_MESH_MAX_HOPS 16
+#define ESPNOW_GROUP_ALL 0              // delivered to every node
+
+typedef struct {
+    uint32_t originated;
+    uint32_t received;
+    uint32_t delivered;
+    uint32_t duplicates;
+    uint32_t group_filtered;        // forwarded but not for us
+    uint32_t ttl_expired;
+    uint32_t forwarded;
+    uint32_t forward_dropped;       // no free forward slot
+    uint32_t tx_bytes;              // originated + forwarded, for airtime
+    uint32_t hops[ESPNOW_MESH_MAX_HOPS];    // delivered messages by hop count
+} espnow_mesh_stats_t;
+
+void espnow_mesh_setup(const uint8_t *self_mac);
+void espnow_mesh_join_group(uint8_t group_id);
+void espnow_mesh_leave_group(uint8_t group_id);
+
+//! stamps origin_addr, msg_id and hop_count, time_to_live 0 uses ESPNOW_MESH_DEFAULT_TTL,
+//! then seals the payload when ESPNOW_FLAG_SECURE is set
+esp_err_t espnow_mesh_stamp(espnow_message_t *message);
+esp_err_t espnow_mesh_send(espnow_message_t *message);
+
+//! records and forwards the message, returns true when it is for this node,
+//! secure frames are passed still sealed and only after they opened
+bool espnow_mesh_receive(const uint8_t *src_addr, const espnow_message_t *message, uint64_t current_time);
+
+//! lookup without recording it, lets the receive callback drop duplicates early,
+//! a hit counts as a duplicate
+bool espnow_mesh_seen(const espnow_message_t *message);
+
+//! rebroadcasts a frame that arrived over another link (LoRa bridge) as one more hop,
+//! returns false for duplicates, an expired TTL or no free forward slot
+bool espnow_mesh_inject(const espnow_message_t *message, uint64_t current_time);
+
+//! sends the forwards whose jitter elapsed, call from the main loop
+void espnow_mesh_task(uint64_t current_time);
+void espnow_mesh_get_stats(espnow_mesh_stats_t *stats);
@@ -0,0 +1,345 @@
+#include "espnow_reliable.h"
+#include "espnow_mesh.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_now.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+static const char *TAG = "ESP-NOW-RELIABLE";
+
+typedef struct {
+    bool used;
+    bool acked;
+    uint8_t mac[6];
+    uint8_t attempts;
+    uint64_t queued_time;
+    uint64_t sent_time;
+    uint64_t next_time;
+    uint64_t ack_time;
+    espnow_delivery_cb callback;
+    espnow_message_t message;
+} pending_slot_t;
+
+typedef struct {
+    uint8_t mac[6];
+    uint8_t msg_id;
+    bool secure;                    // answered with a sealed ACK
+} pending_ack_t;
+
+static uint8_t self_addr[6];
+
+static espnow_peer_t peers[ESPNOW_MAX_PEERS];
+static uint8_t peer_count;
+
+static pending_slot_t slots[ESPNOW_RELIABLE_SLOTS];
+static pending_ack_t ack_queue[ESPNOW_ACK_QUEUE_SIZE];
+static uint8_t ack_head, ack_tail;          // free running, used = head - tail
+
+static espnow_reliable_stats_t reliable_stats;
+
+//! receive and send callbacks run in the WiFi task, everything else in the main loop
+static portMUX_TYPE reliable_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+//! PEERS
+
+static espnow_peer_t *find_peer(const uint8_t *mac) {
+    for (int i = 0; i < peer_count; i++) {
+        if (memcmp(peers[i].mac, mac, sizeof(peers[i].mac)) == 0) return &peers[i];
+    }
+    return NULL;
+}
+
+esp_err_t espnow_peer_add(const uint8_t *mac) {
+    uint8_t evicted[6];
+    bool evict = false;
+
+    taskENTER_CRITICAL(&reliable_lock);
+    espnow_peer_t *peer = find_peer(mac);
+    if (peer) {
+        taskEXIT_CRITICAL(&reliable_lock);
+        return ESP_OK;
+    }
+
+    if (peer_count < ESPNOW_MAX_PEERS) {
+        peer = &peers[peer_count++];
+    } else {
+        //! table full: reuse the peer heard from least recently
+        peer = &peers[0];
+        for (int i = 1; i < peer_count; i++) {
+            if (peers[i].last_seen < peer->last_seen) peer = &peers[i];
+        }
+        memcpy(evicted, peer->mac, sizeof(evicted));
+        evict = true;
+    }
+
+    *peer = (espnow_peer_t){ .last_seen = esp_timer_get_time() };
+    memcpy(peer->mac, mac, sizeof(peer->mac));
+    taskEXIT_CRITICAL(&reliable_lock);
+
+    if (evict) esp_now_del_peer(evicted);
+
+    esp_now_peer_info_t peer_info = {
+        .channel = ESPNOW_CHANNEL,
+        .encrypt = false,
+    };
+    memcpy(peer_info.peer_addr, mac, sizeof(peer_info.peer_addr));
+
+    esp_err_t err = esp_now_add_peer(&peer_info);
+    if (err == ESP_ERR_ESPNOW_EXIST) err = ESP_OK;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "add peer failed: %s", esp_err_to_name(err));
+        espnow_peer_remove(mac);
+    }
+    return err;
+}
+
+esp_err_t espnow_peer_remove(const uint8_t *mac) {
+    taskENTER_CRITICAL(&reliable_lock);
+    espnow_peer_t *peer = find_peer(mac);
+    if (peer) *peer = peers[--peer_count];
+    taskEXIT_CRITICAL(&reliable_lock);
+
+    if (peer == NULL) return ESP_ERR_NOT_FOUND;
+    esp_err_t err = esp_now_del_peer(mac);
+    return err == ESP_ERR_ESPNOW_NOT_FOUND ? ESP_OK : err;
+}
+
+bool espnow_peer_get(const uint8_t *mac, espnow_peer_t *peer) {
+    taskENTER_CRITICAL(&reliable_lock);
+    espnow_peer_t *found = find_peer(mac);
+    if (found) *peer = *found;
+    taskEXIT_CRITICAL(&reliable_lock);
+    return found != NULL;
+}
+
+
+//! SEND
+
+void espnow_reliable_setup(const uint8_t *self_mac) {
+    memcpy(self_addr, self_mac, sizeof(self_addr));
+}
+
+esp_err_t espnow_send_reliable(const uint8_t *mac, espnow_message_t *message, espnow_delivery_cb callback) {
+    esp_err_t err = espnow_peer_add(mac);
+    if (err != ESP_OK) return err;
+
+    //! kept in clear and sealed per transmit, a retry under the old counter would be dropped as a replay
+    uint8_t secure = message->flags & ESPNOW_FLAG_SECURE;
+    memcpy(message->target_addr, mac, sizeof(message->target_addr));
+    message->flags = (message->flags & ~ESPNOW_FLAG_SECURE) | ESPNOW_FLAG_ACK_REQ;
+    err = espnow_mesh_stamp(message);
+    message->flags |= secure;
+    if (err != ESP_OK) return err;
+
+    taskENTER_CRITICAL(&reliable_lock);
+    pending_slot_t *slot = NULL;
+    for (int i = 0; i < ESPNOW_RELIABLE_SLOTS && slot == NULL; i++) {
+        if (!slots[i].used) slot = &slots[i];
+    }
+
+    if (slot) {
+        uint64_t current_time = esp_timer_get_time();
+        *slot = (pending_slot_t){
+            .used = true,
+            .queued_time = current_time,
+            .next_time = current_time,
+            .callback = callback,
+            .message = *message,
+        };
+        memcpy(slot->mac, mac, sizeof(slot->mac));
+        reliable_stats.queued++;
+    } else {
+        reliable_stats.busy++;
+    }
+    taskEXIT_CRITICAL(&reliable_lock);
+
+    return slot ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+
+//! CALLBACKS
+
+bool espnow_reliable_receive(const uint8_t *src_addr, const espnow_message_t *message) {
+    uint64_t current_time = esp_timer_get_time();
+    bool consumed = false;
+
+    taskENTER_CRITICAL(&reliable_lock);
+    espnow_peer_t *peer = find_peer(src_addr);
+    if (peer) peer->last_seen = current_time;
+
+    if (message->flags & ESPNOW_FLAG_ACK) {
+        consumed = true;
+        reliable_stats.acks_received++;
+
+        for (int i = 0; i < ESPNOW_RELIABLE_SLOTS; i++) {
+            pending_slot_t *slot = &slots[i];
+            if (!slot->used || slot->acked || slot->message.msg_id != message->msg_id) continue;
+            if (memcmp(slot->mac, message->origin_addr, sizeof(slot->mac)) != 0) continue;
+
+            //! a plain ACK is unauthenticated, anyone could complete a secure send with it
+            if ((slot->message.flags & ESPNOW_FLAG_SECURE) && !(message->flags & ESPNOW_FLAG_SECURE)) continue;
+
+            slot->acked = true;
+            slot->ack_time = current_time;
+
+            if (peer) {
+                uint32_t rtt = current_time - slot->sent_time;
+                peer->srtt_us = peer->srtt_us ? (peer->srtt_us * 7 + rtt) / 8 : rtt;
+            }
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&reliable_lock);
+
+    return !consumed;
+}
+
+bool espnow_reliable_wants_ack(const espnow_message_t *message) {
+    return (message->flags & ESPNOW_FLAG_ACK_REQ) &&
+           memcmp(message->target_addr, self_addr, sizeof(self_addr)) == 0;
+}
+
+void espnow_reliable_ack(const uint8_t *src_addr, const espnow_message_t *message) {
+    //! the peer may not be registered yet, the ACK goes out from espnow_reliable_task
+    taskENTER_CRITICAL(&reliable_lock);
+    if ((uint8_t)(ack_head - ack_tail) < ESPNOW_ACK_QUEUE_SIZE) {
+        pending_ack_t *ack = &ack_queue[ack_head++ % ESPNOW_ACK_QUEUE_SIZE];
+        memcpy(ack->mac, src_addr, sizeof(ack->mac));
+        ack->msg_id = message->msg_id;
+        ack->secure = message->flags & ESPNOW_FLAG_SECURE;
+    }
+    taskEXIT_CRITICAL(&reliable_lock);
+}
+
+//! link layer status only feeds the peer stats: a frame the MAC acked can still
+//! be dropped before the application, so delivery is decided by our own ACK
+void espnow_reliable_on_sent(const uint8_t *mac, bool success) {
+    taskENTER_CRITICAL(&reliable_lock);
+    espnow_peer_t *peer = find_peer(mac);
+    if (peer) {
+        if (success) peer->tx_ok++;
+        else peer->tx_fail++;
+    }
+    taskEXIT_CRITICAL(&reliable_lock);
+}
+
+
+//! TASK
+
+static void send_acks(void) {
+    while (1) {
+        pending_ack_t ack;
+
+        taskENTER_CRITICAL(&reliable_lock);
+        bool available = ack_head != ack_tail;
+        if (available) ack = ack_queue[ack_tail++ % ESPNOW_ACK_QUEUE_SIZE];
+        taskEXIT_CRITICAL(&reliable_lock);
+
+        if (!available) return;
+        if (espnow_peer_add(ack.mac) != ESP_OK) continue;
+
+        espnow_message_t message = {
+            .msg_id = ack.msg_id,
+            .flags = ESPNOW_FLAG_ACK | (ack.secure ? ESPNOW_FLAG_SECURE : 0),
+        };
+        memcpy(message.target_addr, ack.mac, sizeof(message.target_addr));
+        memcpy(message.origin_addr, self_addr, sizeof(message.origin_addr));
+        if (espnow_seal_message(&message) != ESP_OK) continue;
+
+        //! ACKs bypass the token bucket, dropping one only causes another retry
+        if (esp_now_send(ack.mac, (uint8_t*)&message, espnow_message_size(&message)) == ESP_OK) {
+            taskENTER_CRITICAL(&reliable_lock);
+            reliable_stats.acks_sent++;
+            taskEXIT_CRITICAL(&reliable_lock);
+        }
+    }
+}
+
+static uint32_t ack_timeout(const uint8_t *mac, uint8_t attempts) {
+    espnow_peer_t *peer = find_peer(mac);
+    uint32_t timeout = peer ? MAX(ESPNOW_ACK_TIMEOUT_US, peer->srtt_us * 2) : ESPNOW_ACK_TIMEOUT_US;
+
+    //! exponential backoff with up to 25% jitter so colliding senders drift apart
+    timeout <<= attempts - 1;
+    return timeout + esp_random() % (timeout / 4 + 1);
+}
+
+static void complete(pending_slot_t *slot, bool delivered, uint64_t current_time) {
+    uint32_t latency_us = (delivered ? slot->ack_time : current_time) - slot->queued_time;
+    espnow_delivery_cb callback = slot->callback;
+    uint8_t mac[6], msg_id = slot->message.msg_id;
+    memcpy(mac, slot->mac, sizeof(mac));
+
+    taskENTER_CRITICAL(&reliable_lock);
+    slot->used = false;
+    if (delivered) {
+        reliable_stats.delivered++;
+        uint32_t bucket = 0;
+        while (bucket < ESPNOW_LATENCY_BUCKETS - 1 && (latency_us / 1000) >= (1u << bucket)) bucket++;
+        reliable_stats.latency_hist[bucket]++;
+    } else {
+        reliable_stats.failed++;
+    }
+    taskEXIT_CRITICAL(&reliable_lock);
+
+    if (!delivered) ESP_LOGW(TAG, "msg %d to " MACSTR " not acked", msg_id, MAC2STR(mac));
+    if (callback) callback(mac, msg_id, delivered, latency_us);
+}
+
+void espnow_reliable_task(uint64_t current_time) {
+    send_acks();
+
+    for (int i = 0; i < ESPNOW_RELIABLE_SLOTS; i++) {
+        pending_slot_t *slot = &slots[i];
+
+        taskENTER_CRITICAL(&reliable_lock);
+        bool used = slot->used, acked = slot->acked;
+        taskEXIT_CRITICAL(&reliable_lock);
+
+        if (!used) continue;
+        if (acked) {
+            complete(slot, true, current_time);
+            continue;
+        }
+        if (current_time < slot->next_time) continue;
+
+        if (slot->attempts > ESPNOW_MAX_RETRIES) {
+            complete(slot, false, current_time);
+            continue;
+        }
+
+        espnow_message_t frame = slot->message;
+        esp_err_t err = espnow_seal_message(&frame);
+        if (err != ESP_OK) {
+            complete(slot, false, current_time);
+            continue;
+        }
+        err = espnow_send_to(slot->mac, &frame, espnow_message_size(&frame));
+
+        taskENTER_CRITICAL(&reliable_lock);
+        if (err == ESP_ERR_TIMEOUT) {
+            //! rate limited, not an attempt
+            reliable_stats.rate_limited++;
+            slot->next_time = current_time + 1000000 / ESPNOW_TX_RATE_PER_SEC;
+        } else {
+            if (slot->attempts > 0) reliable_stats.retries++;
+            reliable_stats.transmits++;
+            slot->attempts++;
+            slot->sent_time = current_time;
+            slot->next_time = current_time + ack_timeout(slot->mac, slot->attempts);
+        }
+        taskEXIT_CRITICAL(&reliable_lock);
+    }
+}
+
+void espnow_reliable_get_stats(espnow_reliable_stats_t *stats) {
+    taskENTER_CRITICAL(&reliable_lock);
+    *stats = reliable_stats;
+    taskEXIT_CRITICAL(&reliable_lock);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "mod_espnow.h"
+
+//# Reliable unicast: frames go straight to a peer registered with
+//# esp_now_add_peer, carry ESPNOW_FLAG_ACK_REQ and are resent with
+//# exponential backoff until the receiver's ACK comes back or the retries
+//# run out. ACKs are answered for duplicates too, the first one may be lost,
+//# but only once the frame authenticated: secure frames are sealed again on
+//# every retry so the receiver's replay window accepts them, and their ACK is
+//# sealed as well so a forged one can't complete the send.
+
+#ifndef ESPNOW_MAX_PEERS
+#define ESPNOW_MAX_PEERS 8                  // esp_now allows 20, the broadcast peer included
+#endif
+
+#ifndef ESPNOW_RELIABLE_SLOTS
+#define ESPNOW_RELIABLE_SLOTS 8             // unicasts waiting for an ACK
+#endif
+
+#ifndef ESPNOW_ACK_TIMEOUT_US
+#define ESPNOW_ACK_TIMEOUT_US 30000         // first retry, doubles on every attempt
+#endif
+
+#ifndef ESPNOW_MAX_RETRIES
+#define ESPNOW_MAX_RETRIES 4
+#endif
+
+#define ESPNOW_ACK_QUEUE_SIZE 8
+#define ESPNOW_LATENCY_BUCKETS 12           // bucket n counts latencies below 2^n ms
+
+typedef struct {
+    uint8_t mac[6];
+    uint64_t last_seen;
+    uint32_t tx_ok;                 // link layer status from the send callback
+    uint32_t tx_fail;
+    uint32_t srtt_us;               // smoothed ACK round trip
+} espnow_peer_t;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t busy;                  // no free slot
+    uint32_t transmits;
+    uint32_t retries;
+    uint32_t rate_limited;
+    uint32_t delivered;
+    uint32_t failed;
+    uint32_t acks_sent;
+    uint32_t acks_received;
+    uint32_t latency_hist[ESPNOW_LATENCY_BUCKETS];
+} espnow_reliable_stats_t;
+
+typedef void (*espnow_delivery_cb)(const uint8_t *mac, uint8_t msg_id, bool delivered, uint32_t latency_us);
+
+void espnow_reliable_setup(const uint8_t *self_mac);
+
+esp_err_t espnow_peer_add(const uint8_t *mac);
+esp_err_t espnow_peer_remove(const uint8_t *mac);
+bool espnow_peer_get(const uint8_t *mac, espnow_peer_t *peer);
+
+//! stamps the message like espnow_mesh_send, the result is reported through callback
+esp_err_t espnow_send_reliable(const uint8_t *mac, espnow_message_t *message, espnow_delivery_cb callback);
+
+//! called from espnow_task once the frame opened, returns false for frames consumed here (ACKs)
+bool espnow_reliable_receive(const uint8_t *src_addr, const espnow_message_t *message);
+void espnow_reliable_on_sent(const uint8_t *mac, bool success);
+
+//! true for unicasts to this node that ask for an ACK
+bool espnow_reliable_wants_ack(const espnow_message_t *message);
+
+//! queues the ACK, call only after espnow_open_message accepted the frame
+void espnow_reliable_ack(const uint8_t *src_addr, const espnow_message_t *message);
+
+//! (re)transmits and completes pending unicasts, call from the main loop
+void espnow_reliable_task(uint64_t current_time);
+void espnow_reliable_get_stats(espnow_reliable_stats_t *stats);
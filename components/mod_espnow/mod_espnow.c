@@ -1,6 +1,12 @@
 #include "mod_espnow.h"
+#include "espnow_mesh.h"
+#include "espnow_reliable.h"
+#include "espnow_aggregate.h"
+#include "secure_session.h"
 
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 #include "esp_timer.h"
 #include "esp_log.h"
 
@@ -14,46 +20,277 @@
 #include "esp_crc.h"
 
 #define ESPNOW_MAXDELAY 512
-#define ESPNOW_CHANNEL 6
 #define CONFIG_ESPNOW_PMK "pmk1234567890123"
-#define ESPNOW_QUEUE_SIZE           6
 
 static const char *TAG = "ESP-NOW";
 
 #define BROADCAST_ADDRESS {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}
 static const uint8_t broadcast_mac[] = BROADCAST_ADDRESS;
+static uint8_t self_addr[6];
 
-static uint64_t last_update_time = 0;
-static uint64_t current_time;
 static espnow_message_cb message_callback = NULL;
+static espnow_message_cb tap_callback = NULL;
 
+typedef struct {
+    espnow_received_message_t info;
+    espnow_message_t message;
+} rx_slot_t;
+
+static rx_slot_t rx_pool[ESPNOW_QUEUE_SIZE];
+static uint32_t rx_free_mask = (1u << ESPNOW_QUEUE_SIZE) - 1;
+static QueueHandle_t rx_queue;
+static espnow_rx_stats_t rx_stats;
+static portMUX_TYPE rx_lock = portMUX_INITIALIZER_UNLOCKED;
+
+_Static_assert(ESPNOW_QUEUE_SIZE <= 32, "rx_free_mask holds one bit per pool slot");
+
+// tokens scaled by 1000000 so refill stays integer per elapsed us
+static uint64_t bucket_tokens = ESPNOW_TX_BURST * 1000000ULL;
+static uint64_t bucket_time;
+static portMUX_TYPE bucket_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool take_token(uint64_t current_time) {
+    const uint64_t capacity = ESPNOW_TX_BURST * 1000000ULL;
+    bool ok = false;
+
+    taskENTER_CRITICAL(&bucket_lock);
+    bucket_tokens += (current_time - bucket_time) * ESPNOW_TX_RATE_PER_SEC;
+    if (bucket_tokens > capacity) bucket_tokens = capacity;
+    bucket_time = current_time;
+
+    if (bucket_tokens >= 1000000ULL) {
+        bucket_tokens -= 1000000ULL;
+        ok = true;
+    }
+    taskEXIT_CRITICAL(&bucket_lock);
+    return ok;
+}
+
+static void espnow_send_cb(const uint8_t *mac_addr, esp_now_send_status_t status) {
+    espnow_reliable_on_sent(mac_addr, status == ESP_NOW_SEND_SUCCESS);
+}
+
+//! RECEIVE
+
+esp_err_t espnow_parse_message(const uint8_t *data, int len, espnow_message_t *message, uint8_t *data_len) {
+    if (data == NULL || len < (int)ESPNOW_HEADER_SIZE || len > (int)sizeof(espnow_message_t)) return ESP_ERR_INVALID_SIZE;
+
+    //! the only copy out of the WiFi buffer, the unused payload is zero padded
+    memcpy(message, data, len);
+    memset((uint8_t*)message + len, 0, sizeof(espnow_message_t) - len);
+    if (message->data_len > len - ESPNOW_HEADER_SIZE) return ESP_ERR_INVALID_SIZE;
+    *data_len = message->data_len;
+
+    if (message->flags & ~(ESPNOW_FLAG_ACK_REQ | ESPNOW_FLAG_ACK | ESPNOW_FLAG_AGGREGATE | ESPNOW_FLAG_SECURE)) return ESP_ERR_INVALID_ARG;
+    if ((message->flags & ESPNOW_FLAG_ACK) && (message->flags & ESPNOW_FLAG_ACK_REQ)) return ESP_ERR_INVALID_ARG;
+    if (message->origin_addr[0] & 0x01) return ESP_ERR_INVALID_ARG;         // multicast can't originate
+    return ESP_OK;
+}
+
+//! SECURE
+// The header is authenticated but stays in clear so the mesh can dedup and forward.
+// time_to_live and hop_count change on every hop, data_len changes with the seal.
+
+static void make_aad(const espnow_message_t *message, uint8_t *aad) {
+    memcpy(aad, message, ESPNOW_HEADER_SIZE);
+    aad[offsetof(espnow_message_t, time_to_live)] = 0;
+    aad[offsetof(espnow_message_t, hop_count)] = 0;
+    aad[offsetof(espnow_message_t, data_len)] = 0;
+}
+
+// broadcasts use the group key stored under the broadcast MAC, unicasts the pairwise key
+static const uint8_t *key_owner(const espnow_message_t *message, const uint8_t *peer_addr) {
+    return memcmp(message->target_addr, broadcast_mac, sizeof(broadcast_mac)) == 0 ? broadcast_mac : peer_addr;
+}
+
+esp_err_t espnow_seal_message(espnow_message_t *message) {
+    if (!(message->flags & ESPNOW_FLAG_SECURE)) return ESP_OK;
+
+    uint8_t aad[ESPNOW_HEADER_SIZE];
+    make_aad(message, aad);
+
+    size_t len;
+    esp_err_t err = secure_session_seal(key_owner(message, message->target_addr), aad, sizeof(aad),
+                                        message->data, message->data_len, ESPNOW_MAX_DATA_LEN, &len);
+    if (err == ESP_OK) message->data_len = len;
+    return err;
+}
+
+esp_err_t espnow_open_message(espnow_message_t *message) {
+    if (!(message->flags & ESPNOW_FLAG_SECURE)) return ESP_OK;
+
+    uint8_t aad[ESPNOW_HEADER_SIZE];
+    make_aad(message, aad);
+
+    size_t len;
+    esp_err_t err = secure_session_open(key_owner(message, message->origin_addr), message->origin_addr,
+                                        aad, sizeof(aad), message->data, message->data_len, &len);
+    if (err == ESP_OK) message->data_len = len;
+    return err;
+}
+
+
+//! RECEIVE POOL
+
+static int rx_alloc(void) {
+    int index = -1;
+    taskENTER_CRITICAL(&rx_lock);
+    if (rx_free_mask) {
+        index = __builtin_ctz(rx_free_mask);
+        rx_free_mask &= ~(1u << index);
+    }
+    taskEXIT_CRITICAL(&rx_lock);
+    return index;
+}
+
+static void rx_release(int index) {
+    taskENTER_CRITICAL(&rx_lock);
+    rx_free_mask |= 1u << index;
+    taskEXIT_CRITICAL(&rx_lock);
+}
+
+static void rx_count(uint32_t *counter) {
+    taskENTER_CRITICAL(&rx_lock);
+    (*counter)++;
+    taskEXIT_CRITICAL(&rx_lock);
+}
+
+// WiFi task: validate into a pool slot, never blocks. Nothing here is
+// authenticated yet, ACKs, dedup and forwarding wait for espnow_task
 static void espnow_recv_cb(const esp_now_recv_info_t *recv_info, const uint8_t *data, int len)
 {
-    if (message_callback == NULL) return;
-    if (len < sizeof(espnow_message_t)) {
-        ESP_LOGE(TAG, "Received data size mismatch. Expected at least %d bytes, got %d", sizeof(espnow_message_t), len);
+    rx_count(&rx_stats.received);
+
+    int index = rx_alloc();
+    if (index < 0) {
+        rx_count(&rx_stats.pool_full);
         return;
     }
 
-    espnow_received_message_t received_message = {
-        .rssi = recv_info->rx_ctrl->rssi,
-        .channel = recv_info->rx_ctrl->channel,
-        .message =  (espnow_message_t *)data
-    };
-    // received_message.message = (espnow_message_t *)data;
-    memcpy(received_message.src_addr, recv_info->src_addr, sizeof(received_message.src_addr));
+    rx_slot_t *slot = &rx_pool[index];
+    if (espnow_parse_message(data, len, &slot->message, &slot->info.data_len) != ESP_OK) {
+        rx_count(&rx_stats.malformed);
+        rx_release(index);
+        return;
+    }
 
-    message_callback(received_message);
+    //! the cache only holds opened frames, a retry still needs its ACK and ACKs carry our msg_id
+    if (!(slot->message.flags & ESPNOW_FLAG_ACK) && !espnow_reliable_wants_ack(&slot->message) &&
+        espnow_mesh_seen(&slot->message)) {
+        rx_count(&rx_stats.consumed);
+        rx_release(index);
+        return;
+    }
+
+    slot->info.rssi = recv_info->rx_ctrl->rssi;
+    slot->info.channel = recv_info->rx_ctrl->channel;
+    slot->info.message = &slot->message;
+    memcpy(slot->info.src_addr, recv_info->src_addr, sizeof(slot->info.src_addr));
+
+    uint8_t queued = index;
+    if (xQueueSend(rx_queue, &queued, 0) != pdTRUE) {
+        rx_count(&rx_stats.pool_full);
+        rx_release(index);
+    }
+}
+
+void espnow_task(uint64_t current_time) {
+    uint8_t index;
+
+    //! the queue holds at most one entry per pool slot, draining it is bounded
+    while (rx_queue && xQueueReceive(rx_queue, &index, 0) == pdTRUE) {
+        rx_slot_t *slot = &rx_pool[index];
+        espnow_received_message_t *received = &slot->info;
+        espnow_message_t *message = received->message;
+        bool secure = message->flags & ESPNOW_FLAG_SECURE;
+        bool for_self = memcmp(message->target_addr, self_addr, sizeof(self_addr)) == 0;
+        bool for_all = memcmp(message->target_addr, broadcast_mac, sizeof(broadcast_mac)) == 0;
+
+        //! a relay holds no pairwise key, sealed unicasts between other nodes pass through unopened
+        if (secure && !for_self && !for_all) {
+            espnow_mesh_receive(received->src_addr, message, current_time);
+            rx_release(index);
+            rx_count(&rx_stats.consumed);
+            continue;
+        }
+
+        //! forwards and the tap carry the frame as it came over the air
+        espnow_message_t sealed;
+        if (secure) sealed = *message;
+
+        //! decrypted here rather than in the WiFi task, the session lock may block.
+        //! Everything below trusts the header: a forged frame gets no ACK, completes
+        //! no pending send and leaves no dedup entry
+        if (espnow_open_message(message) != ESP_OK) {
+            rx_release(index);
+            rx_count(&rx_stats.auth_failed);
+            continue;
+        }
+        received->data_len = message->data_len;
+
+        //! a retry of one already delivered gets its ACK again
+        if (espnow_reliable_wants_ack(message)) {
+            espnow_reliable_ack(received->src_addr, message);
+        }
+
+        //! mesh forwarding runs even without an application callback
+        bool has_handler = message_callback != NULL || tap_callback != NULL ||
+                           (message->flags & ESPNOW_FLAG_AGGREGATE);
+        bool deliver = espnow_reliable_receive(received->src_addr, message) &&
+                       espnow_mesh_receive(received->src_addr, secure ? &sealed : message, current_time) &&
+                       has_handler;
+        if (!deliver) {
+            rx_release(index);
+            rx_count(&rx_stats.consumed);
+            continue;
+        }
+
+        if (tap_callback) {
+            espnow_received_message_t tapped = *received;
+            if (secure) {
+                tapped.message = &sealed;
+                tapped.data_len = sealed.data_len;
+            }
+            tap_callback(tapped);
+        }
+
+        if (message->flags & ESPNOW_FLAG_AGGREGATE) {
+            espnow_agg_dispatch(received);
+        } else if (message_callback) {
+            message_callback(*received);
+        }
+        rx_release(index);
+        rx_count(&rx_stats.delivered);
+    }
+
+    espnow_mesh_task(current_time);
+    espnow_reliable_task(current_time);
+}
+
+void espnow_set_tap(espnow_message_cb tap) {
+    tap_callback = tap;
+}
+
+void espnow_get_rx_stats(espnow_rx_stats_t *stats) {
+    taskENTER_CRITICAL(&rx_lock);
+    *stats = rx_stats;
+    taskEXIT_CRITICAL(&rx_lock);
 }
 
 esp_err_t espnow_setup(uint8_t* esp_mac, espnow_message_cb callback)
 {
     message_callback = callback;
+
+    rx_queue = xQueueCreate(ESPNOW_QUEUE_SIZE, sizeof(uint8_t));
+    if (rx_queue == NULL) return ESP_ERR_NO_MEM;
+
     esp_read_mac(esp_mac, 6);       //! ORDER DOES MATTER: after wifi_setup()
+    memcpy(self_addr, esp_mac, sizeof(self_addr));
 
     /* Initialize ESPNOW and register sending and receiving callback function. */
     ESP_ERROR_CHECK( esp_now_init() );
     ESP_ERROR_CHECK( esp_now_register_recv_cb(espnow_recv_cb) );
+    ESP_ERROR_CHECK( esp_now_register_send_cb(espnow_send_cb) );
 
     /* Set primary master key. */
     ESP_ERROR_CHECK( esp_now_set_pmk((uint8_t *)CONFIG_ESPNOW_PMK) );
@@ -65,17 +302,25 @@ esp_err_t espnow_setup(uint8_t* esp_mac, espnow_message_cb callback)
     memcpy(peerInfo.peer_addr, broadcast_mac, 6); // Copy address
     ESP_ERROR_CHECK(esp_now_add_peer(&peerInfo));
 
-    current_time = esp_timer_get_time();
+    espnow_mesh_setup(esp_mac);
+    espnow_reliable_setup(esp_mac);
+
+    //! secure frames fail to seal/open until the session has its NVS namespace
+    esp_err_t err = secure_session_setup(esp_mac);
+    if (err != ESP_OK) ESP_LOGW(TAG, "secure session unavailable: %s", esp_err_to_name(err));
+
+    bucket_time = esp_timer_get_time();
     return ESP_OK;
 }
 
-esp_err_t espnow_send(uint8_t* data, size_t len) {
-    current_time = esp_timer_get_time();
-    if (current_time - last_update_time < 2000000) return ESP_OK;
-    last_update_time = current_time;
+esp_err_t espnow_send_to(const uint8_t *mac, const void *data, size_t len) {
+    if (!take_token(esp_timer_get_time())) return ESP_ERR_TIMEOUT;
 
-    esp_err_t err = esp_now_send(broadcast_mac, data, len);
-    // esp_err_t err = esp_now_send(broadcast_mac, (uint8_t *) "Sending via ESP-NOW", strlen("Sending via ESP-NOW"));
-    ESP_LOGI(TAG,"esp now status : %s", esp_err_to_name(err));
+    esp_err_t err = esp_now_send(mac, data, len);
+    if (err != ESP_OK) ESP_LOGW(TAG, "esp now status : %s", esp_err_to_name(err));
     return err;
+}
+
+esp_err_t espnow_send(uint8_t* data, size_t len) {
+    return espnow_send_to(broadcast_mac, data, len);
 }
\ No newline at end of file
@@ -3,29 +3,95 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <soc/gpio_num.h>
 #include <esp_err.h> 
 
-typedef struct {
+#define ESPNOW_MAX_FRAME_LEN    250     // ESP_NOW_MAX_DATA_LEN
+#define ESPNOW_MAX_DATA_LEN     (ESPNOW_MAX_FRAME_LEN - 20)
+
+typedef struct __attribute__((packed)) {
     uint8_t target_addr[6];
+    uint8_t origin_addr[6];         // node that created the message, kept across hops
     uint8_t group_id;
     uint8_t msg_id;
     uint16_t access_code;
     uint8_t time_to_live;
-    uint8_t data[32];
+    uint8_t hop_count;
+    uint8_t flags;                  // ESPNOW_FLAG_*
+    uint8_t data_len;               // only the used part of data goes on air
+    uint8_t data[ESPNOW_MAX_DATA_LEN];
 } espnow_message_t;
 
+#define ESPNOW_FLAG_ACK_REQ     0x01    // unicast, receiver answers with an ACK
+#define ESPNOW_FLAG_ACK         0x02    // ACK for msg_id from origin_addr
+#define ESPNOW_FLAG_AGGREGATE   0x04    // data is a list of espnow_aggregate records
+#define ESPNOW_FLAG_SECURE      0x08    // data sealed by secure_session, set before sending to encrypt
+
+#ifndef ESPNOW_CHANNEL
+#define ESPNOW_CHANNEL          6
+#endif
+
+// token bucket for originated frames, forwards and ACKs are not limited
+#ifndef ESPNOW_TX_RATE_PER_SEC
+#define ESPNOW_TX_RATE_PER_SEC  20
+#endif
+
+#ifndef ESPNOW_TX_BURST
+#define ESPNOW_TX_BURST         5
+#endif
+
+// received messages wait in a fixed pool, the WiFi task passes pool indices through a queue
+#ifndef ESPNOW_QUEUE_SIZE
+#define ESPNOW_QUEUE_SIZE       6
+#endif
+
+#define ESPNOW_HEADER_SIZE      offsetof(espnow_message_t, data)
+
+_Static_assert(sizeof(espnow_message_t) == ESPNOW_MAX_FRAME_LEN, "espnow_message_t must fill one ESP-NOW frame");
+
+static inline size_t espnow_message_size(const espnow_message_t *message) {
+    return ESPNOW_HEADER_SIZE + message->data_len;
+}
+
 typedef struct {
     uint8_t src_addr[6];
     uint8_t rssi;
     uint8_t channel;
-    espnow_message_t* message;
+    uint8_t data_len;               // copy of message->data_len, the rest of data is zeroed
+    espnow_message_t* message;      // points into the pool, valid until the callback returns
 } espnow_received_message_t;
 
+typedef struct {
+    uint32_t received;
+    uint32_t malformed;
+    uint32_t pool_full;             // dropped, the application task is behind
+    uint32_t consumed;              // ACKs, duplicates, other groups
+    uint32_t auth_failed;           // secure frames that didn't open (bad tag, replay, no key)
+    uint32_t delivered;
+} espnow_rx_stats_t;
+
 typedef void (*espnow_message_cb)(espnow_received_message_t received_message);
 
 // Function prototypes
 esp_err_t espnow_setup(uint8_t* esp_mac, espnow_message_cb callback);
 esp_err_t espnow_send(uint8_t* data, size_t len);
 
+//! returns ESP_ERR_TIMEOUT without sending when the token bucket is empty
+esp_err_t espnow_send_to(const uint8_t *mac, const void *data, size_t len);
+
+//! length-checked copy of a raw frame, returns ESP_ERR_INVALID_SIZE/ESP_ERR_INVALID_ARG when malformed
+esp_err_t espnow_parse_message(const uint8_t *data, int len, espnow_message_t *message, uint8_t *data_len);
+
+//! encrypts data in place when ESPNOW_FLAG_SECURE is set, call once the header is final
+esp_err_t espnow_seal_message(espnow_message_t *message);
+esp_err_t espnow_open_message(espnow_message_t *message);
+
+//! hands queued messages to the callback, then runs mesh forwarding and retries, call from the main loop
+void espnow_task(uint64_t current_time);
+void espnow_get_rx_stats(espnow_rx_stats_t *stats);
+
+//! sees every delivered frame once it authenticated, still sealed, for relays that pass sealed frames through
+void espnow_set_tap(espnow_message_cb tap);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "secure_session.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "nvs.h"
+
+//! with CONFIG_MBEDTLS_HARDWARE_AES (the default) the AES rounds run on the accelerator
+#include "mbedtls/gcm.h"
+
+static const char *TAG = "SECURE_SESSION";
+
+#define NVS_NAMESPACE "session"
+#define NONCE_LEN 12
+
+typedef struct __attribute__((packed)) {
+    uint8_t key_id;
+    uint8_t key[SECURE_SESSION_KEY_LEN];
+    uint8_t has_prev;
+    uint8_t prev_key_id;
+    uint8_t prev_key[SECURE_SESSION_KEY_LEN];
+} stored_key_t;
+
+typedef struct {
+    bool used;
+    bool has_prev;
+    uint8_t mac[6];
+    uint8_t key_id;
+    uint8_t prev_key_id;
+    uint32_t last_used;
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_context prev_gcm;
+} key_slot_t;
+
+typedef struct {
+    bool used;
+    uint8_t mac[6];
+    uint32_t highest;               // highest accepted counter
+    uint32_t window;                // bit n set: highest - n was accepted
+    uint32_t last_used;
+} replay_slot_t;
+
+static key_slot_t keys[SECURE_SESSION_MAX_KEYS];
+static replay_slot_t senders[SECURE_SESSION_MAX_SENDERS];
+static uint32_t use_clock;
+
+static uint8_t self_addr[6];
+static uint32_t tx_counter;
+static uint32_t tx_reserved;        // counters below this are covered by NVS
+
+static nvs_handle_t nvs;
+static SemaphoreHandle_t session_lock;
+static secure_session_stats_t session_stats;
+
+
+//! KEYS
+
+static void nvs_key_name(const uint8_t *mac, char *name) {
+    snprintf(name, 14, "k%02x%02x%02x%02x%02x%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+static void free_slot(key_slot_t *slot) {
+    if (!slot->used) return;
+    mbedtls_gcm_free(&slot->gcm);
+    mbedtls_gcm_free(&slot->prev_gcm);
+    slot->used = false;
+}
+
+static key_slot_t *find_key(const uint8_t *mac) {
+    key_slot_t *oldest = &keys[0];
+
+    for (int i = 0; i < SECURE_SESSION_MAX_KEYS; i++) {
+        key_slot_t *slot = &keys[i];
+        if (slot->used && memcmp(slot->mac, mac, sizeof(slot->mac)) == 0) {
+            slot->last_used = ++use_clock;
+            return slot;
+        }
+        if (!slot->used || (oldest->used && slot->last_used < oldest->last_used)) oldest = slot;
+    }
+
+    //! not cached: load from NVS into the least recently used slot
+    char name[16];
+    nvs_key_name(mac, name);
+    stored_key_t stored;
+    size_t len = sizeof(stored);
+    if (nvs_get_blob(nvs, name, &stored, &len) != ESP_OK || len != sizeof(stored)) return NULL;
+
+    free_slot(oldest);
+    mbedtls_gcm_init(&oldest->gcm);
+    mbedtls_gcm_init(&oldest->prev_gcm);
+
+    int ret = mbedtls_gcm_setkey(&oldest->gcm, MBEDTLS_CIPHER_ID_AES, stored.key, SECURE_SESSION_KEY_LEN * 8);
+    if (ret == 0 && stored.has_prev) {
+        ret = mbedtls_gcm_setkey(&oldest->prev_gcm, MBEDTLS_CIPHER_ID_AES, stored.prev_key, SECURE_SESSION_KEY_LEN * 8);
+    }
+
+    oldest->key_id = stored.key_id;
+    oldest->has_prev = stored.has_prev;
+    oldest->prev_key_id = stored.prev_key_id;
+    memset(&stored, 0, sizeof(stored));
+
+    if (ret != 0) {
+        ESP_LOGE(TAG, "setkey failed: -0x%04X", -ret);
+        mbedtls_gcm_free(&oldest->gcm);
+        mbedtls_gcm_free(&oldest->prev_gcm);
+        return NULL;
+    }
+
+    oldest->used = true;
+    memcpy(oldest->mac, mac, sizeof(oldest->mac));
+    oldest->last_used = ++use_clock;
+    return oldest;
+}
+
+static void drop_cached(const uint8_t *mac) {
+    for (int i = 0; i < SECURE_SESSION_MAX_KEYS; i++) {
+        if (keys[i].used && memcmp(keys[i].mac, mac, sizeof(keys[i].mac)) == 0) free_slot(&keys[i]);
+    }
+}
+
+static esp_err_t store_key(const uint8_t *mac, const stored_key_t *stored) {
+    char name[16];
+    nvs_key_name(mac, name);
+
+    esp_err_t err = nvs_set_blob(nvs, name, stored, sizeof(*stored));
+    if (err == ESP_OK) err = nvs_commit(nvs);
+
+    //! reloaded on the next use
+    drop_cached(mac);
+    return err;
+}
+
+esp_err_t secure_session_set_key(const uint8_t *peer_mac, uint8_t key_id, const uint8_t *key) {
+    if (session_lock == NULL) return ESP_ERR_INVALID_STATE;
+
+    stored_key_t stored = { .key_id = key_id };
+    memcpy(stored.key, key, SECURE_SESSION_KEY_LEN);
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    esp_err_t err = store_key(peer_mac, &stored);
+    xSemaphoreGive(session_lock);
+
+    memset(&stored, 0, sizeof(stored));
+    return err;
+}
+
+esp_err_t secure_session_rotate_key(const uint8_t *peer_mac, const uint8_t *key) {
+    if (session_lock == NULL) return ESP_ERR_INVALID_STATE;
+
+    char name[16];
+    nvs_key_name(peer_mac, name);
+    stored_key_t stored;
+    size_t len = sizeof(stored);
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    esp_err_t err = nvs_get_blob(nvs, name, &stored, &len);
+    if (err == ESP_OK) {
+        stored.has_prev = 1;
+        stored.prev_key_id = stored.key_id;
+        memcpy(stored.prev_key, stored.key, SECURE_SESSION_KEY_LEN);
+        stored.key_id++;
+        memcpy(stored.key, key, SECURE_SESSION_KEY_LEN);
+        err = store_key(peer_mac, &stored);
+    }
+    xSemaphoreGive(session_lock);
+
+    memset(&stored, 0, sizeof(stored));
+    return err;
+}
+
+esp_err_t secure_session_erase_key(const uint8_t *peer_mac) {
+    if (session_lock == NULL) return ESP_ERR_INVALID_STATE;
+
+    char name[16];
+    nvs_key_name(peer_mac, name);
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    drop_cached(peer_mac);
+    esp_err_t err = nvs_erase_key(nvs, name);
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    xSemaphoreGive(session_lock);
+    return err;
+}
+
+
+//! REPLAY
+
+// create is only set for authenticated frames, forged senders can't evict real windows
+static replay_slot_t *find_sender(const uint8_t *mac, bool create) {
+    replay_slot_t *oldest = &senders[0];
+
+    for (int i = 0; i < SECURE_SESSION_MAX_SENDERS; i++) {
+        replay_slot_t *slot = &senders[i];
+        if (slot->used && memcmp(slot->mac, mac, sizeof(slot->mac)) == 0) return slot;
+        if (!slot->used || (oldest->used && slot->last_used < oldest->last_used)) oldest = slot;
+    }
+    if (!create) return NULL;
+
+    //! an evicted sender starts over, keep SECURE_SESSION_MAX_SENDERS above the node count
+    *oldest = (replay_slot_t){ .used = true };
+    memcpy(oldest->mac, mac, sizeof(oldest->mac));
+    return oldest;
+}
+
+static bool replay_seen(const replay_slot_t *slot, uint32_t counter) {
+    if (slot == NULL || slot->window == 0 || counter > slot->highest) return false;
+
+    uint32_t age = slot->highest - counter;
+    return age >= 32 || (slot->window & (1u << age));
+}
+
+static void replay_accept(replay_slot_t *slot, uint32_t counter) {
+    if (slot->window == 0 || counter > slot->highest) {
+        uint32_t shift = slot->window ? counter - slot->highest : 32;
+        slot->window = (shift >= 32 ? 0 : slot->window << shift) | 1;
+        slot->highest = counter;
+    } else {
+        slot->window |= 1u << (slot->highest - counter);
+    }
+    slot->last_used = ++use_clock;
+}
+
+
+//! SEAL / OPEN
+
+static void make_nonce(uint8_t *nonce, const uint8_t *sender_mac, uint32_t counter, uint8_t key_id) {
+    memcpy(nonce, sender_mac, 6);
+    memcpy(nonce + 6, &counter, 4);
+    nonce[10] = key_id;
+    nonce[11] = 0;
+}
+
+static esp_err_t reserve_counter(void) {
+    if (tx_counter < tx_reserved) return ESP_OK;
+
+    //! persist before use, a reboot must never reuse a nonce
+    uint32_t reserved = tx_reserved + SECURE_SESSION_COUNTER_RESERVE;
+    esp_err_t err = nvs_set_u32(nvs, "tx_ctr", reserved);
+    if (err == ESP_OK) err = nvs_commit(nvs);
+    if (err == ESP_OK) tx_reserved = reserved;
+    return err;
+}
+
+esp_err_t secure_session_seal(const uint8_t *key_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t cap, size_t *out_len) {
+    if (session_lock == NULL) return ESP_ERR_INVALID_STATE;
+    if (len + SECURE_SESSION_OVERHEAD > cap) return ESP_ERR_INVALID_SIZE;
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+
+    key_slot_t *slot = find_key(key_mac);
+    esp_err_t err = slot ? reserve_counter() : ESP_ERR_NOT_FOUND;
+    if (err != ESP_OK) {
+        if (slot == NULL) session_stats.no_key++;
+        xSemaphoreGive(session_lock);
+        return err;
+    }
+
+    //! counted from here: the lock wait, key loads and NVS commits aren't the cipher's cost
+    uint32_t start = esp_cpu_get_cycle_count();
+    uint32_t counter = tx_counter++;
+    uint8_t nonce[NONCE_LEN];
+    make_nonce(nonce, self_addr, counter, slot->key_id);
+
+    uint8_t *trailer = buff + len;
+    trailer[0] = slot->key_id;
+    memcpy(trailer + 1, &counter, 4);
+
+    int ret = mbedtls_gcm_crypt_and_tag(&slot->gcm, MBEDTLS_GCM_ENCRYPT, len, nonce, NONCE_LEN,
+                                        aad, aad_len, buff, buff, SECURE_SESSION_TAG_LEN, trailer + 5);
+    if (ret == 0) {
+        session_stats.sealed++;
+        session_stats.seal_cycles += esp_cpu_get_cycle_count() - start;
+    }
+    xSemaphoreGive(session_lock);
+
+    if (ret != 0) return ESP_FAIL;
+    *out_len = len + SECURE_SESSION_OVERHEAD;
+    return ESP_OK;
+}
+
+esp_err_t secure_session_open(const uint8_t *key_mac, const uint8_t *sender_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t *out_len) {
+    if (session_lock == NULL) return ESP_ERR_INVALID_STATE;
+    if (len < SECURE_SESSION_OVERHEAD) return ESP_ERR_INVALID_SIZE;
+
+    size_t data_len = len - SECURE_SESSION_OVERHEAD;
+    const uint8_t *trailer = buff + data_len;
+    uint8_t key_id = trailer[0];
+    uint32_t counter;
+    memcpy(&counter, trailer + 1, 4);
+
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    key_slot_t *slot = find_key(key_mac);
+    uint32_t start = esp_cpu_get_cycle_count();
+    mbedtls_gcm_context *gcm = NULL;
+    if (slot && key_id == slot->key_id) gcm = &slot->gcm;
+    else if (slot && slot->has_prev && key_id == slot->prev_key_id) gcm = &slot->prev_gcm;
+
+    replay_slot_t *sender = find_sender(sender_mac, false);
+
+    if (gcm == NULL) {
+        session_stats.no_key++;
+        err = ESP_ERR_NOT_FOUND;
+    } else if (replay_seen(sender, counter)) {
+        session_stats.replayed++;
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        uint8_t nonce[NONCE_LEN];
+        make_nonce(nonce, sender_mac, counter, key_id);
+
+        //! the window only moves for frames that authenticate
+        int ret = mbedtls_gcm_auth_decrypt(gcm, data_len, nonce, NONCE_LEN, aad, aad_len,
+                                           trailer + 5, SECURE_SESSION_TAG_LEN, buff, buff);
+        if (ret == 0) {
+            replay_accept(sender ? sender : find_sender(sender_mac, true), counter);
+            session_stats.opened++;
+            session_stats.open_cycles += esp_cpu_get_cycle_count() - start;
+        } else {
+            session_stats.auth_failed++;
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    xSemaphoreGive(session_lock);
+
+    if (err == ESP_OK) *out_len = data_len;
+    return err;
+}
+
+
+//! SETUP
+
+esp_err_t secure_session_setup(const uint8_t *self_mac) {
+    if (session_lock) return ESP_OK;
+    memcpy(self_addr, self_mac, sizeof(self_addr));
+
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "nvs_open failed: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    //! resume above everything a previous boot may have used
+    uint32_t stored = 0;
+    nvs_get_u32(nvs, "tx_ctr", &stored);
+    tx_counter = tx_reserved = stored;
+
+    session_lock = xSemaphoreCreateMutex();
+    if (session_lock == NULL) return ESP_ERR_NO_MEM;
+
+    return reserve_counter();
+}
+
+void secure_session_get_stats(secure_session_stats_t *stats) {
+    if (session_lock == NULL) return;
+    xSemaphoreTake(session_lock, portMAX_DELAY);
+    *stats = session_stats;
+    xSemaphoreGive(session_lock);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+//# AES-128-GCM for short frames. Keys are kept per peer MAC in NVS, the
+//# broadcast MAC holds the group key. A sealed payload is
+//#     ciphertext | key_id u8 | counter u32 LE | tag[SECURE_SESSION_TAG_LEN]
+//# The nonce is sender MAC | counter | key_id, so a group key is safe to share.
+//# Counters are strictly increasing per sender and checked against a sliding
+//# window to reject replays. Rotation keeps the previous key for the peers
+//# that haven't switched yet.
+
+#define SECURE_SESSION_KEY_LEN 16
+#define SECURE_SESSION_TAG_LEN 8            // truncated tag keeps the frame overhead at 13 bytes
+#define SECURE_SESSION_OVERHEAD (1 + 4 + SECURE_SESSION_TAG_LEN)
+
+#ifndef SECURE_SESSION_MAX_KEYS
+#define SECURE_SESSION_MAX_KEYS 8
+#endif
+
+#ifndef SECURE_SESSION_MAX_SENDERS
+#define SECURE_SESSION_MAX_SENDERS 16       // replay windows
+#endif
+
+#ifndef SECURE_SESSION_COUNTER_RESERVE
+#define SECURE_SESSION_COUNTER_RESERVE 1024 // tx counters reserved per NVS write
+#endif
+
+typedef struct {
+    uint32_t sealed;
+    uint32_t opened;
+    uint32_t auth_failed;
+    uint32_t replayed;
+    uint32_t no_key;
+    uint64_t seal_cycles;           // CPU cycles in the cipher and replay check, divide by the counts
+    uint64_t open_cycles;
+} secure_session_stats_t;
+
+esp_err_t secure_session_setup(const uint8_t *self_mac);
+
+//! stores the key in NVS, key_id is carried in every frame
+esp_err_t secure_session_set_key(const uint8_t *peer_mac, uint8_t key_id, const uint8_t *key);
+
+//! new key gets key_id + 1, the old one is still accepted for opening
+esp_err_t secure_session_rotate_key(const uint8_t *peer_mac, const uint8_t *key);
+esp_err_t secure_session_erase_key(const uint8_t *peer_mac);
+
+//! encrypts buff[0..len) in place and appends the trailer, cap has to fit len + SECURE_SESSION_OVERHEAD
+esp_err_t secure_session_seal(const uint8_t *key_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t cap, size_t *out_len);
+
+//! decrypts in place, sender_mac selects the replay window and the nonce
+esp_err_t secure_session_open(const uint8_t *key_mac, const uint8_t *sender_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t *out_len);
+
+void secure_session_get_stats(secure_session_stats_t *stats);
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "sd_test_io.h"
@@ -48,7 +49,43 @@ size_t mod_sd_fread(char *buff, size_t len) {
 int mod_sd_fclose() {
     if (file == NULL) return 0;
     ESP_LOGI(TAG, "mod_sd_fclose");
-    return fclose(file);
+    int ret = fclose(file);
+    file = NULL;
+    return ret;
+}
+
+//# Handle based access, each caller owns its descriptor so several streams can be open at once.
+//# Plain read() skips the stdio buffer: large sector aligned reads go to the card as multi-block transfers.
+int mod_sd_open(const char *path, size_t *file_size) {
+    char full_path[MAX_CHAR_SIZE];
+    snprintf(full_path, sizeof(full_path), "%s%s", MOUNT_POINT, path);
+
+    int fd = open(full_path, O_RDONLY);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to open file %s", full_path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (file_size) *file_size = st.st_size;
+    return fd;
+}
+
+ssize_t mod_sd_read(int fd, char *buff, size_t len) {
+    return read(fd, buff, len);
+}
+
+int mod_sd_seek(int fd, size_t offset) {
+    return lseek(fd, offset, SEEK_SET) < 0 ? -1 : 0;
+}
+
+int mod_sd_close(int fd) {
+    return close(fd);
 }
 
 //# Write File
@@ -13,5 +13,10 @@ esp_err_t mod_sd_fopen(const char *path);
 size_t mod_sd_fread(char *buff, size_t len);
 int mod_sd_fclose();
 
+int mod_sd_open(const char *path, size_t *file_size);
+ssize_t mod_sd_read(int fd, char *buff, size_t len);
+int mod_sd_seek(int fd, size_t offset);
+int mod_sd_close(int fd);
+
 esp_err_t mod_sd_get(const char *path, char *buffer, size_t len);
 esp_err_t mod_sd_write(const char *path, char *data);
@@ -0,0 +1,172 @@
+#include "json_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int json_writer_init(json_writer_t* w, char* buff, size_t size, json_flush_cb flush, void* ctx) {
+    w->buff = buff;
+    w->size = size;
+    w->len = 0;
+    w->flush = flush;
+    w->ctx = ctx;
+    w->depth = 0;
+    w->has_items = 0;
+
+    // an empty buffer would never make room, the writer stays unusable and finish reports it
+    w->error = (buff == NULL || size == 0 || flush == NULL) ? -1 : 0;
+    return w->error;
+}
+
+static void json_flush(json_writer_t* w) {
+    if (w->len == 0 || w->error) return;
+    w->error = w->flush(w->ctx, w->buff, w->len);
+    w->len = 0;
+}
+
+static void json_put(json_writer_t* w, const char* data, size_t len) {
+    while (len > 0 && !w->error) {
+        if (w->len == w->size) json_flush(w);
+
+        size_t n = w->size - w->len;
+        if (n > len) n = len;
+        memcpy(w->buff + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void json_putc(json_writer_t* w, char c) {
+    if (w->len == w->size) json_flush(w);
+    if (w->error) return;
+    w->buff[w->len++] = c;
+}
+
+static void json_put_escaped(json_writer_t* w, const char* str) {
+    static const char hex[] = "0123456789abcdef";
+    json_putc(w, '"');
+
+    for (const char* p = str; *p; p++) {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\') {
+            json_putc(w, '\\');
+            json_putc(w, c);
+        } else if (c < 0x20) {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F] };
+            json_put(w, esc, sizeof(esc));
+        } else {
+            json_putc(w, c);
+        }
+    }
+
+    json_putc(w, '"');
+}
+
+// comma handling and the "key": prefix for every new item
+static void json_item(json_writer_t* w, const char* key) {
+    uint16_t bit = 1 << w->depth;
+    if (w->has_items & bit) json_putc(w, ',');
+    w->has_items |= bit;
+
+    if (key) {
+        json_put_escaped(w, key);
+        json_putc(w, ':');
+    }
+}
+
+static void json_put_uint(json_writer_t* w, uint32_t value) {
+    char digits[10];
+    int i = sizeof(digits);
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    json_put(w, digits + i, sizeof(digits) - i);
+}
+
+static void json_open(json_writer_t* w, const char* key, char c) {
+    json_item(w, key);
+    json_putc(w, c);
+
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->error = -1;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1 << w->depth);
+}
+
+static void json_close(json_writer_t* w, char c) {
+    if (w->depth > 0) w->depth--;
+    json_putc(w, c);
+}
+
+void json_object_begin(json_writer_t* w, const char* key) { json_open(w, key, '{'); }
+void json_object_end(json_writer_t* w) { json_close(w, '}'); }
+void json_array_begin(json_writer_t* w, const char* key) { json_open(w, key, '['); }
+void json_array_end(json_writer_t* w) { json_close(w, ']'); }
+
+void json_write_str(json_writer_t* w, const char* key, const char* value) {
+    json_item(w, key);
+    json_put_escaped(w, value);
+}
+
+void json_write_uint(json_writer_t* w, const char* key, uint32_t value) {
+    json_item(w, key);
+    json_put_uint(w, value);
+}
+
+void json_write_int(json_writer_t* w, const char* key, int32_t value) {
+    json_item(w, key);
+    if (value < 0) json_putc(w, '-');
+    json_put_uint(w, value < 0 ? 0u - (uint32_t)value : (uint32_t)value);
+}
+
+void json_write_bool(json_writer_t* w, const char* key, bool value) {
+    json_item(w, key);
+    if (value) json_put(w, "true", 4);
+    else json_put(w, "false", 5);
+}
+
+void json_write_fixed(json_writer_t* w, const char* key, int32_t value, uint8_t decimals) {
+    json_item(w, key);
+
+    uint32_t abs_value = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    if (value < 0) json_putc(w, '-');
+    if (decimals > 9) decimals = 9;
+
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+    json_put_uint(w, abs_value / scale);
+    if (decimals == 0) return;
+
+    // fractional part with leading zeros
+    char frac[10];
+    uint32_t rem = abs_value % scale;
+    for (int i = decimals - 1; i >= 0; i--) {
+        frac[i] = '0' + rem % 10;
+        rem /= 10;
+    }
+    json_putc(w, '.');
+    json_put(w, frac, decimals);
+}
+
+void json_write_u16_array(json_writer_t* w, const char* key, const uint16_t* values, size_t count) {
+    json_array_begin(w, key);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) json_putc(w, ',');
+        json_put_uint(w, values[i]);
+    }
+    if (count) w->has_items |= 1 << w->depth;
+    json_array_end(w);
+}
+
+int json_writer_finish(json_writer_t* w) {
+    json_flush(w);
+    return w->error;
+}
+
+int json_flush_stdout(void* ctx, const char* data, size_t len) {
+    return fwrite(data, 1, len, stdout) == len ? 0 : -1;
+}
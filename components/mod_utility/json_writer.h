@@ -0,0 +1,49 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Streaming JSON writer. Output is staged in a caller owned buffer and handed to
+// the flush callback whenever it fills up, so payload size is not limited by the buffer.
+// flush returns 0 on success, anything else stops the writer.
+typedef int (*json_flush_cb)(void* ctx, const char* data, size_t len);
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+typedef struct {
+    char* buff;
+    size_t size;
+    size_t len;
+    json_flush_cb flush;
+    void* ctx;
+    uint8_t depth;
+    uint16_t has_items;         // bit per depth: a comma is needed before the next item
+    int error;
+} json_writer_t;
+
+// returns -1 for a missing or zero sized buffer or flush, every later call is then a no-op
+int json_writer_init(json_writer_t* w, char* buff, size_t size, json_flush_cb flush, void* ctx);
+int json_writer_finish(json_writer_t* w);
+
+// key is NULL for values inside arrays
+void json_object_begin(json_writer_t* w, const char* key);
+void json_object_end(json_writer_t* w);
+void json_array_begin(json_writer_t* w, const char* key);
+void json_array_end(json_writer_t* w);
+
+void json_write_str(json_writer_t* w, const char* key, const char* value);
+void json_write_int(json_writer_t* w, const char* key, int32_t value);
+void json_write_uint(json_writer_t* w, const char* key, uint32_t value);
+void json_write_bool(json_writer_t* w, const char* key, bool value);
+
+// value / 10^decimals, ie. (2345, 2) -> 23.45
+void json_write_fixed(json_writer_t* w, const char* key, int32_t value, uint8_t decimals);
+
+void json_write_u16_array(json_writer_t* w, const char* key, const uint16_t* values, size_t count);
+
+// flush callback writing to stdout, for console output
+int json_flush_stdout(void* ctx, const char* data, size_t len);
+
+#endif
@@ -0,0 +1,63 @@
+#include "telemetry.h"
+
+#include <string.h>
+
+static void put_byte(telemetry_frame_t *frame, uint8_t value) {
+    if (frame->len >= frame->size) {
+        frame->overflow = true;
+        return;
+    }
+    frame->buff[frame->len++] = value;
+}
+
+static void put_varint(telemetry_frame_t *frame, uint32_t value) {
+    while (value >= 0x80) {
+        put_byte(frame, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    put_byte(frame, value);
+}
+
+// small magnitudes of either sign map to small unsigned values
+static uint32_t zigzag_encode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+void telemetry_frame_begin(telemetry_frame_t *frame, uint8_t *buff, size_t size, uint16_t seq, uint32_t timestamp_ms) {
+    frame->buff = buff;
+    frame->size = size;
+    frame->len = 0;
+    frame->channel_count = 0;
+    frame->overflow = size < TELEMETRY_HEADER_LEN;
+    if (frame->overflow) return;
+
+    buff[0] = TELEMETRY_VERSION;
+    buff[1] = seq & 0xFF;
+    buff[2] = seq >> 8;
+    for (int i = 0; i < 4; i++) buff[3 + i] = (timestamp_ms >> (8*i)) & 0xFF;
+    buff[7] = 0;                // channel count, patched in telemetry_frame_end
+    frame->len = TELEMETRY_HEADER_LEN;
+}
+
+static void channel_begin(telemetry_frame_t *frame, uint8_t channel_id, uint16_t count) {
+    put_byte(frame, channel_id);
+    put_varint(frame, count);
+    frame->channel_count++;
+}
+
+void telemetry_add_channel(telemetry_frame_t *frame, uint8_t channel_id, const int32_t *samples, uint16_t count) {
+    channel_begin(frame, channel_id, count);
+
+    int32_t prev = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        // wrapping difference, decoded back with a wrapping sum
+        put_varint(frame, zigzag_encode((int32_t)((uint32_t)samples[i] - (uint32_t)prev)));
+        prev = samples[i];
+    }
+}
+
+size_t telemetry_frame_end(telemetry_frame_t *frame) {
+    if (frame->overflow) return 0;
+    frame->buff[7] = frame->channel_count;
+    return frame->len;
+}
@@ -0,0 +1,31 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Compact binary telemetry frame (little-endian):
+//  header  : version u8 | seq u16 | timestamp_ms u32 | channel_count u8
+//  channel : channel_id u8 | sample_count varint | first sample zigzag varint | deltas zigzag varint...
+// Slow changing readings cost 1-2 bytes per sample instead of 2 (uint16 array) or 4-6 (JSON text).
+// The reference decoder for clients is in test/host/test_telemetry.c.
+
+#define TELEMETRY_VERSION       1
+#define TELEMETRY_HEADER_LEN    8
+
+typedef struct {
+    uint8_t *buff;
+    size_t size;
+    size_t len;
+    uint8_t channel_count;
+    bool overflow;
+} telemetry_frame_t;
+
+void telemetry_frame_begin(telemetry_frame_t *frame, uint8_t *buff, size_t size, uint16_t seq, uint32_t timestamp_ms);
+void telemetry_add_channel(telemetry_frame_t *frame, uint8_t channel_id, const int32_t *samples, uint16_t count);
+
+// returns the frame length, 0 when the buffer was too small
+size_t telemetry_frame_end(telemetry_frame_t *frame);
+
+#endif
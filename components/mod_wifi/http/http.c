@@ -8,6 +8,7 @@
 */
 
 #include "http.h"
+#include "json_writer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -25,13 +26,53 @@
 #include <esp_http_server.h>
 
 #include "esp_mac.h"
+#include "esp_heap_caps.h"
 #include "lwip/inet.h"
 
 #define ASYNC_WORKER_TASK_PRIORITY      5
-#define ASYNC_WORKER_TASK_STACK_SIZE    2048
-#define CONFIG_EXAMPLE_MAX_ASYNC_REQUESTS 2
+#define ASYNC_WORKER_TASK_STACK_SIZE    4096
 #define CONFIG_EXAMPLE_CONNECT_WIFI true
 
+// Number of worker tasks, override from the build flags if needed
+#ifndef HTTP_ASYNC_WORKERS
+    #define HTTP_ASYNC_WORKERS          2
+#endif
+
+// Pending requests allowed to wait for a worker, overflow is rejected with 503
+#define HTTP_ASYNC_QUEUE_LEN            (HTTP_ASYNC_WORKERS * 2)
+
+// Socket budget, CONFIG_LWIP_MAX_SOCKETS (10 by default) is shared by the whole app:
+//   3  httpd internals, httpd_start refuses max_open_sockets above CONFIG_LWIP_MAX_SOCKETS - 3
+//   1  net_reactor wakeup socket
+//   2  web_socket listener and its first client, later clients take what http leaves
+//   1  UDP telemetry client of app_network
+// Http clients get the rest, up to one per worker and queued request plus one
+// for quick synchronous requests. With the defaults that is 3 of the wanted 7,
+// new clients past that rely on lru_purge_enable closing an idle session.
+#define HTTP_APP_SOCKETS                (3 + 1 + 2 + 1)
+#define HTTP_MAX_OPEN_SOCKETS           MIN(HTTP_ASYNC_WORKERS + HTTP_ASYNC_QUEUE_LEN + 1, \
+                                            CONFIG_LWIP_MAX_SOCKETS - HTTP_APP_SOCKETS)
+#if CONFIG_LWIP_MAX_SOCKETS - HTTP_APP_SOCKETS < HTTP_ASYNC_WORKERS + 1
+    #error "CONFIG_LWIP_MAX_SOCKETS leaves no socket for synchronous requests, raise it or lower HTTP_ASYNC_WORKERS"
+#endif
+
+// Requests waiting longer than this are cancelled, also used as the socket timeouts
+#ifndef HTTP_ASYNC_TIMEOUT_MS
+    #define HTTP_ASYNC_TIMEOUT_MS       5000
+#endif
+
+// Running handlers stop at the next chunk after this, a stuck client can hold a
+// worker for at most this plus one socket timeout
+#ifndef HTTP_ASYNC_DEADLINE_MS
+    #define HTTP_ASYNC_DEADLINE_MS      30000
+#endif
+
+// File read size, matches the FAT allocation unit used by mod_sd
+#ifndef HTTP_FILE_CHUNK_SIZE
+    #define HTTP_FILE_CHUNK_SIZE        (16 * 1024)
+#endif
+#define FILE_READER_TASK_STACK_SIZE     3072
+
 static const char *TAG = "APP_HTTP";
 static http_interface_t* interface;
 
@@ -39,22 +80,58 @@ static http_interface_t* interface;
 // be processed by the workers
 static QueueHandle_t request_queue;
 
-// Track the number of free workers at any given time
-static SemaphoreHandle_t worker_ready_count;
-
 // Each worker has its own thread
-// static TaskHandle_t worker_handles[CONFIG_EXAMPLE_MAX_ASYNC_REQUESTS];
+static TaskHandle_t worker_handles[HTTP_ASYNC_WORKERS];
 
-typedef esp_err_t (*httpd_req_handler_t)(httpd_req_t *req);
+static http_stats_t http_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+//! deadline is in esp_timer_get_time() us, handlers return ESP_ERR_TIMEOUT when they gave up on it
+typedef esp_err_t (*httpd_req_handler_t)(httpd_req_t *req, uint64_t deadline);
 
 typedef struct {
     httpd_req_t* req;
     httpd_req_handler_t handler;
+    uint64_t queued_time;
 } httpd_async_req_t;
 
+//! FILE STREAMING
+// A single reader task owns the SD card reads. While a worker sends one buffer
+// the reader fills the other, so card and socket transfers overlap.
+
+typedef struct {
+    int fd;
+    char* buff;
+    size_t len;
+    ssize_t* result;
+    TaskHandle_t owner;
+} file_read_job_t;
+
+static QueueHandle_t file_read_queue;
+
+static void file_reader_task(void *p)
+{
+    file_read_job_t job;
+    while (true) {
+        if (xQueueReceive(file_read_queue, &job, portMAX_DELAY)) {
+            *job.result = interface->on_file_read_cb(job.fd, job.buff, job.len);
+            xTaskNotifyGive(job.owner);
+        }
+    }
+}
+
+void http_get_stats(http_stats_t* stats) {
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = http_stats;
+    taskEXIT_CRITICAL(&stats_lock);
+    stats->queue_depth = request_queue ? uxQueueMessagesWaiting(request_queue) : 0;
+}
+
 // queue an HTTP req to the worker queue
 static esp_err_t queue_request(httpd_req_t *req, httpd_req_handler_t handler)
 {
+    if (request_queue == NULL) return ESP_FAIL;
+
     // must create a copy of the request that we own
     httpd_req_t* copy = NULL;
     esp_err_t err = httpd_req_async_handler_begin(req, &copy);
@@ -62,44 +139,57 @@ static esp_err_t queue_request(httpd_req_t *req, httpd_req_handler_t handler)
         return err;
     }
 
-    int ticks = 0;
-
-    // counting semaphore: if success, we know 1 or
-    // more asyncReqTaskWorkers are available.
-    if (xSemaphoreTake(worker_ready_count, ticks) == false) {
-        ESP_LOGE(TAG, "No workers are available");
-        httpd_req_async_handler_complete(copy); // cleanup
-        return ESP_FAIL;
-    }
-
     httpd_async_req_t async_req = {
         .req = copy,
         .handler = handler,
+        .queued_time = esp_timer_get_time(),
     };
-    
-    // Since worker_ready_count > 0 the queue should already have space.
-    // But lets wait up to 100ms just to be safe.
-    if (xQueueSend(request_queue, &async_req, pdMS_TO_TICKS(100)) == false) {
-        ESP_LOGE(TAG, "worker queue is full");
+
+    // never block the httpd task, a full queue means the server is busy
+    if (xQueueSend(request_queue, &async_req, 0) == false) {
+        ESP_LOGW(TAG, "worker queue is full");
         httpd_req_async_handler_complete(copy); // cleanup
+
+        taskENTER_CRITICAL(&stats_lock);
+        http_stats.rejected++;
+        taskEXIT_CRITICAL(&stats_lock);
         return ESP_FAIL;
     }
 
+    uint32_t depth = uxQueueMessagesWaiting(request_queue);
+    taskENTER_CRITICAL(&stats_lock);
+    http_stats.queued++;
+    if (depth > http_stats.max_queue_depth) http_stats.max_queue_depth = depth;
+    taskEXIT_CRITICAL(&stats_lock);
+
+    return ESP_OK;
+}
+
+// queue the request or answer 503 when the pool is saturated
+static esp_err_t queue_or_reject(httpd_req_t *req, httpd_req_handler_t handler)
+{
+    if (queue_request(req, handler) == ESP_OK) return ESP_OK;
+
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    httpd_resp_sendstr(req, "<div> no workers available. server busy.</div>");
     return ESP_OK;
 }
 
 /* handle long request (on async thread) */
-static esp_err_t long_async(httpd_req_t *req)
+static esp_err_t long_async(httpd_req_t *req, uint64_t deadline)
 {
     ESP_LOGI(TAG, "running: /long");
 
-    // track the number of long requests
-    static uint8_t req_count = 0;
-    req_count++;
+    // track the number of long requests, the workers run this concurrently
+    static uint32_t req_count = 0;
+    taskENTER_CRITICAL(&stats_lock);
+    uint32_t count = ++req_count;
+    taskEXIT_CRITICAL(&stats_lock);
 
     // send a request count
     char s[100];
-    snprintf(s, sizeof(s), "<div>req: %u</div>\n", req_count);
+    snprintf(s, sizeof(s), "<div>req: %lu</div>\n", count);
     httpd_resp_sendstr_chunk(req, s);
 
     // then every second, send a "tick"
@@ -127,19 +217,41 @@ static void worker_task(void *p)
     ESP_LOGI(TAG, "starting async req task worker");
 
     while (true) {
-
-        // counting semaphore - this signals that a worker
-        // is ready to accept work
-        xSemaphoreGive(worker_ready_count);
-
         // wait for a request
         httpd_async_req_t async_req;
         if (xQueueReceive(request_queue, &async_req, portMAX_DELAY)) {
+            uint64_t start_time = esp_timer_get_time();
+            uint32_t wait_ms = (start_time - async_req.queued_time) / 1000;
+
+            if (wait_ms > HTTP_ASYNC_TIMEOUT_MS) {
+                // the client has waited too long, cancel without running the handler
+                ESP_LOGW(TAG, "request timed out in queue: %s", async_req.req->uri);
+                httpd_resp_send_err(async_req.req, HTTPD_408_REQ_TIMEOUT, NULL);
+
+                taskENTER_CRITICAL(&stats_lock);
+                http_stats.timed_out++;
+                taskEXIT_CRITICAL(&stats_lock);
+            } else {
+                ESP_LOGI(TAG, "invoking %s", async_req.req->uri);
+                uint64_t deadline = start_time + HTTP_ASYNC_DEADLINE_MS * 1000ULL;
+
+                if (async_req.handler(async_req.req, deadline) == ESP_ERR_TIMEOUT) {
+                    // the response is cut short, drop the connection so it isn't taken as complete
+                    ESP_LOGW(TAG, "request ran past its deadline: %s", async_req.req->uri);
+                    httpd_sess_trigger_close(async_req.req->handle, httpd_req_to_sockfd(async_req.req));
+
+                    taskENTER_CRITICAL(&stats_lock);
+                    http_stats.deadline_exceeded++;
+                    taskEXIT_CRITICAL(&stats_lock);
+                }
+            }
 
-            ESP_LOGI(TAG, "invoking %s", async_req.req->uri);
-
-            // call the handler
-            async_req.handler(async_req.req);
+            uint32_t latency_us = esp_timer_get_time() - async_req.queued_time;
+            taskENTER_CRITICAL(&stats_lock);
+            http_stats.completed++;
+            http_stats.total_latency_us += latency_us;
+            if (latency_us > http_stats.max_latency_us) http_stats.max_latency_us = latency_us;
+            taskEXIT_CRITICAL(&stats_lock);
 
             // Inform the server that it can purge the socket used for
             // this request, if needed.
@@ -148,61 +260,67 @@ static void worker_task(void *p)
             }
         }
     }
-
-    ESP_LOGW(TAG, "worker stopped");
-    // vTaskDelete(NULL);
 }
 
 // start worker threads
 static void start_workers(void)
 {
-
-    // counting semaphore keeps track of available workers
-    worker_ready_count = xSemaphoreCreateCounting(
-        CONFIG_EXAMPLE_MAX_ASYNC_REQUESTS,  // Max Count
-        0); // Initial Count
-    if (worker_ready_count == NULL) {
-        ESP_LOGE(TAG, "Failed to create workers counting Semaphore");
-        return;
-    }
-
     // create queue
-    request_queue = xQueueCreate(1, sizeof(httpd_async_req_t));
+    request_queue = xQueueCreate(HTTP_ASYNC_QUEUE_LEN, sizeof(httpd_async_req_t));
     if (request_queue == NULL){
         ESP_LOGE(TAG, "Failed to create request_queue");
-        vSemaphoreDelete(worker_ready_count);
         return;
     }
 
-    // // start worker tasks
-    // for (int i = 0; i < CONFIG_EXAMPLE_MAX_ASYNC_REQUESTS; i++) {
-
-    //     bool success = xTaskCreate(worker_task, "async_req_worker",
-    //                                 ASYNC_WORKER_TASK_STACK_SIZE, // stack size
-    //                                 (void *)0, // argument
-    //                                 ASYNC_WORKER_TASK_PRIORITY, // priority
-    //                                 &worker_handles[i]);
+    // SD reads for the file streams are done here, one job per worker at most
+    file_read_queue = xQueueCreate(HTTP_ASYNC_WORKERS, sizeof(file_read_job_t));
+    if (file_read_queue == NULL ||
+        xTaskCreate(file_reader_task, "file_reader", FILE_READER_TASK_STACK_SIZE,
+                    NULL, ASYNC_WORKER_TASK_PRIORITY + 1, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start file reader, reading inline");
+        if (file_read_queue) vQueueDelete(file_read_queue);
+        file_read_queue = NULL;
+    }
 
-    //     if (!success) {
-    //         ESP_LOGE(TAG, "Failed to start asyncReqWorker");
-    //         continue;
-    //     }
-    // }
+    // start worker tasks
+    for (int i = 0; i < HTTP_ASYNC_WORKERS; i++) {
+        bool success = xTaskCreate(worker_task, "async_req_worker",
+                                    ASYNC_WORKER_TASK_STACK_SIZE, // stack size
+                                    (void *)0, // argument
+                                    ASYNC_WORKER_TASK_PRIORITY, // priority
+                                    &worker_handles[i]);
+
+        if (!success) {
+            ESP_LOGE(TAG, "Failed to start asyncReqWorker");
+            continue;
+        }
+    }
 }
 
 /* adds /long request to the request queue */
 static esp_err_t long_handler(httpd_req_t *req)
 {
     ESP_LOGI(TAG, "uri: /long");
+    return queue_or_reject(req, long_async);
+}
 
-    // add to the async request queue
-    if (queue_request(req, long_async) == ESP_OK) {
-        return ESP_OK;
-    } else {
-        httpd_resp_set_status(req, "503 Busy");
-        httpd_resp_sendstr(req, "<div> no workers available. server busy.</div>");
-        return ESP_OK;
-    }
+/* pool metrics */
+static esp_err_t stats_handler(httpd_req_t *req)
+{
+    http_stats_t stats;
+    http_get_stats(&stats);
+
+    uint32_t avg_latency_us = stats.completed ? stats.total_latency_us / stats.completed : 0;
+
+    char s[200];
+    snprintf(s, sizeof(s), "{\"queued\":%lu,\"rejected\":%lu,\"timed_out\":%lu,\"deadline_exceeded\":%lu,\"completed\":%lu,"
+        "\"queue_depth\":%lu,\"max_queue_depth\":%lu,\"avg_latency_us\":%lu,\"max_latency_us\":%lu}",
+        stats.queued, stats.rejected, stats.timed_out, stats.deadline_exceeded, stats.completed,
+        stats.queue_depth, stats.max_queue_depth, avg_latency_us, stats.max_latency_us);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_sendstr(req, s);
+    return ESP_OK;
 }
 
 /* A quick HTTP GET handler, which does not
@@ -248,55 +366,187 @@ static esp_err_t captive_portal_get_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-// HTTP GET handler for serving the file
-static esp_err_t file_get_handler(httpd_req_t *req) {
-    char chunk_buffer2[800];
-    memset(chunk_buffer2, 0x41, 800);
+typedef enum {
+    RANGE_IGNORED,                  // malformed or another unit, serve the whole file (RFC 7233 3.1)
+    RANGE_SATISFIABLE,
+    RANGE_UNSATISFIABLE,            // well formed but outside the file, 416
+} range_result_t;
+
+// parse "bytes=start-end", "bytes=start-" and "bytes=-suffix", only the first range is served
+static range_result_t parse_range(const char* value, size_t file_size, size_t* start, size_t* end)
+{
+    if (strncmp(value, "bytes=", 6) != 0) return RANGE_IGNORED;
+    const char* spec = value + 6;
+    char* next;
+
+    if (*spec == '-') {
+        unsigned long suffix = strtoul(spec + 1, &next, 10);
+        if (next == spec + 1) return RANGE_IGNORED;
+        if (suffix == 0 || file_size == 0) return RANGE_UNSATISFIABLE;
+        *start = suffix >= file_size ? 0 : file_size - suffix;
+        *end = file_size - 1;
+        return RANGE_SATISFIABLE;
+    }
+
+    unsigned long first = strtoul(spec, &next, 10);
+    if (next == spec || *next != '-') return RANGE_IGNORED;
+
+    const char* last_str = next + 1;
+    unsigned long last = strtoul(last_str, &next, 10);
+    bool open_ended = next == last_str;
+    if (!open_ended && last < first) return RANGE_IGNORED;          // e.g. bytes=5-3
+    if (first >= file_size) return RANGE_UNSATISFIABLE;
 
-    char chunk_buffer[255];
-    char chunk_len = sizeof(chunk_buffer);
+    *start = first;
+    *end = open_ended ? file_size - 1 : MIN(last, file_size - 1);
+    return RANGE_SATISFIABLE;
+}
+
+static esp_err_t file_stream(httpd_req_t *req, int fd, size_t remaining, uint64_t* bytes_sent, uint64_t deadline)
+{
+    char* buffs[2] = {
+        heap_caps_malloc(HTTP_FILE_CHUNK_SIZE, MALLOC_CAP_DMA),
+        heap_caps_malloc(HTTP_FILE_CHUNK_SIZE, MALLOC_CAP_DMA)
+    };
 
+    if (buffs[0] == NULL || buffs[1] == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate file buffers");
+        free(buffs[0]);
+        free(buffs[1]);
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_OK;
+
+    int cur = 0;
+    ssize_t prefetch_len = 0;
+    ssize_t len = interface->on_file_read_cb(fd, buffs[cur], MIN(remaining, HTTP_FILE_CHUNK_SIZE));
+
+    while (len > 0) {
+        remaining -= MIN(remaining, (size_t)len);
+
+        // start reading the next buffer before sending the current one
+        bool prefetch = remaining > 0 && file_read_queue != NULL;
+        if (prefetch) {
+            file_read_job_t job = {
+                .fd = fd,
+                .buff = buffs[cur ^ 1],
+                .len = MIN(remaining, HTTP_FILE_CHUNK_SIZE),
+                .result = &prefetch_len,
+                .owner = xTaskGetCurrentTaskHandle(),
+            };
+            xQueueSend(file_read_queue, &job, portMAX_DELAY);
+        }
+
+        err = httpd_resp_send_chunk(req, buffs[cur], len);
+
+        // the reader still owns the other buffer, always wait for it
+        if (prefetch) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (err == ESP_OK && esp_timer_get_time() > deadline) err = ESP_ERR_TIMEOUT;
+        if (err != ESP_OK) break;
+
+        *bytes_sent += len;
+        if (prefetch) {
+            len = prefetch_len;
+        } else {
+            len = remaining > 0 ? interface->on_file_read_cb(fd, buffs[cur ^ 1], MIN(remaining, HTTP_FILE_CHUNK_SIZE)) : 0;
+        }
+        cur ^= 1;
+    }
+
+    if (len < 0) err = ESP_FAIL;
+
+    free(buffs[0]);
+    free(buffs[1]);
+    return err;
+}
+
+// HTTP GET handler for serving the file (on async thread)
+// GET /file/<path> serves <path> from the SD card, Range requests get 206 responses
+static esp_err_t file_get_async(httpd_req_t *req, uint64_t deadline) {
     uint64_t time_ref = esp_timer_get_time();
-    size_t bytes_read;
-    esp_err_t err = ESP_FAIL;
 
-    err = interface->on_file_fopen_cb("/foo.txt");
-    uint64_t bytes = 0;
+    // strip the "/file" prefix and any query string
+    char path[128];
+    const char* uri = req->uri + strlen("/file");
+    size_t path_len = strcspn(uri, "?");
+    if (path_len == 0 || path_len >= sizeof(path)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, NULL);
+        return ESP_OK;
+    }
+    memcpy(path, uri, path_len);
+    path[path_len] = '\0';
 
-    if (err == ESP_OK) {
-        for (int i = 0; i<70; i++) {
-            bytes += sizeof(chunk_buffer2);
-            err = httpd_resp_send_chunk(req, chunk_buffer2, sizeof(chunk_buffer2));
+    size_t file_size = 0;
+    int fd = interface->on_file_open_cb(path, &file_size);
+    if (fd < 0) {
+        httpd_resp_send_404(req);
+        return ESP_OK;
+    }
+
+    size_t start = 0;
+    size_t end = file_size ? file_size - 1 : 0;
+    char range[64];
+    char content_range[64];
+
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+    httpd_resp_set_type(req, "application/octet-stream");
+
+    if (httpd_req_get_hdr_value_str(req, "Range", range, sizeof(range)) == ESP_OK) {
+        range_result_t result = parse_range(range, file_size, &start, &end);
+        if (result == RANGE_UNSATISFIABLE) {
+            snprintf(content_range, sizeof(content_range), "bytes */%u", file_size);
+            httpd_resp_set_status(req, "416 Range Not Satisfiable");
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
+            httpd_resp_send(req, NULL, 0);
+            interface->on_file_close_cb(fd);
+            return ESP_OK;
+        }
+
+        if (result == RANGE_SATISFIABLE) {
+            snprintf(content_range, sizeof(content_range), "bytes %u-%u/%u", start, end, file_size);
+            httpd_resp_set_status(req, "206 Partial Content");
+            httpd_resp_set_hdr(req, "Content-Range", content_range);
         }
-        
-
-        // // Read and send the file in chunks
-        // while ((bytes_read = interface->on_file_fread_cb(chunk_buffer, chunk_len)) > 0) {
-        //     bytes += bytes_read;
-        //     // printf(">>> bytes: %u\n", bytes_read);
-
-        //     // Send the chunk
-        //     err = httpd_resp_send_chunk(req, chunk_buffer2, sizeof(chunk_buffer2));
-        //     if (err != ESP_OK) {
-        //         httpd_resp_send_500(req);
-        //         break;
-        //     }
-        // }
     }
 
-    printf("total bytes: %llu\n", bytes);
-    interface->on_file_fclose_cb();
+    if (start > 0 && interface->on_file_seek_cb(fd, start) != 0) {
+        httpd_resp_send_500(req);
+        interface->on_file_close_cb(fd);
+        return ESP_OK;
+    }
+
+    uint64_t bytes = 0;
+    size_t length = file_size ? end - start + 1 : 0;
+    esp_err_t err = file_stream(req, fd, length, &bytes, deadline);
+    interface->on_file_close_cb(fd);
+
+    if (err == ESP_OK) {
+        httpd_resp_send_chunk(req, NULL, 0);
+    } else {
+        ESP_LOGE(TAG, "file stream aborted: %s", esp_err_to_name(err));
+    }
 
     uint64_t time_diff = esp_timer_get_time() - time_ref;
-    char str[255];
-    snprintf(str, sizeof(str), "total bytes: %llu, request_time = %llu\n", bytes, time_diff);
-    printf(str);
+    uint32_t kbps = time_diff ? bytes * 1000 / time_diff : 0;
+    ESP_LOGI(TAG, "%s: %llu bytes, %llu us, %lu KB/s (chunk %u)", path, bytes, time_diff, kbps, HTTP_FILE_CHUNK_SIZE);
 
-    snprintf(str, sizeof(str), "bytes: %llu, ms: %llu", bytes, time_diff);
-    interface->on_display_print(str, 0);
-    esp_err_t ret = httpd_resp_send_chunk(req, NULL, 0);
+    if (interface->on_display_print) {
+        char str[64];
+        snprintf(str, sizeof(str), "bytes: %llu, KB/s: %lu", bytes, kbps);
+        interface->on_display_print(str, 0);
+    }
 
-    return ESP_OK;
+    return err == ESP_ERR_TIMEOUT ? err : ESP_OK;
+}
+
+/* large file transfers run on the worker pool so they don't stall the httpd task */
+static esp_err_t file_get_handler(httpd_req_t *req) {
+    return queue_or_reject(req, file_get_async);
+}
+
+static int json_flush_http(void* ctx, const char* data, size_t len) {
+    return httpd_resp_send_chunk((httpd_req_t*)ctx, data, len) == ESP_OK ? 0 : -1;
 }
 
 static esp_err_t device_request_handler(httpd_req_t *req) {
@@ -342,37 +592,29 @@ static esp_err_t device_request_handler(httpd_req_t *req) {
         // ESP_LOGI(TAG, "Name: %s, Value: %s", name, value);
     }
 
-    //! Example array of values
-    // Create a JSON string manually, including the array of values
-    char json_response[400]; // Adjust the size as needed
-
-
     size_t arr_size;
     uint16_t *arr_data;
     interface->on_request_data(&arr_data, &arr_size);
 
-    // Start the JSON string
-    snprintf(json_response, sizeof(json_response),
-    "{\"status\":\"ok\",\"len\":%hu,\"data\":[", arr_size);
-
-    for (uint16_t i = 0; i < arr_size; i++) {
-        char temp[10]; // Temporary buffer for each value
-        snprintf(temp, sizeof(temp), "%hu", arr_data[i]); // Format the value
-        strcat(json_response, temp); // Append the value to the JSON string
+    // Stream the JSON response straight into the chunked response
+    httpd_resp_set_type(req, "application/json");
 
-        // Add a comma after each value (except the last one)
-        if (i < arr_size - 1) {
-            strcat(json_response, ",");
-        }
-    }
+    char json_buff[256];
+    json_writer_t writer;
+    json_writer_init(&writer, json_buff, sizeof(json_buff), json_flush_http, req);
 
-    // Close the JSON array and object
-    strcat(json_response, "]}");
+    json_object_begin(&writer, NULL);
+    json_write_str(&writer, "status", "ok");
+    json_write_uint(&writer, "len", arr_size);
+    json_write_u16_array(&writer, "data", arr_data, arr_size);
+    json_object_end(&writer);
 
-    // Send a response
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json_response, HTTPD_RESP_USE_STRLEN);
+    if (json_writer_finish(&writer) != 0) {
+        ESP_LOGE(TAG, "Failed to send json response");
+        return ESP_FAIL;
+    }
 
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
@@ -380,13 +622,17 @@ static httpd_handle_t start_webserver(void) {
     httpd_handle_t server = NULL;
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.lru_purge_enable = true;
+    config.uri_match_fn = httpd_uri_match_wildcard;
 
-    // It is advisable that httpd_config_t->max_open_sockets > MAX_ASYNC_REQUESTS
+    // It is advisable that httpd_config_t->max_open_sockets > workers + queued requests
     // Why? This leaves at least one socket still available to handle
     // quick synchronous requests. Otherwise, all the sockets will
     // get taken by the long async handlers, and your server will no
-    // longer be responsive.
-    config.max_open_sockets = CONFIG_EXAMPLE_MAX_ASYNC_REQUESTS + 1;
+    // longer be responsive. The lwip sockets left after the rest of the
+    // app cap it, see HTTP_MAX_OPEN_SOCKETS.
+    config.max_open_sockets = HTTP_MAX_OPEN_SOCKETS;
+    config.send_wait_timeout = HTTP_ASYNC_TIMEOUT_MS / 1000;
+    config.recv_wait_timeout = HTTP_ASYNC_TIMEOUT_MS / 1000;
 
     // Start the httpd server
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
@@ -422,7 +668,13 @@ static httpd_handle_t start_webserver(void) {
     });
 
     httpd_register_uri_handler(server, &(const httpd_uri_t) {
-        .uri       = "/file/",
+        .uri       = "/stats",
+        .method    = HTTP_GET,
+        .handler   = stats_handler,
+    });
+
+    httpd_register_uri_handler(server, &(const httpd_uri_t) {
+        .uri       = "/file/*",
         .method    = HTTP_GET,
         .handler   = file_get_handler,
     });
@@ -1,18 +1,33 @@
 #include <stdint.h>
+#include <sys/types.h>
 
 #include <esp_system.h>
 #include <sys/param.h>
 #include "esp_netif.h"
 
 typedef struct {
-    esp_err_t(*on_file_fopen_cb)(const char *path);
-    size_t(*on_file_fread_cb)(char *buffer, size_t len);
-    int(*on_file_fclose_cb)(void);
+    int(*on_file_open_cb)(const char *path, size_t *file_size);
+    ssize_t(*on_file_read_cb)(int fd, char *buffer, size_t len);
+    int(*on_file_seek_cb)(int fd, size_t offset);
+    int(*on_file_close_cb)(int fd);
     void(*on_display_print)(const char *str, uint8_t line);
     void(*on_request_data)(uint16_t **data, size_t *size);
 
 } http_interface_t;
 
+typedef struct {
+    uint32_t queued;
+    uint32_t rejected;
+    uint32_t timed_out;             // waited in the queue past HTTP_ASYNC_TIMEOUT_MS
+    uint32_t deadline_exceeded;     // ran past HTTP_ASYNC_DEADLINE_MS and was cut off
+    uint32_t completed;
+    uint32_t queue_depth;
+    uint32_t max_queue_depth;
+    uint64_t total_latency_us;
+    uint32_t max_latency_us;
+} http_stats_t;
+
 void http_setup(http_interface_t* interface);
+void http_get_stats(http_stats_t* stats);
 void http_get_request(void);
 void http_post_request(void);
\ No newline at end of file
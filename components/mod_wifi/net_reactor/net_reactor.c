@@ -0,0 +1,194 @@
+#include "net_reactor.h"
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+static const char *TAG = "NET_REACTOR";
+
+typedef struct {
+    net_reactor_fill_cb fill;
+    net_reactor_dispatch_cb dispatch;
+    void *ctx;
+    uint8_t first, count;           // this source's slice of the pollfd set
+} reactor_source_t;
+
+static reactor_source_t sources[NET_REACTOR_MAX_SOURCES];
+static uint8_t source_count;
+
+static SemaphoreHandle_t reactor_lock;
+static TaskHandle_t reactor_task_handle;
+static int wakeup_fd = -1;
+static volatile bool wakeup_pending;
+
+static net_reactor_stats_t reactor_stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+
+//! WAKEUP
+// A UDP socket connected to itself on loopback: any task sends one byte, poll()
+// on the reactor returns, the byte is drained on the next turn.
+
+static int wakeup_open(void) {
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (fd < 0) return -1;
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t addr_len = sizeof(addr);
+
+    //! bind to an ephemeral port, then connect to it so send/recv need no address
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) < 0 ||
+        connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+static void wakeup_drain(void) {
+    //! clear first: a wakeup racing the drain sends a fresh byte instead of being lost
+    wakeup_pending = false;
+
+    uint8_t buff[16];
+    while (recv(wakeup_fd, buff, sizeof(buff), MSG_DONTWAIT) > 0) {}
+}
+
+void net_reactor_wakeup(void) {
+    if (wakeup_fd < 0 || xTaskGetCurrentTaskHandle() == reactor_task_handle) return;
+
+    //! one byte in flight is enough, extra wakeups before the drain are collapsed
+    if (wakeup_pending) return;
+    wakeup_pending = true;
+
+    uint8_t byte = 1;
+    send(wakeup_fd, &byte, 1, MSG_DONTWAIT);
+}
+
+
+//! SOURCES
+
+void net_reactor_lock(void) {
+    if (reactor_lock) xSemaphoreTakeRecursive(reactor_lock, portMAX_DELAY);
+}
+
+void net_reactor_unlock(void) {
+    if (reactor_lock) xSemaphoreGiveRecursive(reactor_lock);
+}
+
+int net_reactor_add(net_reactor_fill_cb fill, net_reactor_dispatch_cb dispatch, void *ctx) {
+    if (fill == NULL || dispatch == NULL) return -1;
+
+    net_reactor_lock();
+    int index = source_count < NET_REACTOR_MAX_SOURCES ? source_count++ : -1;
+    if (index >= 0) {
+        sources[index] = (reactor_source_t){ .fill = fill, .dispatch = dispatch, .ctx = ctx };
+    }
+    net_reactor_unlock();
+
+    if (index < 0) {
+        ESP_LOGE(TAG, "Too many sources");
+        return -1;
+    }
+
+    net_reactor_wakeup();
+    return 0;
+}
+
+void net_reactor_get_stats(net_reactor_stats_t *stats) {
+    taskENTER_CRITICAL(&stats_lock);
+    *stats = reactor_stats;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+
+//! TASK
+
+static void reactor_task(void *param) {
+    struct pollfd fds[NET_REACTOR_MAX_POLLFDS];
+
+    while (1) {
+        //! slot 0 is always the wakeup socket
+        fds[0] = (struct pollfd){ .fd = wakeup_fd, .events = POLLIN };
+        int count = 1;
+
+        net_reactor_lock();
+        for (int i = 0; i < source_count; i++) {
+            reactor_source_t *source = &sources[i];
+            source->first = count;
+            source->count = source->fill(source->ctx, fds + count, NET_REACTOR_MAX_POLLFDS - count);
+            count += source->count;
+        }
+        net_reactor_unlock();
+
+        //! only the poll itself runs unlocked, other tasks queue work while we sleep
+        int activity = poll(fds, count, NET_REACTOR_TICK_MS);
+        uint64_t start_time = esp_timer_get_time();
+
+        if (activity < 0) {
+            if (errno != EINTR) ESP_LOGE(TAG, "poll failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(NET_REACTOR_TICK_MS));
+            continue;
+        }
+
+        bool woken = fds[0].revents & POLLIN;
+        if (woken) wakeup_drain();
+
+        //! every source is dispatched each turn, even without events, so idle timeouts still run
+        net_reactor_lock();
+        for (int i = 0; i < source_count; i++) {
+            reactor_source_t *source = &sources[i];
+            source->dispatch(source->ctx, fds + source->first, source->count, start_time);
+        }
+        net_reactor_unlock();
+
+        uint32_t busy_us = esp_timer_get_time() - start_time;
+        taskENTER_CRITICAL(&stats_lock);
+        reactor_stats.loops++;
+        reactor_stats.busy_us += busy_us;
+        if (woken) reactor_stats.wakeups++;
+        if (activity == 0) reactor_stats.timeouts++;
+        if (busy_us > reactor_stats.max_dispatch_us) reactor_stats.max_dispatch_us = busy_us;
+        taskEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+int net_reactor_start(void) {
+    if (reactor_task_handle) return 0;
+
+    if (reactor_lock == NULL) reactor_lock = xSemaphoreCreateRecursiveMutex();
+    if (reactor_lock == NULL) {
+        ESP_LOGE(TAG, "Failed to create lock");
+        return -1;
+    }
+
+    if (wakeup_fd < 0) wakeup_fd = wakeup_open();
+    if (wakeup_fd < 0) {
+        ESP_LOGE(TAG, "Failed to open wakeup socket: errno %d", errno);
+        return -1;
+    }
+
+    if (xTaskCreate(reactor_task, "net_reactor", NET_REACTOR_TASK_STACK_SIZE,
+                    NULL, NET_REACTOR_TASK_PRIORITY, &reactor_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start task");
+        reactor_task_handle = NULL;
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "Started with %d sources", source_count);
+    return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/sockets.h"
+
+//# One task owns every listening and connected socket through a single poll()
+//# set. Protocols register as sources: fill adds their pollfds, dispatch handles
+//# the revents. Other tasks touch a source only between net_reactor_lock/unlock,
+//# and call net_reactor_wakeup when they queued work the poll set must pick up.
+
+#ifndef NET_REACTOR_MAX_SOURCES
+#define NET_REACTOR_MAX_SOURCES 4
+#endif
+
+#ifndef NET_REACTOR_MAX_POLLFDS
+#define NET_REACTOR_MAX_POLLFDS 24
+#endif
+
+#ifndef NET_REACTOR_TICK_MS
+#define NET_REACTOR_TICK_MS 100             // longest poll() so idle timeouts still run
+#endif
+
+#ifndef NET_REACTOR_TASK_STACK_SIZE
+#define NET_REACTOR_TASK_STACK_SIZE 4096
+#endif
+
+#ifndef NET_REACTOR_TASK_PRIORITY
+#define NET_REACTOR_TASK_PRIORITY 5
+#endif
+
+typedef struct {
+    uint32_t loops;
+    uint32_t wakeups;               // turns started by net_reactor_wakeup
+    uint32_t timeouts;              // turns where poll() hit NET_REACTOR_TICK_MS
+    uint32_t max_dispatch_us;
+    uint64_t busy_us;               // time spent outside poll(), against uptime gives the load
+} net_reactor_stats_t;
+
+typedef int (*net_reactor_fill_cb)(void *ctx, struct pollfd *fds, int max);
+typedef void (*net_reactor_dispatch_cb)(void *ctx, const struct pollfd *fds, int count, uint64_t current_time);
+
+int net_reactor_add(net_reactor_fill_cb fill, net_reactor_dispatch_cb dispatch, void *ctx);
+int net_reactor_start(void);
+
+void net_reactor_lock(void);
+void net_reactor_unlock(void);
+void net_reactor_wakeup(void);
+void net_reactor_get_stats(net_reactor_stats_t *stats);
+
@@ -0,0 +1,332 @@
+#include "net_server.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+static const char *TAG = "NET_SERVER";
+
+_Static_assert((NET_CONN_RX_SIZE & (NET_CONN_RX_SIZE - 1)) == 0, "NET_CONN_RX_SIZE must be a power of 2");
+_Static_assert((NET_CONN_TX_SIZE & (NET_CONN_TX_SIZE - 1)) == 0, "NET_CONN_TX_SIZE must be a power of 2");
+
+
+//! RINGS
+
+size_t net_conn_peek(net_conn_t *conn, void *buff, size_t len) {
+    len = MIN(len, net_conn_rx_available(conn));
+    uint32_t offset = conn->rx_tail & (NET_CONN_RX_SIZE - 1);
+    size_t first = MIN(len, NET_CONN_RX_SIZE - offset);
+
+    memcpy(buff, conn->rx_buff + offset, first);
+    memcpy((uint8_t*)buff + first, conn->rx_buff, len - first);
+    return len;
+}
+
+void net_conn_consume(net_conn_t *conn, size_t len) {
+    conn->rx_tail += MIN(len, net_conn_rx_available(conn));
+}
+
+size_t net_conn_recv(net_conn_t *conn, void *buff, size_t len) {
+    len = net_conn_peek(conn, buff, len);
+    conn->rx_tail += len;
+    return len;
+}
+
+// send as much of the tx ring as the socket takes without blocking
+static int flush_tx(net_conn_t *conn) {
+    while (conn->tx_head != conn->tx_tail) {
+        uint32_t offset = conn->tx_tail & (NET_CONN_TX_SIZE - 1);
+        size_t chunk = MIN(conn->tx_head - conn->tx_tail, NET_CONN_TX_SIZE - offset);
+
+        int sent = send(conn->fd, conn->tx_buff + offset, chunk, MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+            return -1;
+        }
+
+        conn->tx_tail += sent;
+        if ((size_t)sent < chunk) return 0;
+    }
+    return 0;
+}
+
+size_t net_conn_send(net_conn_t *conn, const void *data, size_t len) {
+    if (conn->fd < 0 || conn->closing) return 0;
+
+    len = MIN(len, net_conn_tx_free(conn));
+    uint32_t offset = conn->tx_head & (NET_CONN_TX_SIZE - 1);
+    size_t first = MIN(len, NET_CONN_TX_SIZE - offset);
+
+    memcpy(conn->tx_buff + offset, data, first);
+    memcpy(conn->tx_buff, (const uint8_t*)data + first, len - first);
+    conn->tx_head += len;
+
+    //! errors surface on the next poll as POLLERR/POLLHUP
+    flush_tx(conn);
+    return len;
+}
+
+void net_conn_close(net_conn_t *conn) {
+    conn->closing = true;
+}
+
+
+//! CONNECTIONS
+
+static void close_conn(net_server_t *server, net_conn_t *conn) {
+    if (conn->fd < 0) return;
+
+    if (server->handlers.on_close) server->handlers.on_close(server, conn);
+    ESP_LOGI(TAG, "[%d] closed %d", server->port, conn->fd);
+
+    close(conn->fd);
+    conn->fd = -1;
+    conn->user = NULL;
+    server->stats.active--;
+}
+
+static net_conn_t *find_conn(net_server_t *server, int fd) {
+    for (int i = 0; i < NET_SERVER_MAX_CONNS; i++) {
+        if (server->conns[i].fd == fd) return &server->conns[i];
+    }
+    return NULL;
+}
+
+static void handle_accept(net_server_t *server, uint64_t current_time) {
+    //! drain the backlog, the listener is non-blocking
+    while (1) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return;
+
+            //! out of descriptors is transient, anything else means the listener is broken
+            if (errno == ENFILE || errno == EMFILE) {
+                ESP_LOGW(TAG, "[%d] accept: out of sockets", server->port);
+                return;
+            }
+
+            ESP_LOGE(TAG, "[%d] accept failed: errno %d", server->port, errno);
+            close(server->listen_fd);
+            server->listen_fd = -1;
+            server->state = NET_SERVER_RETRY;
+            server->retry_time = current_time + NET_SERVER_RETRY_US;
+            return;
+        }
+
+        net_conn_t *conn = find_conn(server, -1);
+        if (conn == NULL) {
+            //! pool full: close right away so the peer doesn't sit in the backlog
+            server->stats.rejected++;
+            close(fd);
+            continue;
+        }
+
+        int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        conn->fd = fd;
+        conn->closing = false;
+        conn->last_active = current_time;
+        conn->rx_head = conn->rx_tail = 0;
+        conn->tx_head = conn->tx_tail = 0;
+        conn->user = NULL;
+
+        server->stats.accepted++;
+        server->stats.active++;
+        ESP_LOGI(TAG, "[%d] accepted %d", server->port, fd);
+
+        if (server->handlers.on_open) server->handlers.on_open(server, conn);
+    }
+}
+
+// returns false when the connection has to be closed
+static bool handle_read(net_server_t *server, net_conn_t *conn, bool hung_up) {
+    size_t space = NET_CONN_RX_SIZE - net_conn_rx_available(conn);
+    if (space == 0) {
+        if (!hung_up) return true;
+
+        //! POLLHUP fires whatever the events mask, close unless the handler can still make room
+        uint32_t rx_tail = conn->rx_tail;
+        if (server->handlers.on_data) server->handlers.on_data(server, conn);
+        return conn->rx_tail != rx_tail;
+    }
+
+    uint32_t offset = conn->rx_head & (NET_CONN_RX_SIZE - 1);
+    size_t chunk = MIN(space, NET_CONN_RX_SIZE - offset);
+
+    int len = recv(conn->fd, conn->rx_buff + offset, chunk, MSG_DONTWAIT);
+    if (len == 0) return false;
+    if (len < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    conn->rx_head += len;
+    if (server->handlers.on_data) server->handlers.on_data(server, conn);
+    return true;
+}
+
+
+//! LISTENER
+
+void net_server_init(net_server_t *server, uint16_t port, const net_server_handlers_t *handlers, void *ctx) {
+    memset(server, 0, sizeof(*server));
+    server->port = port;
+    server->listen_fd = -1;
+    server->state = NET_SERVER_STOPPED;
+    server->ctx = ctx;
+    if (handlers) server->handlers = *handlers;
+
+    for (int i = 0; i < NET_SERVER_MAX_CONNS; i++) {
+        server->conns[i].fd = -1;
+    }
+}
+
+int net_server_start(net_server_t *server) {
+    if (server->state == NET_SERVER_LISTENING) return 0;
+
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "[%d] socket failed: errno %d", server->port, errno);
+        server->state = NET_SERVER_RETRY;
+        return -1;
+    }
+
+    int opt = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+        .sin_port = htons(server->port),
+    };
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, NET_SERVER_MAX_CONNS) < 0) {
+        ESP_LOGE(TAG, "[%d] bind/listen failed: errno %d", server->port, errno);
+        close(fd);
+        server->state = NET_SERVER_RETRY;
+        return -1;
+    }
+
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+    server->listen_fd = fd;
+    server->state = NET_SERVER_LISTENING;
+    ESP_LOGI(TAG, "Listening on port %d", server->port);
+    return 0;
+}
+
+void net_server_stop(net_server_t *server) {
+    for (int i = 0; i < NET_SERVER_MAX_CONNS; i++) {
+        close_conn(server, &server->conns[i]);
+    }
+
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    server->listen_fd = -1;
+    server->state = NET_SERVER_STOPPED;
+}
+
+
+//! POLLING
+
+int net_server_fill_pollfds(net_server_t *server, struct pollfd *fds, int max) {
+    int count = 0;
+
+    if (server->listen_fd >= 0 && count < max) {
+        fds[count++] = (struct pollfd){ .fd = server->listen_fd, .events = POLLIN };
+    }
+
+    for (int i = 0; i < NET_SERVER_MAX_CONNS && count < max; i++) {
+        net_conn_t *conn = &server->conns[i];
+        if (conn->fd < 0) continue;
+
+        //! backpressure: stop reading while the rx ring is full, tcp flow control does the rest
+        short events = 0;
+        if (net_conn_rx_available(conn) < NET_CONN_RX_SIZE) events |= POLLIN;
+        if (conn->tx_head != conn->tx_tail) events |= POLLOUT;
+
+        fds[count++] = (struct pollfd){ .fd = conn->fd, .events = events };
+    }
+
+    return count;
+}
+
+void net_server_dispatch(net_server_t *server, const struct pollfd *fds, int count, uint64_t current_time) {
+    for (int i = 0; i < count; i++) {
+        short revents = fds[i].revents;
+        if (revents == 0) continue;
+
+        if (fds[i].fd == server->listen_fd) {
+            if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                ESP_LOGE(TAG, "[%d] listener error", server->port);
+                close(server->listen_fd);
+                server->listen_fd = -1;
+                server->state = NET_SERVER_RETRY;
+                server->retry_time = current_time + NET_SERVER_RETRY_US;
+            } else if (revents & POLLIN) {
+                handle_accept(server, current_time);
+            }
+            continue;
+        }
+
+        net_conn_t *conn = find_conn(server, fds[i].fd);
+        if (conn == NULL) continue;
+
+        uint32_t rx_head = conn->rx_head, tx_tail = conn->tx_tail;
+        bool keep = true;
+        if (revents & (POLLERR | POLLNVAL)) keep = false;
+        if (keep && (revents & (POLLIN | POLLHUP))) keep = handle_read(server, conn, revents & POLLHUP);
+        if (keep && (revents & POLLOUT)) keep = flush_tx(conn) == 0;
+
+        //! room in tx again, a handler held back by backpressure gets another go at the rx ring
+        if (keep && conn->tx_tail != tx_tail && net_conn_rx_available(conn) > 0 && server->handlers.on_data) {
+            server->handlers.on_data(server, conn);
+        }
+
+        if (!keep) {
+            close_conn(server, conn);
+        } else if (conn->rx_head != rx_head || conn->tx_tail != tx_tail) {
+            //! only real traffic counts, a stalled peer still times out
+            conn->last_active = current_time;
+        }
+    }
+
+    for (int i = 0; i < NET_SERVER_MAX_CONNS; i++) {
+        net_conn_t *conn = &server->conns[i];
+        if (conn->fd < 0) continue;
+
+        if (conn->closing && conn->tx_head == conn->tx_tail) {
+            close_conn(server, conn);
+        } else if (current_time - conn->last_active > NET_CONN_IDLE_TIMEOUT_US) {
+            server->stats.timed_out++;
+            close_conn(server, conn);
+        }
+    }
+
+    //! recover a failed listener instead of giving up on the server
+    if (server->state == NET_SERVER_RETRY && current_time >= server->retry_time) {
+        server->stats.restarts++;
+        if (net_server_start(server) < 0) {
+            server->retry_time = current_time + NET_SERVER_RETRY_US;
+        }
+    }
+}
+
+int net_server_poll(net_server_t *server, uint64_t current_time, int timeout_ms) {
+    if (server->state == NET_SERVER_STOPPED) return 0;
+
+    struct pollfd fds[NET_SERVER_MAX_POLLFDS];
+    int count = net_server_fill_pollfds(server, fds, NET_SERVER_MAX_POLLFDS);
+
+    int activity = poll(fds, count, timeout_ms);
+    if (activity < 0) {
+        if (errno != EINTR) ESP_LOGE(TAG, "[%d] poll failed: errno %d", server->port, errno);
+        return -1;
+    }
+
+    net_server_dispatch(server, fds, count, current_time);
+    return activity;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "lwip/sockets.h"
+
+//# Non-blocking TCP server core: a listener plus a preallocated pool of
+//# connections, each with its own rx and tx ring. Protocols (echo, WebSocket, ...)
+//# plug in through net_server_handlers_t and only ever touch the rings.
+
+#ifndef NET_SERVER_MAX_CONNS
+#define NET_SERVER_MAX_CONNS 4
+#endif
+
+#ifndef NET_CONN_RX_SIZE
+#define NET_CONN_RX_SIZE 1024                   // power of 2
+#endif
+
+#ifndef NET_CONN_TX_SIZE
+#define NET_CONN_TX_SIZE 1024                   // power of 2
+#endif
+
+#ifndef NET_CONN_IDLE_TIMEOUT_US
+#define NET_CONN_IDLE_TIMEOUT_US 30000000       // close connections with no traffic for 30s
+#endif
+
+#ifndef NET_SERVER_RETRY_US
+#define NET_SERVER_RETRY_US 2000000             // wait before reopening a failed listener
+#endif
+
+// listener + one entry per connection
+#define NET_SERVER_MAX_POLLFDS (NET_SERVER_MAX_CONNS + 1)
+
+typedef enum __attribute__((packed)) {
+    NET_SERVER_STOPPED = 0x00,
+    NET_SERVER_LISTENING = 0x01,
+    NET_SERVER_RETRY = 0x02,
+} net_server_state_t;
+
+typedef struct {
+    int fd;
+    bool closing;                   // close once tx drains
+    uint64_t last_active;
+    uint32_t rx_head, rx_tail;      // free running, used = head - tail
+    uint32_t tx_head, tx_tail;
+    void *user;
+    uint8_t rx_buff[NET_CONN_RX_SIZE];
+    uint8_t tx_buff[NET_CONN_TX_SIZE];
+} net_conn_t;
+
+typedef struct net_server net_server_t;
+
+typedef struct {
+    void (*on_open)(net_server_t *server, net_conn_t *conn);
+    void (*on_data)(net_server_t *server, net_conn_t *conn);     // new bytes in the rx ring
+    void (*on_close)(net_server_t *server, net_conn_t *conn);
+} net_server_handlers_t;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;              // pool full
+    uint32_t timed_out;
+    uint32_t restarts;              // listener reopened after an error
+    uint16_t active;
+} net_server_stats_t;
+
+struct net_server {
+    uint16_t port;
+    int listen_fd;
+    net_server_state_t state;
+    uint64_t retry_time;
+    net_server_handlers_t handlers;
+    void *ctx;
+    net_server_stats_t stats;
+    net_conn_t conns[NET_SERVER_MAX_CONNS];
+};
+
+void net_server_init(net_server_t *server, uint16_t port, const net_server_handlers_t *handlers, void *ctx);
+int net_server_start(net_server_t *server);
+void net_server_stop(net_server_t *server);
+
+//! one poll() over the listener and every connection, timeout_ms 0 for the cooperative loop
+int net_server_poll(net_server_t *server, uint64_t current_time, int timeout_ms);
+
+//! split form of net_server_poll so several servers can share one poll() set
+int net_server_fill_pollfds(net_server_t *server, struct pollfd *fds, int max);
+void net_server_dispatch(net_server_t *server, const struct pollfd *fds, int count, uint64_t current_time);
+
+// returns bytes queued, less than len when the tx ring is full (backpressure)
+size_t net_conn_send(net_conn_t *conn, const void *data, size_t len);
+size_t net_conn_peek(net_conn_t *conn, void *buff, size_t len);
+size_t net_conn_recv(net_conn_t *conn, void *buff, size_t len);
+void net_conn_consume(net_conn_t *conn, size_t len);
+void net_conn_close(net_conn_t *conn);
+
+static inline size_t net_conn_rx_available(const net_conn_t *conn) {
+    return conn->rx_head - conn->rx_tail;
+}
+
+static inline size_t net_conn_tx_free(const net_conn_t *conn) {
+    return NET_CONN_TX_SIZE - (conn->tx_head - conn->tx_tail);
+}
@@ -19,202 +19,52 @@
 #define SERVER_PORT 1234  // Device A's server port
 #define CLIENT_PORT 5678  // Device B's s
 
-#define MAX_CLIENTS 10
-static int client_sockets[MAX_CLIENTS];
-
 static const char *payload = "Message from ESP32 ";
 uint64_t last_send_time;
 #define SERVER_IP "10.0.0.233"
 
 static const char *TAG = "APP_TCP";
-static int server_socket;
-static int client_socket;
-static int current_status = TCP_STATUS_INITIATED;
-static uint64_t last_socket_check;
-
-
-void setup_server() {
-    //! Create server socket
-    server_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-    if (server_socket < 0) {
-        perror("Failed to create server socket");
-        exit(EXIT_FAILURE);
-    }
+static int client_socket = -1;
+static net_server_t tcp_server;
 
-    // Bind server socket
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    server_addr.sin_port = htons(SERVER_PORT);
 
-    //! Bind server socket
-    if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Failed to bind server socket");
-        close(server_socket);
-        exit(EXIT_FAILURE);
-    }
+//! echo whatever fits in the tx ring, the rest stays in rx until the peer reads
+static void on_server_data(net_server_t *server, net_conn_t *conn) {
+    uint8_t buffer[256];
 
-    //! Listen for incoming connections
-    if (listen(server_socket, MAX_CLIENTS) < 0) {
-        perror("Failed to listen on server socket");
-        close(server_socket);
-        exit(EXIT_FAILURE);
+    while (net_conn_rx_available(conn) > 0 && net_conn_tx_free(conn) > 0) {
+        size_t len = net_conn_peek(conn, buffer, MIN(sizeof(buffer), net_conn_tx_free(conn)));
+        net_conn_consume(conn, net_conn_send(conn, buffer, len));
     }
-
-    printf("Server listening on port %d\n", SERVER_PORT);
 }
 
-void setup_client() {
-    // Create client socket
-    client_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_IP);
-    if (client_socket < 0) {
-        perror("Failed to create client socket");
-        return;
-    }
+static const net_server_handlers_t server_handlers = {
+    .on_data = on_server_data,
+};
 
-    // Connect to server
-    struct sockaddr_in server_addr;
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(CLIENT_PORT);
-    inet_pton(AF_INET, SERVER_IP, &server_addr.sin_addr);
+void tcp_server_socket_setup(uint64_t current_time) {
+    if (tcp_server.state != NET_SERVER_STOPPED) return;
 
-    if (connect(client_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        perror("Failed to connect to server");
-        close(client_socket);
-        client_socket = -1;
-        return;
-    }
+    net_server_init(&tcp_server, SERVER_PORT, &server_handlers, NULL);
 
-    printf("Connected to server at %s:%d\n", SERVER_IP, CLIENT_PORT);
+    //! a failed start is retried from the task, never fatal
+    net_server_start(&tcp_server);
 }
 
-void handle_server_activity(fd_set *read_fds) {
-    if (FD_ISSET(server_socket, read_fds)) {
-        // Accept new client connection
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-
-        int new_socket = accept(server_socket, (struct sockaddr *)&client_addr, &addr_len);
-        if (new_socket < 0) {
-            perror("Failed to accept connection");
-            return;
-        }
-
-        printf("New client connected: %s:%d\n", inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-
-        // Handle client communication (e.g., echo data back)
-        char buffer[1024];
-        int len = recv(new_socket, buffer, sizeof(buffer) - 1, 0);
-        if (len > 0) {
-            buffer[len] = '\0';
-            printf("Received from client: %s\n", buffer);
-            send(new_socket, buffer, len, 0);
-        }
-
-        close(new_socket);
-    }
+void tcp_server_socket_task(uint64_t current_time) {
+    net_server_poll(&tcp_server, current_time, 0);
 }
 
-void handle_client_activity(fd_set *read_fds) {
-    if (client_socket != -1 && FD_ISSET(client_socket, read_fds)) {
-        // Receive data from server
-        char buffer[1024];
-        int len = recv(client_socket, buffer, sizeof(buffer) - 1, 0);
-        if (len > 0) {
-            buffer[len] = '\0';
-            printf("Received from server: %s\n", buffer);
-        } else if (len == 0) {
-            // Server closed the connection
-            printf("Server closed the connection\n");
-            close(client_socket);
-            client_socket = -1;
-        } else {
-            perror("Failed to receive data from server");
-            close(client_socket);
-            client_socket = -1;
-        }
-    }
+int tcp_server_fill_pollfds(void *ctx, struct pollfd *fds, int max) {
+    return net_server_fill_pollfds(&tcp_server, fds, max);
 }
 
+void tcp_server_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time) {
+    net_server_dispatch(&tcp_server, fds, count, current_time);
+}
 
-
-void tcp_server_socket_task(uint64_t current_time) {
-    if (current_status != TCP_STATUS_SETUP) return;
-
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(server_socket, &read_fds);
-    int max_fd = server_socket;
-
-    // Add all client sockets to the fd_set
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0) {
-            FD_SET(client_sockets[i], &read_fds);
-            if (client_sockets[i] > max_fd) {
-                max_fd = client_sockets[i];
-            }
-        }
-    }
-
-    // Wait for activity on any socket
-    struct timeval timeout;
-    timeout.tv_sec = 1;  // 1-second timeout
-    timeout.tv_usec = 0;
-
-    int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
-    if (activity < 0) {
-        ESP_LOGE(TAG, "select failed: errno %d", errno);
-        return;
-    }
-
-    // Check for new connections
-    if (FD_ISSET(server_socket, &read_fds)) {
-        struct sockaddr_storage source_addr;
-        socklen_t addr_len = sizeof(source_addr);
-
-        int new_socket = accept(server_socket, (struct sockaddr *)&source_addr, &addr_len);
-        if (new_socket < 0) {
-            ESP_LOGE(TAG, "Unable to accept connection: errno %d", errno);
-        } else {
-            // Set the new socket to non-blocking mode
-            int flags = fcntl(new_socket, F_GETFL, 0);
-            fcntl(new_socket, F_SETFL, flags | O_NONBLOCK);
-
-            // Add the new socket to the list of client sockets
-            for (int i = 0; i < MAX_CLIENTS; i++) {
-                if (client_sockets[i] == -1) {
-                    client_sockets[i] = new_socket;
-                    ESP_LOGI(TAG, "New client connected, socket fd: %d", new_socket);
-                    break;
-                }
-            }
-        }
-    }
-
-    // Handle data from clients
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_sockets[i] > 0 && FD_ISSET(client_sockets[i], &read_fds)) {
-            char buffer[1024];
-
-            int len = recv(client_sockets[i], buffer, sizeof(buffer) - 1, 0);
-            if (len > 0) {
-                buffer[len] = '\0';  // Null-terminate the received data
-                ESP_LOGI(TAG, "Received %d bytes from client %d: %s", len, client_sockets[i], buffer);
-
-                // Echo the data back to the client
-                send(client_sockets[i], buffer, len, 0);
-            } else if (len == 0) {
-                // Client disconnected
-                ESP_LOGI(TAG, "Client disconnected, socket fd: %d", client_sockets[i]);
-                close(client_sockets[i]);
-                client_sockets[i] = -1;
-            } else {
-                ESP_LOGE(TAG, "recv failed: errno %d", errno);
-                close(client_sockets[i]);
-                client_sockets[i] = -1;
-            }
-        }
-    }
+void tcp_server_get_stats(net_server_stats_t *stats) {
+    *stats = tcp_server.stats;
 }
 
 
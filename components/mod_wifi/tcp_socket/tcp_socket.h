@@ -1,5 +1,7 @@
 #include <stdint.h>
 
+#include "net_server/net_server.h"
+
 typedef enum {
     TCP_STATUS_INITIATED = 0x01,
     TCP_STATUS_RETRY = 0x02,
@@ -13,4 +15,9 @@ typedef enum {
 
 void tcp_server_socket_setup(uint64_t current_time);
 void tcp_server_socket_task(uint64_t current_time);
+
+// net_reactor source, replaces tcp_server_socket_task when the reactor task owns the sockets
+int tcp_server_fill_pollfds(void *ctx, struct pollfd *fds, int max);
+void tcp_server_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time);
+void tcp_server_get_stats(net_server_stats_t *stats);
 void tcp_client_socket_task(uint64_t current_time);
\ No newline at end of file
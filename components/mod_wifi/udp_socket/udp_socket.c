@@ -19,6 +19,8 @@
 #include "lwip/err.h"
 #include "lwip/sys.h"
 
+#include <string.h>
+
 
 #define PORT 3333
 
@@ -52,7 +54,7 @@ udp_status_t udp_server_socket_setup(uint64_t current_time) {
         dest_addr_ip4->sin_port = htons(PORT);
         ip_protocol = IPPROTO_IP;
     } else if (addr_family == AF_INET6) {
-        bzero(&dest_addr.sin6_addr.un, sizeof(dest_addr.sin6_addr.un));
+        bzero(&dest_addr.sin6_addr, sizeof(dest_addr.sin6_addr));
         dest_addr.sin6_family = AF_INET6;
         dest_addr.sin6_port = htons(PORT);
         ip_protocol = IPPROTO_IPV6;
@@ -105,90 +107,222 @@ udp_status_t udp_server_socket_setup(uint64_t current_time) {
     return current_status;
 }
 
-static char rx_buffer[128];
-static char addr_str[128];
+static void handle_read(void) {
+    char rx_buffer[128];
+    char addr_str[128];
+
+    int len = recvfrom(server_sock, rx_buffer, sizeof(rx_buffer) - 1, 0,
+                        (struct sockaddr *)&source_addr, &socklen);
+    if (len <= 0) return;
+
+    rx_buffer[len] = 0; // Null-terminate the received data
+
+    // Get the sender's IP address as a string
+    if (source_addr.ss_family == AF_INET) {
+        inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
+    } else if (source_addr.ss_family == AF_INET6) {
+        inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
+    }
+
+    ESP_LOGI(TAG, "Received %d bytes from %s:", len, addr_str);
+    ESP_LOGI(TAG, "%s", rx_buffer);
+
+    // Send a response back to the client
+    int err = sendto(server_sock, rx_buffer, len, 0,
+                        (struct sockaddr *)&source_addr, sizeof(source_addr));
+    if (err < 0) {
+        ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
+    }
+}
 
 void udp_server_socket_task() {
     if (current_status != UDP_STATUS_SETUP) return;
 
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(server_sock, &read_fds);
-
-    struct timeval timeout;
-    timeout.tv_sec = 0;  // 1-second timeout
-    timeout.tv_usec = 1;
-
-    int ret = select(server_sock + 1, &read_fds, NULL, NULL, &timeout);
-    if (ret > 0) {
-        if (FD_ISSET(server_sock, &read_fds)) {
-            char rx_buffer[128];
-            char addr_str[128];
-
-            int len = recvfrom(server_sock, rx_buffer, sizeof(rx_buffer) - 1, 0,
-                              (struct sockaddr *)&source_addr, &socklen);
-            if (len > 0) {
-                rx_buffer[len] = 0; // Null-terminate the received data
-
-                // Get the sender's IP address as a string
-                if (source_addr.ss_family == AF_INET) {
-                    inet_ntoa_r(((struct sockaddr_in *)&source_addr)->sin_addr, addr_str, sizeof(addr_str) - 1);
-                } else if (source_addr.ss_family == AF_INET6) {
-                    inet6_ntoa_r(((struct sockaddr_in6 *)&source_addr)->sin6_addr, addr_str, sizeof(addr_str) - 1);
-                }
-
-                ESP_LOGI(TAG, "Received %d bytes from %s:", len, addr_str);
-                ESP_LOGI(TAG, "%s", rx_buffer);
-
-                // Send a response back to the client
-                int err = sendto(server_sock, rx_buffer, len, 0,
-                                 (struct sockaddr *)&source_addr, sizeof(source_addr));
-                if (err < 0) {
-                    ESP_LOGE(TAG, "Error occurred during sending: errno %d", errno);
-                }
-            }
-        }
-    } else if (ret == 0) {
-        // Timeout: No data received
-        // ESP_LOGI(TAG, "No data received within the timeout period");
-    } else {
-        ESP_LOGE(TAG, "select failed: errno %d", errno);
+    struct pollfd fds = { .fd = server_sock, .events = POLLIN };
+    int ret = poll(&fds, 1, 0);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "poll failed: errno %d", errno);
+    } else if (ret > 0 && (fds.revents & POLLIN)) {
+        handle_read();
     }
 }
 
-#define MESSAGE_UDP "Hello, UDP!"
-#define BROADCAST_IP "10.0.0.255" 
+int udp_server_fill_pollfds(void *ctx, struct pollfd *fds, int max) {
+    if (current_status != UDP_STATUS_SETUP || max < 1) return 0;
+    fds[0] = (struct pollfd){ .fd = server_sock, .events = POLLIN };
+    return 1;
+}
 
-uint64_t last_sent_time = 0;
+void udp_server_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time) {
+    if (count < 1 || fds[0].fd != server_sock) return;
+    if (fds[0].revents & POLLIN) handle_read();
+}
 
-void udp_client_socket_send(uint64_t current_time) {
-    if (current_status != UDP_STATUS_SETUP) return;
-    
-    // printf("last_sent_time: %"PRIu64", curr_time: %"PRIu64"\n", last_sent_time, current_time);
-    if (current_time - last_sent_time < 1000000) return;
-    last_sent_time = current_time;
+//# UDP client: one persistent socket, readings are batched into datagrams
+//# of up to UDP_BATCH_MAX_LEN bytes. Each datagram is:
+//#     seq u32 LE | record_count u16 LE | { len u16 LE | data } * record_count
+//# receivers detect loss by gaps in seq.
+
+#ifndef UDP_BATCH_MAX_LEN
+#define UDP_BATCH_MAX_LEN 1400          // fits the 1500 byte ethernet/wifi MTU with IP + UDP headers
+#endif
+
+#ifndef UDP_FLUSH_INTERVAL_US
+#define UDP_FLUSH_INTERVAL_US 1000000   // max time a queued reading waits for a batch to fill
+#endif
+
+#define UDP_BATCH_HEADER_LEN 6
+#define UDP_RECORD_HEADER_LEN 2
+
+static int client_sock = -1;
+static struct sockaddr_in client_dest;
+
+static uint8_t batch_buff[UDP_BATCH_MAX_LEN];
+static size_t batch_len = UDP_BATCH_HEADER_LEN;
+static uint16_t batch_records = 0;
+static uint32_t batch_seq = 0;
+static uint64_t last_sent_time = 0;
+
+static udp_client_stats_t client_stats;
+
+static uint32_t subnet_broadcast_addr(void) {
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    esp_netif_ip_info_t ip_info;
+
+    if (netif == NULL || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        return htonl(INADDR_BROADCAST);
+    }
+
+    return ip_info.ip.addr | ~ip_info.netmask.addr;
+}
+
+int udp_client_setup(const char *dest_ip, uint16_t port) {
+    if (client_sock >= 0) {
+        close(client_sock);
+        client_sock = -1;
+    }
+
+    memset(&client_dest, 0, sizeof(client_dest));
+    client_dest.sin_family = AF_INET;
+    client_dest.sin_port = htons(port);
+
+    //! no destination: derive the broadcast address from the station's subnet
+    if (dest_ip == NULL) {
+        client_dest.sin_addr.s_addr = subnet_broadcast_addr();
+    } else if (inet_pton(AF_INET, dest_ip, &client_dest.sin_addr) != 1) {
+        ESP_LOGE(TAG, "Invalid destination: %s", dest_ip);
+        return -1;
+    }
 
-    // Create UDP socket
-    int client_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    client_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
     if (client_sock < 0) {
         ESP_LOGE(TAG, "Failed to create socket: errno %d", errno);
-        return;
+        return -1;
     }
 
-    // Configure destination address
-    struct sockaddr_in dest_addr;
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(PORT);
-    inet_pton(AF_INET, BROADCAST_IP, &dest_addr.sin_addr);
+    int opt = 1;
+    setsockopt(client_sock, SOL_SOCKET, SO_BROADCAST, &opt, sizeof(opt));
+
+    if (IN_MULTICAST(ntohl(client_dest.sin_addr.s_addr))) {
+        uint8_t ttl = 1;
+        setsockopt(client_sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    }
+
+    //! sends never block the caller, a full tx buffer counts as a dropped datagram
+    int flags = fcntl(client_sock, F_GETFL, 0);
+    fcntl(client_sock, F_SETFL, flags | O_NONBLOCK);
+
+    batch_len = UDP_BATCH_HEADER_LEN;
+    batch_records = 0;
+
+    char addr_str[16];
+    inet_ntoa_r(client_dest.sin_addr, addr_str, sizeof(addr_str));
+    ESP_LOGI(TAG, "UDP client sending to %s:%d", addr_str, port);
+    return 0;
+}
+
+int udp_multicast_join(const char *group_ip) {
+    if (current_status != UDP_STATUS_SETUP) return -1;
+
+    struct ip_mreq mreq = {
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    if (inet_pton(AF_INET, group_ip, &mreq.imr_multiaddr) != 1 || !IN_MULTICAST(ntohl(mreq.imr_multiaddr.s_addr))) {
+        ESP_LOGE(TAG, "Invalid multicast group: %s", group_ip);
+        return -1;
+    }
+
+    if (setsockopt(server_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        ESP_LOGE(TAG, "Failed to join %s: errno %d", group_ip, errno);
+        return -1;
+    }
+
+    ESP_LOGI(TAG, "Joined multicast group %s", group_ip);
+    return 0;
+}
+
+int udp_client_flush(void) {
+    if (client_sock < 0 || batch_records == 0) return 0;
+
+    uint32_t seq = batch_seq++;
+    batch_buff[0] = seq;
+    batch_buff[1] = seq >> 8;
+    batch_buff[2] = seq >> 16;
+    batch_buff[3] = seq >> 24;
+    batch_buff[4] = batch_records;
+    batch_buff[5] = batch_records >> 8;
+
+    int err = sendto(client_sock, batch_buff, batch_len, 0,
+                        (struct sockaddr *)&client_dest, sizeof(client_dest));
+
+    batch_len = UDP_BATCH_HEADER_LEN;
+    batch_records = 0;
 
-    // Send UDP message
-    int err = sendto(client_sock, MESSAGE_UDP, strlen(MESSAGE_UDP), 0, 
-                        (struct sockaddr *)&dest_addr, sizeof(dest_addr));
     if (err < 0) {
-        ESP_LOGE(TAG, "Failed to send UDP message: errno %d", errno);
-    } else {
-        ESP_LOGI(TAG, "UDP message sent: %s", MESSAGE_UDP);
+        client_stats.dropped++;
+        ESP_LOGW(TAG, "Failed to send UDP batch %lu: errno %d", (unsigned long)seq, errno);
+        return -1;
+    }
+
+    client_stats.datagrams++;
+    client_stats.bytes += err;
+    return 0;
+}
+
+int udp_client_queue(const void *data, uint16_t len) {
+    if (client_sock < 0) return -1;
+    if (len > UDP_BATCH_MAX_LEN - UDP_BATCH_HEADER_LEN - UDP_RECORD_HEADER_LEN) return -1;
+
+    //! no room left in this datagram: send it and start the next
+    if (batch_len + UDP_RECORD_HEADER_LEN + len > UDP_BATCH_MAX_LEN) {
+        udp_client_flush();
     }
 
+    batch_buff[batch_len++] = len;
+    batch_buff[batch_len++] = len >> 8;
+    memcpy(batch_buff + batch_len, data, len);
+    batch_len += len;
+    batch_records++;
+    client_stats.records++;
+    return 0;
+}
+
+void udp_client_socket_send(uint64_t current_time) {
+    if (client_sock < 0) return;
+    if (current_time - last_sent_time < UDP_FLUSH_INTERVAL_US) return;
+    last_sent_time = current_time;
+
+    udp_client_flush();
+}
+
+void udp_client_close(void) {
+    if (client_sock < 0) return;
+    udp_client_flush();
     close(client_sock);
-}
\ No newline at end of file
+    client_sock = -1;
+}
+
+void udp_client_get_stats(udp_client_stats_t *stats) {
+    *stats = client_stats;
+    stats->seq = batch_seq;
+}
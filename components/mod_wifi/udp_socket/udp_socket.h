@@ -1,4 +1,7 @@
 #include <stdint.h>
+#include <stddef.h>
+
+#include "lwip/sockets.h"
 
 typedef enum __attribute__((packed)) {
     UDP_STATUS_INITIATED = 0x01,
@@ -12,4 +15,24 @@ typedef enum __attribute__((packed)) {
 
 udp_status_t udp_server_socket_setup(uint64_t current_time);
 void udp_server_socket_task(void);
-void udp_client_socket_send(uint64_t current_time);
\ No newline at end of file
+
+// net_reactor source, replaces udp_server_socket_task when the reactor task owns the sockets
+int udp_server_fill_pollfds(void *ctx, struct pollfd *fds, int max);
+void udp_server_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time);
+int udp_multicast_join(const char *group_ip);
+
+typedef struct {
+    uint32_t seq;           // next datagram sequence number
+    uint32_t datagrams;     // datagrams sent
+    uint32_t dropped;       // datagrams the stack refused (tx buffer full, no route)
+    uint32_t records;       // readings queued
+    uint64_t bytes;
+} udp_client_stats_t;
+
+//! dest_ip NULL sends to the subnet broadcast address, a 224.0.0.0/4 address sends multicast
+int udp_client_setup(const char *dest_ip, uint16_t port);
+int udp_client_queue(const void *data, uint16_t len);
+int udp_client_flush(void);
+void udp_client_socket_send(uint64_t current_time);
+void udp_client_close(void);
+void udp_client_get_stats(udp_client_stats_t *stats);
\ No newline at end of file
@@ -1,8 +1,10 @@
 #include "web_socket.h"
+#include "ws_frame.h"
 #include <mbedtls/sha1.h>
 #include <mbedtls/base64.h>
 
 
+#include <sys/param.h>
 #include "esp_log.h"
 #include "esp_err.h"
 
@@ -14,26 +16,93 @@
 #define TAG "WEBSOCKET_SERVER"
 
 #define MAX_CLIENTS 10
+
+// Per client limits, override from the build flags if needed
+#ifndef WS_RX_BUFFER_SIZE
+    #define WS_RX_BUFFER_SIZE       1024        // socket reads, data frames larger than this are streamed into msg_buff
+#endif
+#ifndef WS_MAX_MESSAGE_SIZE
+    #define WS_MAX_MESSAGE_SIZE     4096        // largest message, one frame or reassembled from fragments
+#endif
+_Static_assert(WS_RX_BUFFER_SIZE >= WS_MAX_HEADER_LEN + WS_MAX_CONTROL_PAYLOAD, "control frames are parsed in the rx buffer");
+
+// Broadcast frames are encoded once into this ring, every client drains it through its own cursor
+#ifndef WS_TX_RING_SIZE
+    #define WS_TX_RING_SIZE         (8 * 1024)
+#endif
+
+// Frames for one client only (handshake, replies, pong, close), allocated on first use
+#ifndef WS_CLIENT_TX_SIZE
+    #define WS_CLIENT_TX_SIZE       (WS_MAX_HEADER_LEN + WS_MAX_MESSAGE_SIZE)
+#endif
+
+// Default slow client policy, see web_socket_set_slow_policy
+#define WS_SLOW_MAX_LAG_BYTES       (WS_TX_RING_SIZE * 3 / 4)
+#define WS_SLOW_MAX_STALL_MS        3000
+
 typedef struct {
     int socket;
     int8_t handshaked;
+
+    // raw bytes from the socket, frames are parsed in place
+    uint8_t *rx_buff;
+    size_t rx_len;
+
+    // fragmented message being reassembled, msg_opcode is 0 when idle
+    uint8_t *msg_buff;
+    size_t msg_len;
+    uint8_t msg_opcode;
+
+    // data frame whose payload is still arriving, unmasked straight into msg_buff
+    uint32_t frame_left;                    // payload bytes to come, 0 between frames
+    uint32_t frame_pos;                     // payload bytes received so far, the mask phase
+    uint8_t frame_mask[4];
+    bool frame_fin;
+
+    // absolute position in the tx ring, pending bytes = ring_head - tx_cursor
+    uint32_t tx_cursor;
+    uint32_t ring_frame_left;               // bytes left of the broadcast frame in flight, 0 at a frame boundary
+    uint64_t last_tx_progress;
+
+    // unicast frames, sent between broadcast frames so the two never interleave
+    uint8_t *tx_buff;
+    size_t tx_len;
+    bool closing;                           // close frame queued, dropped once tx_buff is out
 } socket_client_info_t;
 
-static socket_client_info_t client_infos[MAX_CLIENTS] = {0};
-static struct pollfd poll_arr[MAX_CLIENTS + 1];            // +1 for the server socket
+static socket_client_info_t client_infos[MAX_CLIENTS];
+static struct pollfd poll_arr[MAX_CLIENTS + 1];            // +1 for the server socket, poll_arr[i+1] is client_infos[i]
 
-static int fds_count;
 static int server_sock = -1;
-static uint64_t last_log_time;
+static int cur_client_sock = -1;
+static web_socket_message_cb message_cb;
+
+static uint8_t tx_ring[WS_TX_RING_SIZE];
+static uint32_t ring_head;                  // total bytes ever written, wraps with uint32
+static uint32_t slow_max_lag = WS_SLOW_MAX_LAG_BYTES;
+static uint32_t slow_max_stall_us = WS_SLOW_MAX_STALL_MS * 1000;
+static uint64_t last_poll_time;
 
 void web_socket_server_cleanup(void) {
-    memset(client_infos, 0, sizeof(client_infos));
-    memset(poll_arr, 0, sizeof(poll_arr));
-    fds_count = 1;                      // Start with only the server socket
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_infos[i].socket > 0) close(client_infos[i].socket);
+        free(client_infos[i].rx_buff);
+        free(client_infos[i].msg_buff);
+        free(client_infos[i].tx_buff);
+        client_infos[i] = (socket_client_info_t){ .socket = -1 };
+        poll_arr[i + 1].fd = -1;
+        poll_arr[i + 1].events = POLLIN;
+    }
+    cur_client_sock = -1;
 
     if (server_sock < 0) return;
     close(server_sock);
     server_sock = -1; // Reset to invalid descriptor
+    poll_arr[0].fd = -1;
+}
+
+void web_socket_on_message(web_socket_message_cb callback) {
+    message_cb = callback;
 }
 
 void web_socket_setup(void) {
@@ -51,6 +120,10 @@ void web_socket_setup(void) {
     poll_arr[0].fd = server_sock;
     poll_arr[0].events = POLLIN;        // Monitor for incoming connections
 
+    // allow rebinding right after the server was restarted
+    int opt = 1;
+    setsockopt(server_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
     struct sockaddr_in server_addr;
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(PORT);
@@ -76,42 +149,232 @@ void web_socket_setup(void) {
     ESP_LOGI(TAG, "WebSocket server started on port %d", PORT);
 }
 
-static void remove_client_socket(int client_sock, int client_index) {
-    close(client_sock);
-    client_infos[client_index].socket = -1;
-    client_infos[client_index].handshaked = 0;
-    printf("Client removed %d\n", client_sock);
+static void remove_client_socket(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+    if (client->socket < 0) return;
+
+    ESP_LOGI(TAG, "Client removed %d", client->socket);
+    close(client->socket);
+    if (cur_client_sock == client->socket) cur_client_sock = -1;
+
+    free(client->rx_buff);
+    free(client->msg_buff);
+    free(client->tx_buff);
+    *client = (socket_client_info_t){ .socket = -1 };
+    poll_arr[client_index + 1].fd = -1;
 }
 
-static int handle_recv(int client_sock, int client_index, char *rx_buff, size_t buffer_len) {
-    int len = recv(client_sock, rx_buff, buffer_len, 0);
-    if (len == 0) {
-        // Client disconnected
-        ESP_LOGW(TAG, "Client disconnected: %d", client_sock);
-        remove_client_socket(client_sock, client_index);
-        return 0;
+//! BROADCAST RING
 
-    } else if (len < 0) {
-        ESP_LOGE(TAG, "Client recv failed: %d. err: %s", client_sock, strerror(errno));
-        remove_client_socket(client_sock, client_index);
-        return 0;
+void web_socket_set_slow_policy(uint32_t max_lag_bytes, uint32_t max_stall_ms) {
+    slow_max_lag = MIN(max_lag_bytes, WS_TX_RING_SIZE);
+    slow_max_stall_us = max_stall_ms * 1000;
+}
+
+static int find_client(int client_sock) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_infos[i].socket == client_sock) return i;
     }
+    return -1;
+}
 
-    ESP_LOGI(TAG, "Received from client: %d. msg: %s", client_sock, rx_buff);
-    rx_buff[len] = '\0'; // Null-terminate the received data
-    return len;
+static void ring_write(const void *data, size_t len) {
+    const uint8_t *ptr = data;
+    while (len > 0) {
+        size_t offset = ring_head % WS_TX_RING_SIZE;
+        size_t n = MIN(len, WS_TX_RING_SIZE - offset);
+        memcpy(tx_ring + offset, ptr, n);
+        ring_head += n;
+        ptr += n;
+        len -= n;
+    }
 }
 
-static int handle_send(int client_sock, int client_index, char *tx_buffer, size_t buffer_len) {
-    int result = send(client_sock, tx_buffer, buffer_len, 0);
-    if (result < 0) {
-        ESP_LOGE(TAG, "Client failed: %d. err: %s\n", client_sock, strerror(errno));
-        remove_client_socket(client_sock, client_index);
-    } else if (result == 0) {
-        ESP_LOGI(TAG, "Client closed: %d", client_sock);
+// length of the broadcast frame starting at pos, frames always go into the ring whole
+static uint32_t ring_frame_len(uint32_t pos) {
+    uint8_t header[WS_MAX_HEADER_LEN];
+    size_t len = MIN(sizeof(header), ring_head - pos);
+    for (size_t i = 0; i < len; i++) header[i] = tx_ring[(pos + i) % WS_TX_RING_SIZE];
+
+    ws_frame_header_t parsed;
+    int header_len = ws_frame_parse_header(header, len, &parsed);
+    return header_len > 0 ? header_len + parsed.payload_len : ring_head - pos;
+}
+
+static bool client_tx_pending(const socket_client_info_t *client) {
+    if (client->tx_len > 0 || client->ring_frame_left > 0) return true;
+    return client->handshaked && !client->closing && client->tx_cursor != ring_head;
+}
+
+// send whatever the socket takes right now, returns false when the client has to be dropped
+static bool flush_client(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+
+    while (1) {
+        const uint8_t *data;
+        size_t n;
+        bool from_ring = client->ring_frame_left > 0 || client->tx_len == 0;
+
+        if (!from_ring) {
+            //! between broadcast frames the client's own frames go first
+            data = client->tx_buff;
+            n = client->tx_len;
+        } else {
+            if (client->ring_frame_left == 0) {
+                if (!client->handshaked || client->closing || client->tx_cursor == ring_head) break;
+                client->ring_frame_left = ring_frame_len(client->tx_cursor);
+            }
+            size_t offset = client->tx_cursor % WS_TX_RING_SIZE;
+            data = tx_ring + offset;
+            n = MIN(client->ring_frame_left, WS_TX_RING_SIZE - offset);
+        }
+
+        int result = send(client->socket, data, n, MSG_DONTWAIT);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            ESP_LOGE(TAG, "Client send failed: %d. err: %s", client->socket, strerror(errno));
+            return false;
+        }
+
+        if (from_ring) {
+            client->tx_cursor += result;
+            client->ring_frame_left -= result;
+        } else {
+            client->tx_len -= result;
+            memmove(client->tx_buff, client->tx_buff + result, client->tx_len);
+        }
+        client->last_tx_progress = last_poll_time;
     }
 
-    return result;
+    bool pending = client_tx_pending(client);
+    if (client->closing && !pending) return false;      // close frame is out
+
+    // wait for POLLOUT only while something is pending, a closing client reads nothing more
+    poll_arr[client_index + 1].events = (client->closing ? 0 : POLLIN) | (pending ? POLLOUT : 0);
+    return true;
+}
+
+// append to the client's unicast frames, all or nothing, returns -1 when they don't fit
+static int queue_client_tx(int client_index, const void *head, size_t head_len, const void *data, size_t len) {
+    socket_client_info_t *client = &client_infos[client_index];
+
+    if (client->tx_buff == NULL) {
+        client->tx_buff = malloc(WS_CLIENT_TX_SIZE);
+        if (client->tx_buff == NULL) return -1;
+    }
+    if (client->tx_len + head_len + len > WS_CLIENT_TX_SIZE) {
+        ESP_LOGW(TAG, "Client tx full: %d", client->socket);
+        return -1;
+    }
+
+    if (!client_tx_pending(client)) client->last_tx_progress = last_poll_time;     // idle until now, start the stall clock
+    memcpy(client->tx_buff + client->tx_len, head, head_len);
+    if (len > 0) memcpy(client->tx_buff + client->tx_len + head_len, data, len);
+    client->tx_len += head_len + len;
+    return 0;
+}
+
+int web_socket_broadcast_parts(uint8_t opcode, const web_socket_part_t *parts, size_t count) {
+    size_t payload_len = 0;
+    for (size_t i = 0; i < count; i++) payload_len += parts[i].len;
+
+    uint8_t header[WS_MAX_HEADER_LEN];
+    size_t header_len = ws_frame_build_header(header, opcode, true, payload_len);
+    size_t frame_len = header_len + payload_len;
+    if (frame_len > slow_max_lag) return -1;
+
+    //! clients that would be overrun by this frame are too slow
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        socket_client_info_t *client = &client_infos[i];
+        if (client->socket < 0 || !client->handshaked) continue;
+
+        if (ring_head - client->tx_cursor + frame_len > slow_max_lag) {
+            ESP_LOGW(TAG, "Slow client dropped: %d", client->socket);
+            remove_client_socket(i);
+        } else if (client->tx_cursor == ring_head) {
+            client->last_tx_progress = last_poll_time;      // idle until now, start the stall clock
+        }
+    }
+
+    ring_write(header, header_len);
+    for (size_t i = 0; i < count; i++) ring_write(parts[i].data, parts[i].len);
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (client_infos[i].socket < 0 || !client_infos[i].handshaked) continue;
+        if (!flush_client(i)) remove_client_socket(i);
+    }
+    return 0;
+}
+
+int web_socket_broadcast(uint8_t opcode, const void *data, size_t len) {
+    web_socket_part_t part = { .data = data, .len = len };
+    return web_socket_broadcast_parts(opcode, &part, 1);
+}
+
+// never blocks, the frame is queued and leaves with POLLOUT whatever the socket doesn't take now
+int web_socket_send_frame(int client_sock, uint8_t opcode, bool fin, const void *data, size_t len) {
+    int client_index = find_client(client_sock);
+    if (client_index < 0 || client_infos[client_index].closing) return -1;
+
+    uint8_t header[WS_MAX_HEADER_LEN];
+    size_t header_len = ws_frame_build_header(header, opcode, fin, len);
+    if (queue_client_tx(client_index, header, header_len, data, len) < 0) return -1;
+
+    if (!flush_client(client_index)) {
+        remove_client_socket(client_index);
+        return -1;
+    }
+    return 0;
+}
+
+// queue a close frame and stop reading, the client is dropped once it is sent or stalls
+static void close_client(int client_index, const uint8_t *payload, size_t len) {
+    socket_client_info_t *client = &client_infos[client_index];
+    if (client->closing) return;
+
+    uint8_t header[WS_MAX_HEADER_LEN];
+    size_t header_len = ws_frame_build_header(header, WS_OPCODE_CLOSE, true, len);
+    queue_client_tx(client_index, header, header_len, payload, len);
+    client->closing = true;
+
+    if (!flush_client(client_index)) remove_client_socket(client_index);
+}
+
+static void send_close_frame(int client_index, uint16_t code) {
+    uint8_t payload[2] = { code >> 8, code & 0xFF };
+    close_client(client_index, payload, sizeof(payload));
+}
+
+// Send a WebSocket text frame to the client
+void send_websocket_message(int client_sock, const void *message, size_t len) {
+    web_socket_send_frame(client_sock, WS_OPCODE_TEXT, true, message, len);
+}
+
+void send_cur_websocket_message(const void *message, size_t len) {
+    if (cur_client_sock < 0) return;
+    send_websocket_message(cur_client_sock, message, len);
+}
+
+//! STREAMING
+// Every write goes out as its own frame, the message is closed by an empty FIN frame.
+
+void web_socket_stream_begin(web_socket_stream_t *stream, int client_sock, uint8_t opcode) {
+    stream->socket = client_sock;
+    stream->opcode = opcode;
+    stream->started = false;
+}
+
+int web_socket_stream_write(void *ctx, const char *data, size_t len) {
+    web_socket_stream_t *stream = ctx;
+    uint8_t opcode = stream->started ? WS_OPCODE_CONTINUATION : stream->opcode;
+    stream->started = true;
+    return web_socket_send_frame(stream->socket, opcode, false, data, len);
+}
+
+int web_socket_stream_end(web_socket_stream_t *stream) {
+    uint8_t opcode = stream->started ? WS_OPCODE_CONTINUATION : stream->opcode;
+    return web_socket_send_frame(stream->socket, opcode, true, NULL, 0);
 }
 
 static uint8_t make_handshake_packet(char *rx_buff, char *tx_buff, size_t tx_len) {
@@ -121,13 +384,10 @@ static uint8_t make_handshake_packet(char *rx_buff, char *tx_buff, size_t tx_len
     char *key_start = strstr(rx_buff, "Sec-WebSocket-Key: ");
     if (!key_start) return 0;
 
-    ESP_LOGI(TAG, "Found key_start");
     key_start += 19; // Move past "Sec-WebSocket-Key: "
 
     char *key_end = strstr(key_start, "\r\n");
     if (!key_end) return 0;
-    
-    ESP_LOGI(TAG, "Found key_end");
     *key_end = 0; // Null-terminate the key
 
     //! Concatenate client key with WebSocket GUID
@@ -160,159 +420,302 @@ static uint8_t make_handshake_packet(char *rx_buff, char *tx_buff, size_t tx_len
     return 1;
 }
 
-static void web_socket_server_poll(int client_sock) {
-    //! Add the new client socket to the pollfd array
-    for (int i = 0; i < MAX_CLIENTS; i++) {
-        if (client_infos[i].socket > 0) continue;
-        client_infos[i].socket = client_sock;
-        
-        //! recv: Receive data from the client. Make sure the buffer is big enough
-        char rx_buff[500];
-        int len = handle_recv(client_sock, i, rx_buff, sizeof(rx_buff) - 1);
-        if (len < 1) continue;
-
-        // Echo the data back to the client if already handshaked
-        if (client_infos[i].handshaked) {
-            handle_send(client_sock, i, rx_buff, len);
-            break;
-        }
+// returns false when the client has to be dropped
+static bool handle_handshake(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+    client->rx_buff[client->rx_len] = '\0';
 
-        //! Perform handshake
-        printf("Start Handshake: %d\n", client_sock);
-        char tx_buff[256]; // Ensure buffer is large enough
-        uint8_t check = make_handshake_packet(rx_buff, tx_buff, sizeof(tx_buff));
-        
-        if (check) {
-            ESP_LOGI(TAG, "Handshake to client: %d. tx_buff:\n%s", client_sock, tx_buff);
-
-            //! send: handshake response
-            int result = handle_send(client_sock, i, tx_buff, strlen(tx_buff));
-            if (result > 0) {
-                ESP_LOGI(TAG, "Handshake sent successfully");
-                client_infos[i].handshaked = 1;
-            }
-        } else {
-            remove_client_socket(client_sock, i);
-        }
-        break;      //! REQUIRED: stop the loop
+    // wait for the complete HTTP upgrade request
+    if (strstr((char *)client->rx_buff, "\r\n\r\n") == NULL) {
+        return client->rx_len < WS_RX_BUFFER_SIZE;
     }
-}
 
-static int cur_client_sock = -1;
+    char tx_buff[256];
+    if (!make_handshake_packet((char *)client->rx_buff, tx_buff, sizeof(tx_buff))) return false;
+    if (queue_client_tx(client_index, tx_buff, strlen(tx_buff), NULL, 0) < 0) return false;
 
-// Send a WebSocket text frame to the client
-void send_websocket_message(int client_sock, const void *message, size_t len) {
-    uint8_t frame[len + 2]; // Frame buffer (header + payload)
+    client->handshaked = 1;
+    client->rx_len = 0;
+    client->tx_cursor = ring_head;          // only frames broadcast from now on
+    cur_client_sock = client->socket;
+    if (!flush_client(client_index)) return false;
+
+    ESP_LOGI(TAG, "Handshake sent to client: %d", client->socket);
+    return true;
+}
+
+static void dispatch_message(int client_index, uint8_t opcode, uint8_t *payload, size_t len) {
+    int client_sock = client_infos[client_index].socket;
     cur_client_sock = client_sock;
 
-    // Construct the frame
-    frame[0] = 0x81;                        // FIN bit set, opcode for text frame
-    frame[1] = len;                         // Payload length
-    memcpy(frame + 2, message, len);        // Copy the payload
+    if (message_cb) {
+        message_cb(client_sock, opcode, payload, len);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Received: %.*s", (int)len, payload);
 
-    // Send the frame
-    send(client_sock, frame, len + 2, 0);
+    // Send a response to the client
+    const char *message = "Hello from ESP32!";
+    send_websocket_message(client_sock, message, strlen(message));
 }
 
-void send_cur_websocket_message(const void *message, size_t len) {
-    if (cur_client_sock < 0) return;
-    send_websocket_message(cur_client_sock, message, len);
+// ping, pong and close, returns false when the client has to be dropped
+static bool handle_control_frame(int client_index, ws_frame_header_t *header, uint8_t *payload) {
+    socket_client_info_t *client = &client_infos[client_index];
+    size_t len = header->payload_len;
+
+    switch (header->opcode) {
+        case WS_OPCODE_PING:
+            web_socket_send_frame(client->socket, WS_OPCODE_PONG, true, payload, len);
+            return true;
+
+        case WS_OPCODE_CLOSE:
+            // echo the status code back and drop the connection
+            close_client(client_index, payload, len >= 2 ? 2 : 0);
+            return false;
+
+        default:
+            return true;
+    }
 }
 
-void web_socket_poll(uint64_t current_time) {
-    //! Wait for activity on any socket
-    int activity = poll(poll_arr, fds_count, 0); // -1 means no timeout
-    if (activity < 0) return;
+// checks a data frame against the message being reassembled, returns false when the client has to be dropped
+static bool begin_data_frame(int client_index, ws_frame_header_t *header) {
+    socket_client_info_t *client = &client_infos[client_index];
+    bool continuation = header->opcode == WS_OPCODE_CONTINUATION;
 
-    if (poll_arr[0].revents & POLLIN) {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_sock = accept(poll_arr[0].fd, (struct sockaddr *)&client_addr, &client_len);
+    // a new message can't start before the fragmented one is finished, a continuation needs one
+    if (continuation != (client->msg_opcode != 0)) {
+        send_close_frame(client_index, WS_CLOSE_PROTOCOL_ERROR);
+        return false;
+    }
 
-        if (client_sock < 0) {
-            ESP_LOGE(TAG, "Failed connection: %s\n", strerror(errno));
-            return;
+    if (client->msg_len + header->payload_len > WS_MAX_MESSAGE_SIZE) {
+        send_close_frame(client_index, WS_CLOSE_TOO_BIG);
+        return false;
+    }
 
-        } else {
-            if (fds_count >= MAX_CLIENTS + 1) {
-                printf("Max clients reached, closing connection\n");
-                close(client_sock);
-                return;
-            }
+    if (!continuation) {
+        client->msg_opcode = header->opcode;
+        client->msg_len = 0;
+    }
+    return true;
+}
 
-            bool found_match = false;
-            for (int i = 1; i <= fds_count; i++) {
-                ESP_LOGW(TAG, "compare fd: %d, client: %d, index: %d", poll_arr[i].fd, client_sock, i);
-                if (poll_arr[i].fd != client_sock) continue;
-                ESP_LOGW(TAG, "found match");
-                found_match = true;
-                break;
-            }
-        
-            if (!found_match) {
-                struct pollfd *poll_ref = &poll_arr[fds_count];
-                poll_arr[fds_count].fd = client_sock;
-                poll_arr[fds_count].events = POLLIN; // Monitor for incoming data
-                ESP_LOGW(TAG, "newly added: %d. at: %d", poll_arr[fds_count].fd, fds_count);
-                fds_count++;
-            }
+static void end_data_frame(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+    if (!client->frame_fin) return;
+
+    uint8_t opcode = client->msg_opcode;
+    size_t len = client->msg_len;
+    client->msg_opcode = 0;
+    client->msg_len = 0;
+    dispatch_message(client_index, opcode, client->msg_buff, len);
+}
+
+// parse every frame in the rx buffer, returns false when the client has to be dropped
+static bool handle_frames(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+    size_t pos = 0;
+
+    while (pos < client->rx_len) {
+        uint8_t *frame = client->rx_buff + pos;
+        size_t available = client->rx_len - pos;
+
+        //! payload of a data frame in progress
+        if (client->frame_left > 0) {
+            uint32_t n = MIN(available, client->frame_left);
+            uint8_t *dest = client->msg_buff + client->msg_len;
+            memcpy(dest, frame, n);
+            ws_frame_unmask(dest, n, client->frame_mask, client->frame_pos);
+
+            client->msg_len += n;
+            client->frame_pos += n;
+            client->frame_left -= n;
+            pos += n;
+
+            if (client->frame_left == 0) end_data_frame(client_index);
+            if (client->socket < 0) return true;        // the handler may have dropped the client
+            continue;
+        }
 
-            ESP_LOGW(TAG, "fds_counts: %d", fds_count);
-            web_socket_server_poll(client_sock);
+        ws_frame_header_t header;
+        int header_len = ws_frame_parse_header(frame, available, &header);
+        if (header_len == 0) break;
+        if (header_len < 0 || !header.masked) {
+            // clients must mask every frame
+            send_close_frame(client_index, WS_CLOSE_PROTOCOL_ERROR);
+            return false;
         }
+
+        uint8_t *payload = frame + header_len;
+        size_t frame_len = header_len + header.payload_len;
+
+        //! control frames carry at most 125 bytes and always fit the rx buffer
+        if (ws_opcode_is_control(header.opcode)) {
+            if (available < frame_len) break;
+            ws_frame_unmask(payload, header.payload_len, header.mask, 0);
+            if (!handle_control_frame(client_index, &header, payload)) return false;
+            if (client->socket < 0) return true;
+            pos += frame_len;
+            continue;
+        }
+
+        if (!begin_data_frame(client_index, &header)) return false;
+
+        //! a whole unfragmented message already in the rx buffer is handed over in place
+        if (header.fin && header.opcode != WS_OPCODE_CONTINUATION && available >= frame_len) {
+            ws_frame_unmask(payload, header.payload_len, header.mask, 0);
+            client->msg_opcode = 0;
+            dispatch_message(client_index, header.opcode, payload, header.payload_len);
+            if (client->socket < 0) return true;
+            pos += frame_len;
+            continue;
+        }
+
+        //! anything else streams into msg_buff as it arrives
+        if (client->msg_buff == NULL) {
+            client->msg_buff = malloc(WS_MAX_MESSAGE_SIZE);
+            if (client->msg_buff == NULL) return false;
+        }
+
+        client->frame_left = header.payload_len;
+        client->frame_pos = 0;
+        client->frame_fin = header.fin;
+        memcpy(client->frame_mask, header.mask, sizeof(client->frame_mask));
+        pos += header_len;
+
+        if (client->frame_left == 0) {
+            end_data_frame(client_index);
+            if (client->socket < 0) return true;
+        }
+    }
+
+    //! keep the partial header or control frame for the next recv
+    client->rx_len -= pos;
+    if (client->rx_len > 0 && pos > 0) memmove(client->rx_buff, client->rx_buff + pos, client->rx_len);
+    return true;
+}
+
+static void handle_client_read(int client_index) {
+    socket_client_info_t *client = &client_infos[client_index];
+    size_t space = WS_RX_BUFFER_SIZE - client->rx_len;
+
+    int len = recv(client->socket, client->rx_buff + client->rx_len, space, 0);
+    if (len == 0) {
+        ESP_LOGW(TAG, "Client disconnected: %d", client->socket);
+        remove_client_socket(client_index);
+        return;
+    } else if (len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return;
+        ESP_LOGE(TAG, "Client recv failed: %d. err: %s", client->socket, strerror(errno));
+        remove_client_socket(client_index);
+        return;
+    }
+
+    client->rx_len += len;
+    bool keep = client->handshaked ? handle_frames(client_index) : handle_handshake(client_index);
+    if (!keep && !client->closing) remove_client_socket(client_index);
+}
+
+static void handle_accept(void) {
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    int client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
+
+    if (client_sock < 0) {
+        ESP_LOGE(TAG, "Failed connection: %s", strerror(errno));
+        return;
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        socket_client_info_t *client = &client_infos[i];
+        if (client->socket >= 0) continue;
+
+        // +1 keeps room for the terminator used while parsing the handshake
+        client->rx_buff = malloc(WS_RX_BUFFER_SIZE + 1);
+        if (client->rx_buff == NULL) break;
+
+        client->socket = client_sock;
+        client->tx_cursor = ring_head;          // nothing pending until the handshake
+        client->last_tx_progress = last_poll_time;
+        poll_arr[i + 1].fd = client_sock;
+        poll_arr[i + 1].events = POLLIN;
+        ESP_LOGI(TAG, "Client added: %d. at: %d", client_sock, i);
+        return;
+    }
+
+    ESP_LOGW(TAG, "Max clients reached, closing connection");
+    close(client_sock);
+}
+
+// handles the revents left in poll_arr by poll() or copied in by web_socket_dispatch
+static void handle_events(uint64_t current_time) {
+    last_poll_time = current_time;
+
+    if (poll_arr[0].revents & POLLIN) {
+        handle_accept();
     }
 
     //! Check for activity on client sockets
-    for (int i = 1; i < fds_count; i++) {
-        struct pollfd target = poll_arr[i];
-        int target_client = target.fd;
-
-        if (target.revents & POLLERR) {
-            //! Remove the client socket with an error
-            printf("Client err: %d\n", target_client);
-            remove_client_socket(target_client, i-1);
-            poll_arr[i].fd = -1; // Mark as invalid in the pollfd array
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        short revents = poll_arr[i + 1].revents;
+        if (client_infos[i].socket < 0 || revents == 0) continue;
+
+        if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            ESP_LOGW(TAG, "Client err: %d", client_infos[i].socket);
+            remove_client_socket(i);
+            continue;
         }
 
-        if (target.revents & POLLIN) {
-            //! Handle client data
-            uint8_t frame[128];
-            // uint8_t check 
-            int len = recv(target_client, frame, sizeof(frame), 0);
-
-            if (len > 0) {
-                // Extract the payload length
-                uint8_t payload_len = frame[1] & 0x7F; // Mask out the MASK bit
-                uint8_t mask_offset = 2; // Start of masking key (if present)
-        
-                // Check if the payload is masked
-                if (frame[1] & 0x80) { // MASK bit is set
-                    // Extract the masking key
-                    uint8_t masking_key[4];
-                    memcpy(masking_key, frame + 2, 4);
-                    mask_offset += 4; // Move past the masking key
-        
-                    // Unmask the payload
-                    uint8_t payload[payload_len];
-                    for (size_t i = 0; i < payload_len; i++) {
-                        payload[i] = frame[mask_offset + i] ^ masking_key[i % 4];
-                    }
-        
-                    // Log the unmasked payload
-                    ESP_LOGI(TAG, "Received: %.*s", payload_len, payload);
-                } else {
-                    // Payload is not masked
-                    ESP_LOGI(TAG, "Received: %.*s", payload_len, frame + mask_offset);
-                }
-        
-                // Send a response to the client
-                const char *message = "Hello from ESP32!";
-                size_t len = strlen(message);
-                send_websocket_message(target_client, message, len);
-                
-            } else if (len == 0) {
-                ESP_LOGI(TAG, "Client disconnected");
-            }
+        if ((revents & POLLOUT) && !flush_client(i)) {
+            remove_client_socket(i);
+            continue;
+        }
+
+        if ((revents & POLLIN) && !client_infos[i].closing) {
+            handle_client_read(i);
+        }
+    }
+
+    //! drop clients that stopped draining their frames
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        socket_client_info_t *client = &client_infos[i];
+        if (client->socket < 0 || !client_tx_pending(client)) continue;
+
+        if (current_time - client->last_tx_progress > slow_max_stall_us) {
+            ESP_LOGW(TAG, "Stalled client dropped: %d", client->socket);
+            remove_client_socket(i);
         }
     }
 }
+
+void web_socket_poll(uint64_t current_time) {
+    if (server_sock < 0) return;
+
+    //! Wait for activity on any socket
+    int activity = poll(poll_arr, MAX_CLIENTS + 1, 0);
+    if (activity < 0) return;
+
+    handle_events(current_time);
+}
+
+int web_socket_fill_pollfds(void *ctx, struct pollfd *fds, int max) {
+    if (server_sock < 0) return 0;
+
+    //! free slots keep fd -1, which poll() ignores, so the layout matches poll_arr
+    int count = MIN(max, MAX_CLIENTS + 1);
+    memcpy(fds, poll_arr, count * sizeof(struct pollfd));
+    return count;
+}
+
+void web_socket_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time) {
+    if (server_sock < 0) return;
+
+    for (int i = 0; i < MAX_CLIENTS + 1; i++) {
+        poll_arr[i].revents = i < count && fds[i].fd == poll_arr[i].fd ? fds[i].revents : 0;
+    }
+
+    handle_events(current_time);
+}
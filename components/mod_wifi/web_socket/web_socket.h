@@ -4,6 +4,10 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "lwip/sockets.h"
+#include "ws_frame.h"
 
 
 typedef enum __attribute__((packed)) {
@@ -13,6 +17,41 @@ typedef enum __attribute__((packed)) {
     WEBSOCKET_HANDSHAKED = 0x03,
 } web_socket_status_t;
 
+// opcode is WS_OPCODE_TEXT or WS_OPCODE_BINARY, fragmented messages arrive reassembled
+typedef void (*web_socket_message_cb)(int client_sock, uint8_t opcode, uint8_t *data, size_t len);
+
+// a message sent as a sequence of frames, web_socket_stream_write matches json_flush_cb
+typedef struct {
+    int socket;
+    uint8_t opcode;
+    bool started;
+} web_socket_stream_t;
+
+typedef struct {
+    const void *data;
+    size_t len;
+} web_socket_part_t;
+
 void web_socket_setup(void);
 void web_socket_poll(uint64_t current_time);
-void send_cur_websocket_message(const void *message, size_t len);
\ No newline at end of file
+
+// net_reactor source, replaces web_socket_poll when the reactor task owns the sockets
+int web_socket_fill_pollfds(void *ctx, struct pollfd *fds, int max);
+void web_socket_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time);
+void web_socket_on_message(web_socket_message_cb callback);
+
+// queued behind the broadcast frame in flight and sent without blocking, -1 when the client queue is full
+int web_socket_send_frame(int client_sock, uint8_t opcode, bool fin, const void *data, size_t len);
+void send_websocket_message(int client_sock, const void *message, size_t len);
+void send_cur_websocket_message(const void *message, size_t len);
+
+// encode once, queue for every handshaked client, sent without blocking
+int web_socket_broadcast(uint8_t opcode, const void *data, size_t len);
+int web_socket_broadcast_parts(uint8_t opcode, const web_socket_part_t *parts, size_t count);
+
+// drop clients lagging more than max_lag_bytes or making no progress for max_stall_ms
+void web_socket_set_slow_policy(uint32_t max_lag_bytes, uint32_t max_stall_ms);
+
+void web_socket_stream_begin(web_socket_stream_t *stream, int client_sock, uint8_t opcode);
+int web_socket_stream_write(void *ctx, const char *data, size_t len);
+int web_socket_stream_end(web_socket_stream_t *stream);
\ No newline at end of file
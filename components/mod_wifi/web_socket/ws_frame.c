@@ -0,0 +1,103 @@
+#include "ws_frame.h"
+
+#include <string.h>
+
+int ws_frame_parse_header(const uint8_t* data, size_t len, ws_frame_header_t* header) {
+    if (len < 2) return 0;
+
+    header->fin = data[0] & 0x80;
+    header->opcode = data[0] & 0x0F;
+    header->masked = data[1] & 0x80;
+
+    // RSV bits are not negotiated
+    if (data[0] & 0x70) return -1;
+
+    uint8_t opcode = header->opcode;
+    if (opcode > WS_OPCODE_BINARY && !ws_opcode_is_control(opcode)) return -1;
+    if (opcode > WS_OPCODE_PONG) return -1;
+
+    uint8_t len7 = data[1] & 0x7F;
+    size_t pos = 2;
+
+    if (len7 == 126) {
+        if (len < pos + 2) return 0;
+        header->payload_len = ((uint16_t)data[2] << 8) | data[3];
+        pos += 2;
+    } else if (len7 == 127) {
+        if (len < pos + 8) return 0;
+        uint64_t value = 0;
+        for (int i = 0; i < 8; i++) value = (value << 8) | data[pos + i];
+        if (value >> 63) return -1;         // most significant bit must be 0
+        header->payload_len = value;
+        pos += 8;
+    } else {
+        header->payload_len = len7;
+    }
+
+    // control frames can't be fragmented and carry at most 125 bytes
+    if (ws_opcode_is_control(opcode) && (!header->fin || header->payload_len > WS_MAX_CONTROL_PAYLOAD)) {
+        return -1;
+    }
+
+    if (header->masked) {
+        if (len < pos + 4) return 0;
+        for (int i = 0; i < 4; i++) header->mask[i] = data[pos + i];
+        pos += 4;
+    }
+
+    header->header_len = pos;
+    return pos;
+}
+
+size_t ws_frame_build_header(uint8_t* out, uint8_t opcode, bool fin, uint64_t payload_len) {
+    out[0] = (fin ? 0x80 : 0x00) | (opcode & 0x0F);
+
+    if (payload_len < 126) {
+        out[1] = payload_len;
+        return 2;
+    }
+
+    if (payload_len <= 0xFFFF) {
+        out[1] = 126;
+        out[2] = payload_len >> 8;
+        out[3] = payload_len & 0xFF;
+        return 4;
+    }
+
+    out[1] = 127;
+    for (int i = 0; i < 8; i++) {
+        out[2 + i] = (payload_len >> (56 - 8*i)) & 0xFF;
+    }
+    return 10;
+}
+
+// the payload buffer is accessed as words, tell the compiler it aliases the bytes
+typedef uint32_t __attribute__((may_alias)) ws_word_t;
+
+void ws_frame_unmask(uint8_t* data, size_t len, const uint8_t mask[4], size_t offset) {
+    // unaligned head, byte by byte
+    size_t i = 0;
+    while (i < len && ((uintptr_t)(data + i) & 3)) {
+        data[i] ^= mask[(offset + i) & 3];
+        i++;
+    }
+
+    // aligned body, one word at a time with the mask rotated to the current position
+    uint8_t rotated[4];
+    for (int k = 0; k < 4; k++) rotated[k] = mask[(offset + i + k) & 3];
+
+    uint32_t mask_word;
+    memcpy(&mask_word, rotated, sizeof(mask_word));
+
+    ws_word_t* words = (ws_word_t*)(data + i);
+    size_t word_count = (len - i) / 4;
+    for (size_t w = 0; w < word_count; w++) {
+        words[w] ^= mask_word;
+    }
+    i += word_count * 4;
+
+    // tail
+    for (; i < len; i++) {
+        data[i] ^= mask[(offset + i) & 3];
+    }
+}
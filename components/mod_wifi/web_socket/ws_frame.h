@@ -0,0 +1,46 @@
+#ifndef WS_FRAME_H
+#define WS_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// RFC 6455 frame codec, no socket I/O in here
+
+#define WS_OPCODE_CONTINUATION  0x00
+#define WS_OPCODE_TEXT          0x01
+#define WS_OPCODE_BINARY        0x02
+#define WS_OPCODE_CLOSE         0x08
+#define WS_OPCODE_PING          0x09
+#define WS_OPCODE_PONG          0x0A
+
+#define WS_CLOSE_NORMAL         1000
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_TOO_BIG        1009
+
+#define WS_MAX_HEADER_LEN       14          // 2 + 8 extended length + 4 mask
+#define WS_MAX_CONTROL_PAYLOAD  125
+
+typedef struct {
+    bool fin;
+    uint8_t opcode;
+    bool masked;
+    uint8_t mask[4];
+    uint8_t header_len;
+    uint64_t payload_len;
+} ws_frame_header_t;
+
+// returns header length, 0 when more bytes are needed, -1 on a protocol error
+int ws_frame_parse_header(const uint8_t* data, size_t len, ws_frame_header_t* header);
+
+// writes an unmasked server header into out (WS_MAX_HEADER_LEN bytes), returns its length
+size_t ws_frame_build_header(uint8_t* out, uint8_t opcode, bool fin, uint64_t payload_len);
+
+// XOR the payload with the mask in place, offset is the position of data inside the payload
+void ws_frame_unmask(uint8_t* data, size_t len, const uint8_t mask[4], size_t offset);
+
+static inline bool ws_opcode_is_control(uint8_t opcode) {
+    return opcode & 0x08;
+}
+
+#endif
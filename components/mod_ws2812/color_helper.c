@@ -58,3 +58,29 @@ void hsv_to_rgb_ints(uint8_t hue, uint8_t sat, uint8_t value, RGB_t* rgb) {
         default:    rgb->red = value;   rgb->green = p;         rgb->blue = q;      break;
     }
 }
+
+
+// round(32767 * sin(i * pi / 128)), the extra entry saves a bounds check at 90 degrees
+static const int16_t sin_quarter[66] = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767, 32767,
+};
+
+int16_t sin_q15(uint16_t angle) {
+    uint16_t quadrant = angle >> 14;
+    uint16_t pos = angle & 0x3FFF;
+    if (quadrant & 1) pos = 0x4000 - pos;       // falling quarters mirror the rising ones
+
+    uint8_t index = pos >> 8, frac = pos & 0xFF;
+    int32_t a = sin_quarter[index], b = sin_quarter[index + 1];
+    int16_t value = a + (((b - a) * frac) >> 8);
+
+    return quadrant & 2 ? -value : value;
+}
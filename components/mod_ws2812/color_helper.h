@@ -22,4 +22,35 @@ RGB_t make_color_byChannels(int16_t value, RGB_t channels);
 void hsv_to_rgb(float h, float s, float v, RGB_t* rgb);
 void hsv_to_rgb_ints(uint8_t hue, uint8_t sat, uint8_t value, RGB_t* rgb);
 
+//# Integer kernels for the effects, the ESP32-C3 has no FPU.
+//# Angles are uint16_t, 65536 is a full turn, so phases wrap for free.
+
+#define ANGLE16_TURN 65536
+
+//! Q15 sine, quarter wave table with linear interpolation, within 4 LSB of sinf
+int16_t sin_q15(uint16_t angle);
+
+//! 0..255, the integer version of 127.5 * (1 + sinf(x)), off by at most 1
+static inline uint8_t sin_wave8(uint16_t angle) {
+    return (uint8_t)(((int32_t)sin_q15(angle) + 32768) >> 8);
+}
+
+//! value * scale / 255 with scale8(x, 255) == x
+static inline uint8_t scale8(uint8_t value, uint8_t scale) {
+    return ((uint16_t)value * (1 + scale)) >> 8;
+}
+
+//! from a towards b, amount 0 gives a, 255 gives b
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t amount) {
+    return b > a ? a + scale8(b - a, amount) : a - scale8(a - b, amount);
+}
+
+static inline RGB_t scale_rgb(RGB_t color, uint8_t scale) {
+    return (RGB_t){ scale8(color.red, scale), scale8(color.green, scale), scale8(color.blue, scale) };
+}
+
+static inline RGB_t lerp_rgb(RGB_t a, RGB_t b, uint8_t amount) {
+    return (RGB_t){ lerp8(a.red, b.red, amount), lerp8(a.green, b.green, amount), lerp8(a.blue, b.blue, amount) };
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "led_compositor.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include "esp_cpu.h"
+
+esp_err_t led_compositor_init(led_compositor_t *comp, uint16_t led_count, uint8_t layer_count) {
+    if (layer_count == 0 || layer_count > LED_COMPOSITOR_MAX_LAYERS || led_count == 0) return ESP_ERR_INVALID_ARG;
+
+    memset(comp, 0, sizeof(*comp));
+    comp->led_count = led_count;
+
+    for (int i = 0; i < layer_count; i++) {
+        uint8_t *pixels = calloc(led_count, 3);
+        if (pixels == NULL) return ESP_ERR_NO_MEM;
+
+        comp->layers[i] = (led_layer_t){
+            .pixels = pixels,
+            .led_count = led_count,
+            .opacity = 255,
+            .blend = LED_BLEND_ALPHA,
+            .start_index = 0,
+            .end_index = led_count - 1,
+            .dirty = true,
+        };
+        comp->layer_count++;
+    }
+    return ESP_OK;
+}
+
+void led_layer_set(led_layer_t *layer, uint16_t index, RGB_t rgb) {
+    if (index >= layer->led_count) return;
+
+    uint8_t *pixel = &layer->pixels[index * 3];
+    if (pixel[0] == rgb.green && pixel[1] == rgb.red && pixel[2] == rgb.blue) return;
+
+    pixel[0] = rgb.green;
+    pixel[1] = rgb.red;
+    pixel[2] = rgb.blue;
+    layer->dirty = true;
+}
+
+//! effects clear before every redraw, an already black layer stays clean
+void led_layer_clear(led_layer_t *layer) {
+    size_t len = layer->led_count * 3;
+    for (size_t i = 0; i < len; i++) {
+        if (layer->pixels[i] == 0) continue;
+
+        memset(layer->pixels + i, 0, len - i);
+        layer->dirty = true;
+        return;
+    }
+}
+
+void led_layer_config(led_layer_t *layer, uint8_t opacity, led_blend_t blend, uint16_t start_index, uint16_t end_index) {
+    layer->opacity = opacity;
+    layer->blend = blend;
+    layer->start_index = start_index;
+    layer->end_index = MIN(end_index, layer->led_count - 1);
+    layer->dirty = true;
+}
+
+static void blend_layer(const led_layer_t *layer, uint8_t *out) {
+    const uint8_t *src = layer->pixels + layer->start_index * 3;
+    uint8_t *dst = out + layer->start_index * 3;
+    size_t len = (layer->end_index - layer->start_index + 1) * 3;
+    uint8_t opacity = layer->opacity;
+
+    switch (layer->blend) {
+        case LED_BLEND_ADD:
+            for (size_t i = 0; i < len; i++) dst[i] = MIN(255, dst[i] + scale8(src[i], opacity));
+            break;
+
+        case LED_BLEND_MAX:
+            for (size_t i = 0; i < len; i++) dst[i] = MAX(dst[i], scale8(src[i], opacity));
+            break;
+
+        case LED_BLEND_MULTIPLY:
+            for (size_t i = 0; i < len; i++) dst[i] = lerp8(dst[i], scale8(dst[i], src[i]), opacity);
+            break;
+
+        default:
+            for (size_t i = 0; i < len; i += 3) {
+                if ((src[i] | src[i + 1] | src[i + 2]) == 0) continue;
+                dst[i] = lerp8(dst[i], src[i], opacity);
+                dst[i + 1] = lerp8(dst[i + 1], src[i + 1], opacity);
+                dst[i + 2] = lerp8(dst[i + 2], src[i + 2], opacity);
+            }
+            break;
+    }
+}
+
+bool led_compositor_flatten(led_compositor_t *comp, uint8_t *out) {
+    bool dirty = false;
+    for (int i = 0; i < comp->layer_count; i++) dirty |= comp->layers[i].dirty;
+    if (!dirty) return false;
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    memset(out, 0, comp->led_count * 3);
+
+    for (int i = 0; i < comp->layer_count; i++) {
+        led_layer_t *layer = &comp->layers[i];
+        layer->dirty = false;
+        if (layer->opacity == 0 || layer->start_index > layer->end_index) continue;
+        blend_layer(layer, out);
+    }
+
+    comp->flatten_cycles += esp_cpu_get_cycle_count() - start;
+    comp->flattens++;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef LED_COMPOSITOR_H
+#define LED_COMPOSITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "color_helper.h"
+
+//# Stacks effects instead of letting them overwrite each other. Every layer
+//# draws into its own buffer (GRB bytes, same order as the strip), then
+//# flatten blends the layers bottom to top into the output buffer. Only LEDs
+//# inside a layer's range are touched by it. Nothing is blended until a layer
+//# changed, so a static strip costs nothing per frame.
+
+#ifndef LED_COMPOSITOR_MAX_LAYERS
+#define LED_COMPOSITOR_MAX_LAYERS 4
+#endif
+
+typedef enum {
+    LED_BLEND_ALPHA,                // lerp towards the layer by opacity, black LEDs are transparent
+    LED_BLEND_ADD,                  // saturating add
+    LED_BLEND_MAX,                  // brightest channel wins
+    LED_BLEND_MULTIPLY,             // darkens what's below, 255 leaves it as is
+} led_blend_t;
+
+typedef struct {
+    uint8_t *pixels;                // led_count * 3, allocated once in init
+    uint16_t led_count;
+    uint8_t opacity;                // 0 hides the layer
+    led_blend_t blend;
+    uint16_t start_index;           // LED range the layer applies to, inclusive
+    uint16_t end_index;
+    bool dirty;
+} led_layer_t;
+
+typedef struct {
+    uint16_t led_count;
+    uint8_t layer_count;
+    led_layer_t layers[LED_COMPOSITOR_MAX_LAYERS];
+    uint32_t flattens;
+    uint64_t flatten_cycles;        // divide by flattens, and by layer_count for per layer
+} led_compositor_t;
+
+//! layers start transparent over the full range, opacity 255 with alpha blend
+esp_err_t led_compositor_init(led_compositor_t *comp, uint16_t led_count, uint8_t layer_count);
+
+void led_layer_set(led_layer_t *layer, uint16_t index, RGB_t rgb);
+void led_layer_clear(led_layer_t *layer);
+void led_layer_config(led_layer_t *layer, uint8_t opacity, led_blend_t blend, uint16_t start_index, uint16_t end_index);
+
+//! blends into out (led_count * 3) when a layer changed, returns false when out is still current
+bool led_compositor_flatten(led_compositor_t *comp, uint8_t *out);
+
+#endif
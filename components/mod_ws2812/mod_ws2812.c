@@ -1,64 +1,246 @@
 #include "mod_ws2812.h"
 #include <math.h>
 #include <string.h>
+#include <sys/param.h>
 
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_attr.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "soc/soc_caps.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 #include "esp_timer.h"
 
-#define LEDS_COUNT         9
-
 
 static const char *TAG = "MOD_WS2812";
-static uint8_t led_pixels[LEDS_COUNT * 3];
 
+//# One strip per RMT TX channel, sizes come from ws2812_setup_strips() and
+//# every buffer is allocated there once. Effects draw into the layers of the
+//# selected strip, each frame is flattened, gamma/dither corrected into one of
+//# two tx buffers and streamed by the encoder while the next one is prepared.
+//# With several strips an RMT sync manager starts all channels together, so
+//# they latch the same frame. Every strip runs its own effect state, sized
+//# to its length.
+
+#define SEQUENCE_LENGTH 5
+#define WAVE_PHASE_STEP 1043        // 0.1 rad in ANGLE16 units
+
+typedef struct {
+    uint16_t current_index;
+    RGB_t neigative_color;
+    int offset;
+    int total_period;
+    uint16_t frequency;             // angle step per position, ANGLE16_TURN is 2 PI
+    bool is_bounced;
+    int8_t direction;
+    uint8_t length;
+    uint8_t gap;
+    uint64_t refresh_time_uS;
+    uint64_t last_refresh_time;
+    uint16_t phase;                 // wraps at 2 PI by itself
+    int16_t expansion;              // moving_wave3
+} sequenced_wave_t;
+
+typedef struct {
+    rmt_channel_handle_t channel;
+    rmt_encoder_handle_t encoder;
+    uint16_t led_count;
+    led_compositor_t compositor;
+    uint8_t *pixels;                // flattened layers, led_count * 3
+    uint8_t *frames[2];             // corrected bytes, read by the encoder while on air
+    uint8_t *dither_error;          // fraction carried to the next frame
+    volatile bool frame_busy[2];
+    uint8_t frame_next;             // buffer the next frame is written into
+    uint8_t frame_done_next;        // transactions finish in order
+    hue_animation_t hue;
+    sequenced_wave_t wave;
+} ws2812_strip_t;
+
+static ws2812_strip_t strips[WS2812_MAX_STRIPS];
+static uint8_t strip_count;
+static rmt_sync_manager_handle_t sync_manager;
+
+//! effects draw into one layer of one strip
+static ws2812_strip_t *draw_strip;
+static led_layer_t *draw_layer;
+
+
+//! ENCODER
+//# Every byte maps to the same 8 symbols, so a 256-entry table turns encoding
+//# into one 32 byte copy per byte, as many bytes per callback as there is room.
+
+static rmt_symbol_word_t symbol_lut[256][8];
+static uint16_t gamma_lut[3][256];          // strip byte order G R B, 8.8 fixed point
+static bool gamma_enabled;                  // off keeps the plain copy
+static bool dither_enabled;
+static bool force_transmit;                 // correction changed, resend the unchanged frame
+static ws2812_stats_t ws2812_stats;
+
+static void build_symbol_lut(void) {
+    for (int value = 0; value < 256; value++) {
+        for (int bit = 0; bit < 8; bit++) {
+            symbol_lut[value][bit] = (value & (0x80 >> bit)) ? ws2812_one : ws2812_zero;
+        }
+    }
+}
+
+static void build_gamma_lut(uint8_t channel, float gamma) {
+    for (int value = 0; value < 256; value++) {
+        gamma_lut[channel][value] = (uint16_t)(powf(value / 255.0f, gamma) * (255 << 8) + 0.5f);
+    }
+}
 
-static size_t encoder_callback(const void *data, size_t data_size,
+// MSB first per byte, then the reset, same stream as the per-bit encoder
+static size_t IRAM_ATTR encoder_callback(const void *data, size_t data_size,
                             size_t symbols_written, size_t symbols_free,
                             rmt_symbol_word_t *symbols, bool *done, void *arg)
 {
-    // We need a minimum of 8 symbol spaces to encode a byte. We only
-    // need one to encode a reset
-    if (symbols_free < 8) {
-        return 0;
-    }
-
-    // We can calculate where in the data we are from the symbol pos.
     size_t data_pos = symbols_written / 8;
-    uint8_t *data_bytes = (uint8_t*)data;
+    const uint8_t *data_bytes = (const uint8_t*)data;
 
     if (data_pos < data_size) {
-        // Encode a byte
-        size_t symbol_pos = 0;
-        for (int bitmask = 0x80; bitmask != 0; bitmask >>= 1) {
-            uint8_t check = data_bytes[data_pos]&bitmask;
-            symbols[symbol_pos++] = check ? ws2812_one : ws2812_zero;
+        size_t count = MIN(symbols_free / 8, data_size - data_pos);
+        for (size_t i = 0; i < count; i++) {
+            memcpy(&symbols[i * 8], symbol_lut[data_bytes[data_pos + i]], sizeof(symbol_lut[0]));
         }
-        // We're done; we should have written 8 symbols.
-        return symbol_pos;
-    } else {
-        //All bytes already are encoded. Encode the reset, and we're done.
-        symbols[0] = ws2812_reset;
-        *done = 1; //Indicate end of the transaction.
-        return 1; //we only wrote one symbol
+        return count * 8;
     }
-}
 
-rmt_channel_handle_t led_chan = NULL;
-rmt_encoder_handle_t simple_encoder = NULL;
+    if (symbols_free < 1) return 0;
+    symbols[0] = ws2812_reset;
+    *done = 1;
+    return 1;
+}
 
 const rmt_simple_encoder_config_t simple_encoder_cfg = {
-    .callback = encoder_callback
-    //Note we don't set min_chunk_size here as the default of 64 is good enough.
+    .callback = encoder_callback,
+    .min_chunk_size = 64,
 };
 
 rmt_transmit_config_t tx_config = {
     .loop_count = 0, // no transfer loop
 };
 
+//# Gamma and dither are one pass over the flattened bytes into the tx buffer.
+//# Dithering keeps the 8 bits below the output per byte and adds them to the
+//# next frame, so a level between two steps averages out over a few frames.
+
+static void correct_frame(ws2812_strip_t *strip, uint8_t *out) {
+    const uint8_t *pixels = strip->pixels;
+    size_t len = strip->led_count * 3;
+
+    if (!gamma_enabled && !dither_enabled) {
+        memcpy(out, pixels, len);
+        return;
+    }
+
+    uint8_t channel = 0;
+    for (size_t i = 0; i < len; i++) {
+        //! max 255 << 8 + 255 still fits the 16 bits
+        uint16_t value = gamma_lut[channel][pixels[i]];
+        if (dither_enabled) {
+            value += strip->dither_error[i];
+            strip->dither_error[i] = value & 0xFF;
+        } else {
+            value += 0x80;
+        }
+
+        out[i] = value >> 8;
+        if (++channel == 3) channel = 0;
+    }
+}
+
+void ws2812_set_gamma(float red, float green, float blue) {
+    build_gamma_lut(0, green);
+    build_gamma_lut(1, red);
+    build_gamma_lut(2, blue);
+    gamma_enabled = red != 1.0f || green != 1.0f || blue != 1.0f;
+    force_transmit = true;
+}
+
+void ws2812_set_dither(bool enabled) {
+    dither_enabled = enabled;
+    for (int i = 0; i < strip_count; i++) {
+        memset(strips[i].dither_error, 0, strips[i].led_count * 3);
+    }
+    force_transmit = true;
+}
+
+static bool IRAM_ATTR on_trans_done(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *edata, void *ctx) {
+    ws2812_strip_t *strip = ctx;
+    strip->frame_busy[strip->frame_done_next] = false;
+    strip->frame_done_next ^= 1;
+    return false;
+}
+
+//! synced strips start together, so a round waits until every channel is idle
+static bool strips_ready(void) {
+    for (int i = 0; i < strip_count; i++) {
+        ws2812_strip_t *strip = &strips[i];
+        if (strip->frame_busy[strip->frame_next]) return false;
+        if (sync_manager && strip->frame_busy[strip->frame_next ^ 1]) return false;
+    }
+    return strip_count > 0;
+}
+
+static void ws2812_transmit(void) {
+    if (!strips_ready()) {
+        ws2812_stats.skipped++;
+        return;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (int i = 0; i < strip_count; i++) {
+        correct_frame(&strips[i], strips[i].frames[strips[i].frame_next]);
+    }
+    ws2812_stats.encode_cycles += esp_cpu_get_cycle_count() - start;
+
+    if (sync_manager) rmt_sync_reset(sync_manager);
+
+    //! frame_busy is set before the transaction can finish, the rest after all strips were handed over
+    bool sent[WS2812_MAX_STRIPS] = { 0 };
+    for (int i = 0; i < strip_count; i++) {
+        ws2812_strip_t *strip = &strips[i];
+        uint8_t next = strip->frame_next;
+
+        strip->frame_busy[next] = true;
+        sent[i] = rmt_transmit(strip->channel, strip->encoder, strip->frames[next], strip->led_count * 3, &tx_config) == ESP_OK;
+        if (sent[i]) continue;
+
+        strip->frame_busy[next] = false;
+        ws2812_stats.skipped++;
+        if (!sync_manager) continue;
+
+        //! the synced channels queued so far would wait for this one forever, drop the round;
+        //! disabling a channel flushes its queue without on_trans_done
+        rmt_sync_reset(sync_manager);
+        for (int j = 0; j < i; j++) {
+            rmt_disable(strips[j].channel);
+            rmt_enable(strips[j].channel);
+            strips[j].frame_busy[strips[j].frame_next] = false;
+        }
+        return;
+    }
+
+    for (int i = 0; i < strip_count; i++) {
+        if (sent[i]) strips[i].frame_next ^= 1;
+    }
+    ws2812_stats.frames++;
+}
+
+void ws2812_get_stats(ws2812_stats_t *stats) {
+    *stats = ws2812_stats;
+    stats->composites = 0;
+    stats->composite_cycles = 0;
+    for (int i = 0; i < strip_count; i++) {
+        stats->composites += strips[i].compositor.flattens;
+        stats->composite_cycles += strips[i].compositor.flatten_cycles;
+    }
+}
+
 
 #define WS2812_TRANSMIT_FREQUENCY 30000   // micro seconds
 
@@ -71,17 +253,110 @@ uint64_t last_transmit_time;
 static uint64_t last_moved_time;
 bool is_filling = false;
 
-void ws2812_setup(uint8_t gpio_pin) {
+
+//! SETUP
+
+static void effects_init(ws2812_strip_t *strip);
+
+static esp_err_t strip_alloc(ws2812_strip_t *strip, uint16_t led_count) {
+    size_t len = led_count * 3;
+    strip->led_count = led_count;
+
+    //! the encoder reads the tx buffers from the RMT interrupt, keep them internal
+    strip->pixels = heap_caps_calloc(len, 1, MALLOC_CAP_8BIT);
+    strip->frames[0] = heap_caps_calloc(len, 1, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    strip->frames[1] = heap_caps_calloc(len, 1, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    strip->dither_error = heap_caps_calloc(len, 1, MALLOC_CAP_8BIT);
+    if (!strip->pixels || !strip->frames[0] || !strip->frames[1] || !strip->dither_error) return ESP_ERR_NO_MEM;
+
+    effects_init(strip);
+    return led_compositor_init(&strip->compositor, led_count, WS2812_LAYER_COUNT);
+}
+
+static esp_err_t strip_channel(ws2812_strip_t *strip, uint8_t gpio_pin, uint8_t index, uint8_t count) {
     rmt_tx_channel_config_t tx_chan_config = {
         .clk_src = RMT_CLK_SRC_DEFAULT,
         .gpio_num = gpio_pin,
-        .mem_block_symbols = 64, // increase the block size can make the LED less flickering
+#if SOC_RMT_SUPPORT_DMA
+        //! DMA buffer, refilled without waking the CPU per block; only the first strip gets it
+        .mem_block_symbols = index == 0 ? 1024 : SOC_RMT_MEM_WORDS_PER_CHANNEL,
+        .flags.with_dma = index == 0,
+#else
+        //! a lone strip can take two blocks, shared strips one each
+        .mem_block_symbols = count == 1 ? 64 : SOC_RMT_MEM_WORDS_PER_CHANNEL,
+#endif
         .resolution_hz = RMT_LED_STRIP_RESOLUTION_HZ,
         .trans_queue_depth = 4, // number of transactions that can be pending in the background
     };
-    rmt_new_tx_channel(&tx_chan_config, &led_chan);
-    rmt_new_simple_encoder(&simple_encoder_cfg, &simple_encoder);
-    rmt_enable(led_chan);
+    esp_err_t err = rmt_new_tx_channel(&tx_chan_config, &strip->channel);
+    if (err != ESP_OK) return err;
+
+    err = rmt_new_simple_encoder(&simple_encoder_cfg, &strip->encoder);
+    if (err != ESP_OK) return err;
+
+    rmt_tx_event_callbacks_t callbacks = {
+        .on_trans_done = on_trans_done,
+    };
+    err = rmt_tx_register_event_callbacks(strip->channel, &callbacks, strip);
+    if (err != ESP_OK) return err;
+    return rmt_enable(strip->channel);
+}
+
+esp_err_t ws2812_setup_strips(const ws2812_strip_config_t *configs, uint8_t count) {
+    if (strip_count) return ESP_ERR_INVALID_STATE;
+    if (count == 0 || count > WS2812_MAX_STRIPS) return ESP_ERR_INVALID_ARG;
+    for (int i = 0; i < count; i++) {
+        if (configs[i].led_count == 0 || configs[i].led_count > WS2812_MAX_LEDS) return ESP_ERR_INVALID_ARG;
+    }
+
+    build_symbol_lut();
+    ws2812_set_gamma(1.0f, 1.0f, 1.0f);
+
+    for (int i = 0; i < count; i++) {
+        ws2812_strip_t *strip = &strips[i];
+        esp_err_t err = strip_alloc(strip, configs[i].led_count);
+        if (err == ESP_OK) err = strip_channel(strip, configs[i].gpio_pin, i, count);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "strip %d on gpio %d: %s", i, configs[i].gpio_pin, esp_err_to_name(err));
+            return err;
+        }
+        strip_count++;
+    }
+
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+    if (count > 1) {
+        rmt_channel_handle_t channels[WS2812_MAX_STRIPS];
+        for (int i = 0; i < count; i++) channels[i] = strips[i].channel;
+
+        rmt_sync_manager_config_t sync_config = {
+            .tx_channel_array = channels,
+            .array_size = count,
+        };
+        esp_err_t err = rmt_new_sync_manager(&sync_config, &sync_manager);
+        if (err != ESP_OK) {
+            //! still usable, the strips just latch a few microseconds apart
+            ESP_LOGW(TAG, "sync manager: %s", esp_err_to_name(err));
+            sync_manager = NULL;
+        }
+    }
+#endif
+
+    ws2812_select_strip(0);
+    return ESP_OK;
+}
+
+void ws2812_setup(uint8_t gpio_pin) {
+    ws2812_strip_config_t config = {
+        .gpio_pin = gpio_pin,
+        .led_count = WS2812_DEFAULT_LEDS,
+    };
+    ESP_ERROR_CHECK(ws2812_setup_strips(&config, 1));
+}
+
+void ws2812_select_strip(uint8_t index) {
+    if (index >= strip_count) return;
+    draw_strip = &strips[index];
+    draw_layer = &draw_strip->compositor.layers[WS2812_LAYER_EFFECT];
 }
 
 void ws2812_load_pulse(ws2812_cyclePulse_t object) {
@@ -94,25 +369,36 @@ void ws2812_load_pulse(ws2812_cyclePulse_t object) {
 }
 
 static void reset_leds(bool transmit) {
-    memset(led_pixels, 0, sizeof(led_pixels));
+    for (int i = 0; i < strip_count; i++) {
+        led_compositor_t *comp = &strips[i].compositor;
+        for (int layer = 0; layer < comp->layer_count; layer++) led_layer_clear(&comp->layers[layer]);
+        led_compositor_flatten(comp, strips[i].pixels);
+    }
     if (!transmit) return;
 
-    rmt_transmit(led_chan, simple_encoder, led_pixels, sizeof(led_pixels), &tx_config);
+    ws2812_transmit();
+}
+
+static void use_layer(ws2812_layer_t layer) {
+    draw_layer = &draw_strip->compositor.layers[layer];
 }
 
 static void request_update_leds(uint16_t index, RGB_t rgb) {
-    led_pixels[index * 3] = rgb.green;          // Green
-    led_pixels[index * 3 + 1] = rgb.red;        // Red
-    led_pixels[index * 3 + 2] = rgb.blue;       // Blue
+    led_layer_set(draw_layer, index, rgb);
 }
 
 static void request_clear_allLeds() {
-    memset(led_pixels, 0, sizeof(led_pixels));
+    led_layer_clear(draw_layer);
+}
+
+void ws2812_config_layer(ws2812_layer_t layer, uint8_t opacity, led_blend_t blend, uint16_t start_index, uint16_t end_index) {
+    led_layer_config(&draw_strip->compositor.layers[layer], opacity, blend, start_index, end_index);
 }
 
 static void on_pulse_handler(uint8_t index, bool state) {
     ws2812_cyclePulse_t* obj = &ws2812_pulse_objs[index];
     RGB_t output = state ? obj->rgb : rgb_off;
+    use_layer(WS2812_LAYER_PULSE);
     request_update_leds(obj->led_index, output);
 }
 
@@ -124,12 +410,11 @@ void ws2812_load_fadeColor(ws2812_cycleFade_t ref, uint8_t index) {
 }
 
 static void fade_sequence_callback(uint8_t obj_index, step_sequence_config_t* conf) {
-    RGB_t new_color;
     int16_t curentValue = conf->current_value;
-    hsv_to_rgb(curentValue, 1.0f, 1.0f, &new_color);
 
     ws2812_cycleFade_t* ref = &cycle_fades[obj_index];
     RGB_t new_color2 = make_color_byChannels(curentValue, ref->active_channels);
+    use_layer(WS2812_LAYER_FADE);
     request_update_leds(ref->led_index, new_color2);
 }
 
@@ -181,92 +466,82 @@ static void step_sequence_callback(uint8_t obj_index, step_sequence_config_t* co
 }
 
 //! hue animation
-hue_animation_t hue_ani2 = {
-    .hue = 0,
-    .direction = true,
-    .is_bounced = false,
-    .start_index = 0,
-    .end_index = LEDS_COUNT - 1,
-    .value = 30,
-    .speed = 1,
-    .refresh_time_uS = 100,
-    .last_refresh_time = 0
-};
-
 void hue_animation(uint64_t current_time) {
-    if (current_time - hue_ani2.last_refresh_time < hue_ani2.refresh_time_uS) return;
-    hue_ani2.last_refresh_time = current_time;
+    hue_animation_t *hue_ani = &draw_strip->hue;
+    if (current_time - hue_ani->last_refresh_time < hue_ani->refresh_time_uS) return;
+    hue_ani->last_refresh_time = current_time;
+
+    uint16_t end_index = hue_ani->end_index;
 
-    for (int i = hue_ani2.start_index; i <= hue_ani2.end_index; i++) {
+    for (int i = hue_ani->start_index; i <= end_index; i++) {
         RGB_t rgb_value;
-        uint8_t offset = hue_ani2.direction ?  hue_ani2.end_index - i : i;
+        uint8_t offset = hue_ani->direction ?  end_index - i : i;
 
-        hsv_to_rgb_ints((hue_ani2.hue + offset * 10) % 256, 255, 10, &rgb_value);
+        hsv_to_rgb_ints((hue_ani->hue + offset * 10) % 256, 255, 10, &rgb_value);
         request_update_leds(i, rgb_value);
     }
 
     // Increment hue for animation
-    hue_ani2.hue = (hue_ani2.hue + hue_ani2.speed) % 256;
+    hue_ani->hue = (hue_ani->hue + hue_ani->speed) % 256;
 
-    if (hue_ani2.is_bounced) {
+    if (hue_ani->is_bounced) {
         // Switch direction when hue completes a full cycle
-        if (hue_ani2.hue == 0) {
-            hue_ani2.direction = ! hue_ani2.direction;  // Toggle direction
+        if (hue_ani->hue == 0) {
+            hue_ani->direction = ! hue_ani->direction;  // Toggle direction
         }
     }
 }
 
 // update this code to make the wave move by adjusting the phase instead of is_moving
 
-#define SEQUENCE_LENGTH 5
-
-typedef struct {
-    uint16_t current_index;
-    RGB_t neigative_color;
-    int offset;
-    int total_period;
-    float frequency;
-    bool is_bounced;
-    int8_t direction;
-    uint8_t length;
-    uint8_t gap;
-    uint64_t refresh_time_uS;
-    uint64_t last_refresh_time;
-    float phase;
-} sequenced_wave_t;
+//! the sizes follow the strip, a sequence repeats after at most 255 LEDs
+static void effects_init(ws2812_strip_t *strip) {
+    strip->hue = (hue_animation_t){
+        .hue = 0,
+        .direction = true,
+        .is_bounced = false,
+        .start_index = 0,
+        .end_index = strip->led_count - 1,
+        .value = 30,
+        .speed = 1,
+        .refresh_time_uS = 100,
+        .last_refresh_time = 0
+    };
 
-sequenced_wave_t sequence1 = {
-    .current_index = 0,
-    .neigative_color = { 0, 0, 0 },
-    .offset = 0,
-    .total_period = SEQUENCE_LENGTH + LEDS_COUNT,
-    .frequency = (2 * M_PI) / SEQUENCE_LENGTH,
-    .is_bounced = true,
-    .direction = 1,
-    .length = LEDS_COUNT,
-    .gap = 3,
-    .refresh_time_uS = 800000,
-    .last_refresh_time = 0,
-    .phase = 0,
-};
+    strip->wave = (sequenced_wave_t){
+        .current_index = 0,
+        .neigative_color = { 0, 0, 0 },
+        .offset = 0,
+        .total_period = SEQUENCE_LENGTH + strip->led_count,
+        .frequency = ANGLE16_TURN / SEQUENCE_LENGTH,
+        .is_bounced = true,
+        .direction = 1,
+        .length = MIN(strip->led_count, UINT8_MAX),
+        .gap = 3,
+        .refresh_time_uS = 800000,
+        .last_refresh_time = 0,
+        .phase = 0,
+        .expansion = 0,
+    };
+}
 
 //! moving wave: repeated sequence
 void moving_wave1(uint64_t current_time) {
-    if (current_time - sequence1.last_refresh_time < sequence1.refresh_time_uS) return;
-    sequence1.last_refresh_time = current_time;
+    sequenced_wave_t *sequence1 = &draw_strip->wave;
+    if (current_time - sequence1->last_refresh_time < sequence1->refresh_time_uS) return;
+    sequence1->last_refresh_time = current_time;
 
-    sequence1.phase += -0.1f * sequence1.direction;
-    if (sequence1.phase >= 2 * M_PI) sequence1.phase -= 2 * M_PI;
+    sequence1->phase -= WAVE_PHASE_STEP * sequence1->direction;
     
-    uint8_t cycle_length = sequence1.length;
+    uint8_t cycle_length = sequence1->length;
+    uint16_t step = ANGLE16_TURN / cycle_length;
 
-    for (int i = 0; i < LEDS_COUNT; i++) {
-        int position = i % (cycle_length + sequence1.gap);
-        request_update_leds(i, sequence1.neigative_color);
+    for (int i = 0; i < draw_strip->led_count; i++) {
+        int position = i % (cycle_length + sequence1->gap);
+        request_update_leds(i, sequence1->neigative_color);
 
         if (position < cycle_length) {
-            float sin_offset = 1.0f + sinf((position / (float)cycle_length) * 2 * M_PI + sequence1.phase);
-            uint8_t brightness = (uint8_t)(127.5f * sin_offset);
+            uint8_t brightness = sin_wave8(position * step + sequence1->phase);
             RGB_t color = { brightness, 0, 0 };
             request_update_leds(i, color);
         }
@@ -275,31 +550,31 @@ void moving_wave1(uint64_t current_time) {
 
 //! moving wave: single sequence
 void moving_wave2(uint64_t current_time) {
-    if (current_time - sequence1.last_refresh_time < sequence1.refresh_time_uS) return;
-    sequence1.last_refresh_time = current_time;
+    sequenced_wave_t *sequence1 = &draw_strip->wave;
+    if (current_time - sequence1->last_refresh_time < sequence1->refresh_time_uS) return;
+    sequence1->last_refresh_time = current_time;
     
-    if (sequence1.is_bounced) {
-        sequence1.offset += sequence1.direction;
+    if (sequence1->is_bounced) {
+        sequence1->offset += sequence1->direction;
         
-        // printf("offset = %d\n", sequence1.offset);    
+        // printf("offset = %d\n", sequence1->offset);    
         // check for dirrection change
-        if ((sequence1.offset >= sequence1.total_period + SEQUENCE_LENGTH)
-            || (sequence1.offset <= SEQUENCE_LENGTH && sequence1.direction != 1)) {
-                sequence1.direction = sequence1.direction * -1;
+        if ((sequence1->offset >= sequence1->total_period + SEQUENCE_LENGTH)
+            || (sequence1->offset <= SEQUENCE_LENGTH && sequence1->direction != 1)) {
+                sequence1->direction = sequence1->direction * -1;
         } 
     } else {
-        int offsetAdjustment = (sequence1.direction == 1) ? sequence1.total_period - 1 : 1;
-        sequence1.offset = (offsetAdjustment + sequence1.offset) % sequence1.total_period;
+        int offsetAdjustment = (sequence1->direction == 1) ? sequence1->total_period - 1 : 1;
+        sequence1->offset = (offsetAdjustment + sequence1->offset) % sequence1->total_period;
     }
 
-    for (int i = 0; i < LEDS_COUNT; i++) {
-        int position = (i + sequence1.offset) % sequence1.total_period;        
-        request_update_leds(i, sequence1.neigative_color);
+    for (int i = 0; i < draw_strip->led_count; i++) {
+        int position = (i + sequence1->offset) % sequence1->total_period;        
+        request_update_leds(i, sequence1->neigative_color);
 
         // printf("%d ", position);
         if (position < SEQUENCE_LENGTH) {
-            float sin_offset = 1.0f + sinf(position * sequence1.frequency);
-            uint8_t brightness = (uint8_t)(127.5f * sin_offset);
+            uint8_t brightness = sin_wave8(position * sequence1->frequency);
             RGB_t color = { brightness, 0, 0 };
             request_update_leds(i, color);
         }
@@ -309,18 +584,19 @@ void moving_wave2(uint64_t current_time) {
 
 //! moving wave: expanding sequence
 void moving_wave3(uint64_t current_time) {
-    int8_t center_led = LEDS_COUNT / 2;
+    sequenced_wave_t *sequence1 = &draw_strip->wave;
+    int16_t center_led = draw_strip->led_count / 2;
 
-    if (current_time - sequence1.last_refresh_time < sequence1.refresh_time_uS) return;
-    sequence1.last_refresh_time = current_time;
+    if (current_time - sequence1->last_refresh_time < sequence1->refresh_time_uS) return;
+    sequence1->last_refresh_time = current_time;
 
-    static int8_t expansion = 0;
-    expansion += sequence1.direction;
+    sequence1->expansion += sequence1->direction;
+    int16_t expansion = sequence1->expansion;
 
     // Change direction if limits are reached
-    if ((expansion >= center_led && sequence1.direction != -1)
-        || (expansion < 0 && sequence1.direction != 1)) {
-            sequence1.direction *= -1;
+    if ((expansion >= center_led && sequence1->direction != -1)
+        || (expansion < 0 && sequence1->direction != 1)) {
+            sequence1->direction *= -1;
     }
     
     // printf("expansion = %d\n", expansion);
@@ -334,7 +610,7 @@ void moving_wave3(uint64_t current_time) {
         uint16_t upperBound = center_led + i;
         uint16_t lowerBound = center_led - i;
 
-        if (upperBound < LEDS_COUNT) {
+        if (upperBound < draw_strip->led_count) {
             request_update_leds(upperBound, value);  // Right side
         }
         if (lowerBound >= 0) {
@@ -344,7 +620,9 @@ void moving_wave3(uint64_t current_time) {
 }
 
 
-RGB_t gradient_array[LEDS_COUNT] = {
+#define GRADIENT_LENGTH WS2812_DEFAULT_LEDS     // repeats along longer strips
+
+RGB_t gradient_array[GRADIENT_LENGTH] = {
     {255, 0, 0},
     {255, 127, 0},
     {255, 255, 0},
@@ -352,18 +630,19 @@ RGB_t gradient_array[LEDS_COUNT] = {
     {0, 0, 255}
 };
 
-static uint32_t last_update = 0;
+#define GRADIENT_REFRESH_US 100000
 
 //! moving wave: fixed gradient array;
 void moving_wave4(uint64_t current_time) {
-    if (current_time - last_update < 100000) return;
-    last_update = current_time;
+    sequenced_wave_t *sequence1 = &draw_strip->wave;
+    if (current_time - sequence1->last_refresh_time < GRADIENT_REFRESH_US) return;
+    sequence1->last_refresh_time = current_time;
 
-    memset(led_pixels, 0, sizeof(led_pixels));
-    sequence1.offset = (sequence1.offset - sequence1.direction + LEDS_COUNT) % LEDS_COUNT;
+    request_clear_allLeds();
+    sequence1->offset = (sequence1->offset - sequence1->direction + GRADIENT_LENGTH) % GRADIENT_LENGTH;
 
-    for (int i = 0; i < LEDS_COUNT; i++) {
-        int position = (i + sequence1.offset) % LEDS_COUNT;
+    for (int i = 0; i < draw_strip->led_count; i++) {
+        int position = (i + sequence1->offset) % GRADIENT_LENGTH;
         RGB_t color = gradient_array[position];
         request_update_leds(i, color);
     }
@@ -399,7 +678,7 @@ sequenced_star_t seq_star = {
 static Star stars[MAX_STARS] = {0};
 
 void moving_wave5(uint64_t current_time) {
-    memset(led_pixels, 0, sizeof(led_pixels));
+    request_clear_allLeds();
 
     for (int i = 0; i < MAX_STARS; i++) {
         if (stars[i].value > 0) {
@@ -432,10 +711,19 @@ void moving_wave5(uint64_t current_time) {
 }
 
 void ws2812_loop(uint64_t current_time) {
-    // moving_wave1(current_time);
+    if (strip_count == 0) return;
 
-    //! handle hue animation
-    hue_animation(current_time);
+    //! every strip animates, ws2812_select_strip() picks the one the app draws into
+    ws2812_strip_t *selected = draw_strip;
+    for (int i = 0; i < strip_count; i++) {
+        draw_strip = &strips[i];
+        use_layer(WS2812_LAYER_EFFECT);
+        // moving_wave1(current_time);
+
+        //! handle hue animation
+        hue_animation(current_time);
+    }
+    ws2812_select_strip(selected - strips);
 
     //! handle filling leds
     // cycle_values(current_time, 0, &fill_sequence, fill_sequence_callback);
@@ -456,8 +744,20 @@ void ws2812_loop(uint64_t current_time) {
 
     //! transmit the updated leds
     if (current_time - last_transmit_time < WS2812_TRANSMIT_FREQUENCY) return;
+
+    //! the layers stay dirty until a tx buffer frees up, unchanged strips aren't sent again
+    //! dithering needs every frame, the fraction only averages out over time
+    //! a frame longer than the period goes out on the next tick, not a whole period later
+    if (!strips_ready()) return;
     last_transmit_time = current_time;
-    rmt_transmit(led_chan, simple_encoder, led_pixels, sizeof(led_pixels), &tx_config);
+    bool changed = false;
+    for (int i = 0; i < strip_count; i++) {
+        changed |= led_compositor_flatten(&strips[i].compositor, strips[i].pixels);
+    }
+    if (!changed && !dither_enabled && !force_transmit) return;
+
+    force_transmit = false;
+    ws2812_transmit();
 }
 
 
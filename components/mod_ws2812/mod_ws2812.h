@@ -5,14 +5,21 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <soc/gpio_num.h>
+#include <soc/soc_caps.h>
+#include <esp_err.h>
 #include "driver/rmt_tx.h"
 
 #include "timer_pulse.h"
 #include "cycle_sequence.h"
 #include "color_helper.h"
+#include "led_compositor.h"
 
 #define RMT_LED_STRIP_RESOLUTION_HZ 10000000 // 10MHz resolution, 1 tick = 0.1us (led strip needs a high resolution)
 
+#define WS2812_DEFAULT_LEDS 9               // ws2812_setup() strip, effect defaults
+#define WS2812_MAX_LEDS 4096                // per strip, ~123ms per frame at 800kHz
+#define WS2812_MAX_STRIPS SOC_RMT_TX_CANDIDATES_PER_GROUP
+
 static const rmt_symbol_word_t ws2812_zero = {
     .level0 = 1,
     .duration0 = 0.3 * RMT_LED_STRIP_RESOLUTION_HZ / 1000000, // T0H=0.3us
@@ -61,14 +68,45 @@ typedef struct {
     uint16_t last_refresh_time;
 } hue_animation_t;
 
+typedef enum {
+    WS2812_LAYER_EFFECT,            // hue animation and moving waves, bottom
+    WS2812_LAYER_FADE,
+    WS2812_LAYER_PULSE,             // top
+    WS2812_LAYER_COUNT,
+} ws2812_layer_t;
+
+typedef struct {
+    uint8_t gpio_pin;
+    uint16_t led_count;             // up to WS2812_MAX_LEDS
+} ws2812_strip_config_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t skipped;               // tx buffers were still on air
+    uint64_t encode_cycles;         // gamma/dither pass over every strip, divide by frames
+    uint32_t composites;            // frames where at least one layer changed
+    uint64_t composite_cycles;      // divide by composites, and by WS2812_LAYER_COUNT for per layer
+} ws2812_stats_t;
+
+
+//! one RMT channel per strip, allocates every buffer once, strips latch together when the chip can sync
+esp_err_t ws2812_setup_strips(const ws2812_strip_config_t *configs, uint8_t count);
+void ws2812_setup(uint8_t gpio_pin);        // one WS2812_DEFAULT_LEDS strip
 
-void ws2812_setup(uint8_t gpio_pin);
+//! effects, pulses, fades and ws2812_config_layer() apply to this strip, 0 after setup
+void ws2812_select_strip(uint8_t index);
 void ws2812_load_pulse(ws2812_cyclePulse_t object);
 void ws2812_load_fadeColor(ws2812_cycleFade_t ref, uint8_t index);
+//! per channel gamma, 1.0 for all three is off, 2.2 looks linear to the eye
+void ws2812_set_gamma(float red, float green, float blue);
+//! temporal dithering, more than 8 bits at low levels but every frame gets sent
+void ws2812_set_dither(bool enabled);
+void ws2812_config_layer(ws2812_layer_t layer, uint8_t opacity, led_blend_t blend, uint16_t start_index, uint16_t end_index);
 
 void ws2812_toggle(bool state, uint8_t led_index);
 void ws2812_run1(uint64_t current_time);
 void ws2812_loop(uint64_t current_time);
 void ws2812_loop2(uint64_t current_time);
+void ws2812_get_stats(ws2812_stats_t *stats);
 
 #endif
\ No newline at end of file
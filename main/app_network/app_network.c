@@ -12,19 +12,32 @@
 #include "mod_wifi.h"
 #include "mod_wifi_nan.h"
 #include "mod_espnow.h"
+#include "espnow_mesh.h"
+#include "espnow_aggregate.h"
 #include "ntp/ntp.h"
 #include "http/http.h"
 #include "esp_wifi.h"
+#include "esp_timer.h"
 
 #include "udp_socket/udp_socket.h"
 #include "tcp_socket/tcp_socket.h"
 #include "web_socket/web_socket.h"
+#include "net_reactor/net_reactor.h"
 // #include "modbus/modbus.h"
 
 #include "sdkconfig.h"
 
 static const char *TAG = "APP_NETWORK";
 
+#define UDP_TELEMETRY_PORT 3333
+
+// a reading waits at most this long for the other sensors' bursts,
+// 50 ms halves the frames of a 20 ms deadline (test/host/bench_espnow_aggregate.c)
+#define ESPNOW_READINGS_DELAY_US 50000
+
+static espnow_aggregator_t readings_agg;
+static bool readings_agg_ready = false;
+
 
 static void espnow_message_handler(espnow_received_message_t received_message) {
     ESP_LOGW(TAG,"received data:");
@@ -35,7 +48,7 @@ static void espnow_message_handler(espnow_received_message_t received_message) {
     ESP_LOGI(TAG, "group_id: %d", received_message.message->group_id);
     ESP_LOGI(TAG, "msg_id: %d", received_message.message->msg_id);
     ESP_LOGI(TAG, "access_code: %u", received_message.message->access_code);
-    ESP_LOGI(TAG, "Data: %.*s", sizeof(received_message.message->data), received_message.message->data);
+    ESP_LOGI(TAG, "Data: %.*s", received_message.data_len, received_message.message->data);
 } 
 
 void espnow_controller_send() {
@@ -45,13 +58,13 @@ void espnow_controller_send() {
     espnow_message_t message = {
         .access_code = 33,
         .group_id = 11,
-        .msg_id = 12,
         .time_to_live = 15,
     };
 
     memcpy(message.target_addr, dest_mac, sizeof(message.target_addr));
-    memcpy(message.data, data, sizeof(message.data));
-    espnow_send((uint8_t*)&message, sizeof(message));
+    memcpy(message.data, data, sizeof(data));
+    message.data_len = sizeof(data);
+    espnow_mesh_send(&message);
 }
 
 static uint8_t esp_mac[6];
@@ -78,6 +91,12 @@ void app_network_setup() {
     wifi_wps_begin();
     espnow_setup(esp_mac, espnow_message_handler);
 
+    //! sensor readings go out as records shared by every node, see app_network_push_reading
+    espnow_agg_init(&readings_agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){
+        .max_delay_us = ESPNOW_READINGS_DELAY_US,
+    });
+    readings_agg_ready = true;
+
     char mac_str[32];
     snprintf(mac_str, sizeof(mac_str), "%02X:%02X:%02X:%02X:%02X:%02X", MAC2STR(esp_mac));
     ESP_LOGW(TAG, "mac: %s", mac_str);
@@ -90,6 +109,20 @@ void app_network_setup() {
 }
 
 static uint64_t second_interval_check = 0;
+static bool reactor_started = false;
+static bool udp_client_started = false;
+
+// the reactor task polls every server socket, the main loop only sets them up
+static void network_reactor_setup(void) {
+    if (reactor_started) return;
+
+    net_reactor_add(web_socket_fill_pollfds, web_socket_dispatch, NULL);
+    //! the UDP and TCP servers stay off as before the reactor, enable these with
+    //! their setup calls in app_network_task, an unset server fills no pollfds
+    // net_reactor_add(udp_server_fill_pollfds, udp_server_dispatch, NULL);
+    // net_reactor_add(tcp_server_fill_pollfds, tcp_server_dispatch, NULL);
+    reactor_started = net_reactor_start() == 0;
+}
 
 void app_network_task(uint64_t current_time) {
     if (current_time - second_interval_check > 1000000) {
@@ -99,6 +132,9 @@ void app_network_task(uint64_t current_time) {
 
     }
 
+    espnow_task(current_time);
+    if (readings_agg_ready) espnow_agg_task(&readings_agg, current_time);
+
     // wifi_nan_checkPeers(current_time);
     // wifi_nan_sendData(current_time);
 
@@ -106,17 +142,24 @@ void app_network_task(uint64_t current_time) {
     
     if (status == WIFI_EVENT_STA_CONNECTED) {
         // ntp_status_t ntp_status = ntp_task(current_time);
+        network_reactor_setup();
+
+        net_reactor_lock();
         web_socket_setup();
         // udp_server_socket_setup(current_time);
         // tcp_server_socket_setup(current_time);
-        
-    } else if (status == WIFI_EVENT_WIFI_READY) {
-        web_socket_poll(current_time);
+        net_reactor_unlock();       // new listeners join the poll set on the next reactor tick
 
-        // udp_server_socket_task();
-        // udp_client_socket_send(current_time);
+        //! telemetry is also broadcast over UDP on the station subnet
+        if (!udp_client_started) udp_client_started = udp_client_setup(NULL, UDP_TELEMETRY_PORT) == 0;
+        udp_client_socket_send(current_time);
 
-        // tcp_server_socket_task(current_time);
+    } else {
+        // the subnet broadcast address can change with the next connection
+        if (udp_client_started) udp_client_close();
+        udp_client_started = false;
+
+        // server sockets are served by the reactor task
         // tcp_client_socket_task(current_time);
     }
 }
@@ -125,15 +168,31 @@ void app_network_task(uint64_t current_time) {
 void app_network_push_data(data_output_t data_output) {
     if (data_output.data == NULL) return;
 
-    // Since buff is uint16_t, we need to allocate space for the type (1 byte) and the data
-    uint16_t buff[1 + data_output.len]; // 1 for type (stored in the first 2 bytes), plus data
+    // type (stored as uint16_t) followed by the data, encoded once for every client
+    uint16_t type = (uint16_t)data_output.type;
+    web_socket_part_t parts[] = {
+        { .data = &type, .len = sizeof(type) },
+        { .data = data_output.data, .len = data_output.len * sizeof(uint16_t) },
+    };
 
-    // Store the type in the first 2 bytes (as uint16_t)
-    buff[0] = (uint16_t)data_output.type;
+    net_reactor_lock();
+    web_socket_broadcast_parts(WS_OPCODE_BINARY, parts, 2);
+    net_reactor_unlock();
+    net_reactor_wakeup();
+}
 
-    // Copy the data into the buffer starting from the second uint16_t element
-    memcpy(buff + 1, data_output.data, data_output.len * sizeof(uint16_t));
+void app_network_push_telemetry(const uint8_t* data, size_t len) {
+    net_reactor_lock();
+    web_socket_broadcast(WS_OPCODE_BINARY, data, len);
+    net_reactor_unlock();
+    net_reactor_wakeup();
 
-    // send the message
-    send_cur_websocket_message(buff, sizeof(buff));
-}
\ No newline at end of file
+    // batched with the other readings, flushed by udp_client_socket_send
+    udp_client_queue(data, len);
+}
+
+//! one record per reading, typed by its telemetry channel, the burst of one sensor shares a frame
+void app_network_push_reading(uint8_t channel, int32_t value) {
+    if (!readings_agg_ready) return;
+    espnow_agg_add(&readings_agg, channel, &value, sizeof(value), esp_timer_get_time());
+}
@@ -21,4 +21,6 @@ typedef struct {
 
 void app_network_setup(void);
 void app_network_task(uint64_t current_time);
-void app_network_push_data(data_output_t data_output);
\ No newline at end of file
+void app_network_push_data(data_output_t data_output);
+void app_network_push_telemetry(const uint8_t* data, size_t len);
+void app_network_push_reading(uint8_t channel, int32_t value);
\ No newline at end of file
@@ -16,14 +16,41 @@
 #define INDEX_INPUT_CMD 1
 #define INDEX_INPUT_GPIO 2
 #define INDEX_OUTPUT_CMD 17
-#define PARSE_STRING_LEN 128
+
+#define BEHAVIOR_BIN_PATH "/littlefs/behaviors.bin"
+#define BEHAVIOR_BIN_MAGIC 0x31564842       // "BHV1"
+#define BEHAVIOR_BIN_VERSION 1
+
+//! binary rules file produced by behavior_pack.py, followed by count * behavior_config_t
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint16_t count;
+    uint16_t reserved;
+    uint32_t crc32;
+} behavior_bin_header_t;
+
+_Static_assert(sizeof(behavior_config_t) == 40, "behavior_config_t must match behavior_pack.py");
 
 #define MAC2STR(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
 
 static const char *TAG = "BEHAVIOR";
 
-static behavior_config_t device_behaviors[10];
-static uint8_t behaviors_index = 0;
+#define BEHAVIOR_ARENA_MIN 8
+#define BEHAVIOR_SLOT_EMPTY 0xFFFF
+#define BEHAVIOR_KEY_MAX_PREFIX 2
+
+//! rules are kept in a growable arena, the index maps key hashes to arena positions
+static behavior_config_t *behavior_arena = NULL;
+static uint16_t behavior_count = 0;
+static uint16_t behavior_capacity = 0;
+
+//! open-addressing index (linear probing), size is always a power of 2
+static uint16_t *behavior_slots = NULL;
+static uint32_t behavior_slot_count = 0;           // up to 65536 for the 32767 rule cap
+static bool behavior_dirty = false;
+
 static uint8_t device_mac[6];
 static behavior_output_interface behavior_interface;
 
@@ -40,30 +67,37 @@ void print_bytes2(uint8_t* data, size_t len) {
 }
 
 
-static void parse_hex_string(const char* input, uint8_t* output) {
-    char str_copy[PARSE_STRING_LEN]; // Make a copy of the input string (adjust size as needed)
-    strncpy(str_copy, input, sizeof(str_copy) - 1);
-    str_copy[sizeof(str_copy) - 1] = '\0'; // Ensure null termination
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
 
-    const char* delimiter = ",";
-    char* token = strtok(str_copy, delimiter); // Tokenize the string
+//! parses comma separated hex bytes straight from the line slice, returns how many were written
+static size_t parse_hex_string(const char* input, size_t len, uint8_t* output, size_t output_size) {
+    const char* end = input + len;
     size_t index = 0;
-    
-    while (token != NULL) {
-        // Skip leading spaces
-        while (isspace((unsigned char)*token)) token++;
 
-        // Trim trailing spaces
-        char* end = token + strlen(token) - 1;
-        while (end > token && isspace((unsigned char)*end)) end--;
-        *(end + 1) = '\0'; // Null-terminate the trimmed token
+    while (input < end && index < output_size) {
+        while (input < end && isspace((unsigned char)*input)) input++;
+
+        uint8_t value = 0;
+        bool has_digits = false;
+        int digit;
+        while (input < end && (digit = hex_digit(*input)) >= 0) {
+            value = (value << 4) | digit;
+            has_digits = true;
+            input++;
+        }
 
-        // Convert hex string to byte
-        output[index++] = (uint8_t)strtol(token, NULL, 16);
+        // skip trailing spaces or junk up to the next separator, empty tokens are dropped
+        while (input < end && *input != ',') input++;
+        input++;
 
-        // Get the next token
-        token = strtok(NULL, delimiter);
+        if (has_digits) output[index++] = value;
     }
+    return index;
 }
 
 static int parse_mac_address(const char *mac_str, uint8_t mac[6]) {
@@ -95,107 +129,257 @@ bool check_config_cmd(behavior_config_t* config) {
 }
 
 void littlefs_readLine_handler(char* file_name, char* str_buff, size_t len) {
-    // len is the length of the string, not length of the byte representations in that string
-    uint8_t remote_mac[6];
-    parse_mac_address(file_name, remote_mac);
-    printf("Parsed MAC: %02X:%02X:%02X:%02X:%02X:%02X\n\n", MAC2STR(remote_mac));
-
-    uint8_t data_buff[len];
-    parse_hex_string(str_buff, data_buff);
-
-    // compare remote_mac to device_mac
-    // int compare_mac = memcmp(remote_mac, device_mac, sizeof(device_mac)) == 0;
-
-    // behavior_config_t config;
-    // // copy remote_mac into config
-    // memcpy(config.remote_mac, remote_mac, sizeof(config.remote_mac));
-    // // copy data_buff starting from index 1 to config starting at index 6
-    // // forget the length bc it's off a  little bit
-    // memcpy((uint8_t*)&config+6, data_buff+1, sizeof(behavior_config_t));
-    
-    // // behavior_config_t* config = (behavior_config_t*)(data_buff+1);
-
-    // int validate_code = data_buff[INDEX_VALIDATION] == BEHAVIOR_VALIDATION_CODE;
-    
-    // if (validate_code && check_config_cmd(&config)) {
-    //     ESP_LOGI(TAG, "Behavior Config:");
-    //     print_bytes2(data_buff, sizeof(behavior_config_t));
-
-    //     // copy config into device_behaviors[behaviors_index]
-    //     memcpy(&device_behaviors[behaviors_index++], &config, sizeof(behavior_config_t));
-    //     printf("INPUT CMD: %02X\n", device_behaviors[behaviors_index-1].input_cmd);
-    //     printf("OUTPUT CMD: %02X\n", device_behaviors[behaviors_index-1].output_cmd);
-    // }
+    behavior_config_t config;
+    if (parse_mac_address(file_name, config.remote_mac) != 6) return;
+
+    // data_buff[0] is the validation code, the rest mirrors behavior_config_t after remote_mac
+    uint8_t data_buff[1 + sizeof(behavior_config_t) - 6];
+    if (parse_hex_string(str_buff, len, data_buff, sizeof(data_buff)) < sizeof(data_buff)) return;
+
+    memcpy((uint8_t*)&config + 6, data_buff + 1, sizeof(behavior_config_t) - 6);
+
+    int validate_code = data_buff[INDEX_VALIDATION] == BEHAVIOR_VALIDATION_CODE;
+    if (validate_code && check_config_cmd(&config)) {
+        behavior_add_config(&config);
+    }
+}
+
+//! number of input_data bytes that take part in the lookup key
+static uint8_t behavior_key_prefix_len(input_command_t input_cmd) {
+    switch (input_cmd) {
+        case INPUT_GPIO_CMD:
+            return 2;           // input_data[0] - input_gpio_t, input_data[1] - pin
+        default:
+            return 0;
+    }
+}
+
+//! FNV-1a over (remote_mac, input_cmd, input_data prefix)
+static uint32_t behavior_hash(const uint8_t* mac, input_command_t input_cmd, const uint8_t* prefix) {
+    uint32_t hash = 2166136261u;
+    for (int i=0; i<6; i++) {
+        hash = (hash ^ mac[i]) * 16777619u;
+    }
+    hash = (hash ^ (uint8_t)input_cmd) * 16777619u;
+
+    uint8_t prefix_len = behavior_key_prefix_len(input_cmd);
+    for (int i=0; i<prefix_len; i++) {
+        hash = (hash ^ prefix[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool behavior_key_match(const behavior_config_t* config, const uint8_t* mac,
+    input_command_t input_cmd, const uint8_t* prefix) {
+    if (config->input_cmd != input_cmd) return false;
+    if (memcmp(config->remote_mac, mac, sizeof(config->remote_mac)) != 0) return false;
+    return memcmp(config->input_data, prefix, behavior_key_prefix_len(input_cmd)) == 0;
+}
+
+bool behavior_add_config(const behavior_config_t* config) {
+    if (behavior_count >= BEHAVIOR_SLOT_EMPTY/2) {
+        ESP_LOGE(TAG, "Behavior table full");
+        return false;
+    }
+
+    if (behavior_count >= behavior_capacity) {
+        uint16_t new_capacity = behavior_capacity ? behavior_capacity*2 : BEHAVIOR_ARENA_MIN;
+        behavior_config_t* new_arena = realloc(behavior_arena, new_capacity * sizeof(behavior_config_t));
+        if (new_arena == NULL) {
+            ESP_LOGE(TAG, "Failed to grow behavior arena");
+            return false;
+        }
+        behavior_arena = new_arena;
+        behavior_capacity = new_capacity;
+    }
+
+    memcpy(&behavior_arena[behavior_count++], config, sizeof(behavior_config_t));
+    behavior_dirty = true;
+    return true;
+}
+
+void behavior_clear(void) {
+    free(behavior_arena);
+    free(behavior_slots);
+    behavior_arena = NULL;
+    behavior_slots = NULL;
+    behavior_count = 0;
+    behavior_capacity = 0;
+    behavior_slot_count = 0;
+    behavior_dirty = false;
+}
+
+bool behavior_compile(void) {
+    // keep the load factor at or below 50%
+    uint32_t slot_count = 16;
+    while (slot_count < (uint32_t)behavior_count*2) slot_count <<= 1;
+
+    if (slot_count != behavior_slot_count) {
+        uint16_t* new_slots = realloc(behavior_slots, slot_count * sizeof(uint16_t));
+        if (new_slots == NULL) {
+            ESP_LOGE(TAG, "Failed to allocate behavior index");
+            return false;
+        }
+        behavior_slots = new_slots;
+        behavior_slot_count = slot_count;
+    }
+    memset(behavior_slots, 0xFF, behavior_slot_count * sizeof(uint16_t));
+
+    uint32_t mask = behavior_slot_count - 1;
+    for (uint16_t i=0; i<behavior_count; i++) {
+        behavior_config_t* config = &behavior_arena[i];
+        uint32_t slot = behavior_hash(config->remote_mac, config->input_cmd, config->input_data) & mask;
+        while (behavior_slots[slot] != BEHAVIOR_SLOT_EMPTY) slot = (slot + 1) & mask;
+        behavior_slots[slot] = i;
+    }
+
+    behavior_dirty = false;
+    return true;
+}
+
+uint16_t behavior_get_count(void) {
+    return behavior_count;
+}
+
+const behavior_config_t* behavior_get_config(uint16_t index) {
+    return index < behavior_count ? &behavior_arena[index] : NULL;
+}
+
+//! call handler for every rule matching the key on this device
+static void behavior_lookup(input_command_t input_cmd, const uint8_t* prefix,
+    void (*handler)(behavior_config_t* config)) {
+    if (behavior_dirty && !behavior_compile()) return;
+    if (behavior_slot_count == 0) return;
+
+    uint32_t mask = behavior_slot_count - 1;
+    uint32_t slot = behavior_hash(device_mac, input_cmd, prefix) & mask;
+
+    while (behavior_slots[slot] != BEHAVIOR_SLOT_EMPTY) {
+        behavior_config_t* config = &behavior_arena[behavior_slots[slot]];
+        if (behavior_key_match(config, device_mac, input_cmd, prefix)) handler(config);
+        slot = (slot + 1) & mask;
+    }
+}
+
+//! zlib compatible crc32, nibble table to keep it small
+static uint32_t behavior_crc32(const uint8_t* data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i=0; i<len; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+//! read all rules with one bulk read straight into the arena
+bool behavior_load_binary(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    behavior_bin_header_t header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+                header.magic == BEHAVIOR_BIN_MAGIC &&
+                header.version == BEHAVIOR_BIN_VERSION &&
+                header.record_size == sizeof(behavior_config_t) &&
+                header.count < BEHAVIOR_SLOT_EMPTY/2;
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Invalid behavior file header: %s", path);
+        fclose(file);
+        return false;
+    }
+
+    behavior_config_t* arena = malloc((header.count ? header.count : 1) * sizeof(behavior_config_t));
+    if (arena == NULL) {
+        fclose(file);
+        return false;
+    }
+
+    size_t read_count = fread(arena, sizeof(behavior_config_t), header.count, file);
+    fclose(file);
+
+    if (read_count != header.count ||
+        behavior_crc32((uint8_t*)arena, header.count * sizeof(behavior_config_t)) != header.crc32) {
+        ESP_LOGW(TAG, "Behavior file corrupted: %s", path);
+        free(arena);
+        return false;
+    }
+
+    behavior_clear();
+    behavior_arena = arena;
+    behavior_count = header.count;
+    behavior_capacity = header.count ? header.count : 1;
+    behavior_dirty = true;
+    return true;
 }
 
 void behavior_setup(uint8_t* esp_mac, behavior_output_interface interface) {
     behavior_interface = interface;
     memcpy(device_mac, esp_mac, sizeof(device_mac));
 
-    behaviors_index = 0;
+    behavior_clear();
     littlefs_setup();
-    littlefs_loadFiles("/littlefs/devices", littlefs_readLine_handler);
+
+    // fall back to the CSV files when the packed rules are missing or invalid
+    if (!behavior_load_binary(BEHAVIOR_BIN_PATH)) {
+        littlefs_loadFiles("/littlefs/devices", littlefs_readLine_handler);
+    }
+    behavior_compile();
+    ESP_LOGI(TAG, "Behaviors loaded: %u", behavior_count);
 }
 
-void behavior_process_gpio(input_gpio_t input_type, int8_t pin, uint16_t input_value) {
-    for (int i=0; i<=behaviors_index; i++) {
-        behavior_config_t config = device_behaviors[i];
-        printf("remote_mac : %02X:%02X:%02X:%02X:%02X:%02X\n", MAC2STR(config.remote_mac));
-        printf("device_mac : %02X:%02X:%02X:%02X:%02X:%02X\n", MAC2STR(device_mac));
-        int compare_mac = memcmp(config.remote_mac, device_mac, sizeof(device_mac)) == 0;
-        if (!compare_mac || config.input_cmd != INPUT_GPIO_CMD) continue;
-
-        output_gpio_t output_type = config.output_data[0];
-        bool check = config.input_data[0] == input_type && config.input_data[1] == pin;
-        if (!check) continue;;
-
-        uint8_t val0 = config.output_data[0];
-        uint8_t output_val1 = config.output_data[1];
-        uint32_t output_val2;
-        uint32_t output_val3;
-
-        memcpy(&output_val2, config.output_data+2, sizeof(uint32_t));
-        memcpy(&output_val3, config.output_data+2, sizeof(uint32_t));
-
-        switch (output_type) {
-            case OUTPUT_GPIO_SET:
-                printf("IM HERE OUTPUT_GPIO_SET\n");
-                behavior_interface.on_gpio_set(val0, output_val1);  // val0 - gpio_pin
-                break;
-            
-            case OUTPUT_GPIO_TOGGLE:
-                printf("IM HERE OUTPUT_GPIO_TOGGLE\n");
-                behavior_interface.on_gpio_toggle(val0);
-                break;
-            
-            case OUTPUT_GPIO_PULSE:
-                printf("IM HERE OUTPUT_GPIO_PULSE\n");
-                behavior_interface.on_gpio_pulse(val0, output_val1, output_val2);
-                break;
-
-            case OUTPUT_GPIO_FADE:
-                printf("IM HERE OUTPUT_GPIO_FADE\n");
-                behavior_interface.on_gpio_fade(val0, output_val2, output_val3);
-                break;
-            
-            case OUTPUT_WS2812_PULSE:
-                printf("IM HERE OUTPUT_WS2812_PULSE\n");
-                break;
-
-            case OUTPUT_WS2812_PATTERN:
-                printf("IM HERE OUTPUT_WS2812_PATTERN\n");
-                break;
-        }
+static void behavior_output_gpio(behavior_config_t* config) {
+    output_gpio_t output_type = config->output_data[0];
+    uint8_t val0 = config->output_data[0];
+    uint8_t output_val1 = config->output_data[1];
+    uint32_t output_val2;
+    uint32_t output_val3;
+
+    memcpy(&output_val2, config->output_data+2, sizeof(uint32_t));
+    memcpy(&output_val3, config->output_data+2, sizeof(uint32_t));
+
+    switch (output_type) {
+        case OUTPUT_GPIO_SET:
+            if (behavior_interface.on_gpio_set) behavior_interface.on_gpio_set(val0, output_val1);  // val0 - gpio_pin
+            break;
+        
+        case OUTPUT_GPIO_TOGGLE:
+            if (behavior_interface.on_gpio_toggle) behavior_interface.on_gpio_toggle(val0);
+            break;
+        
+        case OUTPUT_GPIO_PULSE:
+            if (behavior_interface.on_gpio_pulse) behavior_interface.on_gpio_pulse(val0, output_val1, output_val2);
+            break;
+
+        case OUTPUT_GPIO_FADE:
+            if (behavior_interface.on_gpio_fade) behavior_interface.on_gpio_fade(val0, output_val2, output_val3);
+            break;
+        
+        case OUTPUT_WS2812_PULSE:
+            ESP_LOGD(TAG, "OUTPUT_WS2812_PULSE");
+            break;
 
+        case OUTPUT_WS2812_PATTERN:
+            ESP_LOGD(TAG, "OUTPUT_WS2812_PATTERN");
+            break;
     }
 }
 
-void behavior_process_rotary(uint16_t value, bool direction) {
-    for (int i=0; i<=behaviors_index; i++) {
-        behavior_config_t config = device_behaviors[i];
-        int compare_mac = memcmp(config.remote_mac, device_mac, sizeof(device_mac)) == 0;
-        if (!compare_mac || config.input_cmd != INPUT_ROTARY_CMD) continue;
+void behavior_process_gpio(input_gpio_t input_type, int8_t pin, uint16_t input_value) {
+    uint8_t prefix[BEHAVIOR_KEY_MAX_PREFIX] = { input_type, (uint8_t)pin };
+    behavior_lookup(INPUT_GPIO_CMD, prefix, behavior_output_gpio);
+}
 
-        printf("IM HERE 444\n");
-    }
+static void behavior_output_rotary(behavior_config_t* config) {
+    ESP_LOGD(TAG, "Rotary output %02X", config->output_data[0]);
+}
+
+void behavior_process_rotary(uint16_t value, bool direction) {
+    uint8_t prefix[BEHAVIOR_KEY_MAX_PREFIX] = { 0 };
+    behavior_lookup(INPUT_ROTARY_CMD, prefix, behavior_output_rotary);
 }
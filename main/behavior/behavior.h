@@ -59,7 +59,16 @@ typedef struct {
 
 // Function prototypes
 void behavior_setup(uint8_t* esp_mac, behavior_output_interface interface);
+bool behavior_add_config(const behavior_config_t* config);
+bool behavior_compile(void);
+bool behavior_load_binary(const char* path);
+void behavior_clear(void);
+uint16_t behavior_get_count(void);
+const behavior_config_t* behavior_get_config(uint16_t index);
 void behavior_process_gpio(input_gpio_t input_type, int8_t pin, uint16_t input_value);
 void behavior_process_rotary(uint16_t value, bool direction);
 
+//! littlefs_readLines callback, file_name is the remote MAC and every line one CSV rule
+void littlefs_readLine_handler(char* file_name, char* str_buff, size_t len);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+"""Stage flash_data for the LittleFS image and pack behavior rules into behaviors.bin.
+
+Every devices/<MAC>.text file holds CSV hex rows:
+    validation(0x33), input_cmd, input_data[16], output_cmd, output_data[16]
+The rows are packed into one binary file that mirrors behavior_config_t so the
+device can load all rules with a single read (see behavior_load_binary).
+
+Layout (little-endian):
+    header  : magic u32 | version u16 | record_size u16 | count u16 | reserved u16 | crc32 u32
+    records : count * behavior_config_t (remote_mac[6], input_cmd, input_data[16], output_cmd, output_data[16])
+"""
+
+import os
+import shutil
+import struct
+import sys
+import zlib
+
+BEHAVIOR_BIN_MAGIC = 0x31564842         # "BHV1"
+BEHAVIOR_BIN_VERSION = 1
+BEHAVIOR_RECORD_SIZE = 40
+BEHAVIOR_VALIDATION_CODE = 0x33
+OUTPUT_VALIDATION_CODE = 0xA0
+INPUT_COMMANDS = (0x10, 0x20, 0x30, 0x40)
+
+
+def parse_mac(file_name):
+    stem = os.path.splitext(file_name)[0]
+    parts = stem.split('-')
+    if len(parts) != 6:
+        return None
+    try:
+        return bytes(int(p, 16) for p in parts)
+    except ValueError:
+        return None
+
+
+def parse_hex_tokens(line):
+    """Same rules as parse_hex_string in behavior.c: the leading hex digits of
+    every comma separated token, anything after them ignored, empty tokens dropped."""
+    data = bytearray()
+    for tok in line.split(','):
+        tok = tok.lstrip()
+        digits = len(tok) - len(tok.lstrip('0123456789abcdefABCDEF'))
+        if digits:
+            data.append(int(tok[:digits], 16) & 0xFF)
+    return bytes(data)
+
+
+def parse_rows(path, mac):
+    records = []
+    with open(path, 'r') as f:
+        for line_no, line in enumerate(f, 1):
+            line = line.strip()
+            if not line:
+                continue
+
+            data = parse_hex_tokens(line)
+            if len(data) < BEHAVIOR_RECORD_SIZE - 6 + 1 or data[0] != BEHAVIOR_VALIDATION_CODE:
+                print(f'{path}:{line_no}: invalid behavior row, skipped')
+                continue
+
+            config = data[1:BEHAVIOR_RECORD_SIZE - 6 + 1]
+            if config[0] not in INPUT_COMMANDS or config[17] != OUTPUT_VALIDATION_CODE:
+                print(f'{path}:{line_no}: invalid input/output command, skipped')
+                continue
+
+            records.append(mac + config)
+    return records
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(f'usage: {sys.argv[0]} <flash_data dir> <staging dir>')
+        return 1
+
+    src_dir, out_dir = sys.argv[1], sys.argv[2]
+    shutil.rmtree(out_dir, ignore_errors=True)
+    shutil.copytree(src_dir, out_dir)
+
+    records = []
+    devices_dir = os.path.join(src_dir, 'devices')
+    if os.path.isdir(devices_dir):
+        for file_name in sorted(os.listdir(devices_dir)):
+            mac = parse_mac(file_name)
+            if mac is None:
+                continue
+            records += parse_rows(os.path.join(devices_dir, file_name), mac)
+
+    body = b''.join(records)
+    header = struct.pack('<IHHHHI', BEHAVIOR_BIN_MAGIC, BEHAVIOR_BIN_VERSION,
+                         BEHAVIOR_RECORD_SIZE, len(records), 0, zlib.crc32(body))
+
+    with open(os.path.join(out_dir, 'behaviors.bin'), 'wb') as f:
+        f.write(header + body)
+
+    print(f'behaviors.bin: {len(records)} rules')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
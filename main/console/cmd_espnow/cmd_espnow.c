@@ -7,6 +7,8 @@
 #include "argtable3/argtable3.h"
 
 #include "mod_espnow.h"
+#include "espnow_mesh.h"
+#include "secure_session.h"
 
 static const char *TAG = "CMD_ESPNOW";
 
@@ -16,6 +18,14 @@ static struct {
     struct arg_end *end;
 } msg_args;
 
+static struct {
+    struct arg_str *peer;
+    struct arg_str *key;
+    struct arg_int *key_id;
+    struct arg_lit *rotate;
+    struct arg_end *end;
+} key_args;
+
 
 static int check_arg(int argc, char **argv, void **argtable, struct arg_end *end) {
     int nerrors = arg_parse(argc, argv, argtable);
@@ -43,13 +53,13 @@ static int handle_espnow_send(int argc, char **argv) {
     espnow_message_t message = {
         .access_code = 33,
         .group_id = 11,
-        .msg_id = 12,
         .time_to_live = 15,
     };
 
     memcpy(message.target_addr, dest_mac, sizeof(message.target_addr));
-    memcpy(message.data, data, sizeof(message.data));
-    espnow_send((uint8_t*)&message, sizeof(message));
+    memcpy(message.data, data, sizeof(data));
+    message.data_len = sizeof(data);
+    espnow_mesh_send(&message);
 
     // nvs_type_t type = str_to_type(str_type);
     // esp_err_t err = ESP_FAIL;
@@ -58,6 +68,48 @@ static int handle_espnow_send(int argc, char **argv) {
     return 0;
 }
 
+//! "group" is the key stored under the broadcast MAC
+static bool parse_peer(const char *str, uint8_t *mac) {
+    if (strcmp(str, "group") == 0) {
+        memset(mac, 0xFF, 6);
+        return true;
+    }
+    return sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx", &mac[0], &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) == 6;
+}
+
+static bool parse_key(const char *str, uint8_t *key) {
+    if (strlen(str) != SECURE_SESSION_KEY_LEN * 2) return false;
+
+    for (int i = 0; i < SECURE_SESSION_KEY_LEN; i++) {
+        if (sscanf(str + i * 2, "%2hhx", &key[i]) != 1) return false;
+    }
+    return true;
+}
+
+static int handle_espnow_key(int argc, char **argv) {
+    if (check_arg(argc, argv, (void**) &key_args, key_args.end) != 0) return 1;
+
+    uint8_t mac[6], key[SECURE_SESSION_KEY_LEN];
+    if (!parse_peer(key_args.peer->sval[0], mac)) {
+        ESP_LOGE(TAG, "peer must be aa:bb:cc:dd:ee:ff or group");
+        return 1;
+    }
+    if (!parse_key(key_args.key->sval[0], key)) {
+        ESP_LOGE(TAG, "key must be %d hex characters", SECURE_SESSION_KEY_LEN * 2);
+        return 1;
+    }
+
+    esp_err_t err;
+    if (key_args.rotate->count) {
+        err = secure_session_rotate_key(mac, key);
+    } else {
+        uint8_t key_id = key_args.key_id->count ? key_args.key_id->ival[0] : 0;
+        err = secure_session_set_key(mac, key_id, key);
+    }
+    memset(key, 0, sizeof(key));
+    return check_esp_ok(err);
+}
+
 
 void cmd_espnow_setup(void) {
     msg_args.key = arg_str1(NULL, NULL, "<key>", "key of the value to be set");
@@ -77,4 +129,23 @@ void cmd_espnow_setup(void) {
     };
 
     ESP_ERROR_CHECK( esp_console_cmd_register(&esp_send_cmd) );
+
+    key_args.peer = arg_str1(NULL, NULL, "<peer>", "peer MAC, or group for broadcasts");
+    key_args.key = arg_str1(NULL, NULL, "<key>", "AES-128 key as 32 hex characters");
+    key_args.key_id = arg_int0("i", "id", "<0-255>", "key id carried in the frames, default 0");
+    key_args.rotate = arg_lit0("r", "rotate", "keep the current key for opening, the new one gets its id + 1");
+    key_args.end = arg_end(4);
+
+    const esp_console_cmd_t esp_key_cmd = {
+        .command = "enow_key",
+        .help = "Store the ESP-NOW session key of a peer or the group.\n"
+        "Examples:\n"
+        " enow_key group 000102030405060708090a0b0c0d0e0f -i 1 \n"
+        " enow_key 24:6f:28:01:02:03 f0e0d0c0b0a090807060504030201000 -r \n",
+        .hint = NULL,
+        .func = &handle_espnow_key,
+        .argtable = &key_args
+    };
+
+    ESP_ERROR_CHECK( esp_console_cmd_register(&esp_key_cmd) );
 }
\ No newline at end of file
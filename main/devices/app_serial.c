@@ -6,11 +6,17 @@
 #include "ssd1306_plot.h"
 #include "ssd1306_segment.h"
 #include "ssd1306_bitmap.h"
+#include "telemetry.h"
 
 static const char *TAG = "APP_SERIAL";
 
 #define MAX_PRINT_MODE 4
 #define MAX_PRINT_QUEUE 15
+#define TELEMETRY_INTERVAL_US 1000000
+#define TELEMETRY_MAX_SAMPLES 8             // per channel and frame, sensors report every 200 ms
+
+// every sample as a 5 byte varint, the worst case
+#define TELEMETRY_FRAME_SIZE (TELEMETRY_HEADER_LEN + TELEMETRY_CH_COUNT * (2 + TELEMETRY_MAX_SAMPLES * 5))
 
 typedef struct {
     char text[32];
@@ -26,6 +32,52 @@ bool has_set1 = false;
 int8_t ssd1306_print_mode = 1;
 char display_buff[64];
 
+static app_serial_telemetry_cb telemetry_cb;
+static app_serial_reading_cb reading_cb;
+static int32_t telemetry_samples[TELEMETRY_CH_COUNT][TELEMETRY_MAX_SAMPLES];
+static uint8_t telemetry_counts[TELEMETRY_CH_COUNT];        // samples since the last frame
+static uint8_t telemetry_buff[TELEMETRY_FRAME_SIZE];
+static uint16_t telemetry_seq;
+static uint64_t telemetry_timeRef;
+
+void app_serial_set_telemetry_cb(app_serial_telemetry_cb callback) {
+    telemetry_cb = callback;
+}
+
+void app_serial_set_reading_cb(app_serial_reading_cb callback) {
+    reading_cb = callback;
+}
+
+//! every reading since the last frame is sent, consecutive readings go out as deltas
+static void telemetry_record(telemetry_channel_t channel, int32_t value) {
+    if (reading_cb) reading_cb(channel, value);
+
+    uint8_t count = telemetry_counts[channel];
+    if (count == TELEMETRY_MAX_SAMPLES) count--;           // late frame, keep the newest
+    telemetry_samples[channel][count] = value;
+    telemetry_counts[channel] = count + 1;
+}
+
+static void telemetry_task(uint64_t current_time) {
+    if (telemetry_cb == NULL) return;
+    if (current_time - telemetry_timeRef < TELEMETRY_INTERVAL_US) return;
+    telemetry_timeRef = current_time;
+
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, telemetry_buff, sizeof(telemetry_buff), telemetry_seq, current_time / 1000);
+
+    for (int ch = 0; ch < TELEMETRY_CH_COUNT; ch++) {
+        if (telemetry_counts[ch] == 0) continue;
+        telemetry_add_channel(&frame, ch, telemetry_samples[ch], telemetry_counts[ch]);
+        telemetry_counts[ch] = 0;
+    }
+    if (frame.channel_count == 0) return;
+
+    size_t len = telemetry_frame_end(&frame);
+    if (len > 0) telemetry_cb(telemetry_buff, len);
+    telemetry_seq++;
+}
+
 void app_serial_setMode(uint8_t direction) {
     ssd1306_print_mode += direction;
 
@@ -56,37 +108,54 @@ void app_serial_add_print(const char* buff, uint8_t line) {
 }
 
 static void on_resolve_bh1750(float lux) {
+    telemetry_record(TELEMETRY_CH_LUX, lux * 100);
     snprintf(display_buff, sizeof(display_buff), "BH1750 %.2f", lux);
     app_serial_add_print(display_buff, 2);
 }
 
 static void on_resolve_ap3216(uint16_t ps, uint16_t als) {
+    telemetry_record(TELEMETRY_CH_PROXIMITY, ps);
+    telemetry_record(TELEMETRY_CH_ALS, als);
     snprintf(display_buff, sizeof(display_buff), "prox %u, als %u", ps, als);
     app_serial_add_print(display_buff, 5);
 }
 
 static void on_resolve_apds9960(uint8_t prox, uint16_t clear,
     uint16_t red, uint16_t green, uint16_t blue) {
+    telemetry_record(TELEMETRY_CH_PROXIMITY, prox);
+    telemetry_record(TELEMETRY_CH_CLEAR, clear);
+    telemetry_record(TELEMETRY_CH_RED, red);
+    telemetry_record(TELEMETRY_CH_GREEN, green);
+    telemetry_record(TELEMETRY_CH_BLUE, blue);
     snprintf(display_buff, sizeof(display_buff), "ps %u, w %u, r %u, g %u, b %u", prox, clear, red, green, blue);
     app_serial_add_print(display_buff, 6);
 }
 
 static void on_resolve_max4400(float lux) {
+    telemetry_record(TELEMETRY_CH_LUX, lux * 100);
     snprintf(display_buff, sizeof(display_buff), "lux %.2f", lux);
     // app_serial_add_print(display_buff, 7);
 }
 
 static void on_resolve_vl53lox(uint8_t distance) {
+    telemetry_record(TELEMETRY_CH_DISTANCE, distance);
     snprintf(display_buff, sizeof(display_buff), "dist: %u", distance);
     // app_serial_add_print(display_buff, 7);
 }
 
 static void on_resolve_mpu6050(int16_t accel_x, int16_t accel_y, int16_t accel_z) {
+    telemetry_record(TELEMETRY_CH_ACCEL_X, accel_x);
+    telemetry_record(TELEMETRY_CH_ACCEL_Y, accel_y);
+    telemetry_record(TELEMETRY_CH_ACCEL_Z, accel_z);
     snprintf(display_buff, sizeof(display_buff), "x %u, y %u, z %u", accel_x, accel_y, accel_z);
     app_serial_add_print(display_buff, 4);
 }
 
 static void on_resolve_ina219(int16_t shunt, int16_t bus_mV, int16_t current, int16_t power) {
+    telemetry_record(TELEMETRY_CH_SHUNT, shunt);
+    telemetry_record(TELEMETRY_CH_BUS_MV, bus_mV);
+    telemetry_record(TELEMETRY_CH_CURRENT, current);
+    telemetry_record(TELEMETRY_CH_POWER, power);
     snprintf(display_buff, sizeof(display_buff),"sh %hu, bus %hu, cur %hd, p %hu", 
                 shunt, bus_mV, current, power);
                 app_serial_add_print(display_buff, 7);
@@ -100,6 +169,8 @@ static void on_resolve_ds3231(ds3231_dateTime_t *datetime) {
 }
 
 static void on_resolve_sht31(float temp, float hum) {
+    telemetry_record(TELEMETRY_CH_TEMP, temp * 100);
+    telemetry_record(TELEMETRY_CH_HUMIDITY, hum * 100);
     snprintf(display_buff, sizeof(display_buff), "Temp %.2f, hum %.2f", temp, hum);
     app_serial_add_print(display_buff, 3);
 }
@@ -167,4 +238,6 @@ void app_serial_i2c_task(uint64_t current_time) {
     if (has_set1) {
         handle_task(current_time, &devices_set1);
     }
+
+    telemetry_task(current_time);
 }
\ No newline at end of file
@@ -4,9 +4,39 @@
 
 #include "i2c/sensors.h"
 
+//! telemetry channel ids, floats are sent as fixed point x100
+typedef enum {
+    TELEMETRY_CH_LUX = 1,
+    TELEMETRY_CH_PROXIMITY,
+    TELEMETRY_CH_ALS,
+    TELEMETRY_CH_CLEAR,
+    TELEMETRY_CH_RED,
+    TELEMETRY_CH_GREEN,
+    TELEMETRY_CH_BLUE,
+    TELEMETRY_CH_DISTANCE,
+    TELEMETRY_CH_ACCEL_X,
+    TELEMETRY_CH_ACCEL_Y,
+    TELEMETRY_CH_ACCEL_Z,
+    TELEMETRY_CH_SHUNT,
+    TELEMETRY_CH_BUS_MV,
+    TELEMETRY_CH_CURRENT,
+    TELEMETRY_CH_POWER,
+    TELEMETRY_CH_TEMP,
+    TELEMETRY_CH_HUMIDITY,
+    TELEMETRY_CH_COUNT
+} telemetry_channel_t;
+
+// receives encoded telemetry frames (see telemetry.h), e.g. to broadcast over WebSocket
+typedef void (*app_serial_telemetry_cb)(const uint8_t* data, size_t len);
+
+// receives every reading as its sensor resolves, channel is a telemetry_channel_t
+typedef void (*app_serial_reading_cb)(uint8_t channel, int32_t value);
+
 
 void app_serial_setMode(uint8_t direction);
 void app_serial_i2c_setup(uint8_t scl_pin, uint8_t sda_pin, uint8_t port);
 
 void app_serial_add_print(const char* buff, uint8_t line);
-void app_serial_i2c_task(uint64_t current_time);
\ No newline at end of file
+void app_serial_i2c_task(uint64_t current_time);
+void app_serial_set_telemetry_cb(app_serial_telemetry_cb callback);
+void app_serial_set_reading_cb(app_serial_reading_cb callback);
\ No newline at end of file
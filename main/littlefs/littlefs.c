@@ -7,8 +7,10 @@
 #include "esp_err.h"
 #include "esp_littlefs.h"
 #include <dirent.h>
+#include <fcntl.h>
 
-#define MAX_FILE_CONTENT_SIZE 128
+//! matches the LittleFS block size so every read covers whole blocks
+#define LITTLEFS_READ_CHUNK 4096
 
 static const char *TAG = "LITTLEFS";
 
@@ -49,30 +51,72 @@ void littlefs_setup() {
     }
 }
 
-static void read_file_content(const char* path, char* file_name, littlefs_readfile_cb callback) {
-    // Construct the full file path
-    char file_path[512];
-    snprintf(file_path, sizeof(file_path), "%s/%s", path, file_name);
-    ESP_LOGI("TAG", "Read file: %s", file_path);
+//! read the file in block sized chunks and hand out every line in place
+//! lines are NUL terminated inside the buffer, a line crossing a chunk boundary is
+//! moved to the front and the buffer grows when a single line exceeds it
+void littlefs_readLines(const char* file_path, char* file_name, littlefs_readfile_cb callback) {
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "Failed to open file: %s", file_path);
+        return;
+    }
 
-    FILE* file = fopen(file_path, "r");
-    if (file == NULL) {
-        ESP_LOGE("TAG", "Failed to open file: %s", file_path);
+    size_t capacity = LITTLEFS_READ_CHUNK + 1;
+    char* buff = malloc(capacity);
+    if (buff == NULL) {
+        close(fd);
         return;
     }
 
-    char buff[MAX_FILE_CONTENT_SIZE] = { 0 };
+    size_t carry = 0;           // bytes of an unfinished line at the front of buff
+    ssize_t read_len;
+
+    do {
+        // always request a full chunk so file reads stay block aligned
+        if (carry + LITTLEFS_READ_CHUNK + 1 > capacity) {
+            size_t new_capacity = capacity * 2;
+            char* new_buff = realloc(buff, new_capacity);
+            if (new_buff == NULL) {
+                ESP_LOGE(TAG, "Line too long: %s", file_path);
+                break;
+            }
+            buff = new_buff;
+            capacity = new_capacity;
+        }
+
+        read_len = read(fd, buff + carry, LITTLEFS_READ_CHUNK);
+        if (read_len < 0) {
+            ESP_LOGE(TAG, "Failed to read file: %s", file_path);
+            break;
+        }
+
+        size_t end = carry + read_len;
+        size_t start = 0;
+
+        for (size_t i = carry; i < end; i++) {
+            if (buff[i] != '\n') continue;
 
-    // Read the file line by line
-    while (fgets(buff, sizeof(buff), file) != NULL) {
-        printf("\nline content: \n");
-        printf("%s\n", buff); // Print each line of the file
-        callback(file_name, buff, strlen(buff));
+            size_t len = i - start;
+            if (len > 0 && buff[start + len - 1] == '\r') len--;
+            buff[start + len] = '\0';
+            if (len > 0) callback(file_name, buff + start, len);
+            start = i + 1;
+        }
+
+        carry = end - start;
+        if (carry > 0 && start > 0) memmove(buff, buff + start, carry);
+    } while (read_len > 0);
+
+    // last line without a trailing newline
+    if (carry > 0 && read_len == 0) {
+        if (buff[carry - 1] == '\r') carry--;
+        buff[carry] = '\0';
+        if (carry > 0) callback(file_name, buff, carry);
     }
-    
-    fclose(file);
-}
 
+    free(buff);
+    close(fd);
+}
 
 void littlefs_loadFiles(const char* path, littlefs_readfile_cb callback) {
     // Open the directory
@@ -87,7 +131,10 @@ void littlefs_loadFiles(const char* path, littlefs_readfile_cb callback) {
     while ((entry = readdir(dir)) != NULL) {
         // Skip directories
         if (entry->d_type == DT_DIR) continue;
-        read_file_content(path, entry->d_name, callback);
+
+        char file_path[512];
+        snprintf(file_path, sizeof(file_path), "%s/%s", path, entry->d_name);
+        littlefs_readLines(file_path, entry->d_name, callback);
     }
 
     // Close the directory
@@ -146,4 +193,4 @@ void littlefs_test() {
     // All done, unmount partition and disable LittleFS
     esp_vfs_littlefs_unregister(conf.partition_label);
     ESP_LOGI(TAG, "LittleFS unmounted");
-}
\ No newline at end of file
+}
@@ -11,5 +11,6 @@ typedef void (*littlefs_readfile_cb)(char* file_name, char* buff, size_t len);
 void littlefs_setup(void);
 void littlefs_test(void);
 void littlefs_loadFiles(const char* path, littlefs_readfile_cb callback);
+void littlefs_readLines(const char* file_path, char* file_name, littlefs_readfile_cb callback);
 
 #endif
\ No newline at end of file
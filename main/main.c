@@ -22,6 +22,14 @@
     #include "http/http.h"
 #endif
 
+#define LORA_BRIDGE_ENABLED 0       //! relays ESP-NOW groups over LoRa, needs WIFI_ENABLED
+
+#if LORA_BRIDGE_ENABLED
+    #include "esp_mac.h"
+    #include "sx127x/lora_bridge.h"
+    #include "espnow_mesh.h"
+#endif
+
 static const char *MTAG = "MAIN";
 static uint8_t esp_mac[6];
 
@@ -112,6 +120,11 @@ void app_main(void) {
     ESP_LOGI(MTAG, "APP START");
 
 
+    #if WIFI_ENABLED
+        app_serial_set_telemetry_cb(app_network_push_telemetry);
+        app_serial_set_reading_cb(app_network_push_reading);
+    #endif
+
     app_serial_i2c_setup(SCL_PIN, SDA_PIN, 0);
     app_serial_i2c_setup(SCL_PIN2, SDA_PIN2, 1);
     
@@ -119,9 +132,10 @@ void app_main(void) {
     //     app_network_setup();
 
     //     http_setup(&(http_interface_t){
-    //         .on_file_fopen_cb   = mod_sd_fopen,
-    //         .on_file_fread_cb   = mod_sd_fread,
-    //         .on_file_fclose_cb  = mod_sd_fclose,
+    //         .on_file_open_cb    = mod_sd_open,
+    //         .on_file_read_cb    = mod_sd_read,
+    //         .on_file_seek_cb    = mod_sd_seek,
+    //         .on_file_close_cb   = mod_sd_close,
     //         .on_display_print   = display_print_str,
     //         .on_request_data    = http_request_handler
     //     });
@@ -184,6 +198,12 @@ void app_main(void) {
 
         // mod_sx127_listen(&spi_config_b);
         // mod_sx127_send(&spi_config_b);
+
+        #if LORA_BRIDGE_ENABLED
+            esp_read_mac(esp_mac, ESP_MAC_WIFI_STA);
+            lora_bridge_setup(&spi_config_b, esp_mac);
+            lora_bridge_add_group(ESPNOW_GROUP_ALL, LORA_BRIDGE_PRIO_NORMAL);
+        #endif
     }
 
 
@@ -261,6 +281,10 @@ void app_main(void) {
         #if WIFI_ENABLED
             app_network_task(current_time);
         #endif
+
+        #if LORA_BRIDGE_ENABLED
+            lora_bridge_task(current_time);
+        #endif
         
         #if CONFIG_IDF_TARGET_ESP32C3
             // cdc_read_task();
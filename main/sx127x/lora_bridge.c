@@ -0,0 +1,379 @@
+#include "lora_bridge.h"
+#include "mod_sx127x.h"
+#include "espnow_mesh.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+
+static const char *TAG = "LORA-BRIDGE";
+
+static const uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef struct __attribute__((packed)) {
+    uint16_t bridge_id;             // last two bytes of the sending bridge's MAC
+    uint8_t packet_id;
+    uint8_t fragment;               // index << 4 | count
+} fragment_header_t;
+
+_Static_assert(sizeof(fragment_header_t) == LORA_BRIDGE_HEADER_SIZE, "fragment header size");
+
+typedef struct {
+    bool used;
+    uint8_t priority;
+    uint8_t packet_id;
+    uint8_t next_fragment;
+    uint8_t fragment_count;
+    uint8_t len;
+    uint64_t queued_time;
+    uint8_t frame[ESPNOW_MAX_FRAME_LEN];
+} tx_packet_t;
+
+typedef struct {
+    bool used;
+    uint16_t bridge_id;
+    uint8_t packet_id;
+    uint8_t fragment_count;
+    uint16_t received_mask;
+    uint16_t len;
+    uint64_t started;
+    uint8_t frame[ESPNOW_MAX_FRAME_LEN];
+} rx_packet_t;
+
+typedef struct {
+    uint8_t origin_addr[6];
+    uint8_t msg_id;
+    uint32_t last_used;             // 0 marks a free entry
+} dedup_entry_t;
+
+//! everything runs in the main loop: the ESP-NOW tap from espnow_task(),
+//! the radio callbacks from mod_sx127_radio_poll(), so no locking
+
+static uint16_t bridge_id;
+static uint8_t next_packet_id;
+static uint32_t groups[256 / 32];               // bridged groups bitmap
+static uint8_t group_priority[256];
+
+static tx_packet_t tx_queue[LORA_BRIDGE_QUEUE_SIZE];
+static tx_packet_t *tx_current;                 // fragments of one packet go out back to back
+static rx_packet_t rx_slots[LORA_BRIDGE_REASSEMBLY_SLOTS];
+
+static dedup_entry_t dedup_cache[LORA_BRIDGE_DEDUP_SIZE];
+static uint32_t dedup_clock;
+
+static uint64_t budget_us = LORA_BRIDGE_BUDGET_MAX_US;
+static uint64_t budget_time;
+
+static lora_bridge_stats_t bridge_stats;
+
+
+//! DEDUP
+// returns true when (origin, msg_id) already crossed the bridge, records it otherwise
+
+static bool dedup_check(const uint8_t *origin_addr, uint8_t msg_id) {
+    dedup_entry_t *oldest = &dedup_cache[0];
+    dedup_clock++;
+
+    for (int i = 0; i < LORA_BRIDGE_DEDUP_SIZE; i++) {
+        dedup_entry_t *entry = &dedup_cache[i];
+
+        if (entry->last_used && entry->msg_id == msg_id &&
+            memcmp(entry->origin_addr, origin_addr, sizeof(entry->origin_addr)) == 0) {
+            entry->last_used = dedup_clock;
+            return true;
+        }
+
+        if (entry->last_used < oldest->last_used) oldest = entry;
+    }
+
+    memcpy(oldest->origin_addr, origin_addr, sizeof(oldest->origin_addr));
+    oldest->msg_id = msg_id;
+    oldest->last_used = dedup_clock;
+    return false;
+}
+
+
+//! GROUPS
+
+static bool group_bridged(uint8_t group_id) {
+    return groups[group_id >> 5] & (1u << (group_id & 31));
+}
+
+void lora_bridge_add_group(uint8_t group_id, lora_bridge_prio_t priority) {
+    groups[group_id >> 5] |= 1u << (group_id & 31);
+    group_priority[group_id] = MIN(priority, LORA_BRIDGE_PRIO_COUNT - 1);
+    espnow_mesh_join_group(group_id);
+}
+
+void lora_bridge_remove_group(uint8_t group_id) {
+    groups[group_id >> 5] &= ~(1u << (group_id & 31));
+}
+
+
+//! ESP-NOW -> LORA
+
+// frees room for a new packet: a free slot, else the oldest of the lowest priority below ours
+static tx_packet_t *tx_alloc(uint8_t priority) {
+    tx_packet_t *victim = NULL;
+
+    for (int i = 0; i < LORA_BRIDGE_QUEUE_SIZE; i++) {
+        tx_packet_t *packet = &tx_queue[i];
+        if (!packet->used) return packet;
+        if (packet == tx_current || packet->priority >= priority) continue;
+
+        if (victim == NULL || packet->priority < victim->priority ||
+            (packet->priority == victim->priority && packet->queued_time < victim->queued_time)) {
+            victim = packet;
+        }
+    }
+    return victim;
+}
+
+static void espnow_tap(espnow_received_message_t received) {
+    const espnow_message_t *message = received.message;
+
+    if (!group_bridged(message->group_id)) return;
+    if (memcmp(message->target_addr, broadcast_mac, sizeof(broadcast_mac)) != 0) return;
+
+    //! the far side rebroadcasts with time_to_live - 1, nothing left to spend
+    if (message->time_to_live <= 1) return;
+
+    if (dedup_check(message->origin_addr, message->msg_id)) {
+        bridge_stats.duplicates++;
+        return;
+    }
+
+    uint8_t priority = group_priority[message->group_id];
+    tx_packet_t *packet = tx_alloc(priority);
+    if (packet == NULL) {
+        bridge_stats.queue_dropped++;
+        return;
+    }
+    if (packet->used) bridge_stats.queue_dropped++;
+
+    size_t len = espnow_message_size(message);
+    *packet = (tx_packet_t){
+        .used = true,
+        .priority = priority,
+        .packet_id = next_packet_id++,
+        .fragment_count = (len + LORA_BRIDGE_FRAGMENT_DATA - 1) / LORA_BRIDGE_FRAGMENT_DATA,
+        .len = len,
+        .queued_time = esp_timer_get_time(),
+    };
+    memcpy(packet->frame, message, len);
+    bridge_stats.to_lora++;
+}
+
+static tx_packet_t *tx_next(void) {
+    if (tx_current) return tx_current;
+
+    tx_packet_t *next = NULL;
+    for (int i = 0; i < LORA_BRIDGE_QUEUE_SIZE; i++) {
+        tx_packet_t *packet = &tx_queue[i];
+        if (!packet->used) continue;
+
+        if (next == NULL || packet->priority > next->priority ||
+            (packet->priority == next->priority && packet->queued_time < next->queued_time)) {
+            next = packet;
+        }
+    }
+    return next;
+}
+
+static void refill_budget(uint64_t current_time) {
+    budget_us += (current_time - budget_time) * LORA_BRIDGE_DUTY_PERMILLE / 1000;
+    budget_us = MIN(budget_us, LORA_BRIDGE_BUDGET_MAX_US);
+    budget_time = current_time;
+}
+
+static void send_fragment(uint64_t current_time) {
+    if (mod_sx127_radio_busy()) return;
+
+    tx_packet_t *packet = tx_next();
+    if (packet == NULL) return;
+
+    uint8_t index = packet->next_fragment;
+    size_t offset = index * LORA_BRIDGE_FRAGMENT_DATA;
+    size_t data_len = MIN(packet->len - offset, (size_t)LORA_BRIDGE_FRAGMENT_DATA);
+
+    uint8_t buff[LORA_BRIDGE_MTU];
+    fragment_header_t *header = (fragment_header_t *)buff;
+    header->bridge_id = bridge_id;
+    header->packet_id = packet->packet_id;
+    header->fragment = index << 4 | packet->fragment_count;
+    memcpy(buff + LORA_BRIDGE_HEADER_SIZE, packet->frame + offset, data_len);
+
+    size_t len = LORA_BRIDGE_HEADER_SIZE + data_len;
+    uint32_t airtime = mod_sx127_time_on_air_us(len);
+    if (budget_us < airtime) {
+        bridge_stats.budget_waits++;
+        return;
+    }
+
+    if (mod_sx127_radio_send(buff, len) != ESP_OK) {
+        ESP_LOGW(TAG, "radio send failed");
+        return;
+    }
+
+    budget_us -= airtime;
+    bridge_stats.fragments_sent++;
+    bridge_stats.tx_bytes += len;
+    bridge_stats.airtime_us += airtime;
+
+    packet->next_fragment++;
+    if (packet->next_fragment < packet->fragment_count) {
+        tx_current = packet;
+        return;
+    }
+
+    uint32_t latency = current_time - packet->queued_time;
+    bridge_stats.sent++;
+    bridge_stats.total_latency_us += latency;
+    bridge_stats.max_latency_us = MAX(bridge_stats.max_latency_us, latency);
+    packet->used = false;
+    tx_current = NULL;
+}
+
+//! a packet that waited out the budget isn't worth the airtime anymore,
+//! one already partly on air is finished so the far side doesn't hold a slot for nothing
+static void expire_packets(uint64_t current_time) {
+    for (int i = 0; i < LORA_BRIDGE_QUEUE_SIZE; i++) {
+        tx_packet_t *packet = &tx_queue[i];
+        if (!packet->used || packet == tx_current) continue;
+        if (current_time - packet->queued_time < LORA_BRIDGE_MAX_AGE_US) continue;
+
+        packet->used = false;
+        bridge_stats.expired++;
+    }
+}
+
+
+//! LORA -> ESP-NOW
+
+static rx_packet_t *rx_slot(uint16_t id, uint8_t packet_id, uint8_t count, uint64_t current_time) {
+    rx_packet_t *slot = NULL;
+
+    for (int i = 0; i < LORA_BRIDGE_REASSEMBLY_SLOTS && slot == NULL; i++) {
+        rx_packet_t *entry = &rx_slots[i];
+        if (entry->used && entry->bridge_id == id && entry->packet_id == packet_id) slot = entry;
+    }
+
+    //! same id with another count: the sender wrapped around, start over
+    if (slot && slot->fragment_count == count) return slot;
+
+    if (slot == NULL) {
+        //! a free slot, else give up on the oldest reassembly
+        slot = &rx_slots[0];
+        for (int i = 0; i < LORA_BRIDGE_REASSEMBLY_SLOTS && slot->used; i++) {
+            rx_packet_t *entry = &rx_slots[i];
+            if (!entry->used || entry->started < slot->started) slot = entry;
+        }
+    }
+
+    if (slot->used) bridge_stats.reassembly_timeouts++;
+    *slot = (rx_packet_t){
+        .used = true,
+        .bridge_id = id,
+        .packet_id = packet_id,
+        .fragment_count = count,
+        .started = current_time,
+    };
+    return slot;
+}
+
+static void inject_frame(rx_packet_t *slot, uint64_t current_time) {
+    espnow_message_t message;
+    uint8_t data_len;
+
+    slot->used = false;
+    if (espnow_parse_message(slot->frame, slot->len, &message, &data_len) != ESP_OK) {
+        bridge_stats.malformed++;
+        return;
+    }
+
+    if (dedup_check(message.origin_addr, message.msg_id)) {
+        bridge_stats.duplicates++;
+        return;
+    }
+
+    //! the mesh hands it on, our own application doesn't see it
+    if (!espnow_mesh_inject(&message, current_time)) {
+        bridge_stats.inject_failed++;
+        return;
+    }
+    bridge_stats.from_lora++;
+}
+
+static void lora_rx(const uint8_t *data, uint16_t len, int16_t rssi) {
+    uint64_t current_time = esp_timer_get_time();
+    bridge_stats.rx_bytes += len;
+
+    if (len <= LORA_BRIDGE_HEADER_SIZE || len > LORA_BRIDGE_MTU) {
+        bridge_stats.malformed++;
+        return;
+    }
+
+    fragment_header_t header;
+    memcpy(&header, data, sizeof(header));
+    uint8_t index = header.fragment >> 4, count = header.fragment & 0x0F;
+    uint16_t data_len = len - LORA_BRIDGE_HEADER_SIZE;
+
+    if (header.bridge_id == bridge_id) return;
+
+    //! every fragment but the last is full, so the offset follows from the index
+    if (count == 0 || index >= count || index * LORA_BRIDGE_FRAGMENT_DATA + data_len > ESPNOW_MAX_FRAME_LEN ||
+        (index < count - 1 && data_len != LORA_BRIDGE_FRAGMENT_DATA)) {
+        bridge_stats.malformed++;
+        return;
+    }
+    bridge_stats.fragments_received++;
+
+    rx_packet_t *slot = rx_slot(header.bridge_id, header.packet_id, count, current_time);
+    if (slot->received_mask & (1u << index)) return;
+
+    memcpy(slot->frame + index * LORA_BRIDGE_FRAGMENT_DATA, data + LORA_BRIDGE_HEADER_SIZE, data_len);
+    slot->received_mask |= 1u << index;
+    if (index == count - 1) slot->len = index * LORA_BRIDGE_FRAGMENT_DATA + data_len;
+
+    if (slot->received_mask == (1u << count) - 1) inject_frame(slot, current_time);
+}
+
+static void expire_reassembly(uint64_t current_time) {
+    for (int i = 0; i < LORA_BRIDGE_REASSEMBLY_SLOTS; i++) {
+        rx_packet_t *slot = &rx_slots[i];
+        if (!slot->used || current_time - slot->started < LORA_BRIDGE_REASSEMBLY_TIMEOUT_US) continue;
+
+        slot->used = false;
+        bridge_stats.reassembly_timeouts++;
+    }
+}
+
+
+//! TASK
+
+void lora_bridge_setup(M_Spi_Conf *config, const uint8_t *self_mac) {
+    bridge_id = self_mac[4] << 8 | self_mac[5];
+    next_packet_id = esp_random();
+    budget_time = esp_timer_get_time();
+
+    mod_sx127_radio_setup(config, lora_rx);
+    espnow_set_tap(espnow_tap);
+
+    ESP_LOGI(TAG, "bridge %04X, mtu %d, duty %d permille", bridge_id, LORA_BRIDGE_MTU, LORA_BRIDGE_DUTY_PERMILLE);
+}
+
+void lora_bridge_task(uint64_t current_time) {
+    mod_sx127_radio_poll();
+
+    refill_budget(current_time);
+    expire_packets(current_time);
+    expire_reassembly(current_time);
+    send_fragment(current_time);
+}
+
+void lora_bridge_get_stats(lora_bridge_stats_t *stats) {
+    *stats = bridge_stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+#include "mod_spi.h"
+#include "mod_espnow.h"
+
+//# Relays selected ESP-NOW groups over LoRa and back. Broadcast frames of a
+//# bridged group are queued by priority and sent as fragments of
+//#     bridge_id u16 | packet_id u8 | index u4 count u4 | payload
+//# within an airtime budget that refills at the duty cycle. The far bridge
+//# reassembles the frame and rebroadcasts it into its mesh as one more hop.
+//# Frames pass through still sealed, so secure groups stay end to end.
+//# (origin_addr, msg_id) is remembered both ways, a frame never crosses twice.
+
+#ifndef LORA_BRIDGE_MTU
+#define LORA_BRIDGE_MTU 128                 // bytes per LoRa packet, 255 max
+#endif
+
+#ifndef LORA_BRIDGE_DUTY_PERMILLE
+#define LORA_BRIDGE_DUTY_PERMILLE 10        // 1% airtime
+#endif
+
+#ifndef LORA_BRIDGE_BUDGET_MAX_US
+#define LORA_BRIDGE_BUDGET_MAX_US 2000000   // longest burst after an idle period
+#endif
+
+#ifndef LORA_BRIDGE_QUEUE_SIZE
+#define LORA_BRIDGE_QUEUE_SIZE 8
+#endif
+
+#ifndef LORA_BRIDGE_MAX_AGE_US
+#define LORA_BRIDGE_MAX_AGE_US 30000000     // queued frames older than this are stale
+#endif
+
+#ifndef LORA_BRIDGE_REASSEMBLY_SLOTS
+#define LORA_BRIDGE_REASSEMBLY_SLOTS 4
+#endif
+
+#ifndef LORA_BRIDGE_REASSEMBLY_TIMEOUT_US
+#define LORA_BRIDGE_REASSEMBLY_TIMEOUT_US 5000000
+#endif
+
+#ifndef LORA_BRIDGE_DEDUP_SIZE
+#define LORA_BRIDGE_DEDUP_SIZE 32
+#endif
+
+#define LORA_BRIDGE_HEADER_SIZE 4
+#define LORA_BRIDGE_FRAGMENT_DATA (LORA_BRIDGE_MTU - LORA_BRIDGE_HEADER_SIZE)
+#define LORA_BRIDGE_MAX_FRAGMENTS 15
+
+_Static_assert(LORA_BRIDGE_MTU <= 255, "LoRa payload is at most 255 bytes");
+_Static_assert((ESPNOW_MAX_FRAME_LEN + LORA_BRIDGE_FRAGMENT_DATA - 1) / LORA_BRIDGE_FRAGMENT_DATA <= LORA_BRIDGE_MAX_FRAGMENTS,
+               "an ESP-NOW frame must fit in 15 fragments");
+
+typedef enum {
+    LORA_BRIDGE_PRIO_LOW,
+    LORA_BRIDGE_PRIO_NORMAL,
+    LORA_BRIDGE_PRIO_HIGH,
+    LORA_BRIDGE_PRIO_COUNT,
+} lora_bridge_prio_t;
+
+typedef struct {
+    uint32_t to_lora;               // ESP-NOW frames queued for LoRa
+    uint32_t from_lora;             // reassembled frames injected into the mesh
+    uint32_t sent;                  // frames fully on air
+    uint32_t fragments_sent;
+    uint32_t fragments_received;
+    uint32_t duplicates;
+    uint32_t queue_dropped;         // queue full, lost to a higher priority
+    uint32_t expired;               // waited longer than LORA_BRIDGE_MAX_AGE_US
+    uint32_t reassembly_timeouts;
+    uint32_t malformed;
+    uint32_t inject_failed;         // TTL spent or no forward slot
+    uint32_t budget_waits;          // task passes where a fragment waited for the duty cycle
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint64_t airtime_us;
+    uint64_t total_latency_us;      // queued to last fragment sent, divide by sent
+    uint32_t max_latency_us;
+} lora_bridge_stats_t;
+
+void lora_bridge_setup(M_Spi_Conf *config, const uint8_t *self_mac);
+
+//! joins the group on the mesh side and bridges its broadcasts
+void lora_bridge_add_group(uint8_t group_id, lora_bridge_prio_t priority);
+void lora_bridge_remove_group(uint8_t group_id);
+
+//! polls the radio, expires stale packets and sends the next fragment, call from the main loop
+void lora_bridge_task(uint64_t current_time);
+void lora_bridge_get_stats(lora_bridge_stats_t *stats);
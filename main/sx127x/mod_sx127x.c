@@ -15,6 +15,13 @@ static const char *TAG = "MOD_SX127";
 #define DIO0 13
 #define RST 17
 
+//! modem settings from setup_loRa, used for the time on air
+#define LORA_SF 7
+#define LORA_BW_HZ 125000
+#define LORA_PREAMBLE 8
+#define LORA_CR 1                   // 4/5
+#define LORA_TX_POWER_DBM 14
+
 sx127x device;
 
 void lora_rx_callback(sx127x *device, uint8_t *data, uint16_t data_length) {
@@ -154,4 +161,84 @@ void mod_sx127_send(M_Spi_Conf *config) {
         
         vTaskDelay(10 / portTICK_PERIOD_MS); // Yield to other tasks
     }
-}
\ No newline at end of file
+}
+
+
+//! RADIO
+//# Non-blocking variant for the LoRa bridge: stays in RX_CONT, switches to TX
+//# for one packet and back once DIO0 reports TxDone. Everything runs from
+//# mod_sx127_radio_poll() in the main loop, the callbacks too.
+
+static mod_sx127_rx_cb radio_rx_callback;
+static bool radio_busy;
+static uint64_t radio_tx_deadline;
+
+static void radio_rx(sx127x *device, uint8_t *data, uint16_t data_length) {
+    int16_t rssi = 0;
+    sx127x_rx_get_packet_rssi(device, &rssi);
+    if (radio_rx_callback) radio_rx_callback(data, data_length, rssi);
+}
+
+static void radio_tx_done(sx127x *device) {
+    radio_busy = false;
+    sx127x_set_opmod(SX127x_MODE_RX_CONT, SX127x_MODULATION_LORA, device);
+}
+
+void mod_sx127_radio_setup(M_Spi_Conf *config, mod_sx127_rx_cb callback) {
+    setup_loRa(config);
+    radio_rx_callback = callback;
+
+    ESP_ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_STANDBY, SX127x_MODULATION_LORA, &device));
+    ESP_ERROR_CHECK(sx127x_rx_set_lna_boost_hf(true, &device));
+    ESP_ERROR_CHECK(sx127x_rx_set_lna_gain(SX127x_LNA_GAIN_G4, &device));
+    ESP_ERROR_CHECK(sx127x_tx_set_pa_config(SX127x_PA_PIN_BOOST, LORA_TX_POWER_DBM, &device));
+
+    sx127x_tx_header_t header = {
+        .enable_crc = true,
+        .coding_rate = SX127x_CR_4_5};
+    ESP_ERROR_CHECK(sx127x_lora_tx_set_explicit_header(&header, &device));
+
+    sx127x_rx_set_callback(radio_rx, &device);
+    sx127x_tx_set_callback(radio_tx_done, &device);
+
+    ESP_ERROR_CHECK(sx127x_set_opmod(SX127x_MODE_RX_CONT, SX127x_MODULATION_LORA, &device));
+}
+
+void mod_sx127_radio_poll(void) {
+    if (gpio_get_level(DIO0)) sx127x_handle_interrupt(&device);
+
+    //! a missed TxDone would block the radio for good
+    if (radio_busy && esp_timer_get_time() > radio_tx_deadline) {
+        ESP_LOGW(TAG, "tx done missed, back to rx");
+        radio_tx_done(&device);
+    }
+}
+
+bool mod_sx127_radio_busy(void) {
+    return radio_busy;
+}
+
+esp_err_t mod_sx127_radio_send(const uint8_t *data, uint8_t len) {
+    if (radio_busy) return ESP_ERR_INVALID_STATE;
+
+    if (sx127x_lora_tx_set_for_transmission(data, len, &device) != SX127X_OK) return ESP_FAIL;
+    if (sx127x_set_opmod(SX127x_MODE_TX, SX127x_MODULATION_LORA, &device) != SX127X_OK) return ESP_FAIL;
+
+    radio_busy = true;
+    radio_tx_deadline = esp_timer_get_time() + 2 * mod_sx127_time_on_air_us(len) + 100000;
+    return ESP_OK;
+}
+
+// Semtech AN1200.13 with explicit header and CRC, low data rate optimize off below SF11
+uint32_t mod_sx127_time_on_air_us(uint8_t len) {
+    const uint32_t symbol_us = (1000000ULL << LORA_SF) / LORA_BW_HZ;
+    const int32_t de = LORA_SF >= 11 ? 1 : 0;
+
+    int32_t bits = 8 * len - 4 * LORA_SF + 28 + 16;
+    int32_t per_block = 4 * (LORA_SF - 2 * de);
+    int32_t blocks = bits > 0 ? (bits + per_block - 1) / per_block : 0;
+    uint32_t payload_symbols = 8 + blocks * (LORA_CR + 4);
+
+    //! preamble + 4.25 symbols, in quarter symbols
+    return ((LORA_PREAMBLE * 4 + 17) * symbol_us) / 4 + payload_symbols * symbol_us;
+}
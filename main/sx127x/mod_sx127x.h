@@ -1,7 +1,21 @@
 
+#pragma once
+
+#include <stdbool.h>
 #include "mod_spi.h"
 #include "driver/gpio.h"
 
 void mod_sx127_listen(M_Spi_Conf *config);
 
-void mod_sx127_send(M_Spi_Conf *config);
\ No newline at end of file
+void mod_sx127_send(M_Spi_Conf *config);
+
+//# non-blocking radio for the LoRa bridge, poll from the main loop
+typedef void (*mod_sx127_rx_cb)(const uint8_t *data, uint16_t len, int16_t rssi);
+
+void mod_sx127_radio_setup(M_Spi_Conf *config, mod_sx127_rx_cb callback);
+void mod_sx127_radio_poll(void);
+bool mod_sx127_radio_busy(void);
+
+//! returns ESP_ERR_INVALID_STATE while the previous packet is still on air
+esp_err_t mod_sx127_radio_send(const uint8_t *data, uint8_t len);
+uint32_t mod_sx127_time_on_air_us(uint8_t len);
@@ -0,0 +1,159 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "behavior/behavior.h"
+#include "littlefs/littlefs.h"
+
+//# Lookup cost against table size, hashed index vs the linear scan it
+//# replaced. Every device has one rule per pin, lookups cycle over all pins.
+//# Then boot time loading of 500 rules, CSV text vs the packed binary.
+
+#define LOOKUPS 200000
+
+static const uint8_t self_mac[6] = { 0x7C, 0x9E, 0xBD, 0x46, 0x46, 0x60 };
+static behavior_config_t rules[1000];
+static volatile uint32_t fired;
+
+static void on_toggle(uint8_t pin) {
+    fired++;
+}
+
+static void build_rules(int count) {
+    behavior_clear();
+    for (int i = 0; i < count; i++) {
+        behavior_config_t *config = &rules[i];
+        memset(config, 0, sizeof(*config));
+        memcpy(config->remote_mac, self_mac, 6);
+        config->remote_mac[5] += i / 32;                    // 32 pins per device, device 0 is us
+        config->input_cmd = INPUT_GPIO_CMD;
+        config->input_data[0] = INPUT_GPIO_1CLICK;
+        config->input_data[1] = i % 32;
+        config->output_cmd = 0xA0;
+        config->output_data[0] = OUTPUT_GPIO_TOGGLE;
+        behavior_add_config(config);
+    }
+}
+
+//! what the table did before the index, compare every rule
+static void linear_lookup(int count, uint8_t pin) {
+    for (int i = 0; i < count; i++) {
+        const behavior_config_t *config = &rules[i];
+        if (config->input_cmd == INPUT_GPIO_CMD && memcmp(config->remote_mac, self_mac, 6) == 0 &&
+            config->input_data[0] == INPUT_GPIO_1CLICK && config->input_data[1] == pin) {
+            on_toggle(config->output_data[0]);
+        }
+    }
+}
+
+#define LOAD_RULES 500
+#define LOAD_RUNS 50
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint16_t count;
+    uint16_t reserved;
+    uint32_t crc32;
+} bin_header_t;
+
+static uint32_t crc32_bitwise(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void bench_load(void) {
+    char dir[] = "/tmp/behavior_bench_XXXXXX";
+    if (mkdtemp(dir) == NULL) return;
+
+    char csv_path[256], bin_path[256];
+    snprintf(csv_path, sizeof(csv_path), "%s/7C-9E-BD-46-46-60.text", dir);
+    snprintf(bin_path, sizeof(bin_path), "%s.bin", dir);
+
+    behavior_config_t *records = calloc(LOAD_RULES, sizeof(behavior_config_t));
+    FILE *file = fopen(csv_path, "w");
+    for (int i = 0; i < LOAD_RULES; i++) {
+        behavior_config_t *config = &records[i];
+        memcpy(config->remote_mac, self_mac, 6);
+        config->input_cmd = INPUT_GPIO_CMD;
+        config->input_data[0] = INPUT_GPIO_1CLICK;
+        config->input_data[1] = i;
+        config->output_cmd = 0xA0;
+        for (int j = 0; j < 16; j++) config->output_data[j] = i + j;
+
+        fprintf(file, "33");
+        for (int j = 6; j < sizeof(behavior_config_t); j++) fprintf(file, ", %02X", ((uint8_t*)config)[j]);
+        fprintf(file, "\n");
+    }
+    fclose(file);
+
+    bin_header_t header = {
+        .magic = 0x31564842, .version = 1, .record_size = sizeof(behavior_config_t), .count = LOAD_RULES,
+        .crc32 = crc32_bitwise((uint8_t*)records, LOAD_RULES * sizeof(behavior_config_t)),
+    };
+    file = fopen(bin_path, "wb");
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(records, sizeof(behavior_config_t), LOAD_RULES, file);
+    fclose(file);
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < LOAD_RUNS; i++) {
+        behavior_clear();
+        littlefs_loadFiles(dir, littlefs_readLine_handler);
+        behavior_compile();
+    }
+    double csv_us = (double)(bench_now_ns() - start) / LOAD_RUNS / 1000;
+    uint16_t csv_count = behavior_get_count();
+
+    start = bench_now_ns();
+    for (int i = 0; i < LOAD_RUNS; i++) {
+        behavior_load_binary(bin_path);
+        behavior_compile();
+    }
+    double bin_us = (double)(bench_now_ns() - start) / LOAD_RUNS / 1000;
+
+    printf("\nload %d rules   csv %8.1f us (%u loaded)   binary %8.1f us (%u loaded)\n",
+           LOAD_RULES, csv_us, csv_count, bin_us, behavior_get_count());
+
+    unlink(bin_path);
+    unlink(csv_path);
+    rmdir(dir);
+    free(records);
+}
+
+int main(void) {
+    behavior_output_interface interface = { .on_gpio_toggle = on_toggle };
+    behavior_setup((uint8_t*)self_mac, interface);
+
+    const int sizes[] = { 10, 100, 1000 };
+    printf("%6s %12s %12s %12s\n", "rules", "compile ns", "index ns", "linear ns");
+
+    for (int s = 0; s < 3; s++) {
+        int count = sizes[s];
+        build_rules(count);
+
+        uint64_t start = bench_now_ns();
+        behavior_compile();
+        uint64_t compile_ns = bench_now_ns() - start;
+
+        start = bench_now_ns();
+        for (int i = 0; i < LOOKUPS; i++) behavior_process_gpio(INPUT_GPIO_1CLICK, i % 32, 0);
+        double index_ns = (double)(bench_now_ns() - start) / LOOKUPS;
+
+        start = bench_now_ns();
+        for (int i = 0; i < LOOKUPS; i++) linear_lookup(count, i % 32);
+        double linear_ns = (double)(bench_now_ns() - start) / LOOKUPS;
+
+        printf("%6d %12llu %12.1f %12.1f\n", count, (unsigned long long)compile_ns, index_ns, linear_ns);
+    }
+
+    bench_load();
+    behavior_clear();
+    return 0;
+}
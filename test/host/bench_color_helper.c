@@ -0,0 +1,74 @@
+#include <math.h>
+#include <string.h>
+
+#include "test.h"
+#include "color_helper.h"
+
+//# One frame of the wave and the colour wheel effects at 9, 144 and 1000
+//# LEDs, the float code they had before against the integer kernels. Each
+//# frame writes every LED like moving_wave1 and hue_animation do. The host
+//# has an FPU, the ESP32-C3 emulates every float op in software, so the
+//# gap on the device is wider than the one printed here.
+
+#define MAX_LEDS 1000
+#define WAVE_LENGTH 9
+#define WAVE_GAP 3
+
+static RGB_t frame[MAX_LEDS];
+
+static void wave_float(uint16_t leds, float phase) {
+    for (int i = 0; i < leds; i++) {
+        int position = i % (WAVE_LENGTH + WAVE_GAP);
+        frame[i] = rgb_off;
+        if (position < WAVE_LENGTH) {
+            float sin_offset = 1.0f + sinf((position / (float)WAVE_LENGTH) * 2 * M_PI + phase);
+            frame[i].red = (uint8_t)(127.5f * sin_offset);
+        }
+    }
+}
+
+static void wave_fixed(uint16_t leds, uint16_t phase) {
+    uint16_t step = ANGLE16_TURN / WAVE_LENGTH;
+    for (int i = 0; i < leds; i++) {
+        int position = i % (WAVE_LENGTH + WAVE_GAP);
+        frame[i] = rgb_off;
+        if (position < WAVE_LENGTH) frame[i].red = sin_wave8(position * step + phase);
+    }
+}
+
+static void wheel_float(uint16_t leds, uint8_t hue) {
+    for (int i = 0; i < leds; i++) {
+        hsv_to_rgb((uint8_t)(hue + i * 10) * 360.0f / 256, 1.0f, 10 / 255.0f, &frame[i]);
+    }
+}
+
+static void wheel_fixed(uint16_t leds, uint8_t hue) {
+    for (int i = 0; i < leds; i++) {
+        hsv_to_rgb_ints(hue + i * 10, 255, 10, &frame[i]);
+    }
+}
+
+#define TIME_FRAMES(frames, call) ({                                        \
+        uint64_t start_ = bench_now_ns();                                   \
+        for (int f_ = 0; f_ < (frames); f_++) { call; BENCH_KEEP(frame[0]); } \
+        (double)(bench_now_ns() - start_) / (frames);                       \
+    })
+
+int main(void) {
+    memset(frame, 0, sizeof(frame));
+
+    printf("ns per frame, every LED written\n");
+    printf("  %5s %9s %9s %6s %9s %9s %6s\n", "leds", "sinf", "sin_q15", "ratio", "hsv float", "hsv int", "ratio");
+
+    const uint16_t leds[] = { 9, 144, 1000 };
+    for (size_t l = 0; l < sizeof(leds) / sizeof(leds[0]); l++) {
+        int frames = 2000000 / leds[l];
+        double wave_f = TIME_FRAMES(frames, wave_float(leds[l], f_ * 0.1f));
+        double wave_i = TIME_FRAMES(frames, wave_fixed(leds[l], f_ * 1043));
+        double wheel_f = TIME_FRAMES(frames, wheel_float(leds[l], f_));
+        double wheel_i = TIME_FRAMES(frames, wheel_fixed(leds[l], f_));
+        printf("  %5u %9.0f %9.0f %5.1fx %9.0f %9.0f %5.1fx\n", leds[l], wave_f, wave_i, wave_f / wave_i,
+               wheel_f, wheel_i, wheel_f / wheel_i);
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "esp_random.h"
+#include "espnow_aggregate.h"
+#include "espnow_mesh.h"
+
+//# A minute of app_serial readings sent as aggregated ESP-NOW records. The
+//# eight sensors each resolve a burst every 200 ms at their own phase, the
+//# main loop runs espnow_agg_task every 10 ms, and originated frames pass
+//# the same token bucket as espnow_send_to. Per flush policy: frames and
+//# bytes on air per reading, frames refused by the rate limit, readings
+//# dropped and the add-to-send latency of every reading.
+
+#define SENSOR_PERIOD_US    200000
+#define LOOP_US             10000           // main loop period, main.c
+#define DURATION_US         60000000ULL
+#define RECORD_VALUE_LEN    4               // int32 reading, as app_network_push_reading
+#define MAX_READINGS        (DURATION_US / SENSOR_PERIOD_US * 20)
+
+typedef struct {
+    const char *name;
+    uint8_t readings;                       // per burst, app_serial.c on_resolve_*
+    uint32_t phase_us;
+} sensor_model_t;
+
+typedef struct {
+    const char *name;
+    espnow_agg_policy_t policy;
+} policy_case_t;
+
+static sensor_model_t sensors[] = {
+    { "bh1750", 1 }, { "ap3216", 2 }, { "apds9960", 5 }, { "max4400", 1 },
+    { "vl53lox", 1 }, { "mpu6050", 3 }, { "ina219", 4 }, { "sht31", 2 },
+};
+#define SENSOR_COUNT (sizeof(sensors) / sizeof(sensors[0]))
+
+static uint64_t now;
+static uint64_t bucket_tokens, bucket_time;
+static uint32_t rate_limited, air_bytes;
+
+//! add times of the readings still waiting, oldest first, frames carry them in order
+static uint64_t add_times[MAX_READINGS];
+static uint32_t add_head, add_tail;
+static uint32_t latencies[MAX_READINGS];
+static uint32_t latency_count;
+
+esp_err_t espnow_seal_message(espnow_message_t *message) { return ESP_OK; }
+
+//! token bucket of mod_espnow.c, scaled by 1000000 per token
+esp_err_t espnow_send(uint8_t *data, size_t len) {
+    const uint64_t capacity = ESPNOW_TX_BURST * 1000000ULL;
+    bucket_tokens += (now - bucket_time) * ESPNOW_TX_RATE_PER_SEC;
+    if (bucket_tokens > capacity) bucket_tokens = capacity;
+    bucket_time = now;
+
+    if (bucket_tokens < 1000000ULL) {
+        rate_limited++;
+        return ESP_ERR_TIMEOUT;
+    }
+    bucket_tokens -= 1000000ULL;
+    air_bytes += len;
+
+    const espnow_message_t *message = (const espnow_message_t *)data;
+    for (int pos = 0; pos < message->data_len; pos += ESPNOW_AGG_RECORD_HEADER + message->data[pos + 1]) {
+        latencies[latency_count++] = now - add_times[add_tail++];
+    }
+    return ESP_OK;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(double p) {
+    if (latency_count == 0) return 0;
+    return latencies[(int)(p * (latency_count - 1) + 0.5)] / 1000.0;
+}
+
+static void run(const policy_case_t *test) {
+    espnow_aggregator_t agg;
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, test->policy);
+
+    now = 1000000;
+    bucket_time = now;
+    bucket_tokens = ESPNOW_TX_BURST * 1000000ULL;
+    rate_limited = air_bytes = 0;
+    add_head = add_tail = latency_count = 0;
+
+    uint32_t readings = 0;
+    uint64_t end = now + DURATION_US;
+    uint64_t next_burst[SENSOR_COUNT];
+    for (size_t s = 0; s < SENSOR_COUNT; s++) next_burst[s] = now + sensors[s].phase_us;
+
+    //! one main loop tick: sensors due resolve, then the aggregator deadline
+    for (; now < end; now += LOOP_US) {
+        for (size_t s = 0; s < SENSOR_COUNT; s++) {
+            if (now < next_burst[s]) continue;
+            next_burst[s] += SENSOR_PERIOD_US;
+
+            for (int r = 0; r < sensors[s].readings; r++) {
+                int32_t value = esp_random() % 10000;
+                add_times[add_head++] = now;
+                if (espnow_agg_add(&agg, s * 8 + r + 1, &value, sizeof(value), now) != ESP_OK) add_head--;
+                readings++;
+            }
+        }
+        espnow_agg_task(&agg, now);
+    }
+
+    qsort(latencies, latency_count, sizeof(latencies[0]), compare_u32);
+    printf("  %-14s %8.3f %8.1f %8u %8u %8.1f %8.1f %8.1f\n", test->name,
+           (double)agg.stats.frames / readings, (double)air_bytes / readings,
+           rate_limited, agg.stats.dropped,
+           percentile_ms(0.5), percentile_ms(0.99), percentile_ms(1.0));
+}
+
+int main(void) {
+    srand(1);
+    espnow_mesh_setup((const uint8_t[6]){ 0x02, 0, 0, 0, 0, 1 });
+    int per_round = 0;
+    for (size_t s = 0; s < SENSOR_COUNT; s++) {
+        sensors[s].phase_us = esp_random() % SENSOR_PERIOD_US;
+        per_round += sensors[s].readings;
+    }
+
+    // flush_bytes 0 means a full frame
+    const policy_case_t cases[] = {
+        { "per reading",    { .flush_bytes = ESPNOW_AGG_RECORD_HEADER + RECORD_VALUE_LEN, .max_delay_us = 0 } },
+        { "per burst",      { .max_delay_us = 0 } },
+        { "deadline 20ms",  { .max_delay_us = 20000 } },
+        { "deadline 50ms",  { .max_delay_us = 50000 } },
+        { "deadline 100ms", { .max_delay_us = 100000 } },
+        { "deadline 200ms", { .max_delay_us = 200000 } },
+        { "size only",      { .max_delay_us = 10000000 } },
+    };
+
+    printf("%d sensors, %d readings every %d ms, %d frames/s limit\n", (int)SENSOR_COUNT, per_round,
+           SENSOR_PERIOD_US / 1000, ESPNOW_TX_RATE_PER_SEC);
+    printf("  %-14s %8s %8s %8s %8s %8s %8s %8s\n", "policy", "frm/rd", "B/rd", "limited", "dropped",
+           "p50 ms", "p99 ms", "max ms");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) run(&cases[i]);
+    return 0;
+}
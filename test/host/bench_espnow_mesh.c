@@ -0,0 +1,145 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+#include "espnow_mesh_nodes.h"
+
+//# Flooding over 10 to 50 nodes on line, grid and random topologies, every
+//# node its own copy of espnow_mesh.c state (espnow_mesh_nodes.h). A random
+//# node broadcasts every 20 ms, so forwards of several messages overlap in
+//# the forward slots; the radio itself never loses a frame. Reports the
+//# summed espnow_mesh_stats_t, the delivery ratio and the airtime at the
+//# 1 Mbps ESP-NOW rate.
+
+#define MESSAGES        100
+#define SEND_EVERY_US   20000
+#define STEP_US         1000
+
+#define AIR_FRAME_US    (192 + 43 * 8)          // long preamble, 802.11 and vendor action headers
+#define AIR_BYTE_US     8
+
+typedef enum { TOPO_LINE, TOPO_GRID, TOPO_RANDOM } topology_t;
+static const char *topology_names[] = { "line", "grid", "random" };
+
+static int link_count;
+
+static void link_nodes(int a, int b) {
+    mesh_nodes_link(a, b);
+    link_count++;
+}
+
+//! every node reached from node 0 over the links made so far
+static bool connected(int count, const bool adjacent[][MESH_NODES_MAX]) {
+    bool seen[MESH_NODES_MAX] = { true };
+    int stack[MESH_NODES_MAX] = { 0 }, top = 1, reached = 1;
+    while (top) {
+        int node = stack[--top];
+        for (int i = 0; i < count; i++) {
+            if (!adjacent[node][i] || seen[i]) continue;
+            seen[i] = true;
+            stack[top++] = i;
+            reached++;
+        }
+    }
+    return reached == count;
+}
+
+//! nodes dropped on a square, in range below a radius giving about 6 neighbours
+static void random_topology(int count) {
+    static bool adjacent[MESH_NODES_MAX][MESH_NODES_MAX];
+    double x[MESH_NODES_MAX], y[MESH_NODES_MAX];
+    double range = sqrt(6.0 / (M_PI * count));
+
+    do {
+        memset(adjacent, 0, sizeof(adjacent));
+        for (int i = 0; i < count; i++) {
+            x[i] = rand() / (double)RAND_MAX;
+            y[i] = rand() / (double)RAND_MAX;
+        }
+        for (int i = 0; i < count; i++) {
+            for (int j = i + 1; j < count; j++) {
+                adjacent[i][j] = adjacent[j][i] = hypot(x[i] - x[j], y[i] - y[j]) < range;
+            }
+        }
+    } while (!connected(count, adjacent));
+
+    for (int i = 0; i < count; i++) {
+        for (int j = i + 1; j < count; j++) {
+            if (adjacent[i][j]) link_nodes(i, j);
+        }
+    }
+}
+
+static void build(topology_t topology, int count) {
+    mesh_nodes_setup(count);
+    link_count = 0;
+
+    if (topology == TOPO_LINE) {
+        for (int i = 0; i + 1 < count; i++) link_nodes(i, i + 1);
+    } else if (topology == TOPO_GRID) {
+        int columns = (int)ceil(sqrt(count));
+        for (int i = 0; i < count; i++) {
+            if ((i + 1) % columns && i + 1 < count) link_nodes(i, i + 1);
+            if (i + columns < count) link_nodes(i, i + columns);
+        }
+    } else {
+        random_topology(count);
+    }
+}
+
+static void run(topology_t topology, int count, uint8_t ttl) {
+    srand(count * 31 + topology);
+    build(topology, count);
+
+    uint64_t now = 1000000, next_send = now;
+    int sent = 0;
+    while (sent < MESSAGES || !mesh_nodes_idle()) {
+        if (sent < MESSAGES && now >= next_send) {
+            espnow_message_t message = { .time_to_live = ttl, .data_len = 32 };
+            memset(message.target_addr, 0xFF, sizeof(message.target_addr));
+            mesh_nodes_send(rand() % count, &message, now);
+            next_send += SEND_EVERY_US;
+            sent++;
+        }
+        now += STEP_US;
+        mesh_nodes_step(now);
+    }
+
+    espnow_mesh_stats_t total = { 0 };
+    for (int i = 0; i < count; i++) {
+        espnow_mesh_stats_t stats;
+        mesh_nodes_get_stats(i, &stats);
+        total.delivered += stats.delivered;
+        total.duplicates += stats.duplicates;
+        total.forwarded += stats.forwarded;
+        total.forward_dropped += stats.forward_dropped;
+        total.ttl_expired += stats.ttl_expired;
+        total.tx_bytes += stats.tx_bytes;
+    }
+
+    uint32_t frames = mesh_nodes_frames();
+    double airtime_ms = (frames * AIR_FRAME_US + (double)total.tx_bytes * AIR_BYTE_US) / 1000;
+    printf("  %-6s %3d %5.1f %3u %9u %9u %9u %7.1f%% %6u %6u %9.1f %6.2f\n",
+           topology_names[topology], count, 2.0 * link_count / count, ttl,
+           total.delivered, total.duplicates, total.tx_bytes,
+           100.0 * total.delivered / (MESSAGES * (count - 1)),
+           total.forward_dropped, total.ttl_expired, airtime_ms, airtime_ms / MESSAGES);
+}
+
+int main(void) {
+    const int sizes[] = { 10, 25, 50 };
+    const uint8_t ttls[] = { ESPNOW_MESH_DEFAULT_TTL, 10 };
+
+    printf("%d broadcasts of 32 bytes, one every %d ms\n", MESSAGES, SEND_EVERY_US / 1000);
+    printf("  %-6s %3s %5s %3s %9s %9s %9s %8s %6s %6s %9s %6s\n", "topo", "n", "deg", "ttl",
+           "delivered", "dups", "tx_bytes", "ratio", "fwd_dr", "ttl_ex", "air ms", "/msg");
+
+    for (int t = TOPO_LINE; t <= TOPO_RANDOM; t++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (size_t l = 0; l < sizeof(ttls) / sizeof(ttls[0]); l++) run(t, sizes[s], ttls[l]);
+        }
+    }
+    return 0;
+}
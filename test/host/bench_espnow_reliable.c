@@ -0,0 +1,149 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+#include "esp_timer.h"
+#include "espnow_reliable.h"
+#include "espnow_mesh.h"
+
+//# Simulated link between this node and one peer. Data frames and ACKs are
+//# dropped independently with the given loss rate. The peer answers from its
+//# main loop like espnow_task does, up to one 10 ms tick after the frame
+//# arrived and opened. Reports delivery, transmits per message and latency
+//# percentiles from queueing to the ACK, per loss rate.
+
+#define MESSAGES        2000
+#define INTERVAL_US     50000           // offered load, under ESPNOW_TX_RATE_PER_SEC
+#define LOOP_US         10000           // main loop period, main.c
+#define AIR_US          1000            // frame on air plus the receive path
+#define MAX_EVENTS      64
+
+typedef struct {
+    uint64_t due;
+    uint8_t msg_id;
+} ack_event_t;
+
+static const uint8_t self_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static ack_event_t events[MAX_EVENTS];
+static int event_count;
+static uint32_t latencies[MESSAGES];
+static int delivered, failed;
+
+esp_err_t espnow_seal_message(espnow_message_t *message) { return ESP_OK; }
+esp_err_t espnow_open_message(espnow_message_t *message) { return ESP_OK; }
+
+esp_err_t espnow_send_to(const uint8_t *mac, const void *data, size_t len) {
+    return esp_now_send(mac, data, len);
+}
+
+esp_err_t espnow_send(uint8_t *data, size_t len) {
+    return ESP_OK;
+}
+
+static void on_delivery(const uint8_t *mac, uint8_t msg_id, bool ok, uint32_t latency_us) {
+    if (ok) latencies[delivered++] = latency_us;
+    else failed++;
+}
+
+static bool lost(double loss) {
+    return rand() < loss * RAND_MAX;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile_ms(double p) {
+    if (delivered == 0) return 0;
+    int index = (int)(p * (delivered - 1) + 0.5);
+    return latencies[index] / 1000.0;
+}
+
+//! data frames the peer received become ACK events, lost ones vanish
+static void air(uint64_t now, double loss) {
+    mock_espnow_frame_t frame;
+    while (mock_espnow_pop(&frame)) {
+        espnow_message_t *message = (espnow_message_t *)frame.data;
+        if (lost(loss) || event_count == MAX_EVENTS) continue;
+
+        //! the peer ACKs from its next loop tick, the ACK itself can be lost too
+        uint64_t due = now + AIR_US + rand() % LOOP_US + AIR_US;
+        if (lost(loss)) continue;
+        events[event_count++] = (ack_event_t){ .due = due, .msg_id = message->msg_id };
+    }
+}
+
+static void deliver_acks(uint64_t now) {
+    for (int i = 0; i < event_count;) {
+        if (events[i].due > now) {
+            i++;
+            continue;
+        }
+
+        espnow_message_t ack = { .msg_id = events[i].msg_id, .flags = ESPNOW_FLAG_ACK };
+        memcpy(ack.target_addr, self_mac, 6);
+        memcpy(ack.origin_addr, peer_mac, 6);
+        espnow_reliable_receive(peer_mac, &ack);
+        events[i] = events[--event_count];
+    }
+}
+
+static void run(double loss) {
+    espnow_reliable_stats_t before, after;
+    espnow_reliable_get_stats(&before);
+    delivered = failed = event_count = 0;
+    mock_espnow_reset();
+
+    static uint64_t now = 1000000;
+    uint64_t next_send = now, next_loop = now;
+    int sent = 0, busy = 0;
+
+    while (delivered + failed < MESSAGES) {
+        host_set_time(now);
+
+        if (sent < MESSAGES && now >= next_send) {
+            espnow_message_t message = { .data_len = 16 };
+            if (espnow_send_reliable(peer_mac, &message, on_delivery) == ESP_OK) {
+                sent++;
+                next_send += INTERVAL_US;
+            } else {
+                busy++;
+            }
+        }
+
+        deliver_acks(now);
+        if (now >= next_loop) {
+            espnow_reliable_task(now);
+            next_loop += LOOP_US;
+        }
+        air(now, loss);
+        now += 1000;
+    }
+
+    espnow_reliable_get_stats(&after);
+    qsort(latencies, delivered, sizeof(latencies[0]), compare_u32);
+
+    printf("  %4.0f%%  %6.2f%%  %6.2f  %6d  %7.1f %7.1f %7.1f %7.1f\n",
+           loss * 100, 100.0 * delivered / MESSAGES,
+           (double)(after.transmits - before.transmits) / MESSAGES, busy,
+           percentile_ms(0.5), percentile_ms(0.9), percentile_ms(0.99), percentile_ms(1.0));
+}
+
+int main(void) {
+    srand(1);
+    espnow_mesh_setup(self_mac);
+    espnow_reliable_setup(self_mac);
+
+    printf("%d messages every %d ms, ack timeout %d ms, %d retries\n",
+           MESSAGES, INTERVAL_US / 1000, ESPNOW_ACK_TIMEOUT_US / 1000, ESPNOW_MAX_RETRIES);
+    printf("  %5s  %7s  %6s  %6s  %7s %7s %7s %7s\n",
+           "loss", "deliv", "tx/msg", "busy", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+    const double loss_rates[] = { 0, 0.01, 0.05, 0.10, 0.20, 0.30, 0.50 };
+    for (size_t i = 0; i < sizeof(loss_rates) / sizeof(loss_rates[0]); i++) run(loss_rates[i]);
+    return 0;
+}
@@ -0,0 +1,137 @@
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "mock_httpd.h"
+#include "http.h"
+
+//# GET /file/ through the worker pool and the prefetching file_stream, once
+//# per HTTP_FILE_CHUNK_SIZE build (the Makefile builds this file with 512,
+//# 4096, 16384 and 32768). Every run is done twice: on the bare host, where
+//# only the per call overhead of the code shows, and with an SD card and a
+//# WiFi link modelled by sleeps in the file read callback and the mock send,
+//# where the fixed cost per call decides how far a chunk size gets.
+
+#define FILE_SIZE       (256 * 1024)
+#define MAX_FDS         8
+#define CONCURRENT      4                       // 2 workers busy, 2 waiting in the queue
+
+#define SD_READ_US      300                     // command and FAT lookup per read
+#define SD_BYTES_PER_MS 2500                    // SDSPI at 20 MHz
+#define TX_CHUNK_US     150                     // httpd_send and the lwip segment per chunk
+#define TX_BYTES_PER_MS 1000                    // what a C3 sustains over WiFi, shared
+
+typedef struct {
+    bool used;
+    size_t offset;
+} mem_file_t;
+
+static mem_file_t files[MAX_FDS];
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool sd_model;
+static uint32_t file_reads;
+
+static int file_open(const char *path, size_t *file_size) {
+    pthread_mutex_lock(&files_lock);
+    for (int fd = 0; fd < MAX_FDS; fd++) {
+        if (files[fd].used) continue;
+        files[fd] = (mem_file_t){ .used = true };
+        pthread_mutex_unlock(&files_lock);
+        *file_size = FILE_SIZE;
+        return fd;
+    }
+    pthread_mutex_unlock(&files_lock);
+    return -1;
+}
+
+static ssize_t file_read(int fd, char *buffer, size_t len) {
+    mem_file_t *file = &files[fd];
+    size_t n = MIN(FILE_SIZE - file->offset, len);
+    memset(buffer, (uint8_t)file->offset, n);
+    file->offset += n;
+    __atomic_add_fetch(&file_reads, 1, __ATOMIC_RELAXED);
+    if (sd_model) usleep(SD_READ_US + (uint64_t)n * 1000 / SD_BYTES_PER_MS);
+    return n;
+}
+
+static int file_seek(int fd, size_t offset) {
+    files[fd].offset = offset;
+    return 0;
+}
+
+static int file_close(int fd) {
+    pthread_mutex_lock(&files_lock);
+    files[fd].used = false;
+    pthread_mutex_unlock(&files_lock);
+    return 0;
+}
+
+static http_interface_t interface = {
+    .on_file_open_cb = file_open,
+    .on_file_read_cb = file_read,
+    .on_file_seek_cb = file_seek,
+    .on_file_close_cb = file_close,
+};
+
+static void wait_idle(void) {
+    http_stats_t stats;
+    do {
+        usleep(1000);
+        http_get_stats(&stats);
+    } while (stats.queue_depth > 0);
+    usleep(20000);
+}
+
+static void run(const char *name, int downloads) {
+    mock_response_t responses[CONCURRENT];
+    wait_idle();
+    file_reads = 0;
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < downloads; i++) {
+        mock_response_init(&responses[i]);
+        mock_httpd_request(HTTP_GET, "/file/bench.bin", NULL, &responses[i]);
+    }
+
+    uint64_t bytes = 0;
+    uint32_t sends = 0;
+    int failed = 0;
+    for (int i = 0; i < downloads; i++) {
+        mock_response_wait(&responses[i], 30000);
+        if (responses[i].body_len != FILE_SIZE || !responses[i].chunked_end) failed++;
+        bytes += responses[i].body_len;
+        sends += responses[i].sends + responses[i].chunked_end;
+        mock_response_free(&responses[i]);
+    }
+    double seconds = (bench_now_ns() - start) / 1e9;
+
+    printf("  %-22s %9.2f MB/s %8u %8u %6d\n", name, bytes / 1e6 / seconds,
+           sends / downloads, file_reads / downloads, failed);
+}
+
+static void run_all(const char *model) {
+    char name[32];
+    snprintf(name, sizeof(name), "%s, 1 download", model);
+    run(name, 1);
+    snprintf(name, sizeof(name), "%s, %d downloads", model, CONCURRENT);
+    run(name, CONCURRENT);
+}
+
+int main(void) {
+    http_setup(&interface);
+
+    printf("chunk %u bytes, %u KB of stream buffers per worker, %d KB file\n",
+           HTTP_FILE_CHUNK_SIZE, 2 * HTTP_FILE_CHUNK_SIZE / 1024, FILE_SIZE / 1024);
+    printf("  %-22s %14s %8s %8s %6s\n", "", "", "sends", "reads", "failed");
+
+    sd_model = false;
+    run_all("host");
+
+    sd_model = true;
+    mock_httpd_set_send_delay(TX_CHUNK_US);
+    mock_httpd_set_send_rate(TX_BYTES_PER_MS);
+    run_all("SD + WiFi");
+    return 0;
+}
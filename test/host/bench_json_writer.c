@@ -0,0 +1,81 @@
+#include <string.h>
+
+#include "test.h"
+#include "json_writer.h"
+
+//# The device handler reply {"status":"ok","len":N,"data":[...]}, built by
+//# the streaming writer through a 256 byte buffer against the snprintf +
+//# strcat code it replaced. The old code had a fixed 400 byte response, the
+//# reference here gets a buffer big enough for every N so both produce the
+//# same bytes.
+
+#define WRITER_BUFF 256
+#define ROUNDS      2000
+
+static uint16_t values[1000];
+static char reference[8192];
+static size_t sink_bytes;
+static int sink_flushes;
+
+static int sink_flush(void *ctx, const char *data, size_t len) {
+    sink_bytes += len;
+    sink_flushes++;
+    BENCH_KEEP(data);
+    return 0;
+}
+
+//! the pre writer code, every strcat walks the whole response again
+static size_t build_strcat(char *json_response, size_t size, uint16_t count) {
+    char temp[8];
+    snprintf(json_response, size, "{\"status\":\"ok\",\"len\":%hu,\"data\":[", count);
+    for (uint16_t i = 0; i < count; i++) {
+        snprintf(temp, sizeof(temp), "%hu", values[i]);
+        strcat(json_response, temp);
+        if (i < count - 1) strcat(json_response, ",");
+    }
+    strcat(json_response, "]}");
+    return strlen(json_response);
+}
+
+static size_t build_writer(uint16_t count) {
+    char buff[WRITER_BUFF];
+    json_writer_t w;
+
+    sink_bytes = 0;
+    json_writer_init(&w, buff, sizeof(buff), sink_flush, NULL);
+    json_object_begin(&w, NULL);
+    json_write_str(&w, "status", "ok");
+    json_write_uint(&w, "len", count);
+    json_write_u16_array(&w, "data", values, count);
+    json_object_end(&w);
+    json_writer_finish(&w);
+    return sink_bytes;
+}
+
+int main(void) {
+    for (int i = 0; i < 1000; i++) values[i] = (uint16_t)(i * 977u);
+
+    printf("%6s %8s %12s %12s %8s %10s\n", "values", "bytes", "strcat ns", "writer ns", "flushes", "RAM B");
+    const uint16_t counts[] = { 10, 100, 1000 };
+    for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        uint16_t count = counts[c];
+
+        uint64_t start = bench_now_ns();
+        size_t ref_len = 0;
+        for (int r = 0; r < ROUNDS; r++) ref_len = build_strcat(reference, sizeof(reference), count);
+        uint64_t strcat_ns = (bench_now_ns() - start) / ROUNDS;
+        BENCH_KEEP(reference);
+
+        start = bench_now_ns();
+        size_t len = 0;
+        sink_flushes = 0;
+        for (int r = 0; r < ROUNDS; r++) len = build_writer(count);
+        uint64_t writer_ns = (bench_now_ns() - start) / ROUNDS;
+
+        if (len != ref_len) printf("length mismatch %zu vs %zu\n", len, ref_len);
+        printf("%6u %8zu %12llu %12llu %8d %5zu/%d\n", count, len,
+               (unsigned long long)strcat_ns, (unsigned long long)writer_ns,
+               sink_flushes / ROUNDS, ref_len + 1, WRITER_BUFF);
+    }
+    return 0;
+}
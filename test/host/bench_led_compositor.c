@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "led_compositor.h"
+
+//# Compositing cost per layer and blend mode at 9, 144 and 1000 LEDs:
+//# LED_COMPOSITOR_MAX_LAYERS full range layers of random colours, one
+//# marked dirty per frame so every flatten blends them all. The idle column
+//# is a flatten with nothing dirty, what a static strip pays per frame.
+//# Per layer is from the compositor's own flatten_cycles, host ns.
+
+#define MAX_LEDS 1000
+
+static uint8_t out[MAX_LEDS * 3];
+
+static double per_layer(uint16_t leds, led_blend_t blend, double *idle_ns) {
+    led_compositor_t comp;
+    led_compositor_init(&comp, leds, LED_COMPOSITOR_MAX_LAYERS);
+    for (int l = 0; l < comp.layer_count; l++) {
+        for (int i = 0; i < leds * 3; i++) comp.layers[l].pixels[i] = rand();
+        led_layer_config(&comp.layers[l], 200, l == 0 ? LED_BLEND_ALPHA : blend, 0, leds - 1);
+    }
+
+    int frames = 4000000 / leds;
+    for (int f = 0; f < frames; f++) {
+        comp.layers[0].dirty = true;
+        led_compositor_flatten(&comp, out);
+        BENCH_KEEP(out[0]);
+    }
+    double ns = (double)comp.flatten_cycles / comp.flattens / comp.layer_count;
+
+    uint64_t start = bench_now_ns();
+    for (int f = 0; f < frames; f++) BENCH_KEEP(led_compositor_flatten(&comp, out));
+    *idle_ns = (double)(bench_now_ns() - start) / frames;
+
+    for (int l = 0; l < comp.layer_count; l++) free(comp.layers[l].pixels);
+    return ns;
+}
+
+int main(void) {
+    srand(9);
+    memset(out, 0, sizeof(out));
+
+    printf("%d layers, ns per layer per frame\n", LED_COMPOSITOR_MAX_LAYERS);
+    printf("  %5s %8s %8s %8s %8s %6s\n", "leds", "alpha", "add", "max", "multiply", "idle");
+
+    const uint16_t leds[] = { 9, 144, 1000 };
+    const led_blend_t blends[] = { LED_BLEND_ALPHA, LED_BLEND_ADD, LED_BLEND_MAX, LED_BLEND_MULTIPLY };
+    for (size_t l = 0; l < sizeof(leds) / sizeof(leds[0]); l++) {
+        double idle_ns = 0;
+        printf("  %5u", leds[l]);
+        for (size_t b = 0; b < sizeof(blends) / sizeof(blends[0]); b++) printf(" %8.0f", per_layer(leds[l], blends[b], &idle_ns));
+        printf(" %6.1f\n", idle_ns);
+    }
+    return 0;
+}
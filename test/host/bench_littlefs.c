@@ -0,0 +1,209 @@
+#include <string.h>
+#include <math.h>
+
+#include "test.h"
+#include "lfs.h"
+#include "bd/lfs_emubd.h"
+
+//# Replays this project's storage patterns on an emulated copy of the
+//# "storage" partition (lfs_emubd from the littlefs component): small per
+//# device config files, append-heavy logs and read-mostly web assets.
+//# Every run reports bytes read/programmed/erased per phase and the erase
+//# wear spread over blocks, swept over block_cycles, cache and lookahead.
+
+#define BLOCK_SIZE          4096
+#define BLOCK_COUNT         (0x70000 / BLOCK_SIZE)     // partitions.csv storage
+#define READ_SIZE           128                         // CONFIG_LITTLEFS_READ_SIZE
+#define PROG_SIZE           128                         // CONFIG_LITTLEFS_WRITE_SIZE
+
+#define DEVICE_FILES        32
+#define DEVICE_FILE_SIZE    140                         // one behavior rule row
+#define LOG_APPENDS         4000
+#define LOG_APPEND_SIZE     64
+#define LOG_ROTATE_SIZE     (16 * 1024)                 // log.txt -> log.old
+#define ASSET_SIZE          (16 * 1024)
+#define ASSET_READS         20
+
+typedef struct {
+    int32_t block_cycles;
+    lfs_size_t cache_size;
+    lfs_size_t lookahead_size;
+} bench_params_t;
+
+typedef struct {
+    lfs_emubd_io_t read, prog, erase;
+} bench_io_t;
+
+static lfs_emubd_t bd;
+static struct lfs_emubd_config bd_config = {
+    .read_size = READ_SIZE,
+    .prog_size = PROG_SIZE,
+    .erase_size = BLOCK_SIZE,
+    .erase_count = BLOCK_COUNT,
+    .erase_value = -1,
+    .erase_cycles = 100000,                             // NOR flash rating, wear is only counted when set
+};
+static uint8_t buff[BLOCK_SIZE];
+
+static bench_io_t io_snapshot(const struct lfs_config *cfg) {
+    return (bench_io_t){ lfs_emubd_readed(cfg), lfs_emubd_proged(cfg), lfs_emubd_erased(cfg) };
+}
+
+static void io_report(const char *name, const struct lfs_config *cfg, bench_io_t start, uint64_t start_ns) {
+    bench_io_t now = io_snapshot(cfg);
+    printf("  %-14s %10llu %10llu %10llu %9.2f ms\n", name,
+           (unsigned long long)(now.read - start.read),
+           (unsigned long long)(now.prog - start.prog),
+           (unsigned long long)(now.erase - start.erase),
+           (bench_now_ns() - start_ns) / 1e6);
+}
+
+static void write_file(lfs_t *lfs, const char *path, int flags, const void *data, lfs_size_t len) {
+    lfs_file_t file;
+    if (lfs_file_open(lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | flags) < 0) return;
+    lfs_file_write(lfs, &file, data, len);
+    lfs_file_close(lfs, &file);
+}
+
+static void bench_device_configs(lfs_t *lfs, const struct lfs_config *cfg) {
+    char path[32];
+    memset(buff, 'c', DEVICE_FILE_SIZE);
+    lfs_mkdir(lfs, "devices");
+
+    bench_io_t io = io_snapshot(cfg);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < DEVICE_FILES; i++) {
+        snprintf(path, sizeof(path), "devices/%02X.text", i);
+        write_file(lfs, path, LFS_O_TRUNC, buff, DEVICE_FILE_SIZE);
+    }
+    io_report("config write", cfg, io, start);
+
+    io = io_snapshot(cfg);
+    start = bench_now_ns();
+    for (int i = 0; i < DEVICE_FILES; i++) {
+        snprintf(path, sizeof(path), "devices/%02X.text", i);
+        lfs_file_t file;
+        if (lfs_file_open(lfs, &file, path, LFS_O_RDONLY) < 0) continue;
+        lfs_file_read(lfs, &file, buff, BLOCK_SIZE);
+        lfs_file_close(lfs, &file);
+    }
+    io_report("config read", cfg, io, start);
+}
+
+//! open/append/close per line like a logger without a held handle
+static void bench_log_appends(lfs_t *lfs, const struct lfs_config *cfg) {
+    memset(buff, 'l', LOG_APPEND_SIZE);
+
+    bench_io_t io = io_snapshot(cfg);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < LOG_APPENDS; i++) {
+        write_file(lfs, "log.txt", LFS_O_APPEND, buff, LOG_APPEND_SIZE);
+
+        struct lfs_info info;
+        if (lfs_stat(lfs, "log.txt", &info) == 0 && info.size >= LOG_ROTATE_SIZE) {
+            lfs_rename(lfs, "log.txt", "log.old");
+        }
+    }
+    io_report("log append", cfg, io, start);
+}
+
+static void bench_web_assets(lfs_t *lfs, const struct lfs_config *cfg) {
+    memset(buff, 'w', BLOCK_SIZE);
+
+    bench_io_t io = io_snapshot(cfg);
+    uint64_t start = bench_now_ns();
+    lfs_file_t file;
+    if (lfs_file_open(lfs, &file, "index.html", LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) < 0) return;
+    for (int i = 0; i < ASSET_SIZE / BLOCK_SIZE; i++) lfs_file_write(lfs, &file, buff, BLOCK_SIZE);
+    lfs_file_close(lfs, &file);
+    io_report("asset write", cfg, io, start);
+
+    io = io_snapshot(cfg);
+    start = bench_now_ns();
+    for (int i = 0; i < ASSET_READS; i++) {
+        if (lfs_file_open(lfs, &file, "index.html", LFS_O_RDONLY) < 0) continue;
+        while (lfs_file_read(lfs, &file, buff, BLOCK_SIZE) > 0);
+        lfs_file_close(lfs, &file);
+    }
+    io_report("asset read", cfg, io, start);
+}
+
+//! erase count per block, a high max against the mean means wear leveling isn't spreading
+static void wear_report(const struct lfs_config *cfg) {
+    lfs_emubd_wear_t min = UINT32_MAX, max = 0;
+    double sum = 0, sum_sq = 0;
+    int used = 0;
+
+    for (lfs_block_t block = 0; block < BLOCK_COUNT; block++) {
+        lfs_emubd_wear_t wear = lfs_emubd_wear(cfg, block);
+        min = wear < min ? wear : min;
+        max = wear > max ? wear : max;
+        sum += wear;
+        sum_sq += (double)wear * wear;
+        used += wear > 0;
+    }
+
+    double mean = sum / BLOCK_COUNT;
+    double stddev = sqrt(sum_sq / BLOCK_COUNT - mean * mean);
+    printf("  wear           min %u  max %u  mean %.1f  stddev %.1f  blocks erased %d/%d\n",
+           min, max, mean, stddev, used, BLOCK_COUNT);
+}
+
+static void run(bench_params_t params) {
+    uint8_t read_buffer[BLOCK_SIZE], prog_buffer[BLOCK_SIZE];
+    uint8_t lookahead_buffer[256];
+
+    struct lfs_config cfg = {
+        .context = &bd,
+        .read = lfs_emubd_read,
+        .prog = lfs_emubd_prog,
+        .erase = lfs_emubd_erase,
+        .sync = lfs_emubd_sync,
+        .read_size = READ_SIZE,
+        .prog_size = PROG_SIZE,
+        .block_size = BLOCK_SIZE,
+        .block_count = BLOCK_COUNT,
+        .block_cycles = params.block_cycles,
+        .cache_size = params.cache_size,
+        .lookahead_size = params.lookahead_size,
+        .read_buffer = read_buffer,
+        .prog_buffer = prog_buffer,
+        .lookahead_buffer = lookahead_buffer,
+    };
+
+    printf("\nblock_cycles %d  cache %u  lookahead %u\n",
+           params.block_cycles, params.cache_size, params.lookahead_size);
+    printf("  %-14s %10s %10s %10s %12s\n", "phase", "read B", "prog B", "erase B", "host time");
+
+    if (lfs_emubd_create(&cfg, &bd_config) != 0) return;
+
+    lfs_t lfs;
+    if (lfs_format(&lfs, &cfg) == 0 && lfs_mount(&lfs, &cfg) == 0) {
+        bench_device_configs(&lfs, &cfg);
+        bench_log_appends(&lfs, &cfg);
+        bench_web_assets(&lfs, &cfg);
+        lfs_unmount(&lfs);
+        wear_report(&cfg);
+    } else {
+        printf("  format/mount failed\n");
+    }
+
+    lfs_emubd_destroy(&cfg);
+}
+
+int main(void) {
+    // menuconfig defaults first, then one knob at a time
+    const bench_params_t sweep[] = {
+        { 512, 512, 128 },
+        { 100, 512, 128 },
+        { 1000, 512, 128 },
+        { -1, 512, 128 },
+        { 512, 128, 128 },
+        { 512, 4096, 128 },
+        { 512, 512, 16 },
+        { 512, 512, 256 },
+    };
+
+    for (size_t i = 0; i < sizeof(sweep) / sizeof(sweep[0]); i++) run(sweep[i]);
+    return 0;
+}
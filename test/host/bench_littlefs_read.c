@@ -0,0 +1,93 @@
+#include <string.h>
+
+#include "test.h"
+#include "mock_lfs_vfs.h"
+#include "littlefs/littlefs.h"
+
+//# littlefs_readLines against the fgets(buff, 128) loop it replaced, both
+//# over the same file on lfs_emubd. The old loop goes through a FILE with
+//# newlib's 128 byte buffer, so every 128 bytes is one lfs_file_read; the
+//# chunked reader asks for 4096 at a time. Reports MB/s, callbacks, file
+//# reads and block device bytes for rule files and a log.
+
+#define RUNS 20
+
+typedef struct {
+    const char *name;
+    size_t size;
+    size_t min_line, max_line;
+} bench_file_t;
+
+static const bench_file_t files[] = {
+    { "behavior rules", 2 * 1024, 20, 60 },                 // a device's rule rows
+    { "device config", 8 * 1024, 40, 140 },
+    { "log", 64 * 1024, 30, 120 },
+    { "log, long lines", 64 * 1024, 100, 400 },             // fgets(128) splits these
+};
+
+static uint32_t callbacks;
+static size_t callback_bytes;
+
+static void on_line(char *file_name, char *buff, size_t len) {
+    callbacks++;
+    callback_bytes += len;
+    BENCH_KEEP(buff[0]);
+}
+
+static size_t build_file(char *out, const bench_file_t *file) {
+    size_t len = 0;
+    uint32_t seed = 12345;
+    while (len < file->size) {
+        seed = seed * 1103515245u + 12345u;
+        size_t line = file->min_line + (seed >> 8) % (file->max_line - file->min_line + 1);
+        for (size_t i = 0; i < line; i++) out[len++] = "0123456789abcdef,"[(seed + i) % 17];
+        out[len++] = '\n';
+    }
+    return len;
+}
+
+//! the baseline: fgets(128) per line, as littlefs_readLines did before
+static void fgets_lines(const char *path, char *file_name, littlefs_readfile_cb callback) {
+    FILE *file = mock_lfs_fopen(path);
+    if (file == NULL) return;
+    char buff[128];
+    while (fgets(buff, sizeof(buff), file) != NULL) callback(file_name, buff, strlen(buff));
+    fclose(file);
+}
+
+typedef void (*reader_fn)(const char *path, char *file_name, littlefs_readfile_cb callback);
+
+static void chunked_lines(const char *path, char *file_name, littlefs_readfile_cb callback) {
+    littlefs_readLines(path, file_name, callback);
+}
+
+static void run(const char *name, reader_fn reader, size_t size) {
+    callbacks = 0;
+    callback_bytes = 0;
+    uint32_t reads = mock_lfs_file_reads();
+    uint64_t bd_bytes = mock_lfs_bd_read_bytes();
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < RUNS; i++) reader(MOCK_LFS_BASE "/bench.text", "bench.text", on_line);
+    uint64_t ns = bench_now_ns() - start;
+
+    printf("  %-10s %8.1f MB/s %9u %9u %11llu\n", name, (double)size * RUNS / 1e6 / (ns / 1e9),
+           callbacks / RUNS, (mock_lfs_file_reads() - reads) / RUNS,
+           (unsigned long long)(mock_lfs_bd_read_bytes() - bd_bytes) / RUNS);
+}
+
+int main(void) {
+    static char content[80 * 1024];
+    mock_lfs_mount();
+
+    for (size_t f = 0; f < sizeof(files) / sizeof(files[0]); f++) {
+        size_t size = build_file(content, &files[f]);
+        mock_lfs_write("bench.text", content, size);
+        printf("%s, %zu bytes\n", files[f].name, size);
+        printf("  %-10s %13s %9s %9s %11s\n", "reader", "", "callbacks", "lfs reads", "bd bytes");
+        run("fgets(128)", fgets_lines, size);
+        run("chunked", chunked_lines, size);
+    }
+
+    mock_lfs_unmount();
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "test.h"
+#include "esp_timer.h"
+#include "mock_lora.h"
+
+//# An hour of traffic across two bridges over the mocked radios, SF7 125 kHz
+//# at LORA_BRIDGE_DUTY_PERMILLE. Both meshes offer Poisson traffic, 20% high
+//# priority, 50% normal, 30% low, 8 to 120 payload bytes. The main loop runs
+//# both bridges every 10 ms. Per load and packet loss: frames delivered,
+//# payload throughput, airtime used per side and the tap to inject latency
+//# per priority, plus what the queue dropped or expired and what collided.
+//# Under overload the latency of the frames that made it is survivorship,
+//# the delivered share per priority is what the queue policy decides.
+
+#define LOOP_US         10000           // main loop period, main.c
+#define DURATION_US     3600000000ULL
+#define MAX_FRAMES      8192
+
+typedef struct {
+    const char *name;
+    double per_minute;                  // offered frames per side
+    double loss;
+} scenario_t;
+
+typedef struct {
+    uint64_t tap_time;
+    uint8_t priority;
+    uint8_t data_len;
+    bool delivered;
+} frame_record_t;
+
+static const uint8_t near_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t far_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static frame_record_t records[MAX_FRAMES];
+static uint32_t record_count;
+static uint32_t latencies[LORA_BRIDGE_PRIO_COUNT][MAX_FRAMES];
+static uint32_t latency_count[LORA_BRIDGE_PRIO_COUNT];
+static uint32_t offered[LORA_BRIDGE_PRIO_COUNT];
+static uint32_t delivered, delivered_bytes;
+
+//! the frame's sequence number rides in its first two payload bytes
+static void on_inject(int side, const espnow_message_t *message, uint64_t current_time) {
+    uint16_t seq;
+    memcpy(&seq, message->data, sizeof(seq));
+    frame_record_t *record = &records[seq];
+    if (record->delivered) return;
+
+    record->delivered = true;
+    delivered++;
+    delivered_bytes += record->data_len;
+    latencies[record->priority][latency_count[record->priority]++] = current_time - record->tap_time;
+}
+
+static double exponential(double mean) {
+    return -log((rand() + 1.0) / (RAND_MAX + 2.0)) * mean;
+}
+
+static void offer(int side, uint64_t now) {
+    static const uint8_t groups[] = { 3, 3, 3, 1, 1, 1, 1, 1, 2, 2 };
+    if (record_count == MAX_FRAMES) return;
+
+    uint16_t seq = record_count++;
+    uint8_t group_id = groups[rand() % sizeof(groups)];
+    espnow_message_t message = {
+        .group_id = group_id,
+        .msg_id = seq,
+        .time_to_live = 5,
+        .data_len = 8 + rand() % 113,
+    };
+    memset(message.target_addr, 0xFF, sizeof(message.target_addr));
+    memcpy(message.origin_addr, side == MOCK_LORA_NEAR ? near_mac : far_mac, sizeof(message.origin_addr));
+    message.origin_addr[4] = seq >> 8;                          // a fresh origin per 256 ids keeps the dedup exact
+    memcpy(message.data, &seq, sizeof(seq));
+
+    records[seq] = (frame_record_t){
+        .tap_time = now,
+        .priority = group_id == 2 ? LORA_BRIDGE_PRIO_HIGH : group_id == 1 ? LORA_BRIDGE_PRIO_NORMAL : LORA_BRIDGE_PRIO_LOW,
+        .data_len = message.data_len,
+    };
+    offered[records[seq].priority]++;
+    mock_lora_tap(side, &message);
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double delivered_pct(int priority) {
+    return offered[priority] ? 100.0 * latency_count[priority] / offered[priority] : 0;
+}
+
+static double percentile_s(int priority, double p) {
+    uint32_t count = latency_count[priority];
+    if (count == 0) return 0;
+    return latencies[priority][(int)(p * (count - 1) + 0.5)] / 1e6;
+}
+
+static void stats_delta(lora_bridge_stats_t *delta, const lora_bridge_stats_t *before, const lora_bridge_stats_t *after) {
+    delta->queue_dropped = after->queue_dropped - before->queue_dropped;
+    delta->expired = after->expired - before->expired;
+    delta->airtime_us = after->airtime_us - before->airtime_us;
+}
+
+static void run(const scenario_t *scenario) {
+    static uint64_t now = 1000000;
+
+    //! a long idle pass starts every scenario with a full budget
+    now += 1000000000ULL;
+    host_set_time(now);
+    lora_bridge_task(now);
+    far_bridge_task(now);
+
+    mock_lora_reset(scenario->loss);
+    memset(records, 0, sizeof(records));
+    memset(latency_count, 0, sizeof(latency_count));
+    memset(offered, 0, sizeof(offered));
+    record_count = delivered = delivered_bytes = 0;
+
+    lora_bridge_stats_t near_before, far_before, near_after, far_after, near, far;
+    lora_bridge_get_stats(&near_before);
+    far_bridge_get_stats(&far_before);
+
+    double mean_us = 60e6 / scenario->per_minute;
+    uint64_t next_offer[2] = { now + exponential(mean_us), now + exponential(mean_us) };
+    uint64_t offer_end = now + DURATION_US;
+
+    //! the last minute only drains, anything older than LORA_BRIDGE_MAX_AGE_US is gone by then
+    for (uint64_t end = offer_end + 60000000; now < end; now += LOOP_US) {
+        host_set_time(now);
+        for (int side = 0; side < 2; side++) {
+            while (next_offer[side] <= now && now < offer_end) {
+                offer(side, now);
+                next_offer[side] += exponential(mean_us);
+            }
+        }
+        lora_bridge_task(now);
+        far_bridge_task(now);
+    }
+
+    lora_bridge_get_stats(&near_after);
+    far_bridge_get_stats(&far_after);
+    stats_delta(&near, &near_before, &near_after);
+    stats_delta(&far, &far_before, &far_after);
+    for (int p = 0; p < LORA_BRIDGE_PRIO_COUNT; p++) qsort(latencies[p], latency_count[p], sizeof(uint32_t), compare_u32);
+
+    printf("  %-10s %6u %5.1f%% %5.1f%% %5.1f%% %5.1f %5.2f%% %5.2f%% %6.1f %6.1f %6.1f %6.1f %5u %5u %4u\n",
+           scenario->name, record_count, 100.0 * delivered / record_count,
+           delivered_pct(LORA_BRIDGE_PRIO_HIGH), delivered_pct(LORA_BRIDGE_PRIO_LOW), delivered_bytes / (DURATION_US / 1e6),
+           100.0 * near.airtime_us / DURATION_US, 100.0 * far.airtime_us / DURATION_US,
+           percentile_s(LORA_BRIDGE_PRIO_HIGH, 0.5), percentile_s(LORA_BRIDGE_PRIO_HIGH, 0.99),
+           percentile_s(LORA_BRIDGE_PRIO_LOW, 0.5), percentile_s(LORA_BRIDGE_PRIO_LOW, 0.99),
+           near.queue_dropped + far.queue_dropped, near.expired + far.expired, mock_lora_collisions());
+}
+
+int main(void) {
+    srand(1);
+    host_set_time(1000000);
+    mock_lora_set_inject_cb(on_inject);
+    lora_bridge_setup(NULL, near_mac);
+    far_bridge_setup(NULL, far_mac);
+
+    for (uint8_t group_id = 1; group_id <= 3; group_id++) {
+        lora_bridge_prio_t priority = group_id == 2 ? LORA_BRIDGE_PRIO_HIGH :
+                                      group_id == 1 ? LORA_BRIDGE_PRIO_NORMAL : LORA_BRIDGE_PRIO_LOW;
+        lora_bridge_add_group(group_id, priority);
+        far_bridge_add_group(group_id, priority);
+    }
+
+    const scenario_t scenarios[] = {
+        { "0.5/min",     0.5, 0 },
+        { "1/min",       1,   0 },
+        { "2/min",       2,   0 },
+        { "4/min",       4,   0 },
+        { "8/min",       8,   0 },
+        { "16/min",      16,  0 },
+        { "2/min 10%",   2,   0.10 },
+        { "2/min 30%",   2,   0.30 },
+    };
+
+    printf("1 h per load and side, mtu %d, duty %d permille, latency in s\n", LORA_BRIDGE_MTU, LORA_BRIDGE_DUTY_PERMILLE);
+    printf("  %-10s %6s %6s %6s %6s %5s %6s %6s %6s %6s %6s %6s %5s %5s %4s\n", "load loss", "frames", "deliv",
+           "hi", "lo", "B/s",
+           "air A", "air B", "hi p50", "hi p99", "lo p50", "lo p99", "drop", "exp", "coll");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) run(&scenarios[i]);
+    return 0;
+}
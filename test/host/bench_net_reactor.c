@@ -0,0 +1,148 @@
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "mock_socket.h"
+#include "net_reactor.h"
+#include "esp_timer.h"
+
+//# Two server sources on mock_socket pairs, served first the old way and
+//# then by net_reactor. The old way is what app_network did before the
+//# reactor: every 10 ms main loop turn polled each server with a zero
+//# timeout (web_socket_poll, udp_server_socket_task). Reports loop turns and
+//# busy time per idle second, and the delay from a client's send to the
+//# dispatch that reads it.
+
+#define SOURCE_FDS      4
+#define MAIN_LOOP_MS    10                  // vTaskDelay in main.c
+#define IDLE_MS         1000
+#define EVENTS          300
+
+typedef struct {
+    int server[SOURCE_FDS];
+    int client[SOURCE_FDS];
+} bench_source_t;
+
+static bench_source_t sources[2];
+static uint32_t latencies[EVENTS];
+static volatile uint32_t received;
+
+static int source_fill(void *ctx, struct pollfd *fds, int max) {
+    bench_source_t *source = ctx;
+    for (int i = 0; i < SOURCE_FDS; i++) fds[i] = (struct pollfd){ .fd = source->server[i], .events = POLLIN };
+    return SOURCE_FDS;
+}
+
+//! every event is the send time of its client
+static void source_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time) {
+    for (int i = 0; i < count; i++) {
+        if (!(fds[i].revents & POLLIN)) continue;
+        uint64_t sent;
+        while (recv(fds[i].fd, &sent, sizeof(sent), MSG_DONTWAIT) == sizeof(sent)) {
+            uint64_t now = esp_timer_get_time();
+            if (received < EVENTS) latencies[received] = now - sent;
+            received++;
+        }
+    }
+}
+
+//! SECTION old per server loop
+
+static volatile bool loop_running;
+static uint32_t loop_turns;
+static uint64_t loop_busy_us;
+
+static void *main_loop(void *arg) {
+    struct pollfd fds[SOURCE_FDS];
+    while (loop_running) {
+        uint64_t start = esp_timer_get_time();
+        for (int s = 0; s < 2; s++) {
+            int count = source_fill(&sources[s], fds, SOURCE_FDS);
+            if (poll(fds, count, 0) < 0) continue;
+            source_dispatch(&sources[s], fds, count, start);
+        }
+        loop_busy_us += esp_timer_get_time() - start;
+        loop_turns++;
+        usleep(MAIN_LOOP_MS * 1000);
+    }
+    return NULL;
+}
+
+//! SECTION measurement
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+//! clients on both sources send at 1..4 ms spacing
+static void send_events(void) {
+    received = 0;
+    uint32_t seed = 7;
+    for (int i = 0; i < EVENTS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        bench_source_t *source = &sources[i & 1];
+        uint64_t now = esp_timer_get_time();
+        send(source->client[(seed >> 8) % SOURCE_FDS], &now, sizeof(now), 0);
+        usleep(1000 + (seed >> 16) % 3000);
+    }
+    uint64_t deadline = esp_timer_get_time() + 1000000;
+    while (received < EVENTS && esp_timer_get_time() < deadline) usleep(1000);
+}
+
+static void report_latency(void) {
+    uint32_t count = received < EVENTS ? received : EVENTS;
+    qsort(latencies, count, sizeof(uint32_t), compare_u32);
+    printf("  send to dispatch    p50 %6u us  p99 %6u us  max %6u us\n",
+           latencies[count / 2], latencies[count * 99 / 100], latencies[count - 1]);
+}
+
+static void report_idle(uint32_t turns, uint64_t busy_us, uint32_t polls) {
+    printf("  idle second         %6u turns %6u polls %8.1f us busy\n",
+           turns * 1000 / IDLE_MS, polls * 1000 / IDLE_MS, (double)busy_us * 1000 / IDLE_MS);
+}
+
+int main(void) {
+    for (int s = 0; s < 2; s++) {
+        for (int i = 0; i < SOURCE_FDS; i++) {
+            sources[s].client[i] = mock_socket_connect();
+            sources[s].server[i] = accept(-1, NULL, NULL);
+        }
+    }
+
+    printf("per server poll from the %d ms main loop\n", MAIN_LOOP_MS);
+    pthread_t thread;
+    loop_running = true;
+    pthread_create(&thread, NULL, main_loop, NULL);
+    usleep(50000);
+    uint32_t turns = loop_turns;
+    uint64_t busy = loop_busy_us;
+    usleep(IDLE_MS * 1000);
+    report_idle(loop_turns - turns, loop_busy_us - busy, 2 * (loop_turns - turns));
+    send_events();
+    report_latency();
+    loop_running = false;
+    pthread_join(thread, NULL);
+
+    printf("net_reactor, %d ms tick\n", NET_REACTOR_TICK_MS);
+    net_reactor_add(source_fill, source_dispatch, &sources[0]);
+    net_reactor_add(source_fill, source_dispatch, &sources[1]);
+    net_reactor_start();
+    usleep(50000);
+    net_reactor_stats_t before, after;
+    net_reactor_get_stats(&before);
+    usleep(IDLE_MS * 1000);
+    net_reactor_get_stats(&after);
+    report_idle(after.loops - before.loops, after.busy_us - before.busy_us, after.loops - before.loops);
+
+    net_reactor_get_stats(&before);
+    send_events();
+    net_reactor_get_stats(&after);
+    report_latency();
+    printf("  %u events           %6u turns %6u wakeups %5llu us busy, worst turn %u us\n", EVENTS,
+           after.loops - before.loops, after.wakeups - before.wakeups,
+           (unsigned long long)(after.busy_us - before.busy_us), after.max_dispatch_us);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "telemetry.h"
+#include "json_writer.h"
+
+//# One second of app_serial readings, 17 channels read every 200 ms, packed
+//# the ways the WebSocket stream could carry them: the delta frame, the
+//# latest value only frame it replaced, raw int32 samples and JSON text.
+
+#define CHANNELS    17
+#define SAMPLES     5
+#define ROUNDS      20000
+
+typedef struct {
+    const char *name;
+    int32_t base;
+    int32_t noise;                          // reading to reading jitter
+} channel_model_t;
+
+// ids 1..17 as in app_serial.h, floats as fixed point x100
+static const channel_model_t models[CHANNELS] = {
+    { "lux",       12345,  40 },
+    { "proximity",    12,   3 },
+    { "als",         310,  10 },
+    { "clear",      1450,  30 },
+    { "red",         520,  12 },
+    { "green",       610,  12 },
+    { "blue",        480,  12 },
+    { "distance",    120,   4 },
+    { "accel_x",     -80, 120 },
+    { "accel_y",      45, 120 },
+    { "accel_z",   16384, 150 },
+    { "shunt",       210,   6 },
+    { "bus_mv",     4980,   8 },
+    { "current",     865,  20 },
+    { "power",      4300,  60 },
+    { "temp",       2345,   2 },
+    { "humidity",   4520,   5 },
+};
+
+static int32_t samples[CHANNELS][SAMPLES];
+static uint8_t buff[2048];
+static size_t json_bytes;
+
+static int count_flush(void *ctx, const char *data, size_t len) {
+    json_bytes += len;
+    return 0;
+}
+
+static size_t pack_delta(void) {
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 7, 123456);
+    for (int ch = 0; ch < CHANNELS; ch++) telemetry_add_channel(&frame, ch + 1, samples[ch], SAMPLES);
+    return telemetry_frame_end(&frame);
+}
+
+static size_t pack_latest(void) {
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 7, 123456);
+    for (int ch = 0; ch < CHANNELS; ch++) telemetry_add_channel(&frame, ch + 1, &samples[ch][SAMPLES - 1], 1);
+    return telemetry_frame_end(&frame);
+}
+
+//! same header, then id u8 | count u8 | int32 samples
+static size_t pack_raw(void) {
+    size_t len = TELEMETRY_HEADER_LEN;
+    for (int ch = 0; ch < CHANNELS; ch++) {
+        buff[len++] = ch + 1;
+        buff[len++] = SAMPLES;
+        memcpy(buff + len, samples[ch], sizeof(samples[ch]));
+        len += sizeof(samples[ch]);
+    }
+    return len;
+}
+
+static size_t pack_json(void) {
+    char json_buff[256];
+    json_writer_t w;
+    json_bytes = 0;
+
+    json_writer_init(&w, json_buff, sizeof(json_buff), count_flush, NULL);
+    json_object_begin(&w, NULL);
+    json_write_uint(&w, "seq", 7);
+    json_write_uint(&w, "t", 123456);
+    for (int ch = 0; ch < CHANNELS; ch++) {
+        json_array_begin(&w, models[ch].name);
+        for (int i = 0; i < SAMPLES; i++) json_write_int(&w, NULL, samples[ch][i]);
+        json_array_end(&w);
+    }
+    json_object_end(&w);
+    json_writer_finish(&w);
+    return json_bytes;
+}
+
+static void run(const char *name, size_t (*pack)(void), int values) {
+    size_t len = 0;
+    uint64_t start = bench_now_ns();
+    for (int r = 0; r < ROUNDS; r++) {
+        len = pack();
+        BENCH_KEEP(buff);
+    }
+    uint64_t ns = (bench_now_ns() - start) / ROUNDS;
+    printf("%-14s %8zu %10.2f %10llu\n", name, len, (double)len / values, (unsigned long long)ns);
+}
+
+int main(void) {
+    srand(1);
+    for (int ch = 0; ch < CHANNELS; ch++) {
+        int32_t value = models[ch].base;
+        for (int i = 0; i < SAMPLES; i++) {
+            value += rand() % (2 * models[ch].noise + 1) - models[ch].noise;
+            samples[ch][i] = value;
+        }
+    }
+
+    printf("%d channels x %d readings per frame\n", CHANNELS, SAMPLES);
+    printf("%-14s %8s %10s %10s\n", "layout", "bytes", "B/reading", "encode ns");
+    run("delta varint", pack_delta, CHANNELS * SAMPLES);
+    run("latest only", pack_latest, CHANNELS);
+    run("raw int32", pack_raw, CHANNELS * SAMPLES);
+    run("json", pack_json, CHANNELS * SAMPLES);
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "mock_rmt.h"
+#include "mod_ws2812.h"
+
+//# Encoder cost per LED, the table encoder of mod_ws2812.c against the
+//# per-bit one it replaced, driven the way mock_rmt.c drives them: 48
+//# symbol channel memory refilled half a block at a time on the ESP32-C3,
+//# 1024 symbols with DMA. Callbacks per frame is where the refill
+//# interrupts go; on the C3 each one also pays the ISR entry. Host ns,
+//# the ratio is what carries over. The LED itself takes 30 us on air.
+
+#define MAX_LEDS 1000
+#define MAX_SYMBOLS (MAX_LEDS * 24 + 64)
+
+extern const rmt_simple_encoder_config_t simple_encoder_cfg;
+
+static size_t per_bit_callback(const void *data, size_t data_size,
+                            size_t symbols_written, size_t symbols_free,
+                            rmt_symbol_word_t *symbols, bool *done, void *arg)
+{
+    if (symbols_free < 8) {
+        return 0;
+    }
+
+    size_t data_pos = symbols_written / 8;
+    uint8_t *data_bytes = (uint8_t*)data;
+
+    if (data_pos < data_size) {
+        size_t symbol_pos = 0;
+        for (int bitmask = 0x80; bitmask != 0; bitmask >>= 1) {
+            uint8_t check = data_bytes[data_pos]&bitmask;
+            symbols[symbol_pos++] = check ? ws2812_one : ws2812_zero;
+        }
+        return symbol_pos;
+    } else {
+        symbols[0] = ws2812_reset;
+        *done = 1;
+        return 1;
+    }
+}
+
+static const rmt_simple_encoder_config_t per_bit_cfg = {
+    .callback = per_bit_callback,
+};
+
+static uint8_t data[MAX_LEDS * 3];
+static rmt_symbol_word_t symbols[MAX_SYMBOLS];
+
+//! the refill loop of mock_rmt_encode without its canary checks, straight into the output
+static size_t drive(const rmt_simple_encoder_config_t *config, size_t data_size, size_t block, uint32_t *callbacks) {
+    rmt_symbol_word_t overflow[64];
+    size_t written = 0, symbols_free = block;
+    uint32_t calls = 0;
+    bool done = false;
+
+    while (!done) {
+        if (symbols_free == 0) symbols_free = block / 2;
+        size_t count = config->callback(data, data_size, written, symbols_free, &symbols[written], &done, NULL);
+        calls++;
+        if (count == 0) {
+            count = config->callback(data, data_size, written, 64, overflow, &done, NULL);
+            calls++;
+            memcpy(&symbols[written], overflow, count * sizeof(overflow[0]));
+            symbols_free = 0;
+        } else {
+            symbols_free -= count;
+        }
+        written += count;
+    }
+    *callbacks = calls;
+    return written;
+}
+
+static double ns_per_led(const rmt_simple_encoder_config_t *config, uint16_t leds, size_t block, uint32_t *callbacks) {
+    int rounds = 200000 / leds;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < rounds; i++) {
+        size_t count = drive(config, leds * 3, block, callbacks);
+        BENCH_KEEP(symbols[count - 1]);
+    }
+    return (double)(bench_now_ns() - start) / rounds / leds;
+}
+
+int main(void) {
+    const ws2812_strip_config_t config = { .gpio_pin = 8, .led_count = 9 };
+    ws2812_setup_strips(&config, 1);                // builds the table
+    srand(3);
+    for (size_t i = 0; i < sizeof(data); i++) data[i] = rand();
+    memset(symbols, 0, sizeof(symbols));
+
+    printf("ns per LED, callbacks per frame\n");
+    printf("  %5s %5s %8s %8s %6s %6s %6s\n", "leds", "block", "per-bit", "table", "ratio", "cb old", "cb new");
+
+    const uint16_t leds[] = { 9, 144, 1000 };
+    const size_t blocks[] = { SOC_RMT_MEM_WORDS_PER_CHANNEL, 1024 };
+    for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+        for (size_t l = 0; l < sizeof(leds) / sizeof(leds[0]); l++) {
+            uint32_t old_calls, new_calls;
+            double old_ns = ns_per_led(&per_bit_cfg, leds[l], blocks[b], &old_calls);
+            double new_ns = ns_per_led(&simple_encoder_cfg, leds[l], blocks[b], &new_calls);
+            printf("  %5u %5u %8.1f %8.1f %5.1fx %6u %6u\n", leds[l], (unsigned)blocks[b], old_ns, new_ns,
+                   old_ns / new_ns, old_calls, new_calls);
+        }
+    }
+    return 0;
+}
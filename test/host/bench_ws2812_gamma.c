@@ -0,0 +1,50 @@
+#include "test.h"
+
+//# Per frame cost of correct_frame in mod_ws2812.c, compiled in here to
+//# call it on strips of 9, 144 and 1000 LEDs: the plain copy when gamma and
+//# dither are off, the table lookup with rounding, and the lookup with the
+//# carried dither fraction. Host ns per frame and per LED.
+
+#include "mod_ws2812.c"
+
+#define MAX_LEDS 1000
+
+static uint8_t pixels[MAX_LEDS * 3], error[MAX_LEDS * 3], out[MAX_LEDS * 3];
+
+static double frame_ns(uint16_t leds) {
+    ws2812_strip_t strip = { .led_count = leds, .pixels = pixels, .dither_error = error };
+    int frames = 4000000 / leds;
+    uint64_t start = bench_now_ns();
+    for (int f = 0; f < frames; f++) {
+        correct_frame(&strip, out);
+        BENCH_KEEP(out[0]);
+    }
+    return (double)(bench_now_ns() - start) / frames;
+}
+
+int main(void) {
+    srand(4);
+    for (size_t i = 0; i < sizeof(pixels); i++) pixels[i] = rand();
+    memset(error, 0, sizeof(error));
+    memset(out, 0, sizeof(out));
+
+    printf("ns per frame (per LED)\n");
+    printf("  %5s %14s %14s %14s\n", "leds", "copy", "gamma", "gamma+dither");
+
+    const uint16_t leds[] = { 9, 144, 1000 };
+    for (size_t l = 0; l < sizeof(leds) / sizeof(leds[0]); l++) {
+        double ns[3];
+        ws2812_set_gamma(1.0f, 1.0f, 1.0f);
+        ws2812_set_dither(false);
+        ns[0] = frame_ns(leds[l]);
+        ws2812_set_gamma(2.2f, 2.2f, 2.2f);
+        ns[1] = frame_ns(leds[l]);
+        ws2812_set_dither(true);
+        ns[2] = frame_ns(leds[l]);
+
+        printf("  %5u", leds[l]);
+        for (int i = 0; i < 3; i++) printf(" %7.0f (%4.1f)", ns[i], ns[i] / leds[l]);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "test.h"
+#include "ws_frame.h"
+
+//# ws_frame_unmask against the byte loop it replaced, per payload size and
+//# start alignment. The byte loop is kept out of line so the compiler can't
+//# vectorise it into something the Xtensa build would never get.
+
+#define TOTAL_BYTES (64u * 1024 * 1024)
+
+static uint8_t buff[4096 + 4];
+
+__attribute__((noinline, optimize("no-tree-vectorize")))
+static void unmask_bytewise(uint8_t *data, size_t len, const uint8_t mask[4], size_t offset) {
+    for (size_t i = 0; i < len; i++) data[i] ^= mask[(offset + i) & 3];
+}
+
+typedef void (*unmask_fn)(uint8_t *data, size_t len, const uint8_t mask[4], size_t offset);
+
+static double run(unmask_fn fn, size_t len, size_t align) {
+    const uint8_t mask[4] = { 0x37, 0xFA, 0x21, 0x3D };
+    size_t rounds = TOTAL_BYTES / len;
+
+    uint64_t start = bench_now_ns();
+    for (size_t r = 0; r < rounds; r++) {
+        fn(buff + align, len, mask, r);
+        BENCH_KEEP(buff);
+    }
+    return (double)(bench_now_ns() - start) / ((double)rounds * len);
+}
+
+int main(void) {
+    memset(buff, 0x55, sizeof(buff));
+    printf("%6s %6s %12s %12s %8s\n", "bytes", "align", "byte ns/B", "word ns/B", "speedup");
+
+    const size_t sizes[] = { 16, 125, 1024, 4096 };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (size_t align = 0; align < 4; align += 3) {
+            double bytewise = run(unmask_bytewise, sizes[s], align);
+            double word = run(ws_frame_unmask, sizes[s], align);
+            printf("%6zu %6zu %12.3f %12.3f %7.1fx\n", sizes[s], align, bytewise, word, bytewise / word);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "espnow_mesh.c"
+
+#include "espnow_mesh_nodes.h"
+#include "mock_espnow.h"
+
+//! everything espnow_mesh.c keeps per node
+typedef struct {
+    uint8_t self_addr[6];
+    uint8_t next_msg_id;
+    uint32_t groups[256 / 32];
+    dedup_entry_t dedup_cache[ESPNOW_MESH_DEDUP_SIZE];
+    uint32_t dedup_clock;
+    forward_slot_t forward_slots[ESPNOW_MESH_FORWARD_SLOTS];
+    espnow_mesh_stats_t mesh_stats;
+} node_state_t;
+
+static node_state_t nodes[MESH_NODES_MAX];
+static uint64_t links[MESH_NODES_MAX];
+static int node_count;
+static int selected = -1;
+static uint32_t frames;
+
+//! the frames of mod_espnow.c, without sealing or rate limit
+esp_err_t espnow_seal_message(espnow_message_t *message) {
+    return ESP_OK;
+}
+
+esp_err_t espnow_send(uint8_t *data, size_t len) {
+    return esp_now_send(broadcast_mac, data, len);
+}
+
+
+//! STATE
+
+static void node_save(int node) {
+    node_state_t *state = &nodes[node];
+    memcpy(state->self_addr, self_addr, sizeof(self_addr));
+    state->next_msg_id = next_msg_id;
+    memcpy(state->groups, groups, sizeof(groups));
+    memcpy(state->dedup_cache, dedup_cache, sizeof(dedup_cache));
+    state->dedup_clock = dedup_clock;
+    memcpy(state->forward_slots, forward_slots, sizeof(forward_slots));
+    state->mesh_stats = mesh_stats;
+}
+
+static void node_load(int node) {
+    const node_state_t *state = &nodes[node];
+    memcpy(self_addr, state->self_addr, sizeof(self_addr));
+    next_msg_id = state->next_msg_id;
+    memcpy(groups, state->groups, sizeof(groups));
+    memcpy(dedup_cache, state->dedup_cache, sizeof(dedup_cache));
+    dedup_clock = state->dedup_clock;
+    memcpy(forward_slots, state->forward_slots, sizeof(forward_slots));
+    mesh_stats = state->mesh_stats;
+}
+
+void mesh_nodes_select(int node) {
+    if (node == selected) return;
+    if (selected >= 0) node_save(selected);
+    node_load(node);
+    selected = node;
+}
+
+void mesh_nodes_setup(int count) {
+    node_count = count;
+    selected = -1;
+    frames = 0;
+    memset(nodes, 0, sizeof(nodes));
+    memset(links, 0, sizeof(links));
+    mock_espnow_reset();
+
+    for (int i = 0; i < count; i++) {
+        uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, i >> 8, i };
+        //! espnow_mesh_setup only writes the mac and a random first msg_id
+        memset(&mesh_stats, 0, sizeof(mesh_stats));
+        memset(groups, 0, sizeof(groups));
+        memset(dedup_cache, 0, sizeof(dedup_cache));
+        memset(forward_slots, 0, sizeof(forward_slots));
+        dedup_clock = 0;
+        espnow_mesh_setup(mac);
+        node_save(i);
+    }
+}
+
+void mesh_nodes_link(int a, int b) {
+    links[a] |= 1ull << b;
+    links[b] |= 1ull << a;
+}
+
+const uint8_t *mesh_nodes_mac(int node) {
+    return nodes[node].self_addr;
+}
+
+void mesh_nodes_get_stats(int node, espnow_mesh_stats_t *stats) {
+    mesh_nodes_select(node);
+    espnow_mesh_get_stats(stats);
+}
+
+uint32_t mesh_nodes_frames(void) {
+    return frames;
+}
+
+
+//! AIR
+
+//! whatever node sent reaches every node linked to it
+static void air_deliver(int node, uint64_t current_time) {
+    mock_espnow_frame_t frame;
+    while (mock_espnow_pop(&frame)) {
+        espnow_message_t message = { 0 };
+        memcpy(&message, frame.data, frame.len);
+        frames++;
+
+        for (int i = 0; i < node_count; i++) {
+            if (!(links[node] & (1ull << i))) continue;
+            mesh_nodes_select(i);
+            espnow_mesh_receive(nodes[node].self_addr, &message, current_time);
+        }
+    }
+}
+
+esp_err_t mesh_nodes_send(int node, espnow_message_t *message, uint64_t current_time) {
+    mesh_nodes_select(node);
+    esp_err_t err = espnow_mesh_send(message);
+    air_deliver(node, current_time);
+    return err;
+}
+
+void mesh_nodes_step(uint64_t current_time) {
+    for (int i = 0; i < node_count; i++) {
+        mesh_nodes_select(i);
+        espnow_mesh_task(current_time);
+        air_deliver(i, current_time);
+    }
+}
+
+bool mesh_nodes_idle(void) {
+    if (selected >= 0) node_save(selected);
+    for (int i = 0; i < node_count; i++) {
+        for (int j = 0; j < ESPNOW_MESH_FORWARD_SLOTS; j++) {
+            if (nodes[i].forward_slots[j].used) return false;
+        }
+    }
+    return true;
+}
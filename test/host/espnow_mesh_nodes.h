@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "espnow_mesh.h"
+
+//# Many mesh nodes in one process: espnow_mesh.c is built into
+//# espnow_mesh_nodes.c, and each node keeps its own copy of the module's
+//# static state, which is swapped in by mesh_nodes_select. Frames a node
+//# sends through the mocked driver go on air at once to the nodes linked to
+//# it. Sealing and the origin rate limit of mod_espnow.c are left out.
+
+#define MESH_NODES_MAX 64
+
+//! node i gets the mac 02:00:00:00:<i>, no links, no groups
+void mesh_nodes_setup(int count);
+void mesh_nodes_link(int a, int b);
+const uint8_t *mesh_nodes_mac(int node);
+
+//! later espnow_mesh_* calls act on this node
+void mesh_nodes_select(int node);
+
+//! originates through espnow_mesh_send on node, the frame reaches its neighbours at once
+esp_err_t mesh_nodes_send(int node, espnow_message_t *message, uint64_t current_time);
+
+//! espnow_mesh_task on every node, forwards that became due go on air
+void mesh_nodes_step(uint64_t current_time);
+
+//! no node holds a forward anymore
+bool mesh_nodes_idle(void);
+
+void mesh_nodes_get_stats(int node, espnow_mesh_stats_t *stats);
+
+//! frames put on air since setup
+uint32_t mesh_nodes_frames(void);
@@ -0,0 +1,20 @@
+//# The far bridge of the simulation: lora_bridge.c once more, its public
+//# functions and the radio and mesh hooks renamed so the mocks can tell the
+//# two sides apart. Its static state is separate from the near copy.
+
+#define lora_bridge_setup           far_bridge_setup
+#define lora_bridge_add_group       far_bridge_add_group
+#define lora_bridge_remove_group    far_bridge_remove_group
+#define lora_bridge_task            far_bridge_task
+#define lora_bridge_get_stats       far_bridge_get_stats
+
+#define mod_sx127_radio_setup       far_radio_setup
+#define mod_sx127_radio_poll        far_radio_poll
+#define mod_sx127_radio_busy        far_radio_busy
+#define mod_sx127_radio_send        far_radio_send
+
+#define espnow_set_tap              far_set_tap
+#define espnow_mesh_inject          far_mesh_inject
+#define espnow_mesh_join_group      far_mesh_join_group
+
+#include "sx127x/lora_bridge.c"
@@ -0,0 +1,91 @@
+#include <string.h>
+
+#include "mock_espnow.h"
+
+#define MOCK_ESPNOW_PEERS 20
+
+static mock_espnow_frame_t queue[MOCK_ESPNOW_QUEUE];
+static uint32_t queue_head, queue_tail;
+
+static uint8_t peers[MOCK_ESPNOW_PEERS][ESP_NOW_ETH_ALEN];
+static int peer_count;
+
+static esp_now_recv_cb_t recv_cb;
+static esp_now_send_cb_t send_cb;
+
+void mock_espnow_reset(void) {
+    queue_head = queue_tail = 0;
+}
+
+bool mock_espnow_pop(mock_espnow_frame_t *frame) {
+    if (queue_tail == queue_head) return false;
+    *frame = queue[queue_tail++ % MOCK_ESPNOW_QUEUE];
+    return true;
+}
+
+int mock_espnow_pending(void) {
+    return queue_head - queue_tail;
+}
+
+int mock_espnow_peer_count(void) {
+    return peer_count;
+}
+
+void mock_espnow_receive(const uint8_t *src_addr, const void *data, size_t len) {
+    uint8_t src[ESP_NOW_ETH_ALEN], dest[ESP_NOW_ETH_ALEN] = { 0 };
+    wifi_pkt_rx_ctrl_t rx_ctrl = { .rssi = -40, .channel = 6 };
+    memcpy(src, src_addr, sizeof(src));
+
+    esp_now_recv_info_t info = { .src_addr = src, .des_addr = dest, .rx_ctrl = &rx_ctrl };
+    if (recv_cb) recv_cb(&info, data, len);
+}
+
+static int find_peer(const uint8_t *mac) {
+    for (int i = 0; i < peer_count; i++) {
+        if (memcmp(peers[i], mac, ESP_NOW_ETH_ALEN) == 0) return i;
+    }
+    return -1;
+}
+
+esp_err_t esp_now_init(void) { return ESP_OK; }
+esp_err_t esp_now_set_pmk(const uint8_t *pmk) { return ESP_OK; }
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) {
+    recv_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) {
+    send_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer) {
+    if (find_peer(peer->peer_addr) >= 0) return ESP_ERR_ESPNOW_EXIST;
+    if (peer_count >= MOCK_ESPNOW_PEERS) return ESP_ERR_NO_MEM;
+    memcpy(peers[peer_count++], peer->peer_addr, ESP_NOW_ETH_ALEN);
+    return ESP_OK;
+}
+
+esp_err_t esp_now_del_peer(const uint8_t *peer_addr) {
+    int index = find_peer(peer_addr);
+    if (index < 0) return ESP_ERR_ESPNOW_NOT_FOUND;
+    memcpy(peers[index], peers[--peer_count], ESP_NOW_ETH_ALEN);
+    return ESP_OK;
+}
+
+//! the driver only takes frames for registered peers
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len) {
+    static const uint8_t broadcast[ESP_NOW_ETH_ALEN] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    if (len > ESP_NOW_MAX_DATA_LEN) return ESP_ERR_INVALID_ARG;
+    if (memcmp(peer_addr, broadcast, sizeof(broadcast)) != 0 && find_peer(peer_addr) < 0) return ESP_ERR_ESPNOW_NOT_FOUND;
+    if (queue_head - queue_tail >= MOCK_ESPNOW_QUEUE) return ESP_ERR_NO_MEM;
+
+    mock_espnow_frame_t *frame = &queue[queue_head++ % MOCK_ESPNOW_QUEUE];
+    memcpy(frame->mac, peer_addr, sizeof(frame->mac));
+    memcpy(frame->data, data, len);
+    frame->len = len;
+
+    if (send_cb) send_cb(peer_addr, ESP_NOW_SEND_SUCCESS);
+    return ESP_OK;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "esp_now.h"
+
+//# Stands in for the ESP-NOW driver. Every esp_now_send lands in a FIFO the
+//# test pops from, mock_espnow_receive runs the registered receive callback
+//# on the calling thread like the WiFi task would.
+
+#define MOCK_ESPNOW_QUEUE 64
+
+typedef struct {
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    uint8_t data[ESP_NOW_MAX_DATA_LEN];
+    size_t len;
+} mock_espnow_frame_t;
+
+//! drops queued frames, peers and callbacks stay like in the driver
+void mock_espnow_reset(void);
+
+//! oldest sent frame first, false when none is left
+bool mock_espnow_pop(mock_espnow_frame_t *frame);
+int mock_espnow_pending(void);
+int mock_espnow_peer_count(void);
+
+void mock_espnow_receive(const uint8_t *src_addr, const void *data, size_t len);
@@ -0,0 +1,295 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <strings.h>
+#include <time.h>
+
+#include "mock_httpd.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+
+#define MOCK_MAX_HANDLERS 16
+
+typedef struct {
+    mock_response_t *response;
+    const char *range;
+    int refs;                       // the httpd task while dispatching, plus one per async copy
+    int sockfd;
+} mock_conn_t;
+
+static httpd_uri_t handlers[MOCK_MAX_HANDLERS];
+static int handler_count;
+static httpd_err_handler_func_t not_found_handler;
+static httpd_uri_match_func_t match_fn;
+static uint32_t send_delay_us;
+static uint32_t send_bytes_per_ms;
+static pthread_mutex_t link_lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_sockfd = 50;
+
+// open connections by sockfd, for httpd_sess_trigger_close
+static mock_conn_t *live_conns[256];
+static pthread_mutex_t live_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void conn_track(mock_conn_t *conn, bool open) {
+    pthread_mutex_lock(&live_lock);
+    live_conns[conn->sockfd % 256] = open ? conn : NULL;
+    pthread_mutex_unlock(&live_lock);
+}
+
+void mock_httpd_reset(void) {
+    handler_count = 0;
+    not_found_handler = NULL;
+    match_fn = NULL;
+    send_delay_us = 0;
+    send_bytes_per_ms = 0;
+}
+
+void mock_httpd_set_send_delay(uint32_t delay_us) {
+    send_delay_us = delay_us;
+}
+
+void mock_httpd_set_send_rate(uint32_t bytes_per_ms) {
+    send_bytes_per_ms = bytes_per_ms;
+}
+
+void mock_response_init(mock_response_t *response) {
+    memset(response, 0, sizeof(*response));
+    strcpy(response->status, "200 OK");
+    pthread_mutex_init(&response->lock, NULL);
+    pthread_cond_init(&response->cond, NULL);
+}
+
+void mock_response_free(mock_response_t *response) {
+    free(response->body);
+    response->body = NULL;
+}
+
+bool mock_response_wait(mock_response_t *response, uint32_t timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&response->lock);
+    while (!response->complete) {
+        if (pthread_cond_timedwait(&response->cond, &response->lock, &deadline) != 0) break;
+    }
+    bool complete = response->complete;
+    pthread_mutex_unlock(&response->lock);
+    return complete;
+}
+
+static void response_complete(mock_response_t *response) {
+    pthread_mutex_lock(&response->lock);
+    response->complete = true;
+    response->done_us = esp_timer_get_time();
+    pthread_cond_broadcast(&response->cond);
+    pthread_mutex_unlock(&response->lock);
+}
+
+//! the response is done once nobody holds the connection anymore
+static void conn_release(mock_conn_t *conn) {
+    if (__atomic_sub_fetch(&conn->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    response_complete(conn->response);
+    conn_track(conn, false);
+    free(conn);
+}
+
+static mock_response_t *response_of(httpd_req_t *req) {
+    return ((mock_conn_t*)req->aux)->response;
+}
+
+static void append(mock_response_t *response, const char *buf, size_t len) {
+    pthread_mutex_lock(&response->lock);
+    if (response->body_len + len > response->body_cap) {
+        response->body_cap = (response->body_len + len) * 2;
+        response->body = realloc(response->body, response->body_cap);
+    }
+    memcpy(response->body + response->body_len, buf, len);
+    response->body_len += len;
+    response->sends++;
+    pthread_mutex_unlock(&response->lock);
+}
+
+//! SERVER
+
+static httpd_config_t started_config;
+
+const httpd_config_t *mock_httpd_config(void) {
+    return &started_config;
+}
+
+bool httpd_uri_match_wildcard(const char *reference_uri, const char *uri_to_match, size_t match_upto) {
+    size_t ref_len = strlen(reference_uri);
+    if (ref_len && reference_uri[ref_len - 1] == '*') {
+        return match_upto >= ref_len - 1 && strncmp(reference_uri, uri_to_match, ref_len - 1) == 0;
+    }
+    return ref_len == match_upto && strncmp(reference_uri, uri_to_match, match_upto) == 0;
+}
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config) {
+    //! the check httpd_create does, it keeps 3 sockets for itself
+    if (config->max_open_sockets > CONFIG_LWIP_MAX_SOCKETS - 3) return ESP_ERR_INVALID_ARG;
+    started_config = *config;
+    match_fn = config->uri_match_fn;
+    *handle = (httpd_handle_t)handlers;
+    return ESP_OK;
+}
+
+esp_err_t httpd_stop(httpd_handle_t handle) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler) {
+    if (handler_count == MOCK_MAX_HANDLERS) return ESP_ERR_NO_MEM;
+    handlers[handler_count++] = *uri_handler;
+    return ESP_OK;
+}
+
+esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_code_t error, httpd_err_handler_func_t handler) {
+    if (error == HTTPD_404_NOT_FOUND) not_found_handler = handler;
+    return ESP_OK;
+}
+
+esp_err_t mock_httpd_request(httpd_method_t method, const char *uri, const char *range, mock_response_t *response) {
+    mock_conn_t *conn = calloc(1, sizeof(mock_conn_t));
+    conn->response = response;
+    conn->range = range;
+    conn->refs = 1;
+    conn->sockfd = __atomic_fetch_add(&next_sockfd, 1, __ATOMIC_RELAXED);
+    conn_track(conn, true);
+
+    httpd_req_t req = { .handle = (httpd_handle_t)handlers, .method = method, .aux = conn };
+    strncpy(req.uri, uri, HTTPD_MAX_URI_LEN);
+    response->start_us = esp_timer_get_time();
+
+    size_t match_upto = strcspn(uri, "?");
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    bool found = false;
+
+    for (int i = 0; i < handler_count; i++) {
+        bool match = match_fn ? match_fn(handlers[i].uri, uri, match_upto)
+                              : strncmp(handlers[i].uri, uri, match_upto) == 0 && handlers[i].uri[match_upto] == '\0';
+        if (!match || handlers[i].method != method) continue;
+
+        req.user_ctx = handlers[i].user_ctx;
+        err = handlers[i].handler(&req);
+        found = true;
+        break;
+    }
+    if (!found && not_found_handler) err = not_found_handler(&req, HTTPD_404_NOT_FOUND);
+
+    // an async copy keeps the connection until it completes
+    conn_release(conn);
+    return err;
+}
+
+//! REQUESTS
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *req, httpd_req_t **out) {
+    httpd_req_t *copy = malloc(sizeof(httpd_req_t));
+    if (copy == NULL) return ESP_ERR_NO_MEM;
+
+    *copy = *req;
+    __atomic_add_fetch(&((mock_conn_t*)req->aux)->refs, 1, __ATOMIC_ACQ_REL);
+    *out = copy;
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *req) {
+    conn_release(req->aux);
+    free(req);
+    return ESP_OK;
+}
+
+int httpd_req_to_sockfd(httpd_req_t *req) {
+    return ((mock_conn_t*)req->aux)->sockfd;
+}
+
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd) {
+    pthread_mutex_lock(&live_lock);
+    mock_conn_t *conn = live_conns[sockfd % 256];
+    if (conn && conn->sockfd == sockfd) conn->response->closed = true;
+    pthread_mutex_unlock(&live_lock);
+    return conn ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size) {
+    const char *range = ((mock_conn_t*)req->aux)->range;
+    if (strcasecmp(field, "Range") != 0 || range == NULL) return ESP_ERR_NOT_FOUND;
+    if (strlen(range) >= val_size) return ESP_ERR_INVALID_SIZE;
+    strcpy(val, range);
+    return ESP_OK;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+    return 0;
+}
+
+//! RESPONSES
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+    mock_response_t *response = response_of(req);
+    strncpy(response->status, status, sizeof(response->status) - 1);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+    if (strcasecmp(field, "Content-Range") == 0) {
+        mock_response_t *response = response_of(req);
+        strncpy(response->content_range, value, sizeof(response->content_range) - 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = strlen(buf);
+    if (buf_len > 0) append(response_of(req), buf, buf_len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    if (buf_len == HTTPD_RESP_USE_STRLEN) buf_len = buf ? strlen(buf) : 0;
+    if (buf == NULL || buf_len == 0) {
+        response_of(req)->chunked_end = true;
+        return ESP_OK;
+    }
+    if (send_delay_us) usleep(send_delay_us);
+    if (send_bytes_per_ms) {
+        //! one link for every connection, concurrent sends queue for it
+        pthread_mutex_lock(&link_lock);
+        usleep((uint64_t)buf_len * 1000 / send_bytes_per_ms);
+        pthread_mutex_unlock(&link_lock);
+    }
+    append(response_of(req), buf, buf_len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg) {
+    static const char *statuses[] = {
+        [HTTPD_500_INTERNAL_SERVER_ERROR] = "500 Internal Server Error",
+        [HTTPD_400_BAD_REQUEST] = "400 Bad Request",
+        [HTTPD_404_NOT_FOUND] = "404 Not Found",
+        [HTTPD_408_REQ_TIMEOUT] = "408 Request Timeout",
+    };
+    httpd_resp_set_status(req, statuses[error]);
+    return httpd_resp_send(req, msg ? msg : statuses[error], HTTPD_RESP_USE_STRLEN);
+}
+
+//! CLIENT, never connects on the host
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config) { return NULL; }
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client) { return ESP_FAIL; }
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client) { return ESP_OK; }
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method) { return ESP_OK; }
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value) { return ESP_OK; }
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len) { return ESP_OK; }
+bool esp_http_client_is_chunked_response(esp_http_client_handle_t client) { return false; }
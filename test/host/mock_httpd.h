@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "esp_http_server.h"
+
+//# Stands in for the httpd task and its sockets. mock_httpd_request runs the
+//# registered handler on the calling thread like the httpd task would, every
+//# response call is recorded into a mock_response_t the test can wait on.
+
+typedef struct {
+    char status[40];                // "200 OK" unless the handler set one
+    char content_range[64];
+    uint8_t *body;
+    size_t body_len;
+    size_t body_cap;
+    uint32_t sends;                 // send and send_chunk calls carrying data
+    bool chunked_end;               // the terminating empty chunk was sent
+    bool complete;                  // handler returned, or the async copy completed
+    bool closed;                    // the handler asked for the socket to be closed
+    uint64_t start_us;
+    uint64_t done_us;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} mock_response_t;
+
+//! forgets registered handlers, clears the send delay and rate
+void mock_httpd_reset(void);
+
+//! the config of the last successful httpd_start
+const httpd_config_t *mock_httpd_config(void);
+
+//! every body chunk blocks this long, a slow client
+void mock_httpd_set_send_delay(uint32_t delay_us);
+
+//! on top of the delay, every body chunk takes its length at this rate on a link
+//! shared by all connections, 0 for no limit
+void mock_httpd_set_send_rate(uint32_t bytes_per_ms);
+
+void mock_response_init(mock_response_t *response);
+void mock_response_free(mock_response_t *response);
+bool mock_response_wait(mock_response_t *response, uint32_t timeout_ms);
+
+//! range may be NULL, uri may carry a query string
+esp_err_t mock_httpd_request(httpd_method_t method, const char *uri, const char *range, mock_response_t *response);
@@ -0,0 +1,159 @@
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include "bd/lfs_emubd.h"
+#include "mock_lfs_vfs.h"
+
+#define MOCK_LFS_FD_BASE 1000
+#define MOCK_LFS_MAX_FILES 4
+#define MOCK_LFS_STDIO_BUFFER 128       // BUFSIZ of ESP-IDF's newlib
+
+int __real_open(const char *path, int flags, ...);
+ssize_t __real_read(int fd, void *buf, size_t count);
+int __real_close(int fd);
+
+static lfs_emubd_t bd;
+static const struct lfs_emubd_config bd_config = {
+    .read_size = 128,                   // CONFIG_LITTLEFS_READ_SIZE
+    .prog_size = 128,
+    .erase_size = MOCK_LFS_BLOCK_SIZE,
+    .erase_count = 0x70000 / MOCK_LFS_BLOCK_SIZE,   // partitions.csv storage
+    .erase_value = -1,
+};
+static uint8_t read_buffer[512], prog_buffer[512], lookahead_buffer[128];
+static struct lfs_config cfg = {
+    .context = &bd,
+    .read = lfs_emubd_read,
+    .prog = lfs_emubd_prog,
+    .erase = lfs_emubd_erase,
+    .sync = lfs_emubd_sync,
+    .read_size = 128,
+    .prog_size = 128,
+    .block_size = MOCK_LFS_BLOCK_SIZE,
+    .block_count = 0x70000 / MOCK_LFS_BLOCK_SIZE,
+    .block_cycles = 512,
+    .cache_size = 512,                  // esp_littlefs defaults
+    .lookahead_size = 128,
+    .read_buffer = read_buffer,
+    .prog_buffer = prog_buffer,
+    .lookahead_buffer = lookahead_buffer,
+};
+
+static lfs_t lfs;
+static bool mounted;
+static lfs_file_t files[MOCK_LFS_MAX_FILES];
+static bool file_used[MOCK_LFS_MAX_FILES];
+static uint32_t file_reads;
+static char stdio_buffers[MOCK_LFS_MAX_FILES][MOCK_LFS_STDIO_BUFFER];
+
+void mock_lfs_mount(void) {
+    if (mounted) mock_lfs_unmount();
+    lfs_emubd_create(&cfg, &bd_config);
+    lfs_format(&lfs, &cfg);
+    lfs_mount(&lfs, &cfg);
+    mounted = true;
+    file_reads = 0;
+}
+
+void mock_lfs_unmount(void) {
+    lfs_unmount(&lfs);
+    lfs_emubd_destroy(&cfg);
+    mounted = false;
+}
+
+int mock_lfs_write(const char *path, const void *data, size_t len) {
+    lfs_file_t file;
+    int err = lfs_file_open(&lfs, &file, path, LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC);
+    if (err < 0) return err;
+    lfs_ssize_t written = lfs_file_write(&lfs, &file, data, len);
+    lfs_file_close(&lfs, &file);
+    return written == (lfs_ssize_t)len ? 0 : -1;
+}
+
+uint32_t mock_lfs_file_reads(void) { return file_reads; }
+uint64_t mock_lfs_bd_read_bytes(void) { return lfs_emubd_readed(&cfg); }
+
+static const char *lfs_path(const char *path) {
+    size_t base_len = strlen(MOCK_LFS_BASE);
+    if (strncmp(path, MOCK_LFS_BASE "/", base_len + 1) != 0) return NULL;
+    return path + base_len + 1;
+}
+
+static int file_open(const char *path) {
+    for (int i = 0; i < MOCK_LFS_MAX_FILES; i++) {
+        if (file_used[i]) continue;
+        if (lfs_file_open(&lfs, &files[i], path, LFS_O_RDONLY) < 0) return -1;
+        file_used[i] = true;
+        return i;
+    }
+    return -1;
+}
+
+static ssize_t file_read(int index, void *buf, size_t count) {
+    file_reads++;
+    lfs_ssize_t len = lfs_file_read(&lfs, &files[index], buf, count);
+    return len < 0 ? -1 : len;
+}
+
+static void file_close(int index) {
+    lfs_file_close(&lfs, &files[index]);
+    file_used[index] = false;
+}
+
+
+//! VFS
+
+int __wrap_open(const char *path, int flags, ...) {
+    const char *relative = lfs_path(path);
+    if (relative == NULL) {
+        va_list args;
+        va_start(args, flags);
+        int mode = va_arg(args, int);
+        va_end(args);
+        return __real_open(path, flags, mode);
+    }
+    if ((flags & O_ACCMODE) != O_RDONLY) return -1;
+
+    int index = file_open(relative);
+    return index < 0 ? -1 : MOCK_LFS_FD_BASE + index;
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t count) {
+    if (fd < MOCK_LFS_FD_BASE) return __real_read(fd, buf, count);
+    return file_read(fd - MOCK_LFS_FD_BASE, buf, count);
+}
+
+int __wrap_close(int fd) {
+    if (fd < MOCK_LFS_FD_BASE) return __real_close(fd);
+    file_close(fd - MOCK_LFS_FD_BASE);
+    return 0;
+}
+
+
+//! STDIO
+
+static ssize_t cookie_read(void *cookie, char *buf, size_t size) {
+    return file_read((intptr_t)cookie, buf, size);
+}
+
+static int cookie_close(void *cookie) {
+    file_close((intptr_t)cookie);
+    return 0;
+}
+
+FILE *mock_lfs_fopen(const char *path) {
+    const char *relative = lfs_path(path);
+    int index = file_open(relative ? relative : path);
+    if (index < 0) return NULL;
+
+    FILE *file = fopencookie((void *)(intptr_t)index, "r", (cookie_io_functions_t){
+        .read = cookie_read,
+        .close = cookie_close,
+    });
+    //! glibc ignores the size without a buffer of its own
+    setvbuf(file, stdio_buffers[index], _IOFBF, MOCK_LFS_STDIO_BUFFER);
+    return file;
+}
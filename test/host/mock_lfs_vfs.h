@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "lfs.h"
+
+//# The "storage" partition on lfs_emubd, mounted at /littlefs like the
+//# esp_littlefs VFS does on the device. Link with
+//#   -Wl,--wrap=open,--wrap=read,--wrap=close
+//# and open/read/close on /littlefs paths become lfs_file_* calls, one
+//# lfs_file_read per read() as through the VFS; other paths pass through.
+
+#define MOCK_LFS_BASE "/littlefs"
+#define MOCK_LFS_BLOCK_SIZE 4096
+
+//! formats and mounts a fresh partition
+void mock_lfs_mount(void);
+void mock_lfs_unmount(void);
+
+//! path relative to MOCK_LFS_BASE, replaces the file
+int mock_lfs_write(const char *path, const void *data, size_t len);
+
+//! the old stdio path: a FILE over the same lfs file with newlib's 128 byte buffer
+FILE *mock_lfs_fopen(const char *path);
+
+//! lfs_file_read calls and bytes the block device read since mount
+uint32_t mock_lfs_file_reads(void);
+uint64_t mock_lfs_bd_read_bytes(void);
@@ -0,0 +1,176 @@
+#include <string.h>
+#include <stdlib.h>
+#include <sys/param.h>
+
+#include "esp_timer.h"
+#include "sx127x/mod_sx127x.h"
+#include "sx127x/lora_bridge.h"
+#include "mock_lora.h"
+
+#define MOCK_LORA_IN_FLIGHT 4
+
+// mod_sx127x.c settings: SF7, 125 kHz, 8 symbol preamble, CR 4/5
+#define LORA_SF 7
+#define LORA_BW_HZ 125000
+#define LORA_PREAMBLE 8
+#define LORA_CR 1
+
+typedef struct {
+    bool used;
+    uint8_t data[255];
+    uint8_t len;
+    uint64_t end_time;
+} air_packet_t;
+
+typedef struct {
+    mod_sx127_rx_cb rx_callback;
+    espnow_message_cb tap;
+    uint64_t tx_start, tx_end;          // last transmission, the receiver is deaf meanwhile
+    bool drop_next;
+    uint32_t packets;
+    air_packet_t in_flight[MOCK_LORA_IN_FLIGHT];    // sent by this side, not yet received
+} side_t;
+
+static side_t sides[2];
+static double loss_rate;
+static uint32_t collisions;
+static mock_lora_inject_cb inject_callback;
+
+void mock_lora_reset(double loss) {
+    for (int i = 0; i < 2; i++) {
+        side_t *side = &sides[i];
+        side->tx_start = side->tx_end = 0;
+        side->drop_next = false;
+        side->packets = 0;
+        memset(side->in_flight, 0, sizeof(side->in_flight));
+    }
+    loss_rate = loss;
+    collisions = 0;
+}
+
+void mock_lora_set_inject_cb(mock_lora_inject_cb callback) {
+    inject_callback = callback;
+}
+
+void mock_lora_tap(int side, const espnow_message_t *message) {
+    espnow_message_t copy = *message;
+    espnow_received_message_t received = { .message = &copy, .data_len = message->data_len };
+    if (sides[side].tap) sides[side].tap(received);
+}
+
+void mock_lora_drop_next(int side) {
+    sides[side].drop_next = true;
+}
+
+uint32_t mock_lora_packets(int side) {
+    return sides[side].packets;
+}
+
+uint32_t mock_lora_collisions(void) {
+    return collisions;
+}
+
+
+//! RADIO
+
+uint32_t mod_sx127_time_on_air_us(uint8_t len) {
+    const uint32_t symbol_us = (1000000ULL << LORA_SF) / LORA_BW_HZ;
+    const int32_t de = LORA_SF >= 11 ? 1 : 0;
+
+    int32_t bits = 8 * len - 4 * LORA_SF + 28 + 16;
+    int32_t per_block = 4 * (LORA_SF - 2 * de);
+    int32_t blocks = bits > 0 ? (bits + per_block - 1) / per_block : 0;
+    uint32_t payload_symbols = 8 + blocks * (LORA_CR + 4);
+    return ((LORA_PREAMBLE * 4 + 17) * symbol_us) / 4 + payload_symbols * symbol_us;
+}
+
+static bool busy(int index) {
+    return (uint64_t)esp_timer_get_time() < sides[index].tx_end;
+}
+
+static esp_err_t send(int index, const uint8_t *data, uint8_t len) {
+    side_t *side = &sides[index];
+    if (busy(index)) return ESP_ERR_INVALID_STATE;
+
+    uint64_t now = esp_timer_get_time();
+    side->tx_start = now;
+    side->tx_end = now + mod_sx127_time_on_air_us(len);
+    side->packets++;
+
+    bool lost = side->drop_next || (loss_rate > 0 && rand() < loss_rate * RAND_MAX);
+    side->drop_next = false;
+    if (lost) return ESP_OK;
+
+    for (int i = 0; i < MOCK_LORA_IN_FLIGHT; i++) {
+        air_packet_t *packet = &side->in_flight[i];
+        if (packet->used) continue;
+
+        *packet = (air_packet_t){ .used = true, .len = len, .end_time = side->tx_end };
+        memcpy(packet->data, data, len);
+        break;
+    }
+    return ESP_OK;
+}
+
+//! packets of the other side that finished arrive, unless this side was talking over them
+static void poll(int index) {
+    side_t *self = &sides[index], *other = &sides[!index];
+    uint64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < MOCK_LORA_IN_FLIGHT; i++) {
+        air_packet_t *packet = &other->in_flight[i];
+        if (!packet->used || packet->end_time > now) continue;
+        packet->used = false;
+
+        uint64_t start = packet->end_time - mod_sx127_time_on_air_us(packet->len);
+        if (self->tx_start < packet->end_time && self->tx_end > start) {
+            collisions++;
+            continue;
+        }
+        if (self->rx_callback) self->rx_callback(packet->data, packet->len, -80);
+    }
+}
+
+void mod_sx127_radio_setup(M_Spi_Conf *config, mod_sx127_rx_cb callback) { sides[MOCK_LORA_NEAR].rx_callback = callback; }
+void mod_sx127_radio_poll(void) { poll(MOCK_LORA_NEAR); }
+bool mod_sx127_radio_busy(void) { return busy(MOCK_LORA_NEAR); }
+esp_err_t mod_sx127_radio_send(const uint8_t *data, uint8_t len) { return send(MOCK_LORA_NEAR, data, len); }
+
+void far_radio_setup(M_Spi_Conf *config, mod_sx127_rx_cb callback) { sides[MOCK_LORA_FAR].rx_callback = callback; }
+void far_radio_poll(void) { poll(MOCK_LORA_FAR); }
+bool far_radio_busy(void) { return busy(MOCK_LORA_FAR); }
+esp_err_t far_radio_send(const uint8_t *data, uint8_t len) { return send(MOCK_LORA_FAR, data, len); }
+
+
+//! MESH
+
+void espnow_set_tap(espnow_message_cb tap) { sides[MOCK_LORA_NEAR].tap = tap; }
+void far_set_tap(espnow_message_cb tap) { sides[MOCK_LORA_FAR].tap = tap; }
+
+void espnow_mesh_join_group(uint8_t group_id) {}
+void far_mesh_join_group(uint8_t group_id) {}
+
+static bool inject(int side, const espnow_message_t *message, uint64_t current_time) {
+    if (message->time_to_live <= 1) return false;
+    if (inject_callback) inject_callback(side, message, current_time);
+    return true;
+}
+
+bool espnow_mesh_inject(const espnow_message_t *message, uint64_t current_time) {
+    return inject(MOCK_LORA_NEAR, message, current_time);
+}
+
+bool far_mesh_inject(const espnow_message_t *message, uint64_t current_time) {
+    return inject(MOCK_LORA_FAR, message, current_time);
+}
+
+//! the length checks of mod_espnow.c
+esp_err_t espnow_parse_message(const uint8_t *data, int len, espnow_message_t *message, uint8_t *data_len) {
+    if (data == NULL || len < (int)ESPNOW_HEADER_SIZE || len > (int)sizeof(espnow_message_t)) return ESP_ERR_INVALID_SIZE;
+
+    memcpy(message, data, len);
+    memset((uint8_t*)message + len, 0, sizeof(espnow_message_t) - len);
+    if (message->data_len > len - ESPNOW_HEADER_SIZE) return ESP_ERR_INVALID_SIZE;
+    *data_len = message->data_len;
+    return ESP_OK;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sx127x/lora_bridge.h"
+
+//# Two LoRa bridges on one channel. The near bridge is lora_bridge.c as
+//# built for the device, the far one the same file compiled again by
+//# lora_bridge_far.c with its entry points prefixed far_. Each side gets a
+//# mocked SX127x: a send occupies the channel for mod_sx127_time_on_air_us
+//# and arrives at the other side's next radio poll after that. The radios
+//# are half duplex, a packet sent while the receiver itself transmits is
+//# lost, and every packet is dropped with the configured loss rate.
+//# The mesh around each bridge is mocked too: mock_lora_tap hands a frame
+//# to that side's tap like espnow_task, injected frames go to a callback.
+
+#define MOCK_LORA_NEAR 0
+#define MOCK_LORA_FAR 1
+
+typedef void (*mock_lora_inject_cb)(int side, const espnow_message_t *message, uint64_t current_time);
+
+//! clears the channel and the counters, keeps the registered callbacks
+void mock_lora_reset(double loss);
+void mock_lora_set_inject_cb(mock_lora_inject_cb callback);
+
+//! a frame the mesh delivered on that side
+void mock_lora_tap(int side, const espnow_message_t *message);
+
+//! drops the next packet the side sends, for tests
+void mock_lora_drop_next(int side);
+
+uint32_t mock_lora_packets(int side);
+uint32_t mock_lora_collisions(void);
+
+//! the far bridge, see lora_bridge_far.c
+void far_bridge_setup(M_Spi_Conf *config, const uint8_t *self_mac);
+void far_bridge_add_group(uint8_t group_id, lora_bridge_prio_t priority);
+void far_bridge_task(uint64_t current_time);
+void far_bridge_get_stats(lora_bridge_stats_t *stats);
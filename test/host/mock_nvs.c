@@ -0,0 +1,103 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "mock_nvs.h"
+
+#define MOCK_NVS_ENTRIES 32
+#define MOCK_NVS_VALUE 64
+
+typedef enum { ENTRY_FREE, ENTRY_U32, ENTRY_BLOB } entry_type_t;
+
+typedef struct {
+    entry_type_t type;
+    char key[16];
+    uint8_t value[MOCK_NVS_VALUE];
+    size_t len;
+} entry_t;
+
+static entry_t entries[MOCK_NVS_ENTRIES];
+static uint32_t commits;
+static uint32_t commit_delay_us;
+
+void mock_nvs_reset(void) {
+    memset(entries, 0, sizeof(entries));
+    commits = 0;
+    commit_delay_us = 0;
+}
+
+uint32_t mock_nvs_commits(void) {
+    return commits;
+}
+
+void mock_nvs_set_commit_delay(uint32_t delay_us) {
+    commit_delay_us = delay_us;
+}
+
+static entry_t *find(const char *key, bool create) {
+    entry_t *free_entry = NULL;
+    for (int i = 0; i < MOCK_NVS_ENTRIES; i++) {
+        if (entries[i].type == ENTRY_FREE) {
+            if (free_entry == NULL) free_entry = &entries[i];
+        } else if (strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    if (!create || free_entry == NULL) return NULL;
+
+    strncpy(free_entry->key, key, sizeof(free_entry->key) - 1);
+    return free_entry;
+}
+
+static esp_err_t set(const char *key, entry_type_t type, const void *value, size_t len) {
+    if (len > MOCK_NVS_VALUE) return ESP_ERR_NVS_INVALID_LENGTH;
+    entry_t *entry = find(key, true);
+    if (entry == NULL) return ESP_ERR_NO_MEM;
+
+    entry->type = type;
+    memcpy(entry->value, value, len);
+    entry->len = len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle) {
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length) {
+    entry_t *entry = find(key, false);
+    if (entry == NULL || entry->type != ENTRY_BLOB) return ESP_ERR_NVS_NOT_FOUND;
+    if (*length < entry->len) return ESP_ERR_NVS_INVALID_LENGTH;
+
+    memcpy(out_value, entry->value, entry->len);
+    *length = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+    return set(key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value) {
+    entry_t *entry = find(key, false);
+    if (entry == NULL || entry->type != ENTRY_U32) return ESP_ERR_NVS_NOT_FOUND;
+    memcpy(out_value, entry->value, sizeof(*out_value));
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value) {
+    return set(key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+    entry_t *entry = find(key, false);
+    if (entry == NULL) return ESP_ERR_NVS_NOT_FOUND;
+    entry->type = ENTRY_FREE;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    if (commit_delay_us) usleep(commit_delay_us);
+    commits++;
+    return ESP_OK;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nvs.h"
+
+//# In-memory NVS. Every namespace shares one table, values keep their type
+//# and a commit only counts, the writes are visible straight away.
+
+//! erases every key and the commit count
+void mock_nvs_reset(void);
+uint32_t mock_nvs_commits(void);
+
+//! every commit sleeps this long, a flash erase takes milliseconds
+void mock_nvs_set_commit_delay(uint32_t delay_us);
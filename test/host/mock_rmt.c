@@ -0,0 +1,278 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "esp_timer.h"
+#include "mock_rmt.h"
+
+#define MOCK_RMT_QUEUE_MAX 8
+#define MOCK_RMT_CANARY 8
+#define MOCK_RMT_CANARY_WORD 0xDEADBEEF
+#define MOCK_RMT_DEFAULT_CHUNK 64       // rmt_encoder_simple.c without min_chunk_size
+
+struct rmt_channel_t {
+    rmt_tx_channel_config_t config;
+    bool enabled;
+    rmt_tx_done_callback_t on_trans_done;
+    void *user_data;
+
+    mock_rmt_tx_t queue[MOCK_RMT_QUEUE_MAX];
+    int pending;
+    uint64_t free_at;                   // the last queued transaction ends
+    uint32_t transmits;
+    uint32_t flushed;
+    esp_err_t fail_next;
+
+    mock_rmt_tx_t last;
+    uint8_t *data;
+    rmt_symbol_word_t *symbols;
+    size_t capacity;                    // payload bytes the buffers hold
+};
+
+struct rmt_encoder_t {
+    rmt_simple_encoder_config_t config;
+};
+
+struct rmt_sync_manager_t {
+    struct rmt_channel_t *members[MOCK_RMT_MAX_CHANNELS];
+    int member_count;
+};
+
+static struct rmt_channel_t channels[MOCK_RMT_MAX_CHANNELS];
+static int channel_count;
+static struct rmt_encoder_t *encoders[MOCK_RMT_MAX_CHANNELS * 2];
+static int encoder_count;
+static struct rmt_sync_manager_t *sync_manager;
+
+void mock_rmt_reset(void) {
+    for (int i = 0; i < channel_count; i++) {
+        free(channels[i].data);
+        free(channels[i].symbols);
+    }
+    memset(channels, 0, sizeof(channels));
+    channel_count = 0;
+
+    for (int i = 0; i < encoder_count; i++) free(encoders[i]);
+    encoder_count = 0;
+    free(sync_manager);
+    sync_manager = NULL;
+}
+
+int mock_rmt_channels(void) { return channel_count; }
+rmt_channel_handle_t mock_rmt_channel(int index) { return &channels[index]; }
+uint32_t mock_rmt_transmits(int index) { return channels[index].transmits; }
+int mock_rmt_pending(int index) { return channels[index].pending; }
+uint32_t mock_rmt_flushed(int index) { return channels[index].flushed; }
+void mock_rmt_fail_next(int index, esp_err_t err) { channels[index].fail_next = err; }
+const mock_rmt_tx_t *mock_rmt_last(int index) { return &channels[index].last; }
+const uint8_t *mock_rmt_last_data(int index) { return channels[index].data; }
+const rmt_symbol_word_t *mock_rmt_last_symbols(int index) { return channels[index].symbols; }
+
+const rmt_simple_encoder_config_t *mock_rmt_encoder_config(rmt_encoder_handle_t encoder) {
+    return &encoder->config;
+}
+
+void mock_rmt_run(uint64_t now) {
+    for (int i = 0; i < channel_count; i++) {
+        struct rmt_channel_t *channel = &channels[i];
+        while (channel->pending > 0 && !channel->queue[0].held && channel->queue[0].end_us <= now) {
+            rmt_tx_done_event_data_t event = { .num_symbols = channel->queue[0].symbols };
+            channel->pending--;
+            memmove(&channel->queue[0], &channel->queue[1], channel->pending * sizeof(channel->queue[0]));
+            if (channel->on_trans_done) channel->on_trans_done(channel, &event, channel->user_data);
+        }
+    }
+}
+
+
+//! ENCODER
+
+uint64_t mock_rmt_duration_us(const rmt_symbol_word_t *symbols, size_t count, uint32_t resolution_hz) {
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < count; i++) ticks += symbols[i].duration0 + symbols[i].duration1;
+    return ticks * 1000000 / resolution_hz;
+}
+
+//! one callback into a scratch buffer with a canary behind symbols_free
+static size_t encode_call(const rmt_simple_encoder_config_t *config, const void *data, size_t data_size, size_t written,
+                          size_t symbols_free, rmt_symbol_word_t *scratch, bool *done, bool *overrun) {
+    for (size_t i = 0; i < symbols_free + MOCK_RMT_CANARY; i++) scratch[i].val = MOCK_RMT_CANARY_WORD;
+
+    size_t count = config->callback(data, data_size, written, symbols_free, scratch, done, config->arg);
+    if (count > symbols_free) *overrun = true;
+    for (size_t i = symbols_free; i < symbols_free + MOCK_RMT_CANARY; i++) {
+        if (scratch[i].val != MOCK_RMT_CANARY_WORD) *overrun = true;
+    }
+    return count;
+}
+
+size_t mock_rmt_encode(const rmt_simple_encoder_config_t *config, const void *data, size_t data_size,
+                       size_t block_symbols, rmt_symbol_word_t *out, size_t out_max, uint32_t *callbacks) {
+    size_t chunk = config->min_chunk_size ? config->min_chunk_size : MOCK_RMT_DEFAULT_CHUNK;
+    size_t scratch_len = (block_symbols > chunk ? block_symbols : chunk) + MOCK_RMT_CANARY;
+    rmt_symbol_word_t *scratch = malloc(scratch_len * sizeof(rmt_symbol_word_t));
+
+    size_t written = 0;
+    size_t symbols_free = block_symbols;                // the first fill takes the whole memory
+    uint32_t calls = 0;
+    bool done = false, overrun = false;
+
+    while (!done && !overrun) {
+        if (symbols_free == 0) symbols_free = block_symbols / 2;
+
+        size_t count = encode_call(config, data, data_size, written, symbols_free, scratch, &done, &overrun);
+        calls++;
+        if (count == 0 && !done) {
+            //! no room for the callback, the driver hands it the overflow buffer and drains that later
+            count = encode_call(config, data, data_size, written, chunk, scratch, &done, &overrun);
+            calls++;
+            if (count == 0 && !done) overrun = true;
+            symbols_free = 0;
+        } else {
+            symbols_free -= count;
+        }
+        if (written + count > out_max) overrun = true;
+        if (overrun) break;
+
+        memcpy(&out[written], scratch, count * sizeof(rmt_symbol_word_t));
+        written += count;
+    }
+
+    free(scratch);
+    if (callbacks) *callbacks = calls;
+    return overrun ? 0 : written;
+}
+
+
+//! DRIVER
+
+esp_err_t rmt_new_tx_channel(const rmt_tx_channel_config_t *config, rmt_channel_handle_t *ret_chan) {
+    if (channel_count == MOCK_RMT_MAX_CHANNELS) return ESP_ERR_NOT_FOUND;
+    if (config->trans_queue_depth == 0 || config->trans_queue_depth > MOCK_RMT_QUEUE_MAX) return ESP_ERR_INVALID_ARG;
+
+    struct rmt_channel_t *channel = &channels[channel_count++];
+    channel->config = *config;
+    *ret_chan = channel;
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_simple_encoder(const rmt_simple_encoder_config_t *config, rmt_encoder_handle_t *ret_encoder) {
+    if (config->callback == NULL) return ESP_ERR_INVALID_ARG;
+    if (encoder_count == sizeof(encoders) / sizeof(encoders[0])) return ESP_ERR_NO_MEM;
+
+    struct rmt_encoder_t *encoder = calloc(1, sizeof(*encoder));
+    encoder->config = *config;
+    encoders[encoder_count++] = encoder;
+    *ret_encoder = encoder;
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_register_event_callbacks(rmt_channel_handle_t tx_channel, const rmt_tx_event_callbacks_t *cbs, void *user_data) {
+    tx_channel->on_trans_done = cbs->on_trans_done;
+    tx_channel->user_data = user_data;
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel) {
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_disable(rmt_channel_handle_t channel) {
+    uint64_t now = esp_timer_get_time();
+    channel->enabled = false;
+    channel->flushed += channel->pending;
+    channel->pending = 0;
+    if (channel->free_at > now) channel->free_at = now;
+    return ESP_OK;
+}
+
+//! end_us holds the duration until the transaction starts
+static void start(struct rmt_channel_t *channel, mock_rmt_tx_t *tx, uint64_t now) {
+    tx->held = false;
+    tx->start_us = channel->free_at > now ? channel->free_at : now;
+    tx->end_us += tx->start_us;
+    channel->free_at = tx->end_us;
+}
+
+static bool sync_member(struct rmt_channel_t *channel) {
+    if (sync_manager == NULL) return false;
+    for (int i = 0; i < sync_manager->member_count; i++) {
+        if (sync_manager->members[i] == channel) return true;
+    }
+    return false;
+}
+
+static mock_rmt_tx_t *held_tx(struct rmt_channel_t *channel) {
+    for (int i = 0; i < channel->pending; i++) {
+        if (channel->queue[i].held) return &channel->queue[i];
+    }
+    return NULL;
+}
+
+//! once every member holds one, all of them go out at the same time
+static void sync_release(void) {
+    uint64_t now = esp_timer_get_time();
+    for (int i = 0; i < sync_manager->member_count; i++) {
+        struct rmt_channel_t *channel = sync_manager->members[i];
+        if (held_tx(channel) == NULL) return;
+        if (channel->free_at > now) now = channel->free_at;
+    }
+
+    for (int i = 0; i < sync_manager->member_count; i++) {
+        struct rmt_channel_t *channel = sync_manager->members[i];
+        mock_rmt_tx_t *tx = held_tx(channel);
+        start(channel, tx, now);
+        channel->last = *tx;
+    }
+}
+
+esp_err_t rmt_transmit(rmt_channel_handle_t tx_channel, rmt_encoder_handle_t encoder, const void *payload, size_t payload_bytes,
+                       const rmt_transmit_config_t *config) {
+    struct rmt_channel_t *channel = tx_channel;
+    if (!channel->enabled) return ESP_ERR_INVALID_STATE;
+    if (channel->fail_next != ESP_OK) {
+        esp_err_t err = channel->fail_next;
+        channel->fail_next = ESP_OK;
+        return err;
+    }
+    //! the driver would block for a free slot, which the module must never need
+    if (channel->pending == (int)channel->config.trans_queue_depth) return ESP_ERR_INVALID_STATE;
+
+    if (payload_bytes > channel->capacity) {
+        free(channel->data);
+        free(channel->symbols);
+        channel->capacity = payload_bytes;
+        channel->data = malloc(payload_bytes);
+        channel->symbols = malloc((payload_bytes * 8 + MOCK_RMT_DEFAULT_CHUNK) * sizeof(rmt_symbol_word_t));
+    }
+    memcpy(channel->data, payload, payload_bytes);
+
+    mock_rmt_tx_t tx = { .bytes = payload_bytes };
+    tx.symbols = mock_rmt_encode(&encoder->config, channel->data, payload_bytes, channel->config.mem_block_symbols,
+                                 channel->symbols, payload_bytes * 8 + MOCK_RMT_DEFAULT_CHUNK, &tx.callbacks);
+    if (tx.symbols == 0) return ESP_FAIL;
+
+    tx.end_us = mock_rmt_duration_us(channel->symbols, tx.symbols, channel->config.resolution_hz);
+    tx.held = sync_member(channel);
+    if (!tx.held) start(channel, &tx, esp_timer_get_time());
+
+    channel->queue[channel->pending++] = tx;
+    channel->last = tx;
+    channel->transmits++;
+    if (tx.held) sync_release();
+    return ESP_OK;
+}
+
+esp_err_t rmt_new_sync_manager(const rmt_sync_manager_config_t *config, rmt_sync_manager_handle_t *ret_synchro) {
+    if (sync_manager) return ESP_ERR_NOT_FOUND;
+    if (config->array_size > MOCK_RMT_MAX_CHANNELS) return ESP_ERR_INVALID_ARG;
+    sync_manager = calloc(1, sizeof(*sync_manager));
+    for (size_t i = 0; i < config->array_size; i++) sync_manager->members[i] = config->tx_channel_array[i];
+    sync_manager->member_count = config->array_size;
+    *ret_synchro = sync_manager;
+    return ESP_OK;
+}
+
+esp_err_t rmt_sync_reset(rmt_sync_manager_handle_t synchro) {
+    return ESP_OK;
+}
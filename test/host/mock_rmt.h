@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "driver/rmt_tx.h"
+#include "soc/soc_caps.h"
+
+//# RMT TX channels without hardware. rmt_transmit runs the simple encoder
+//# the way the driver does: the callback first fills the whole channel
+//# memory, then half a block per ping-pong refill, and when it returns 0 it
+//# gets the overflow buffer of min_chunk_size. The symbols are kept per
+//# channel with a copy of the payload. Transactions queue per channel, each
+//# goes on air when the previous one ended and lasts as long as its symbols;
+//# mock_rmt_run finishes the ones that ended and calls on_trans_done.
+//# Channels under a sync manager hold their transaction until every member
+//# has one, then all start together. rmt_disable drops whatever is queued
+//# without on_trans_done, like the driver.
+
+#define MOCK_RMT_MAX_CHANNELS SOC_RMT_TX_CANDIDATES_PER_GROUP
+
+typedef struct {
+    uint64_t start_us;              // on air
+    uint64_t end_us;
+    size_t bytes;
+    size_t symbols;
+    uint32_t callbacks;             // encoder calls, refills plus overflows
+    bool held;                      // waits for the other synced channels, no times yet
+} mock_rmt_tx_t;
+
+//! frees every channel, encoder and sync manager
+void mock_rmt_reset(void);
+
+//! finishes the transactions that ended by now, in order per channel
+void mock_rmt_run(uint64_t now);
+
+//! channels in creation order
+int mock_rmt_channels(void);
+rmt_channel_handle_t mock_rmt_channel(int index);
+uint32_t mock_rmt_transmits(int index);
+int mock_rmt_pending(int index);
+uint32_t mock_rmt_flushed(int index);         // transactions rmt_disable dropped
+
+//! the channel's next rmt_transmit returns err without queueing anything
+void mock_rmt_fail_next(int index, esp_err_t err);
+
+//! the channel's last transmission, its payload copy and symbol stream
+const mock_rmt_tx_t *mock_rmt_last(int index);
+const uint8_t *mock_rmt_last_data(int index);
+const rmt_symbol_word_t *mock_rmt_last_symbols(int index);
+
+//! the config a simple encoder was made from
+const rmt_simple_encoder_config_t *mock_rmt_encoder_config(rmt_encoder_handle_t encoder);
+
+//! runs a simple encoder callback into out, as rmt_transmit does, 0 when it
+//! failed, wrote past symbols_free or out_max
+size_t mock_rmt_encode(const rmt_simple_encoder_config_t *config, const void *data, size_t data_size,
+                       size_t block_symbols, rmt_symbol_word_t *out, size_t out_max, uint32_t *callbacks);
+
+//! air time of a symbol stream at the resolution
+uint64_t mock_rmt_duration_us(const rmt_symbol_word_t *symbols, size_t count, uint32_t resolution_hz);
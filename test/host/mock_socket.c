@@ -0,0 +1,46 @@
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <errno.h>
+
+#include "mock_socket.h"
+
+#define MOCK_SOCKET_BACKLOG 32
+
+static int backlog[MOCK_SOCKET_BACKLOG];
+static int backlog_len;
+
+int __real_bind(int fd, const struct sockaddr *addr, socklen_t len);
+int __real_accept(int fd, struct sockaddr *addr, socklen_t *len);
+
+int __wrap_bind(int fd, const struct sockaddr *addr, socklen_t len) {
+    struct sockaddr_in loopback = {
+        .sin_family = AF_INET,
+        .sin_port = 0,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    return __real_bind(fd, (struct sockaddr *)&loopback, sizeof(loopback));
+}
+
+int __wrap_accept(int fd, struct sockaddr *addr, socklen_t *len) {
+    if (backlog_len == 0) return __real_accept(fd, addr, len);
+
+    int server_end = backlog[0];
+    memmove(backlog, backlog + 1, --backlog_len * sizeof(backlog[0]));
+    if (addr && len) memset(addr, 0, *len);
+    return server_end;
+}
+
+int mock_socket_connect(void) {
+    int pair[2];
+    if (backlog_len == MOCK_SOCKET_BACKLOG) return -1;
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) return -1;
+
+    backlog[backlog_len++] = pair[1];
+    return pair[0];
+}
+
+int mock_socket_pending(void) {
+    return backlog_len;
+}
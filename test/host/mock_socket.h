@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+//# Loopback for the socket servers. Link with
+//#   -Wl,--wrap=bind,--wrap=accept
+//# bind takes an ephemeral loopback port instead of the fixed one, accept
+//# hands out the server end of socketpairs made by mock_socket_connect before
+//# falling back to the real listening socket.
+
+//! returns the client end, the server end waits for the next accept()
+int mock_socket_connect(void);
+
+//! connections waiting for accept(), the caller raises POLLIN on the server fd for them
+int mock_socket_pending(void);
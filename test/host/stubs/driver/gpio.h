@@ -0,0 +1,3 @@
+#pragma once
+
+#include "soc/gpio_num.h"
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+//! nanoseconds on the host, so benchmark "cycles" read as ns
+uint32_t esp_cpu_get_cycle_count(void);
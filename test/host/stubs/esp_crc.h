@@ -0,0 +1,5 @@
+#pragma once
+
+#include <stdint.h>
+
+uint16_t esp_crc16_le(uint16_t crc, uint8_t const *buf, uint32_t len);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+
+extern esp_event_base_t const IP_EVENT;
+extern esp_event_base_t const WIFI_EVENT;
+
+#define IP_EVENT_STA_GOT_IP             0
+#define WIFI_EVENT_STA_DISCONNECTED     5
+
+//! handlers are not called on the host, the tests drive the modules directly
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t handler, void *arg);
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <string.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+//# Request/response surface of esp_http_server, backed by mock_httpd.c which
+//# records every response instead of writing to a socket.
+
+#define HTTPD_MAX_URI_LEN       512
+#define HTTPD_RESP_USE_STRLEN   -1
+#define HTTPD_SOCK_ERR_FAIL     -1
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+typedef void *httpd_handle_t;
+
+typedef enum {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_HEAD = 2,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+    HTTP_OPTIONS = 6,
+} httpd_method_t;
+
+typedef struct httpd_req {
+    httpd_handle_t handle;
+    int method;
+    char uri[HTTPD_MAX_URI_LEN + 1];
+    size_t content_len;
+    void *aux;                      // mock connection
+    void *user_ctx;
+    void *sess_ctx;
+} httpd_req_t;
+
+typedef struct httpd_uri {
+    const char *uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t *req);
+    void *user_ctx;
+} httpd_uri_t;
+
+typedef enum {
+    HTTPD_500_INTERNAL_SERVER_ERROR = 0,
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_408_REQ_TIMEOUT,
+    HTTPD_ERR_CODE_MAX,
+} httpd_err_code_t;
+
+typedef esp_err_t (*httpd_err_handler_func_t)(httpd_req_t *req, httpd_err_code_t error);
+typedef bool (*httpd_uri_match_func_t)(const char *reference_uri, const char *uri_to_match, size_t match_upto);
+
+typedef struct {
+    uint16_t server_port;
+    uint16_t max_open_sockets;
+    uint16_t send_wait_timeout;
+    uint16_t recv_wait_timeout;
+    bool lru_purge_enable;
+    httpd_uri_match_func_t uri_match_fn;
+} httpd_config_t;
+
+#define CONFIG_LWIP_MAX_SOCKETS 10     // sdkconfig default
+
+#define HTTPD_DEFAULT_CONFIG() (httpd_config_t) {   \
+        .server_port = 80,                          \
+        .max_open_sockets = 7,                      \
+        .send_wait_timeout = 5,                     \
+        .recv_wait_timeout = 5,                     \
+    }
+
+bool httpd_uri_match_wildcard(const char *reference_uri, const char *uri_to_match, size_t match_upto);
+
+esp_err_t httpd_start(httpd_handle_t *handle, const httpd_config_t *config);
+esp_err_t httpd_stop(httpd_handle_t handle);
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t *uri_handler);
+esp_err_t httpd_register_err_handler(httpd_handle_t handle, httpd_err_code_t error, httpd_err_handler_func_t handler);
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *req, httpd_req_t **out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *req);
+int httpd_req_to_sockfd(httpd_req_t *req);
+esp_err_t httpd_sess_trigger_close(httpd_handle_t handle, int sockfd);
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *req, const char *field, char *val, size_t val_size);
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len);
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *req, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *msg);
+
+static inline esp_err_t httpd_resp_sendstr(httpd_req_t *req, const char *str) {
+    return httpd_resp_send(req, str, str ? HTTPD_RESP_USE_STRLEN : 0);
+}
+
+static inline esp_err_t httpd_resp_sendstr_chunk(httpd_req_t *req, const char *str) {
+    return httpd_resp_send_chunk(req, str, str ? HTTPD_RESP_USE_STRLEN : 0);
+}
+
+static inline esp_err_t httpd_resp_send_404(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_408(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_408_REQ_TIMEOUT, NULL);
+}
+
+static inline esp_err_t httpd_resp_send_500(httpd_req_t *req) {
+    return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, NULL);
+}
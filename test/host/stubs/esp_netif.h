@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct esp_netif_obj esp_netif_t;
+
+typedef struct {
+    uint32_t addr;
+} esp_ip4_addr_t;
+
+typedef struct {
+    esp_ip4_addr_t ip;
+    esp_ip4_addr_t netmask;
+    esp_ip4_addr_t gw;
+} esp_netif_ip_info_t;
+
+typedef enum { ESP_NETIF_OP_SET, ESP_NETIF_OP_GET } esp_netif_dhcp_option_mode_t;
+typedef enum { ESP_NETIF_CAPTIVEPORTAL_URI = 114 } esp_netif_dhcp_option_id_t;
+
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) (x)
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key);
+esp_err_t esp_netif_get_ip_info(esp_netif_t *netif, esp_netif_ip_info_t *ip_info);
+esp_err_t esp_netif_dhcps_start(esp_netif_t *netif);
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *netif);
+esp_err_t esp_netif_dhcps_option(esp_netif_t *netif, esp_netif_dhcp_option_mode_t mode,
+                                 esp_netif_dhcp_option_id_t id, void *value, uint32_t len);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+//! rand() based, seed it with srand for reproducible runs
+uint32_t esp_random(void);
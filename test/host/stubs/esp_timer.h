@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+//! monotonic microseconds, or the value set with host_set_time
+int64_t esp_timer_get_time(void);
+
+//! freezes esp_timer_get_time for simulations, a negative value unfreezes it
+void host_set_time(int64_t time_us);
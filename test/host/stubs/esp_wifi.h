@@ -0,0 +1,3 @@
+#pragma once
+
+//! only included, nothing used on the host
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+    pthread_cond_t writable;
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_semaphore {
+    bool is_mutex;
+    pthread_mutex_t mutex;              // is_mutex
+    pthread_mutex_t lock;               // counter otherwise
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+static __thread struct host_task *current_task;
+
+static void deadline_after(struct timespec *ts, TickType_t ticks) {
+    clock_gettime(CLOCK_REALTIME, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+//! waits on cond until ready() or the ticks ran out, lock is held around it
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                       bool (*ready)(void *ctx), void *ctx) {
+    struct timespec deadline;
+    if (ticks != portMAX_DELAY) deadline_after(&deadline, ticks);
+
+    while (!ready(ctx)) {
+        if (ticks == 0) return false;
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return ready(ctx);
+        }
+    }
+    return true;
+}
+
+//! TASKS
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg) {
+    struct host_task *task = calloc(1, sizeof(*task));
+    task->fn = fn;
+    task->arg = arg;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    return task;
+}
+
+static void *task_entry(void *arg) {
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+    struct host_task *task = task_new(fn, arg);
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle) *handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_size, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+    return xTaskCreate(fn, name, stack_size, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    usleep((useconds_t)ticks * 1000);
+}
+
+TickType_t xTaskGetTickCount(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (current_task == NULL) {
+        current_task = task_new(NULL, NULL);
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+static bool notified(void *ctx) {
+    return ((struct host_task*)ctx)->notify > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&task->lock);
+    wait_until(&task->cond, &task->lock, ticks, notified, task);
+    uint32_t value = task->notify;
+    if (value) task->notify = clear_on_exit ? 0 : value - 1;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+//! QUEUES
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    queue->items = calloc(length, item_size);
+    queue->length = length;
+    queue->item_size = item_size;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->readable, NULL);
+    pthread_cond_init(&queue->writable, NULL);
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    free(queue->items);
+    free(queue);
+}
+
+static bool queue_has_space(void *ctx) {
+    struct host_queue *queue = ctx;
+    return queue->count < queue->length;
+}
+
+static bool queue_has_items(void *ctx) {
+    return ((struct host_queue*)ctx)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = wait_until(&queue->writable, &queue->lock, ticks, queue_has_space, queue);
+    if (ok) {
+        UBaseType_t tail = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + tail * queue->item_size, item, queue->item_size);
+        queue->count++;
+        pthread_cond_signal(&queue->readable);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    pthread_mutex_lock(&queue->lock);
+    bool ok = wait_until(&queue->readable, &queue->lock, ticks, queue_has_items, queue);
+    if (ok) {
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->writable);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    return queue->length - uxQueueMessagesWaiting(queue);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->head = 0;
+    queue->count = 0;
+    pthread_cond_broadcast(&queue->writable);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+//! SEMAPHORES
+
+static struct host_semaphore *semaphore_new(bool is_mutex, UBaseType_t max_count, UBaseType_t count) {
+    struct host_semaphore *semaphore = calloc(1, sizeof(*semaphore));
+    semaphore->is_mutex = is_mutex;
+    semaphore->max_count = max_count;
+    semaphore->count = count;
+
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&semaphore->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    pthread_mutex_init(&semaphore->lock, NULL);
+    pthread_cond_init(&semaphore->cond, NULL);
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return semaphore_new(true, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return semaphore_new(false, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return semaphore_new(false, max_count, initial_count);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    free(semaphore);
+}
+
+static bool semaphore_available(void *ctx) {
+    return ((struct host_semaphore*)ctx)->count > 0;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    if (semaphore->is_mutex) {
+        if (ticks == portMAX_DELAY) return pthread_mutex_lock(&semaphore->mutex) == 0;
+        struct timespec deadline;
+        deadline_after(&deadline, ticks);
+        return pthread_mutex_timedlock(&semaphore->mutex, &deadline) == 0;
+    }
+
+    pthread_mutex_lock(&semaphore->lock);
+    bool ok = wait_until(&semaphore->cond, &semaphore->lock, ticks, semaphore_available, semaphore);
+    if (ok) semaphore->count--;
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (semaphore->is_mutex) return pthread_mutex_unlock(&semaphore->mutex) == 0;
+
+    pthread_mutex_lock(&semaphore->lock);
+    bool ok = semaphore->count < semaphore->max_count;
+    if (ok) {
+        semaphore->count++;
+        pthread_cond_signal(&semaphore->cond);
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
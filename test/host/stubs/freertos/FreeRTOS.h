@@ -0,0 +1,39 @@
+#pragma once
+
+//# pthread backed FreeRTOS subset, enough for the modules under test.
+//# A tick is a millisecond. Critical sections are a recursive mutex per
+//# portMUX, they serialize tasks the same way the spinlock does on target.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE          1
+#define pdFALSE         0
+#define pdPASS          1
+#define pdFAIL          0
+#define portMAX_DELAY   ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define taskENTER_CRITICAL_ISR(mux)     pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL_ISR(mux)      pthread_mutex_unlock(&(mux)->mutex)
+#define portYIELD_FROM_ISR(woken)       (void)(woken)
+
+#include "freertos/task.h"
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "freertos/queue.h"
+
+//! mutexes are recursive pthread mutexes, binary and counting semaphores a counter
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#define xSemaphoreCreateRecursiveMutex() xSemaphoreCreateMutex()
+#define xSemaphoreTakeRecursive(semaphore, ticks) xSemaphoreTake(semaphore, ticks)
+#define xSemaphoreGiveRecursive(semaphore) xSemaphoreGive(semaphore)
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <arpa/inet.h>
+
+#define inet_ntoa_r(addr, buff, len) inet_ntop(AF_INET, &(addr), buff, len)
+#define inet6_ntoa_r(addr, buff, len) inet_ntop(AF_INET6, &(addr), buff, len)
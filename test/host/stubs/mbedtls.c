@@ -0,0 +1,89 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+
+//# Plain FIPS 180-1 SHA-1 and RFC 4648 base64, enough for the WebSocket
+//# handshake. Not constant time, host tests only.
+
+static uint32_t rol(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[4*i] << 24 | (uint32_t)block[4*i + 1] << 16 | (uint32_t)block[4*i + 2] << 8 | block[4*i + 3];
+    }
+    for (int i = 16; i < 80; i++) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+
+        uint32_t temp = rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20]) {
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t block[64];
+    size_t pos = 0;
+
+    for (; pos + 64 <= ilen; pos += 64) sha1_block(state, input + pos);
+
+    //! padding, one or two final blocks
+    size_t rest = ilen - pos;
+    memset(block, 0, sizeof(block));
+    memcpy(block, input + pos, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+
+    uint64_t bits = (uint64_t)ilen * 8;
+    for (int i = 0; i < 8; i++) block[63 - i] = bits >> (8 * i);
+    sha1_block(state, block);
+
+    for (int i = 0; i < 20; i++) output[i] = state[i / 4] >> (24 - 8 * (i % 4));
+    return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *dst, size_t dlen, size_t *olen, const unsigned char *src, size_t slen) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t needed = (slen + 2) / 3 * 4;
+    *olen = needed + 1;
+    if (dlen < needed + 1) return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+
+    size_t out = 0;
+    for (size_t i = 0; i < slen; i += 3) {
+        uint32_t n = (uint32_t)src[i] << 16;
+        if (i + 1 < slen) n |= (uint32_t)src[i + 1] << 8;
+        if (i + 2 < slen) n |= src[i + 2];
+
+        dst[out++] = table[(n >> 18) & 0x3F];
+        dst[out++] = table[(n >> 12) & 0x3F];
+        dst[out++] = i + 1 < slen ? table[(n >> 6) & 0x3F] : '=';
+        dst[out++] = i + 2 < slen ? table[n & 0x3F] : '=';
+    }
+    dst[out] = 0;
+    *olen = out;
+    return 0;
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+typedef int gpio_num_t;
@@ -0,0 +1,6 @@
+#pragma once
+
+//! ESP32-C3, the target the ws2812 strips run on
+#define SOC_RMT_TX_CANDIDATES_PER_GROUP     2
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL       48
+#define SOC_RMT_SUPPORT_TX_SYNCHRO          1
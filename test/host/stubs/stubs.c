@@ -0,0 +1,92 @@
+#include <time.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_littlefs.h"
+
+static int64_t frozen_time = -1;
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_TIMEOUT:       return "ESP_ERR_TIMEOUT";
+        default:                    return "ESP_ERR_UNKNOWN";
+    }
+}
+
+static int64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int64_t esp_timer_get_time(void) {
+    return frozen_time >= 0 ? frozen_time : monotonic_ns() / 1000;
+}
+
+void host_set_time(int64_t time_us) {
+    frozen_time = time_us;
+}
+
+uint32_t esp_cpu_get_cycle_count(void) {
+    return (uint32_t)monotonic_ns();
+}
+
+esp_err_t esp_vfs_littlefs_register(const esp_vfs_littlefs_conf_t *conf) { return ESP_OK; }
+esp_err_t esp_vfs_littlefs_unregister(const char *partition_label) { return ESP_OK; }
+esp_err_t esp_littlefs_format(const char *partition_label) { return ESP_OK; }
+
+esp_err_t esp_littlefs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes) {
+    *total_bytes = 0;
+    *used_bytes = 0;
+    return ESP_OK;
+}
+
+//! SYSTEM
+
+#include <string.h>
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_mac.h"
+
+esp_event_base_t const IP_EVENT = "IP_EVENT";
+esp_event_base_t const WIFI_EVENT = "WIFI_EVENT";
+
+esp_err_t esp_event_handler_register(esp_event_base_t event_base, int32_t event_id,
+                                     esp_event_handler_t handler, void *arg) {
+    return ESP_OK;
+}
+
+esp_netif_t *esp_netif_get_handle_from_ifkey(const char *if_key) { return NULL; }
+esp_err_t esp_netif_dhcps_start(esp_netif_t *netif) { return ESP_OK; }
+esp_err_t esp_netif_dhcps_stop(esp_netif_t *netif) { return ESP_OK; }
+
+esp_err_t esp_netif_get_ip_info(esp_netif_t *netif, esp_netif_ip_info_t *ip_info) {
+    memset(ip_info, 0, sizeof(*ip_info));
+    ip_info->ip.addr = 0x0104A8C0;              // 192.168.4.1, the softAP default
+    return ESP_OK;
+}
+
+esp_err_t esp_netif_dhcps_option(esp_netif_t *netif, esp_netif_dhcp_option_mode_t mode,
+                                 esp_netif_dhcp_option_id_t id, void *value, uint32_t len) {
+    return ESP_OK;
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type) {
+    static const uint8_t host_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    memcpy(mac, host_mac, 6);
+    return ESP_OK;
+}
+
+#include "esp_random.h"
+
+uint32_t esp_random(void) {
+    return (uint32_t)rand() << 16 ^ (uint32_t)rand();
+}
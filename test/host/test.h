@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+//# Minimal harness shared by the host tests and benchmarks. A test is a
+//# void function, TEST_ASSERT records a failure and keeps going, TEST_MAIN
+//# returns non-zero when anything failed.
+
+static int test_failures = 0;
+
+#define TEST_ASSERT(cond) do {                                              \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);      \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do {                            \
+        long long expected_ = (long long)(expected);                        \
+        long long actual_ = (long long)(actual);                            \
+        if (expected_ != actual_) {                                         \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %lld\n",           \
+                    __FILE__, __LINE__, #actual, actual_, expected_);       \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define RUN_TEST(fn) do {                                                   \
+        int before_ = test_failures;                                        \
+        fn();                                                               \
+        printf("%-44s %s\n", #fn, test_failures == before_ ? "ok" : "FAIL"); \
+    } while (0)
+
+#define TEST_RESULT() (test_failures ? (printf("%d failure(s)\n", test_failures), 1) : 0)
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+//! keeps the optimizer from dropping a benchmarked result
+#define BENCH_KEEP(value) __asm__ volatile("" : : "g"(value) : "memory")
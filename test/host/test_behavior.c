@@ -0,0 +1,211 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "test.h"
+#include "behavior/behavior.h"
+#include "littlefs/littlefs.h"
+
+static const uint8_t self_mac[6] = { 0x7C, 0x9E, 0xBD, 0x46, 0x46, 0x60 };
+static int toggles[256];
+
+static void on_toggle(uint8_t pin) {
+    toggles[pin]++;
+}
+
+static behavior_config_t gpio_rule(const uint8_t *mac, input_gpio_t input, uint8_t pin, uint8_t out_pin) {
+    behavior_config_t config = { 0 };
+    memcpy(config.remote_mac, mac, 6);
+    config.input_cmd = INPUT_GPIO_CMD;
+    config.input_data[0] = input;
+    config.input_data[1] = pin;
+    config.output_cmd = 0xA0;
+    config.output_data[0] = OUTPUT_GPIO_TOGGLE;         // also the pin handed to on_gpio_toggle
+    config.output_data[1] = out_pin;
+    return config;
+}
+
+static void setup(void) {
+    behavior_output_interface interface = { .on_gpio_toggle = on_toggle };
+    behavior_setup((uint8_t*)self_mac, interface);
+    behavior_clear();
+    memset(toggles, 0, sizeof(toggles));
+}
+
+static void test_lookup_matches_key(void) {
+    setup();
+    uint8_t other_mac[6] = { 1, 2, 3, 4, 5, 6 };
+
+    behavior_config_t rule = gpio_rule(self_mac, INPUT_GPIO_1CLICK, 4, 0);
+    TEST_ASSERT(behavior_add_config(&rule));
+    rule = gpio_rule(self_mac, INPUT_GPIO_1CLICK, 4, 1);
+    TEST_ASSERT(behavior_add_config(&rule));                // same key, both fire
+    rule = gpio_rule(self_mac, INPUT_GPIO_2CLICK, 4, 0);
+    TEST_ASSERT(behavior_add_config(&rule));
+    rule = gpio_rule(other_mac, INPUT_GPIO_1CLICK, 4, 0);
+    TEST_ASSERT(behavior_add_config(&rule));
+
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 4, 0);
+    TEST_ASSERT_EQUAL(2, toggles[OUTPUT_GPIO_TOGGLE]);
+
+    behavior_process_gpio(INPUT_GPIO_PRESS, 4, 0);
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 5, 0);
+    TEST_ASSERT_EQUAL(2, toggles[OUTPUT_GPIO_TOGGLE]);
+
+    behavior_process_gpio(INPUT_GPIO_2CLICK, 4, 0);
+    TEST_ASSERT_EQUAL(3, toggles[OUTPUT_GPIO_TOGGLE]);
+}
+
+static void test_empty_table(void) {
+    setup();
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 4, 0);
+    TEST_ASSERT_EQUAL(0, toggles[OUTPUT_GPIO_TOGGLE]);
+    TEST_ASSERT_EQUAL(0, behavior_get_count());
+}
+
+static void test_rules_added_after_lookup(void) {
+    setup();
+    behavior_config_t rule = gpio_rule(self_mac, INPUT_GPIO_1CLICK, 1, 0);
+    behavior_add_config(&rule);
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 1, 0);
+
+    rule = gpio_rule(self_mac, INPUT_GPIO_1CLICK, 2, 0);
+    behavior_add_config(&rule);
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 2, 0);
+    TEST_ASSERT_EQUAL(2, toggles[OUTPUT_GPIO_TOGGLE]);
+}
+
+//! above 16384 rules the index needs 65536 slots, which a 16 bit count can't hold
+static void test_table_at_capacity(void) {
+    setup();
+    uint8_t mac[6];
+    memcpy(mac, self_mac, 6);
+
+    int added = 0;
+    for (int i = 0; i < 40000; i++) {
+        mac[0] = i >> 8;
+        mac[1] = i;
+        behavior_config_t rule = gpio_rule(i % 2 ? mac : self_mac, INPUT_GPIO_1CLICK, i % 100, 0);
+        if (!behavior_add_config(&rule)) break;
+        added++;
+    }
+    TEST_ASSERT_EQUAL(32767, added);
+    TEST_ASSERT(behavior_compile());
+
+    behavior_process_gpio(INPUT_GPIO_1CLICK, 7, 0);
+    int expected = 0;
+    for (int i = 0; i < added; i++) expected += i % 2 == 0 && i % 100 == 7;
+    TEST_ASSERT_EQUAL(expected, toggles[OUTPUT_GPIO_TOGGLE]);
+}
+
+//! header layout written by behavior_pack.py
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint16_t count;
+    uint16_t reserved;
+    uint32_t crc32;
+} bin_header_t;
+
+static uint32_t crc32_bitwise(const uint8_t *data, size_t len) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void write_csv(const char *dir, const char *rows) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/7C-9E-BD-46-46-60.text", dir);
+    FILE *file = fopen(path, "w");
+    fputs(rows, file);
+    fclose(file);
+}
+
+static void remove_dir(const char *dir) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/7C-9E-BD-46-46-60.text", dir);
+    unlink(path);
+    rmdir(dir);
+}
+
+//! rows are about 138 characters, longer than the old 128 byte parse buffer
+static void test_csv_row_full_width(void) {
+    setup();
+    char dir[] = "/tmp/behavior_test_XXXXXX";
+    TEST_ASSERT(mkdtemp(dir) != NULL);
+    write_csv(dir,
+        "33, 10, 11, 04, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, A0, A2, F1, F2, F3, F4, F5, F6, F7, F8, F9, FA, FB, FC, FD, FE, FF\r\n"
+        "\n"
+        "33,10,11,05,0,0,0,0,0,0,0,0,0,0,0,0,0,0,a0,a1,1,2,3,4,5,6,7,8,9,a,b,c,d,e,f\n"
+        "33, 10, 11, 06, 00, A0, A1\n"                          // short row
+        "34, 10, 11, 07, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, A0, A1, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00, 00");
+
+    littlefs_loadFiles(dir, littlefs_readLine_handler);
+    remove_dir(dir);
+
+    TEST_ASSERT_EQUAL(2, behavior_get_count());
+    const behavior_config_t *config = behavior_get_config(0);
+    TEST_ASSERT(memcmp(config->remote_mac, self_mac, 6) == 0);
+    TEST_ASSERT_EQUAL(INPUT_GPIO_CMD, config->input_cmd);
+    TEST_ASSERT_EQUAL(0x04, config->input_data[1]);
+    TEST_ASSERT_EQUAL(0xA0, config->output_cmd);
+    for (int i = 1; i < 16; i++) TEST_ASSERT_EQUAL(0xF0 + i, config->output_data[i]);
+
+    config = behavior_get_config(1);
+    TEST_ASSERT_EQUAL(0x05, config->input_data[1]);
+    for (int i = 1; i < 16; i++) TEST_ASSERT_EQUAL(i, config->output_data[i]);
+}
+
+//! the packed file must describe the same rules as the CSV it came from
+static void test_binary_matches_csv(void) {
+    setup();
+    littlefs_loadFiles("../../flash_data/devices", littlefs_readLine_handler);
+    uint16_t count = behavior_get_count();
+    TEST_ASSERT(count > 0);
+
+    behavior_config_t *records = malloc(count * sizeof(behavior_config_t));
+    for (int i = 0; i < count; i++) records[i] = *behavior_get_config(i);
+
+    bin_header_t header = {
+        .magic = 0x31564842, .version = 1, .record_size = sizeof(behavior_config_t), .count = count,
+        .crc32 = crc32_bitwise((uint8_t*)records, count * sizeof(behavior_config_t)),
+    };
+    char path[] = "/tmp/behavior_bin_XXXXXX";
+    int fd = mkstemp(path);
+    write(fd, &header, sizeof(header));
+    write(fd, records, count * sizeof(behavior_config_t));
+    close(fd);
+
+    TEST_ASSERT(behavior_load_binary(path));
+    TEST_ASSERT_EQUAL(count, behavior_get_count());
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT(memcmp(behavior_get_config(i), &records[i], sizeof(behavior_config_t)) == 0);
+    }
+
+    // a flipped record byte fails the CRC and keeps the table untouched
+    fd = open(path, O_WRONLY);
+    lseek(fd, sizeof(header) + 10, SEEK_SET);
+    write(fd, "\xEE", 1);
+    close(fd);
+    TEST_ASSERT(!behavior_load_binary(path));
+    TEST_ASSERT_EQUAL(count, behavior_get_count());
+
+    unlink(path);
+    free(records);
+}
+
+int main(void) {
+    RUN_TEST(test_lookup_matches_key);
+    RUN_TEST(test_empty_table);
+    RUN_TEST(test_rules_added_after_lookup);
+    RUN_TEST(test_table_at_capacity);
+    RUN_TEST(test_csv_row_full_width);
+    RUN_TEST(test_binary_matches_csv);
+    behavior_clear();
+    return TEST_RESULT();
+}
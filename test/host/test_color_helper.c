@@ -0,0 +1,85 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "color_helper.h"
+
+//# The integer kernels of color_helper against the float math they replace,
+//# exhaustively where the domain allows it.
+
+static void test_sin_q15_all_angles(void) {
+    double max_error = 0;
+    for (int angle = 0; angle < ANGLE16_TURN; angle++) {
+        double expected = 32767.0 * sin(angle * (2 * M_PI / ANGLE16_TURN));
+        double error = fabs(sin_q15(angle) - expected);
+        if (error > max_error) max_error = error;
+    }
+    TEST_ASSERT(max_error <= 4.0);
+
+    TEST_ASSERT_EQUAL(0, sin_q15(0));
+    TEST_ASSERT_EQUAL(32767, sin_q15(ANGLE16_TURN / 4));
+    TEST_ASSERT_EQUAL(0, sin_q15(ANGLE16_TURN / 2));
+    TEST_ASSERT_EQUAL(-32767, sin_q15(ANGLE16_TURN * 3 / 4));
+}
+
+//! the float expression the wave effects used, (uint8_t)(127.5f * (1 + sinf(x)))
+static void test_sin_wave8_all_angles(void) {
+    int max_error = 0;
+    for (int angle = 0; angle < ANGLE16_TURN; angle++) {
+        float x = angle * (2 * (float)M_PI / ANGLE16_TURN);
+        int expected = (uint8_t)(127.5f * (1.0f + sinf(x)));
+        int error = abs(sin_wave8(angle) - expected);
+        if (error > max_error) max_error = error;
+    }
+    TEST_ASSERT(max_error <= 1);
+}
+
+static void test_scale8_lerp8(void) {
+    int scale_errors = 0, lerp_errors = 0;
+    for (int a = 0; a < 256; a++) {
+        TEST_ASSERT_EQUAL(a, scale8(a, 255));
+        TEST_ASSERT_EQUAL(0, scale8(a, 0));
+        for (int b = 0; b < 256; b++) {
+            //! b as the scale here, truncating like the integer division would
+            if (abs(scale8(a, b) - a * b / 255) > 1) scale_errors++;
+
+            for (int amount = 0; amount < 256; amount += 17) {
+                double expected = a + (b - a) * amount / 255.0;
+                if (fabs(lerp8(a, b, amount) - expected) > 1) lerp_errors++;
+            }
+            TEST_ASSERT(lerp8(a, b, 0) == a);
+            TEST_ASSERT(lerp8(a, b, 255) == b);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, scale_errors);
+    TEST_ASSERT_EQUAL(0, lerp_errors);
+}
+
+//! hue 0..255 maps to 0..360 degrees, the integer path steps in sixths of 43
+static void test_hsv_ints_near_float(void) {
+    int max_error = 0;
+    for (int hue = 0; hue < 256; hue++) {
+        for (int sat = 0; sat < 256; sat += 15) {
+            for (int value = 0; value < 256; value += 15) {
+                RGB_t fixed, exact;
+                hsv_to_rgb_ints(hue, sat, value, &fixed);
+                hsv_to_rgb(hue * 360.0f / 256, sat / 255.0f, value / 255.0f, &exact);
+
+                int errors[3] = { fixed.red - exact.red, fixed.green - exact.green, fixed.blue - exact.blue };
+                for (int c = 0; c < 3; c++) {
+                    if (abs(errors[c]) > max_error) max_error = abs(errors[c]);
+                }
+            }
+        }
+    }
+    TEST_ASSERT(max_error <= 10);
+}
+
+int main(void) {
+    RUN_TEST(test_sin_q15_all_angles);
+    RUN_TEST(test_sin_wave8_all_angles);
+    RUN_TEST(test_scale8_lerp8);
+    RUN_TEST(test_hsv_ints_near_float);
+
+    return TEST_RESULT();
+}
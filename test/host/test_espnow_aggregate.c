@@ -0,0 +1,139 @@
+#include <string.h>
+
+#include "test.h"
+#include "espnow_aggregate.h"
+#include "espnow_mesh.h"
+#include "secure_session.h"
+
+//# Records packed by the sender come back out of espnow_agg_dispatch in
+//# order, and every flush reason fires when it should. Sent frames are
+//# captured in place of espnow_send.
+
+static espnow_message_t sent[8];
+static int sent_count;
+static bool send_fails;
+
+static uint8_t got_types[64];
+static int32_t got_values[64];
+static int got_count;
+
+esp_err_t espnow_seal_message(espnow_message_t *message) { return ESP_OK; }
+
+esp_err_t espnow_send(uint8_t *data, size_t len) {
+    if (send_fails || sent_count == 8) return ESP_ERR_TIMEOUT;
+    memcpy(&sent[sent_count++], data, len);
+    return ESP_OK;
+}
+
+static void on_record(const uint8_t *src_addr, uint8_t type, const uint8_t *value, uint8_t len) {
+    got_types[got_count] = type;
+    memcpy(&got_values[got_count], value, len < 4 ? len : 4);
+    got_count++;
+}
+
+static void reset(void) {
+    sent_count = got_count = 0;
+    send_fails = false;
+}
+
+static int dispatch(espnow_message_t *message) {
+    espnow_received_message_t received = { .message = message, .data_len = message->data_len };
+    return espnow_agg_dispatch(&received);
+}
+
+static void add_reading(espnow_aggregator_t *agg, uint8_t type, int32_t value, uint64_t time) {
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_agg_add(agg, type, &value, sizeof(value), time));
+}
+
+static void test_burst_round_trip(void) {
+    reset();
+    espnow_aggregator_t agg;
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){ .max_delay_us = 50000 });
+
+    // one apds9960 burst
+    for (int i = 0; i < 5; i++) add_reading(&agg, 4 + i, 1000 * i - 7, 1000);
+    espnow_agg_task(&agg, 40000);
+    TEST_ASSERT_EQUAL(0, sent_count);
+    espnow_agg_task(&agg, 51000);
+    TEST_ASSERT_EQUAL(1, sent_count);
+    TEST_ASSERT_EQUAL(1, agg.stats.flush_deadline);
+    TEST_ASSERT_EQUAL(50000, agg.stats.total_delay_us);
+
+    TEST_ASSERT(sent[0].flags & ESPNOW_FLAG_AGGREGATE);
+    TEST_ASSERT_EQUAL(5 * (ESPNOW_AGG_RECORD_HEADER + 4), sent[0].data_len);
+    TEST_ASSERT_EQUAL(5, dispatch(&sent[0]));
+    TEST_ASSERT_EQUAL(5, got_count);
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(4 + i, got_types[i]);
+        TEST_ASSERT_EQUAL(1000 * i - 7, got_values[i]);
+    }
+}
+
+static void test_flush_on_size_and_full(void) {
+    reset();
+    espnow_aggregator_t agg;
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){ .max_delay_us = 1000000 });
+
+    // 38 records of 6 bytes fill 228 of the 230 bytes, the 39th starts a new frame
+    int per_frame = ESPNOW_MAX_DATA_LEN / (ESPNOW_AGG_RECORD_HEADER + 4);
+    for (int i = 0; i <= per_frame; i++) add_reading(&agg, 1, i, 0);
+    TEST_ASSERT_EQUAL(1, sent_count);
+    TEST_ASSERT_EQUAL(1, agg.stats.flush_full);
+    TEST_ASSERT_EQUAL(per_frame, dispatch(&sent[0]));
+
+    // a size threshold sends as soon as it is reached
+    reset();
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){ .flush_bytes = 12, .max_delay_us = 1000000 });
+    add_reading(&agg, 1, 1, 0);
+    TEST_ASSERT_EQUAL(0, sent_count);
+    add_reading(&agg, 2, 2, 0);
+    TEST_ASSERT_EQUAL(1, sent_count);
+    TEST_ASSERT_EQUAL(1, agg.stats.flush_size);
+}
+
+//! a refused send keeps the records, only a record that can't fit anywhere is dropped
+static void test_failed_send_keeps_records(void) {
+    reset();
+    espnow_aggregator_t agg;
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){ .max_delay_us = 10000 });
+    add_reading(&agg, 1, 11, 0);
+
+    send_fails = true;
+    espnow_agg_task(&agg, 20000);
+    TEST_ASSERT_EQUAL(0, agg.stats.frames);
+
+    send_fails = false;
+    espnow_agg_task(&agg, 30000);
+    TEST_ASSERT_EQUAL(1, sent_count);
+    TEST_ASSERT_EQUAL(1, dispatch(&sent[0]));
+    TEST_ASSERT_EQUAL(11, got_values[0]);
+
+    uint8_t big[ESPNOW_MAX_DATA_LEN];
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, espnow_agg_add(&agg, 1, big, ESPNOW_MAX_DATA_LEN - 1, 0));
+
+    // secure frames leave room for the seal
+    espnow_agg_init(&agg, ESPNOW_GROUP_ALL, (espnow_agg_policy_t){ .secure = true });
+    TEST_ASSERT_EQUAL(ESPNOW_MAX_DATA_LEN - SECURE_SESSION_OVERHEAD, agg.policy.flush_bytes);
+}
+
+static void test_truncated_frame(void) {
+    reset();
+    espnow_message_t message = { .flags = ESPNOW_FLAG_AGGREGATE, .data_len = 9 };
+    uint8_t records[] = { 1, 4, 1, 0, 0, 0, 2, 4, 0 };     // second record cut short
+    memcpy(message.data, records, sizeof(records));
+
+    TEST_ASSERT_EQUAL(-1, dispatch(&message));
+    TEST_ASSERT_EQUAL(1, got_count);
+}
+
+int main(void) {
+    espnow_mesh_setup((const uint8_t[6]){ 0x02, 0, 0, 0, 0, 1 });
+    for (int type = 1; type <= 8; type++) espnow_agg_register(type, on_record);
+
+    RUN_TEST(test_burst_round_trip);
+    RUN_TEST(test_flush_on_size_and_full);
+    RUN_TEST(test_failed_send_keeps_records);
+    RUN_TEST(test_truncated_frame);
+
+    return TEST_RESULT();
+}
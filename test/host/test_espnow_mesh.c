@@ -0,0 +1,157 @@
+#include <string.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+#include "espnow_mesh_nodes.h"
+
+//# The flooding mesh on small fixed topologies, every node its own copy of
+//# espnow_mesh.c state, see espnow_mesh_nodes.h.
+
+static const uint8_t broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+static uint64_t now = 1000000;
+
+static espnow_message_t make_message(const uint8_t *target, uint8_t group_id) {
+    espnow_message_t message = { .group_id = group_id, .data_len = 4 };
+    memcpy(message.target_addr, target, 6);
+    memcpy(message.data, "ping", 4);
+    return message;
+}
+
+static void line(int count) {
+    mesh_nodes_setup(count);
+    for (int i = 0; i + 1 < count; i++) mesh_nodes_link(i, i + 1);
+}
+
+//! steps 1 ms at a time until every forward went out
+static void settle(void) {
+    for (int i = 0; i < 1000 && !mesh_nodes_idle(); i++) {
+        now += 1000;
+        mesh_nodes_step(now);
+    }
+    TEST_ASSERT(mesh_nodes_idle());
+}
+
+static espnow_mesh_stats_t stats_of(int node) {
+    espnow_mesh_stats_t stats;
+    mesh_nodes_get_stats(node, &stats);
+    return stats;
+}
+
+//! SECTION hops
+
+//! node k of a line hears the broadcast after k - 1 forwards, TTL 5 ends it at node 5
+static void test_hop_histogram(void) {
+    line(7);
+    espnow_message_t message = make_message(broadcast, ESPNOW_GROUP_ALL);
+    TEST_ASSERT_EQUAL(ESP_OK, mesh_nodes_send(0, &message, now));
+    settle();
+
+    for (int node = 1; node <= 5; node++) {
+        espnow_mesh_stats_t stats = stats_of(node);
+        TEST_ASSERT_EQUAL(1, stats.delivered);
+        for (int hop = 0; hop < ESPNOW_MESH_MAX_HOPS; hop++) {
+            TEST_ASSERT_EQUAL(hop == node - 1 ? 1 : 0, stats.hops[hop]);
+        }
+    }
+    TEST_ASSERT_EQUAL(1, stats_of(5).ttl_expired);
+    TEST_ASSERT_EQUAL(0, stats_of(5).forwarded);
+    TEST_ASSERT_EQUAL(0, stats_of(6).received);
+
+    //! the origin hears its own message back once, as a duplicate
+    espnow_mesh_stats_t origin = stats_of(0);
+    TEST_ASSERT_EQUAL(1, origin.originated);
+    TEST_ASSERT_EQUAL(0, origin.delivered);
+    TEST_ASSERT_EQUAL(1, origin.duplicates);
+    TEST_ASSERT_EQUAL(1 + 4, mesh_nodes_frames());
+}
+
+//! SECTION dedup
+
+static bool receive(uint8_t msg_id, const uint8_t *target) {
+    static const uint8_t origin[6] = { 0x02, 0x00, 0x00, 0x00, 0x0A, 0x0A };
+    espnow_message_t message = make_message(target, ESPNOW_GROUP_ALL);
+    memcpy(message.origin_addr, origin, 6);
+    message.msg_id = msg_id;
+    message.time_to_live = 1;                           // nothing queued for forwarding
+    mesh_nodes_select(0);
+    return espnow_mesh_receive(origin, &message, now);
+}
+
+//! a full cache evicts the least recently seen entry, a hit refreshes it
+static void test_dedup_eviction(void) {
+    mesh_nodes_setup(1);
+    for (int id = 0; id < ESPNOW_MESH_DEDUP_SIZE; id++) TEST_ASSERT(receive(id, broadcast));
+
+    TEST_ASSERT(!receive(0, broadcast));                // still cached, now the newest
+    TEST_ASSERT(receive(ESPNOW_MESH_DEDUP_SIZE, broadcast));  // evicts id 1
+    TEST_ASSERT(receive(1, broadcast));                 // delivered again, evicts id 2
+    TEST_ASSERT(!receive(0, broadcast));
+    TEST_ASSERT(!receive(ESPNOW_MESH_DEDUP_SIZE, broadcast));
+    TEST_ASSERT(receive(2, broadcast));
+
+    //! the target is part of the key, a unicast can't shadow the broadcast with the same id
+    TEST_ASSERT(receive(3, mesh_nodes_mac(0)));
+
+    espnow_mesh_stats_t stats = stats_of(0);
+    TEST_ASSERT_EQUAL(3, stats.duplicates);
+    TEST_ASSERT_EQUAL(ESPNOW_MESH_DEDUP_SIZE + 4, stats.delivered);
+    TEST_ASSERT_EQUAL(stats.received, stats.delivered + stats.duplicates);
+}
+
+//! SECTION groups
+
+//! a node outside the group forwards the message without delivering it
+static void test_group_filtering(void) {
+    line(3);
+    mesh_nodes_select(2);
+    espnow_mesh_join_group(9);
+
+    espnow_message_t message = make_message(broadcast, 9);
+    mesh_nodes_send(0, &message, now);
+    settle();
+    TEST_ASSERT_EQUAL(0, stats_of(1).delivered);
+    TEST_ASSERT_EQUAL(1, stats_of(1).group_filtered);
+    TEST_ASSERT_EQUAL(1, stats_of(1).forwarded);
+    TEST_ASSERT_EQUAL(1, stats_of(2).delivered);
+
+    mesh_nodes_select(2);
+    espnow_mesh_leave_group(9);
+    message = make_message(broadcast, 9);
+    mesh_nodes_send(0, &message, now);
+    settle();
+    TEST_ASSERT_EQUAL(1, stats_of(2).delivered);
+    TEST_ASSERT_EQUAL(1, stats_of(2).group_filtered);
+
+    //! ESPNOW_GROUP_ALL needs no join
+    message = make_message(broadcast, ESPNOW_GROUP_ALL);
+    mesh_nodes_send(0, &message, now);
+    settle();
+    TEST_ASSERT_EQUAL(1, stats_of(1).delivered);
+    TEST_ASSERT_EQUAL(2, stats_of(2).delivered);
+}
+
+//! SECTION unicast
+
+//! a unicast is relayed towards its target and not past it
+static void test_unicast_stops_at_target(void) {
+    line(4);
+    espnow_message_t message = make_message(mesh_nodes_mac(2), ESPNOW_GROUP_ALL);
+    mesh_nodes_send(0, &message, now);
+    settle();
+
+    TEST_ASSERT_EQUAL(0, stats_of(1).delivered);
+    TEST_ASSERT_EQUAL(1, stats_of(1).forwarded);
+    TEST_ASSERT_EQUAL(1, stats_of(2).delivered);
+    TEST_ASSERT_EQUAL(1, stats_of(2).hops[1]);
+    TEST_ASSERT_EQUAL(0, stats_of(2).forwarded);
+    TEST_ASSERT_EQUAL(0, stats_of(3).received);
+    TEST_ASSERT_EQUAL(1 + 1, mesh_nodes_frames());
+}
+
+int main(void) {
+    RUN_TEST(test_hop_histogram);
+    RUN_TEST(test_dedup_eviction);
+    RUN_TEST(test_group_filtering);
+    RUN_TEST(test_unicast_stops_at_target);
+    return TEST_RESULT();
+}
@@ -0,0 +1,265 @@
+#include <stdlib.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+
+//# espnow_parse_message and the receive callback around it, built with
+//# -fsanitize=address. Every frame is copied into a heap buffer of exactly
+//# its length, so a read past the end of the WiFi buffer is reported by
+//# ASan. mod_espnow.c is compiled in here to check the rx pool's free mask
+//# after every rejection. Sessions are stubbed, nothing here gets sealed.
+
+#include "mod_espnow.c"
+
+#define ALL_FREE    ((1u << ESPNOW_QUEUE_SIZE) - 1)
+#define RANDOM_RUNS 20000
+
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+static uint8_t self_mac[6];
+static uint64_t now = 1000000;
+static int delivered;
+
+esp_err_t secure_session_setup(const uint8_t *self_mac) {
+    return ESP_OK;
+}
+
+esp_err_t secure_session_seal(const uint8_t *key_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t cap, size_t *out_len) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t secure_session_open(const uint8_t *key_mac, const uint8_t *sender_mac, const uint8_t *aad, size_t aad_len,
+                              uint8_t *buff, size_t len, size_t *out_len) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+static void on_message(espnow_received_message_t received) {
+    delivered++;
+}
+
+//! a well formed broadcast with data_len payload bytes
+static espnow_message_t make_frame(uint8_t data_len) {
+    static uint8_t msg_id;
+    espnow_message_t message = { .msg_id = msg_id++, .time_to_live = 1, .data_len = data_len };
+    memset(message.target_addr, 0xFF, sizeof(message.target_addr));
+    memcpy(message.origin_addr, peer_mac, sizeof(peer_mac));
+    for (int i = 0; i < data_len; i++) message.data[i] = i;
+    return message;
+}
+
+static uint32_t free_mask(void) {
+    taskENTER_CRITICAL(&rx_lock);
+    uint32_t mask = rx_free_mask;
+    taskEXIT_CRITICAL(&rx_lock);
+    return mask;
+}
+
+//! the WiFi task hands over len bytes, from a buffer that ends right there
+static void receive(const void *frame, int len) {
+    uint8_t *buff = malloc(len);
+    memcpy(buff, frame, len);
+    mock_espnow_receive(peer_mac, buff, len);
+    free(buff);
+}
+
+//! parses a heap copy of exactly len bytes
+static esp_err_t parse(const void *frame, int len) {
+    uint8_t *buff = malloc(len);
+    memcpy(buff, frame, len);
+    espnow_message_t message;
+    uint8_t data_len;
+    esp_err_t err = espnow_parse_message(buff, len, &message, &data_len);
+    free(buff);
+    return err;
+}
+
+//! hands everything queued to espnow_task, the pool is empty again afterwards
+static void drain(void) {
+    now += 1000;
+    espnow_task(now);
+    mock_espnow_reset();
+    TEST_ASSERT_EQUAL(ALL_FREE, free_mask());
+}
+
+//! the frame went through the receive callback and was counted as malformed, nothing kept
+static void expect_rejected(const void *frame, int len) {
+    espnow_rx_stats_t before, after;
+    espnow_get_rx_stats(&before);
+    receive(frame, len);
+    espnow_get_rx_stats(&after);
+
+    TEST_ASSERT_EQUAL(before.received + 1, after.received);
+    TEST_ASSERT_EQUAL(before.malformed + 1, after.malformed);
+    TEST_ASSERT_EQUAL(before.pool_full, after.pool_full);
+    TEST_ASSERT_EQUAL(ALL_FREE, free_mask());
+}
+
+//! SECTION lengths
+
+//! every cut of a full frame, and frames longer than ESP-NOW carries
+static void test_truncation(void) {
+    uint8_t frame[ESPNOW_MAX_FRAME_LEN + 16] = { 0 };
+    espnow_message_t full = make_frame(ESPNOW_MAX_DATA_LEN);
+    memcpy(frame, &full, sizeof(full));
+
+    for (int len = 0; len < (int)sizeof(frame); len++) {
+        esp_err_t err = parse(frame, len);
+        if (len == ESPNOW_MAX_FRAME_LEN) {
+            TEST_ASSERT_EQUAL(ESP_OK, err);
+            continue;
+        }
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, err);
+        expect_rejected(frame, len);
+    }
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, espnow_parse_message(NULL, 0, &full, &full.data_len));
+}
+
+//! a frame cut one byte before the end of its payload
+static void test_short_payload(void) {
+    for (int data_len = 0; data_len <= ESPNOW_MAX_DATA_LEN; data_len += 23) {
+        espnow_message_t message = make_frame(data_len);
+        int len = ESPNOW_HEADER_SIZE + data_len;
+        TEST_ASSERT_EQUAL(ESP_OK, parse(&message, len));
+        if (data_len == 0) continue;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(&message, len - 1));
+        expect_rejected(&message, len - 1);
+    }
+}
+
+//! data_len claiming more than the frame holds, up to 255
+static void test_oversized_data_len(void) {
+    espnow_message_t message = make_frame(16);
+    int len = ESPNOW_HEADER_SIZE + 16;
+
+    for (int data_len = 17; data_len <= 255; data_len++) {
+        message.data_len = data_len;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(&message, len));
+        expect_rejected(&message, len);
+    }
+
+    //! the full frame doesn't make room for more than ESPNOW_MAX_DATA_LEN either
+    message.data_len = ESPNOW_MAX_DATA_LEN + 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, parse(&message, ESPNOW_MAX_FRAME_LEN));
+    expect_rejected(&message, ESPNOW_MAX_FRAME_LEN);
+}
+
+//! SECTION header
+
+static void test_flags(void) {
+    espnow_message_t message = make_frame(8);
+    int len = ESPNOW_HEADER_SIZE + 8;
+
+    for (int bit = 4; bit < 8; bit++) {
+        message.flags = 1u << bit;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(&message, len));
+        expect_rejected(&message, len);
+
+        //! an unknown bit next to known ones
+        message.flags = (1u << bit) | ESPNOW_FLAG_AGGREGATE;
+        expect_rejected(&message, len);
+    }
+
+    message.flags = ESPNOW_FLAG_ACK | ESPNOW_FLAG_ACK_REQ;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(&message, len));
+    expect_rejected(&message, len);
+
+    const uint8_t valid[] = { 0, ESPNOW_FLAG_ACK_REQ, ESPNOW_FLAG_ACK, ESPNOW_FLAG_AGGREGATE, ESPNOW_FLAG_SECURE,
+                              ESPNOW_FLAG_ACK_REQ | ESPNOW_FLAG_SECURE };
+    for (size_t i = 0; i < sizeof(valid); i++) {
+        message.flags = valid[i];
+        TEST_ASSERT_EQUAL(ESP_OK, parse(&message, len));
+    }
+}
+
+//! group and broadcast addresses can be a target, never an origin
+static void test_multicast_origin(void) {
+    espnow_message_t message = make_frame(8);
+    int len = ESPNOW_HEADER_SIZE + 8;
+
+    message.origin_addr[0] |= 0x01;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(&message, len));
+    expect_rejected(&message, len);
+
+    memset(message.origin_addr, 0xFF, sizeof(message.origin_addr));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, parse(&message, len));
+    expect_rejected(&message, len);
+}
+
+//! SECTION pool
+
+//! a full pool drops before parsing, malformed or not, and frees up after espnow_task
+static void test_pool_overflow(void) {
+    espnow_rx_stats_t before, after;
+    espnow_get_rx_stats(&before);
+
+    for (int i = 0; i < ESPNOW_QUEUE_SIZE; i++) {
+        espnow_message_t message = make_frame(8);
+        receive(&message, ESPNOW_HEADER_SIZE + 8);
+    }
+    TEST_ASSERT_EQUAL(0, free_mask());
+
+    espnow_message_t message = make_frame(8);
+    receive(&message, ESPNOW_HEADER_SIZE + 8);
+    receive(&message, 3);
+
+    espnow_get_rx_stats(&after);
+    TEST_ASSERT_EQUAL(2, after.pool_full - before.pool_full);
+    TEST_ASSERT_EQUAL(0, after.malformed - before.malformed);
+
+    delivered = 0;
+    drain();
+    TEST_ASSERT_EQUAL(ESPNOW_QUEUE_SIZE, delivered);
+}
+
+//! SECTION random
+
+//! what espnow_parse_message has to decide, written out independently
+static bool acceptable(const uint8_t *frame, int len) {
+    if (len < (int)ESPNOW_HEADER_SIZE || len > ESPNOW_MAX_FRAME_LEN) return false;
+    const espnow_message_t *message = (const espnow_message_t*)frame;
+    if (message->data_len + (int)ESPNOW_HEADER_SIZE > len) return false;
+    if (message->flags & 0xF0) return false;
+    if ((message->flags & 0x03) == 0x03) return false;
+    return !(message->origin_addr[0] & 0x01);
+}
+
+//! random bytes, random lengths, and random bytes behind a header that mostly passes
+static void test_random_frames(void) {
+    uint8_t frame[ESPNOW_MAX_FRAME_LEN + 8];
+    srand(1234);
+
+    for (int run = 0; run < RANDOM_RUNS; run++) {
+        int len = rand() % (sizeof(frame) + 1);
+        for (size_t i = 0; i < sizeof(frame); i++) frame[i] = rand();
+
+        if (run & 1) {
+            espnow_message_t *message = (espnow_message_t*)frame;
+            message->origin_addr[0] &= 0xFE;
+            message->flags &= ESPNOW_FLAG_AGGREGATE | ESPNOW_FLAG_SECURE;
+            if (len >= (int)ESPNOW_HEADER_SIZE) message->data_len %= len - ESPNOW_HEADER_SIZE + 2;
+        }
+
+        bool ok = acceptable(frame, len);
+        TEST_ASSERT_EQUAL(ok, parse(frame, len) == ESP_OK);
+        if (ok) {
+            receive(frame, len);
+            drain();
+        } else {
+            expect_rejected(frame, len);
+        }
+    }
+}
+
+int main(void) {
+    espnow_setup(self_mac, on_message);
+    host_set_time(now);
+
+    RUN_TEST(test_truncation);
+    RUN_TEST(test_short_payload);
+    RUN_TEST(test_oversized_data_len);
+    RUN_TEST(test_flags);
+    RUN_TEST(test_multicast_origin);
+    RUN_TEST(test_pool_overflow);
+    RUN_TEST(test_random_frames);
+    return TEST_RESULT();
+}
@@ -0,0 +1,198 @@
+#include <string.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+#include "esp_timer.h"
+#include "espnow_reliable.h"
+#include "espnow_mesh.h"
+
+//# Reliable unicast against the mocked driver. The sealing and rate limit
+//# normally in mod_espnow.c are stood in for below: a sealed payload gets
+//# one trailing counter byte, like the real trailer it changes on every seal.
+
+static const uint8_t self_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+static uint8_t seal_counter;
+static bool rate_limited;
+
+static int deliveries, failures;
+static uint32_t last_latency_us;
+
+esp_err_t espnow_seal_message(espnow_message_t *message) {
+    if (!(message->flags & ESPNOW_FLAG_SECURE)) return ESP_OK;
+    message->data[message->data_len++] = seal_counter++;
+    return ESP_OK;
+}
+
+esp_err_t espnow_open_message(espnow_message_t *message) {
+    return ESP_OK;
+}
+
+esp_err_t espnow_send_to(const uint8_t *mac, const void *data, size_t len) {
+    if (rate_limited) return ESP_ERR_TIMEOUT;
+    return esp_now_send(mac, data, len);
+}
+
+esp_err_t espnow_send(uint8_t *data, size_t len) {
+    static const uint8_t broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    return espnow_send_to(broadcast, data, len);
+}
+
+static void on_delivery(const uint8_t *mac, uint8_t msg_id, bool delivered, uint32_t latency_us) {
+    if (delivered) deliveries++;
+    else failures++;
+    last_latency_us = latency_us;
+}
+
+static void reset(void) {
+    mock_espnow_reset();
+    deliveries = failures = 0;
+    rate_limited = false;
+}
+
+static espnow_message_t make_message(const char *text, uint8_t flags) {
+    espnow_message_t message = { .flags = flags, .data_len = strlen(text) };
+    memcpy(message.data, text, message.data_len);
+    return message;
+}
+
+static void run_task(uint64_t time) {
+    host_set_time(time);
+    espnow_reliable_task(time);
+}
+
+static espnow_message_t ack_for(uint8_t msg_id) {
+    espnow_message_t ack = { .msg_id = msg_id, .flags = ESPNOW_FLAG_ACK };
+    memcpy(ack.target_addr, self_mac, 6);
+    memcpy(ack.origin_addr, peer_mac, 6);
+    return ack;
+}
+
+//! receiving an ACK request queues nothing by itself, the ACK waits for espnow_reliable_ack
+static void test_no_ack_before_authentication(void) {
+    reset();
+    espnow_message_t request = make_message("cmd", ESPNOW_FLAG_ACK_REQ | ESPNOW_FLAG_SECURE);
+    memcpy(request.target_addr, self_mac, 6);
+    memcpy(request.origin_addr, peer_mac, 6);
+    request.msg_id = 77;
+
+    TEST_ASSERT(espnow_reliable_wants_ack(&request));
+    TEST_ASSERT(espnow_reliable_receive(peer_mac, &request));      // not consumed, goes on to be opened
+    run_task(1000);
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+
+    espnow_reliable_ack(peer_mac, &request);
+    run_task(2000);
+
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+    espnow_message_t *ack = (espnow_message_t *)frame.data;
+    TEST_ASSERT(memcmp(frame.mac, peer_mac, 6) == 0);
+    TEST_ASSERT_EQUAL(ESPNOW_FLAG_ACK | ESPNOW_FLAG_SECURE, ack->flags);   // a secure request gets a sealed ACK
+    TEST_ASSERT_EQUAL(1, ack->data_len);
+    TEST_ASSERT_EQUAL(77, ack->msg_id);
+    TEST_ASSERT(memcmp(ack->origin_addr, self_mac, 6) == 0);
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+
+    // unicasts to another node and broadcasts never ask us for an ACK
+    memcpy(request.target_addr, peer_mac, 6);
+    TEST_ASSERT(!espnow_reliable_wants_ack(&request));
+    request.flags = ESPNOW_FLAG_SECURE;
+    memcpy(request.target_addr, self_mac, 6);
+    TEST_ASSERT(!espnow_reliable_wants_ack(&request));
+}
+
+//! every transmit is sealed on its own, the retry carries a fresh counter
+static void test_retry_is_sealed_again(void) {
+    reset();
+    uint64_t now = 1000000;
+    host_set_time(now);
+
+    espnow_message_t message = make_message("abc", ESPNOW_FLAG_SECURE);
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_send_reliable(peer_mac, &message, on_delivery));
+    TEST_ASSERT_EQUAL(3, message.data_len);                         // the caller's copy stays in clear
+
+    mock_espnow_frame_t first, second;
+    run_task(now);
+    TEST_ASSERT(mock_espnow_pop(&first));
+    run_task(now += ESPNOW_ACK_TIMEOUT_US * 2);
+    TEST_ASSERT(mock_espnow_pop(&second));
+
+    espnow_message_t *a = (espnow_message_t *)first.data, *b = (espnow_message_t *)second.data;
+    TEST_ASSERT_EQUAL(4, a->data_len);
+    TEST_ASSERT_EQUAL(4, b->data_len);
+    TEST_ASSERT_EQUAL(a->msg_id, b->msg_id);
+    TEST_ASSERT(memcmp(a->data, "abc", 3) == 0 && memcmp(b->data, "abc", 3) == 0);
+    TEST_ASSERT(a->data[3] != b->data[3]);
+    TEST_ASSERT(a->flags & ESPNOW_FLAG_SECURE);
+
+    //! anyone can send a plain ACK, only the sealed one completes a secure send
+    espnow_message_t ack = ack_for(a->msg_id);
+    TEST_ASSERT(!espnow_reliable_receive(peer_mac, &ack));
+    run_task(now + 1000);
+    TEST_ASSERT_EQUAL(0, deliveries);
+
+    ack.flags |= ESPNOW_FLAG_SECURE;
+    TEST_ASSERT(!espnow_reliable_receive(peer_mac, &ack));
+    run_task(now + 2000);
+    TEST_ASSERT_EQUAL(1, deliveries);
+}
+
+static void test_gives_up_after_retries(void) {
+    reset();
+    uint64_t now = 2000000;
+    host_set_time(now);
+
+    espnow_message_t message = make_message("lost", 0);
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_send_reliable(peer_mac, &message, on_delivery));
+
+    // backoff doubles with up to 25% jitter, a second per step is past any of them
+    for (int i = 0; i < ESPNOW_MAX_RETRIES + 3; i++) run_task(now += 1000000);
+
+    int transmits = 0;
+    mock_espnow_frame_t frame;
+    while (mock_espnow_pop(&frame)) transmits++;
+    TEST_ASSERT_EQUAL(ESPNOW_MAX_RETRIES + 1, transmits);
+    TEST_ASSERT_EQUAL(0, deliveries);
+    TEST_ASSERT_EQUAL(1, failures);
+}
+
+//! rate limited transmits don't count as attempts
+static void test_rate_limit_is_not_an_attempt(void) {
+    reset();
+    uint64_t now = 3000000;
+    host_set_time(now);
+
+    espnow_message_t message = make_message("slow", 0);
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_send_reliable(peer_mac, &message, on_delivery));
+
+    rate_limited = true;
+    for (int i = 0; i < 20; i++) run_task(now += 1000000);
+    TEST_ASSERT_EQUAL(0, failures);
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+
+    rate_limited = false;
+    run_task(now += 1000000);
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+
+    espnow_message_t ack = ack_for(((espnow_message_t *)frame.data)->msg_id);
+    espnow_reliable_receive(peer_mac, &ack);
+    run_task(now + 1000);
+    TEST_ASSERT_EQUAL(1, deliveries);
+    TEST_ASSERT_EQUAL(21 * 1000000, last_latency_us);
+}
+
+int main(void) {
+    srand(1);
+    espnow_mesh_setup(self_mac);
+    espnow_reliable_setup(self_mac);
+
+    RUN_TEST(test_no_ack_before_authentication);
+    RUN_TEST(test_retry_is_sealed_again);
+    RUN_TEST(test_gives_up_after_retries);
+    RUN_TEST(test_rate_limit_is_not_an_attempt);
+
+    return TEST_RESULT();
+}
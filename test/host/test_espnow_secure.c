@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "test.h"
+#include "mock_espnow.h"
+#include "mock_nvs.h"
+#include "esp_timer.h"
+#include "mbedtls/gcm.h"
+#include "mod_espnow.h"
+#include "espnow_mesh.h"
+#include "espnow_reliable.h"
+#include "secure_session.h"
+
+//# The receive path of mod_espnow.c with real AES-GCM. The peers' frames are
+//# sealed here straight with mbedTLS, following the trailer layout in
+//# secure_session.h, so the test also pins the wire format. A forged frame
+//# must not get an ACK, complete a send, enter the dedup cache or be forwarded.
+
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+static const uint8_t other_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x03 };
+static const uint8_t broadcast_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+static const uint8_t peer_key[SECURE_SESSION_KEY_LEN] = "peer-key-012345";
+static const uint8_t group_key[SECURE_SESSION_KEY_LEN] = "group-key-01234";
+
+static uint8_t self_mac[6];
+static uint32_t peer_counter = 1;
+static uint64_t now = 1000000;
+
+static int received_count;
+static espnow_message_t last_received;
+static int delivered_count;
+
+static void on_message(espnow_received_message_t received) {
+    received_count++;
+    last_received = *received.message;
+}
+
+static void on_delivery(const uint8_t *mac, uint8_t msg_id, bool delivered, uint32_t latency_us) {
+    if (delivered) delivered_count++;
+}
+
+//! seals as the peer would: nonce sender MAC | counter | key_id, header with the hop fields zeroed
+static void seal_as(const uint8_t *sender_mac, const uint8_t *key, espnow_message_t *message) {
+    uint8_t aad[ESPNOW_HEADER_SIZE], nonce[12] = { 0 };
+    memcpy(aad, message, sizeof(aad));
+    aad[offsetof(espnow_message_t, time_to_live)] = 0;
+    aad[offsetof(espnow_message_t, hop_count)] = 0;
+    aad[offsetof(espnow_message_t, data_len)] = 0;
+
+    uint32_t counter = peer_counter++;
+    memcpy(nonce, sender_mac, 6);
+    memcpy(nonce + 6, &counter, 4);
+    nonce[10] = 1;
+
+    uint8_t *trailer = message->data + message->data_len;
+    trailer[0] = 1;
+    memcpy(trailer + 1, &counter, 4);
+
+    mbedtls_gcm_context gcm;
+    mbedtls_gcm_init(&gcm);
+    mbedtls_gcm_setkey(&gcm, MBEDTLS_CIPHER_ID_AES, key, SECURE_SESSION_KEY_LEN * 8);
+    mbedtls_gcm_crypt_and_tag(&gcm, MBEDTLS_GCM_ENCRYPT, message->data_len, nonce, sizeof(nonce), aad, sizeof(aad),
+                              message->data, message->data, SECURE_SESSION_TAG_LEN, trailer + 5);
+    mbedtls_gcm_free(&gcm);
+    message->data_len += SECURE_SESSION_OVERHEAD;
+}
+
+static espnow_message_t make_message(const uint8_t *target, const uint8_t *origin, uint8_t msg_id,
+                                     uint8_t flags, const char *text) {
+    espnow_message_t message = { .msg_id = msg_id, .flags = flags, .time_to_live = 3, .data_len = strlen(text) };
+    memcpy(message.target_addr, target, 6);
+    memcpy(message.origin_addr, origin, 6);
+    memcpy(message.data, text, message.data_len);
+    return message;
+}
+
+static espnow_message_t forge(espnow_message_t message) {
+    message.data[0] ^= 0x01;
+    return message;
+}
+
+static void receive(const uint8_t *src_addr, const espnow_message_t *message) {
+    mock_espnow_receive(src_addr, message, espnow_message_size(message));
+}
+
+//! one main loop tick, then the next one after every forward jitter ran out
+static void run_task(void) {
+    host_set_time(now);
+    espnow_task(now);
+    now += ESPNOW_MESH_JITTER_MAX_US + 1000;
+    host_set_time(now);
+    espnow_task(now);
+}
+
+static void reset(void) {
+    mock_espnow_reset();
+    received_count = delivered_count = 0;
+}
+
+static void test_forged_request_gets_no_ack(void) {
+    reset();
+    espnow_rx_stats_t before, after;
+    espnow_get_rx_stats(&before);
+
+    espnow_message_t request = make_message(self_mac, peer_mac, 10, ESPNOW_FLAG_SECURE | ESPNOW_FLAG_ACK_REQ, "open");
+    seal_as(peer_mac, peer_key, &request);
+
+    //! the forgery arrives first, it must not shadow the real frame as a duplicate
+    espnow_message_t forged = forge(request);
+    receive(peer_mac, &forged);
+    run_task();
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+    TEST_ASSERT_EQUAL(0, received_count);
+
+    receive(peer_mac, &request);
+    run_task();
+    TEST_ASSERT_EQUAL(1, received_count);
+    TEST_ASSERT(memcmp(last_received.data, "open", 4) == 0);
+    TEST_ASSERT_EQUAL(4, last_received.data_len);
+
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+    espnow_message_t *ack = (espnow_message_t *)frame.data;
+    TEST_ASSERT(memcmp(frame.mac, peer_mac, 6) == 0);
+    TEST_ASSERT_EQUAL(ESPNOW_FLAG_ACK | ESPNOW_FLAG_SECURE, ack->flags);
+    TEST_ASSERT_EQUAL(SECURE_SESSION_OVERHEAD, ack->data_len);
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+
+    espnow_get_rx_stats(&after);
+    TEST_ASSERT_EQUAL(1, after.auth_failed - before.auth_failed);
+    TEST_ASSERT_EQUAL(1, after.delivered - before.delivered);
+}
+
+static void test_forged_ack_keeps_send_pending(void) {
+    reset();
+    espnow_message_t message = make_message(peer_mac, self_mac, 0, ESPNOW_FLAG_SECURE, "cmd");
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_send_reliable(peer_mac, &message, on_delivery));
+    host_set_time(now);
+    espnow_task(now);
+
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+    uint8_t msg_id = ((espnow_message_t *)frame.data)->msg_id;
+
+    //! a plain ACK and a sealed one with a bad tag both leave it waiting
+    espnow_message_t plain = make_message(self_mac, peer_mac, msg_id, ESPNOW_FLAG_ACK, "");
+    receive(peer_mac, &plain);
+    espnow_message_t ack = make_message(self_mac, peer_mac, msg_id, ESPNOW_FLAG_ACK | ESPNOW_FLAG_SECURE, "");
+    seal_as(peer_mac, peer_key, &ack);
+    espnow_message_t forged = ack;
+    forged.data[SECURE_SESSION_OVERHEAD - 1] ^= 0x01;
+    receive(peer_mac, &forged);
+    host_set_time(now += 1000);
+    espnow_task(now);
+    host_set_time(now += 1000);
+    espnow_task(now);
+    TEST_ASSERT_EQUAL(0, delivered_count);
+
+    receive(peer_mac, &ack);
+    host_set_time(now += 1000);
+    espnow_task(now);
+    host_set_time(now += 1000);
+    espnow_task(now);
+    TEST_ASSERT_EQUAL(1, delivered_count);
+    while (mock_espnow_pop(&frame)) {}
+}
+
+static void test_group_forwarded_only_after_open(void) {
+    reset();
+    espnow_message_t message = make_message(broadcast_mac, other_mac, 20, ESPNOW_FLAG_SECURE, "all");
+    seal_as(other_mac, group_key, &message);
+
+    espnow_message_t forged = forge(message);
+    receive(peer_mac, &forged);
+    run_task();
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+
+    receive(peer_mac, &message);
+    run_task();
+    TEST_ASSERT_EQUAL(1, received_count);
+
+    //! the forward is the frame as received, still sealed, one hop further
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+    espnow_message_t *forward = (espnow_message_t *)frame.data;
+    TEST_ASSERT(memcmp(frame.mac, broadcast_mac, 6) == 0);
+    TEST_ASSERT_EQUAL(message.data_len, forward->data_len);
+    TEST_ASSERT(memcmp(forward->data, message.data, message.data_len) == 0);
+    TEST_ASSERT_EQUAL(2, forward->time_to_live);
+    TEST_ASSERT_EQUAL(1, forward->hop_count);
+
+    //! the echo from another neighbour is a duplicate now
+    receive(other_mac, &message);
+    run_task();
+    TEST_ASSERT_EQUAL(1, received_count);
+    TEST_ASSERT_EQUAL(0, mock_espnow_pending());
+}
+
+//! no pairwise key for other nodes' unicasts, they pass through unopened
+static void test_relays_foreign_unicast(void) {
+    reset();
+    espnow_message_t message = make_message(other_mac, peer_mac, 30, ESPNOW_FLAG_SECURE, "hop");
+    seal_as(peer_mac, peer_key, &message);
+
+    receive(peer_mac, &message);
+    run_task();
+    TEST_ASSERT_EQUAL(0, received_count);
+
+    mock_espnow_frame_t frame;
+    TEST_ASSERT(mock_espnow_pop(&frame));
+    espnow_message_t *forward = (espnow_message_t *)frame.data;
+    TEST_ASSERT(memcmp(forward->target_addr, other_mac, 6) == 0);
+    TEST_ASSERT(memcmp(forward->data, message.data, message.data_len) == 0);
+}
+
+int main(void) {
+    srand(1);
+    mock_nvs_reset();
+    host_set_time(now);
+    TEST_ASSERT_EQUAL(ESP_OK, espnow_setup(self_mac, on_message));
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_set_key(peer_mac, 1, peer_key));
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_set_key(broadcast_mac, 1, group_key));
+
+    RUN_TEST(test_forged_request_gets_no_ack);
+    RUN_TEST(test_forged_ack_keeps_send_pending);
+    RUN_TEST(test_group_forwarded_only_after_open);
+    RUN_TEST(test_relays_foreign_unicast);
+
+    return TEST_RESULT();
+}
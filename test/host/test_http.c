@@ -0,0 +1,382 @@
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "mock_httpd.h"
+#include "http.h"
+
+//# Load test of the async worker pool through the mocked httpd transport.
+//# Built with HTTP_ASYNC_TIMEOUT_MS=200 and HTTP_ASYNC_DEADLINE_MS=500 so
+//# queue timeouts and deadlines trigger within a test run.
+
+#define FILE_SIZE       (64 * 1024)             // 4 chunks of HTTP_FILE_CHUNK_SIZE
+#define SMALL_FILE_SIZE (16 * 1024)
+#define MAX_FDS         32
+
+typedef struct {
+    bool used;
+    size_t size;
+    size_t offset;
+} mem_file_t;
+
+static mem_file_t files[MAX_FDS];
+static pthread_mutex_t files_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint8_t file_byte(size_t offset) {
+    return (offset * 7 + (offset >> 8)) & 0xFF;
+}
+
+static int file_open(const char *path, size_t *file_size) {
+    size_t size;
+    if (strcmp(path, "/big.bin") == 0) size = FILE_SIZE;
+    else if (strcmp(path, "/small.bin") == 0) size = SMALL_FILE_SIZE;
+    else return -1;
+
+    pthread_mutex_lock(&files_lock);
+    for (int fd = 0; fd < MAX_FDS; fd++) {
+        if (files[fd].used) continue;
+        files[fd] = (mem_file_t){ .used = true, .size = size };
+        pthread_mutex_unlock(&files_lock);
+        *file_size = size;
+        return fd;
+    }
+    pthread_mutex_unlock(&files_lock);
+    return -1;
+}
+
+static ssize_t file_read(int fd, char *buffer, size_t len) {
+    mem_file_t *file = &files[fd];
+    size_t n = file->size - file->offset < len ? file->size - file->offset : len;
+    for (size_t i = 0; i < n; i++) buffer[i] = file_byte(file->offset + i);
+    file->offset += n;
+    return n;
+}
+
+static int file_seek(int fd, size_t offset) {
+    if (offset > files[fd].size) return -1;
+    files[fd].offset = offset;
+    return 0;
+}
+
+static int file_close(int fd) {
+    pthread_mutex_lock(&files_lock);
+    files[fd].used = false;
+    pthread_mutex_unlock(&files_lock);
+    return 0;
+}
+
+static void request_data(uint16_t **data, size_t *size) {
+    static uint16_t values[4] = { 1, 2, 3, 4 };
+    *data = values;
+    *size = 4;
+}
+
+static http_interface_t interface = {
+    .on_file_open_cb = file_open,
+    .on_file_read_cb = file_read,
+    .on_file_seek_cb = file_seek,
+    .on_file_close_cb = file_close,
+    .on_request_data = request_data,
+};
+
+static bool body_matches(const mock_response_t *response, size_t start, size_t len) {
+    if (response->body_len != len) return false;
+    for (size_t i = 0; i < len; i++) {
+        if (response->body[i] != file_byte(start + i)) return false;
+    }
+    return true;
+}
+
+static void wait_queue_empty(void) {
+    http_stats_t stats;
+    do {
+        usleep(1000);
+        http_get_stats(&stats);
+    } while (stats.queue_depth > 0);
+}
+
+//! lets the workers finish whatever they picked up last
+static void wait_idle(void) {
+    wait_queue_empty();
+    usleep(50000);
+}
+
+//! SECTION /long counter
+
+#define COUNT_THREADS 4
+#define COUNT_REQUESTS 50
+
+static int counts[COUNT_THREADS * COUNT_REQUESTS];
+static int count_index;
+static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void *long_client(void *arg) {
+    for (int i = 0; i < COUNT_REQUESTS; i++) {
+        mock_response_t response;
+        do {
+            mock_response_init(&response);
+            mock_httpd_request(HTTP_GET, "/long", NULL, &response);
+            mock_response_wait(&response, 2000);
+            if (strncmp(response.status, "503", 3) == 0) {
+                mock_response_free(&response);
+                usleep(100);
+                continue;
+            }
+            break;
+        } while (true);
+
+        int value = -1;
+        if (response.body) sscanf((char*)response.body, "<div>req: %d", &value);
+        pthread_mutex_lock(&count_lock);
+        counts[count_index++] = value;
+        pthread_mutex_unlock(&count_lock);
+        mock_response_free(&response);
+    }
+    return NULL;
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+//! the workers bump the counter concurrently, every request must see its own value
+static void test_long_counter_is_unique(void) {
+    pthread_t threads[COUNT_THREADS];
+    for (int i = 0; i < COUNT_THREADS; i++) pthread_create(&threads[i], NULL, long_client, NULL);
+    for (int i = 0; i < COUNT_THREADS; i++) pthread_join(threads[i], NULL);
+
+    int total = COUNT_THREADS * COUNT_REQUESTS;
+    TEST_ASSERT_EQUAL(total, count_index);
+    qsort(counts, total, sizeof(int), compare_int);
+    for (int i = 0; i < total; i++) TEST_ASSERT_EQUAL(i + 1, counts[i]);
+}
+
+//! SECTION pool limits
+
+//! workers plus queue slots are accepted, the rest is turned away with 503
+static void test_burst_rejects_overflow(void) {
+    wait_idle();
+    mock_httpd_set_send_delay(20000);                   // ~80 ms per request
+
+    enum { BURST = 12 };
+    mock_response_t responses[BURST];
+    http_stats_t before, after;
+    http_get_stats(&before);
+
+    for (int i = 0; i < BURST; i++) {
+        mock_response_init(&responses[i]);
+        mock_httpd_request(HTTP_GET, "/file/big.bin", NULL, &responses[i]);
+    }
+
+    int accepted = 0, rejected = 0;
+    for (int i = 0; i < BURST; i++) {
+        TEST_ASSERT(mock_response_wait(&responses[i], 5000));
+        if (strncmp(responses[i].status, "503", 3) == 0) {
+            rejected++;
+        } else {
+            accepted++;
+            TEST_ASSERT(strcmp(responses[i].status, "200 OK") == 0);
+            TEST_ASSERT(responses[i].chunked_end);
+            TEST_ASSERT(body_matches(&responses[i], 0, FILE_SIZE));
+        }
+        mock_response_free(&responses[i]);
+    }
+
+    http_get_stats(&after);
+    TEST_ASSERT(accepted >= 4 && accepted <= 6);        // queue of 4, up to 2 already taken by workers
+    TEST_ASSERT_EQUAL(BURST - accepted, rejected);
+    TEST_ASSERT_EQUAL(rejected, after.rejected - before.rejected);
+    TEST_ASSERT(after.max_queue_depth <= 4);
+    mock_httpd_set_send_delay(0);
+}
+
+//! requests stuck behind slow ones past HTTP_ASYNC_TIMEOUT_MS get 408 without running
+static void test_queue_timeout(void) {
+    wait_idle();
+    mock_httpd_set_send_delay(100000);                  // ~400 ms per request, below the deadline
+
+    enum { BURST = 6 };
+    mock_response_t responses[BURST];
+    http_stats_t before, after;
+    http_get_stats(&before);
+
+    for (int i = 0; i < BURST; i++) {
+        if (i == 2) wait_queue_empty();                 // both workers busy, the rest waits in the queue
+        mock_response_init(&responses[i]);
+        mock_httpd_request(HTTP_GET, "/file/big.bin", NULL, &responses[i]);
+    }
+
+    int ok = 0, timed_out = 0;
+    for (int i = 0; i < BURST; i++) {
+        TEST_ASSERT(mock_response_wait(&responses[i], 5000));
+        if (strncmp(responses[i].status, "408", 3) == 0) timed_out++;
+        if (strncmp(responses[i].status, "200", 3) == 0 && body_matches(&responses[i], 0, FILE_SIZE)) ok++;
+        mock_response_free(&responses[i]);
+    }
+
+    http_get_stats(&after);
+    TEST_ASSERT_EQUAL(2, ok);
+    TEST_ASSERT_EQUAL(4, timed_out);
+    TEST_ASSERT_EQUAL(4, after.timed_out - before.timed_out);
+    mock_httpd_set_send_delay(0);
+}
+
+//! a client draining slower than HTTP_ASYNC_DEADLINE_MS allows is cut off and closed
+static void test_deadline_cuts_slow_client(void) {
+    wait_idle();
+    mock_httpd_set_send_delay(200000);                  // chunk 3 finishes at 600 ms
+
+    http_stats_t before, after;
+    http_get_stats(&before);
+
+    mock_response_t response;
+    mock_response_init(&response);
+    mock_httpd_request(HTTP_GET, "/file/big.bin", NULL, &response);
+    TEST_ASSERT(mock_response_wait(&response, 5000));
+
+    http_get_stats(&after);
+    TEST_ASSERT(response.closed);
+    TEST_ASSERT(!response.chunked_end);
+    TEST_ASSERT(response.body_len < FILE_SIZE);
+    TEST_ASSERT(response.done_us - response.start_us < 1000000);
+    TEST_ASSERT_EQUAL(1, after.deadline_exceeded - before.deadline_exceeded);
+
+    mock_response_free(&response);
+    mock_httpd_set_send_delay(0);
+}
+
+//! SECTION ranges
+
+typedef struct {
+    const char *range;
+    const char *status;
+    size_t start;
+    size_t len;
+} range_case_t;
+
+//! RFC 7233: malformed ranges are ignored (200, whole file), well formed ones outside the file get 416
+static void test_range_requests(void) {
+    wait_idle();
+    const range_case_t cases[] = {
+        { "bytes=0-99", "206", 0, 100 },
+        { "bytes=100-", "206", 100, SMALL_FILE_SIZE - 100 },
+        { "bytes=-100", "206", SMALL_FILE_SIZE - 100, 100 },
+        { "bytes=-99999", "206", 0, SMALL_FILE_SIZE },
+        { "bytes=16000-99999", "206", 16000, SMALL_FILE_SIZE - 16000 },
+        { "bytes=5-3", "200", 0, SMALL_FILE_SIZE },
+        { "bytes=abc", "200", 0, SMALL_FILE_SIZE },
+        { "bytes=-", "200", 0, SMALL_FILE_SIZE },
+        { "items=0-5", "200", 0, SMALL_FILE_SIZE },
+        { "bytes=16384-", "416", 0, 0 },
+        { "bytes=-0", "416", 0, 0 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const range_case_t *c = &cases[i];
+        mock_response_t response;
+        mock_response_init(&response);
+        mock_httpd_request(HTTP_GET, "/file/small.bin", c->range, &response);
+        TEST_ASSERT(mock_response_wait(&response, 2000));
+
+        bool ok = strncmp(response.status, c->status, 3) == 0 && body_matches(&response, c->start, c->len);
+        if (!ok) fprintf(stderr, "  %s -> %s, %zu bytes\n", c->range, response.status, response.body_len);
+        TEST_ASSERT(ok);
+
+        if (c->status[0] == '2' && c->status[2] == '6') {
+            char expected[64];
+            snprintf(expected, sizeof(expected), "bytes %zu-%zu/%d", c->start, c->start + c->len - 1, SMALL_FILE_SIZE);
+            TEST_ASSERT(strcmp(response.content_range, expected) == 0);
+        }
+        mock_response_free(&response);
+    }
+}
+
+//! SECTION sustained load
+
+#define LOAD_THREADS 6
+#define LOAD_REQUESTS 100
+
+static uint32_t latencies[LOAD_THREADS * LOAD_REQUESTS];
+static int latency_count;
+static int load_rejects;
+
+static void *load_client(void *arg) {
+    uintptr_t id = (uintptr_t)arg;
+    for (int i = 0; i < LOAD_REQUESTS; i++) {
+        const char *uri = (i + id) % 3 ? "/file/small.bin" : "/long";
+        uint64_t start = bench_now_ns();
+        mock_response_t response;
+
+        while (true) {
+            mock_response_init(&response);
+            mock_httpd_request(HTTP_GET, uri, NULL, &response);
+            mock_response_wait(&response, 5000);
+            if (strncmp(response.status, "503", 3) != 0) break;
+
+            __atomic_fetch_add(&load_rejects, 1, __ATOMIC_RELAXED);
+            mock_response_free(&response);
+            usleep(1000);                               // Retry-After, scaled down
+        }
+
+        TEST_ASSERT(strcmp(response.status, "200 OK") == 0);
+        mock_response_free(&response);
+
+        int index = __atomic_fetch_add(&latency_count, 1, __ATOMIC_RELAXED);
+        latencies[index] = (bench_now_ns() - start) / 1000;
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+//! more clients than workers and queue slots, each with a 1 ms send time per chunk
+static void test_sustained_load(void) {
+    wait_idle();
+    mock_httpd_set_send_delay(1000);
+
+    http_stats_t before, after;
+    http_get_stats(&before);
+
+    pthread_t threads[LOAD_THREADS];
+    for (uintptr_t i = 0; i < LOAD_THREADS; i++) pthread_create(&threads[i], NULL, load_client, (void*)i);
+    for (int i = 0; i < LOAD_THREADS; i++) pthread_join(threads[i], NULL);
+
+    http_get_stats(&after);
+    int total = LOAD_THREADS * LOAD_REQUESTS;
+    TEST_ASSERT_EQUAL(total, latency_count);
+    TEST_ASSERT_EQUAL(0, after.timed_out - before.timed_out);
+    TEST_ASSERT_EQUAL(0, after.deadline_exceeded - before.deadline_exceeded);
+
+    qsort(latencies, total, sizeof(uint32_t), compare_u32);
+    uint32_t completed = after.completed - before.completed;
+    printf("  %d clients, %d requests: p50 %u us  p95 %u us  p99 %u us  max %u us\n",
+           LOAD_THREADS, total, latencies[total / 2], latencies[total * 95 / 100],
+           latencies[total * 99 / 100], latencies[total - 1]);
+    printf("  503 retries %d, max queue depth %u, avg pool latency %llu us\n", load_rejects,
+           after.max_queue_depth, (unsigned long long)((after.total_latency_us - before.total_latency_us) / completed));
+
+    mock_httpd_set_send_delay(0);
+}
+
+//! httpd keeps 3 lwip sockets, the rest of the app 4, http gets what is left of 10
+static void test_socket_budget(void) {
+    TEST_ASSERT_EQUAL(CONFIG_LWIP_MAX_SOCKETS - 3 - 4, mock_httpd_config()->max_open_sockets);
+}
+
+int main(void) {
+    http_setup(&interface);
+
+    RUN_TEST(test_socket_budget);
+    RUN_TEST(test_long_counter_is_unique);
+    RUN_TEST(test_burst_rejects_overflow);
+    RUN_TEST(test_queue_timeout);
+    RUN_TEST(test_deadline_cuts_slow_client);
+    RUN_TEST(test_range_requests);
+    RUN_TEST(test_sustained_load);
+    return TEST_RESULT();
+}
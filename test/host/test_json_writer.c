@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "test.h"
+#include "json_writer.h"
+
+typedef struct {
+    char data[1024];
+    size_t len;
+    int flushes;
+    int fail_after;                                     // flush calls before reporting an error, 0 never
+} sink_t;
+
+static int sink_flush(void *ctx, const char *data, size_t len) {
+    sink_t *sink = ctx;
+    sink->flushes++;
+    if (sink->fail_after && sink->flushes >= sink->fail_after) return -1;
+    if (sink->len + len >= sizeof(sink->data)) return -1;
+    memcpy(sink->data + sink->len, data, len);
+    sink->len += len;
+    sink->data[sink->len] = 0;
+    return 0;
+}
+
+static void write_sample(json_writer_t *w) {
+    static const uint16_t values[] = { 0, 7, 65535 };
+    json_object_begin(w, NULL);
+    json_write_str(w, "status", "ok");
+    json_write_int(w, "min", -2147483647 - 1);
+    json_write_uint(w, "max", 4294967295u);
+    json_write_bool(w, "on", true);
+    json_write_fixed(w, "temp", -205, 2);
+    json_write_fixed(w, "volt", 3005, 3);
+    json_write_str(w, "esc", "a\"b\\c\n");
+    json_write_u16_array(w, "data", values, 3);
+    json_write_u16_array(w, "none", values, 0);
+    json_array_begin(w, "nested");
+    json_object_begin(w, NULL);
+    json_object_end(w);
+    json_write_uint(w, NULL, 1);
+    json_array_end(w);
+    json_object_end(w);
+}
+
+static const char sample_json[] =
+    "{\"status\":\"ok\",\"min\":-2147483648,\"max\":4294967295,\"on\":true,"
+    "\"temp\":-2.05,\"volt\":3.005,\"esc\":\"a\\\"b\\\\c\\u000a\","
+    "\"data\":[0,7,65535],\"none\":[],\"nested\":[{},1]}";
+
+static void test_zero_size_rejected(void) {
+    char buff[4];
+    sink_t sink = { 0 };
+    json_writer_t w;
+
+    // used to spin in json_put forever
+    TEST_ASSERT(json_writer_init(&w, buff, 0, sink_flush, &sink) != 0);
+    write_sample(&w);
+    TEST_ASSERT(json_writer_finish(&w) != 0);
+    TEST_ASSERT_EQUAL(0, sink.flushes);
+
+    TEST_ASSERT(json_writer_init(&w, NULL, sizeof(buff), sink_flush, &sink) != 0);
+    write_sample(&w);
+    TEST_ASSERT(json_writer_finish(&w) != 0);
+
+    TEST_ASSERT(json_writer_init(&w, buff, sizeof(buff), NULL, &sink) != 0);
+    write_sample(&w);
+    TEST_ASSERT(json_writer_finish(&w) != 0);
+    TEST_ASSERT_EQUAL(0, sink.flushes);
+}
+
+//! same document for every buffer size, down to one byte per flush
+static void test_output_any_buffer_size(void) {
+    const size_t sizes[] = { 1, 2, 7, 64, 256 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char buff[256];
+        sink_t sink = { 0 };
+        json_writer_t w;
+
+        TEST_ASSERT_EQUAL(0, json_writer_init(&w, buff, sizes[i], sink_flush, &sink));
+        write_sample(&w);
+        TEST_ASSERT_EQUAL(0, json_writer_finish(&w));
+        TEST_ASSERT(strcmp(sink.data, sample_json) == 0);
+        TEST_ASSERT_EQUAL((sizeof(sample_json) - 1 + sizes[i] - 1) / sizes[i], sink.flushes);
+    }
+}
+
+static void test_flush_error_stops_writer(void) {
+    char buff[8];
+    sink_t sink = { .fail_after = 2 };
+    json_writer_t w;
+
+    json_writer_init(&w, buff, sizeof(buff), sink_flush, &sink);
+    write_sample(&w);
+    TEST_ASSERT(json_writer_finish(&w) != 0);
+    TEST_ASSERT_EQUAL(2, sink.flushes);
+    TEST_ASSERT_EQUAL(sizeof(buff), sink.len);
+}
+
+static void test_depth_overflow(void) {
+    char buff[64];
+    sink_t sink = { 0 };
+    json_writer_t w;
+
+    json_writer_init(&w, buff, sizeof(buff), sink_flush, &sink);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH; i++) json_array_begin(&w, NULL);
+    TEST_ASSERT(json_writer_finish(&w) != 0);
+
+    json_writer_init(&w, buff, sizeof(buff), sink_flush, &sink);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH - 1; i++) json_array_begin(&w, NULL);
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH - 1; i++) json_array_end(&w);
+    TEST_ASSERT_EQUAL(0, json_writer_finish(&w));
+}
+
+int main(void) {
+    RUN_TEST(test_zero_size_rejected);
+    RUN_TEST(test_output_any_buffer_size);
+    RUN_TEST(test_flush_error_stops_writer);
+    RUN_TEST(test_depth_overflow);
+    return TEST_RESULT();
+}
@@ -0,0 +1,147 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test.h"
+#include "led_compositor.h"
+
+//# Blend modes against their float definitions, the range mask, layer
+//# order and when flatten has to do anything at all.
+
+#define LEDS 64
+
+static led_compositor_t comp;
+static uint8_t out[LEDS * 3];
+
+static void reset(void) {
+    for (int i = 0; i < comp.layer_count; i++) free(comp.layers[i].pixels);
+    TEST_ASSERT_EQUAL(ESP_OK, led_compositor_init(&comp, LEDS, 2));
+}
+
+//! bottom layer random and fully opaque, so out is just that layer before the top one blends
+static void fill_random(led_layer_t *layer, bool with_black) {
+    for (int i = 0; i < LEDS; i++) {
+        RGB_t rgb = { rand(), rand(), rand() };
+        if (with_black && i % 4 == 0) rgb = rgb_off;
+        led_layer_set(layer, i, rgb);
+    }
+}
+
+static double reference(led_blend_t blend, double dst, double src, double opacity, bool src_black) {
+    double a = opacity / 255;
+    switch (blend) {
+        case LED_BLEND_ADD:         return fmin(255, dst + src * a);
+        case LED_BLEND_MAX:         return fmax(dst, src * a);
+        case LED_BLEND_MULTIPLY:    return dst + (dst * src / 255 - dst) * a;
+        default:                    return src_black ? dst : dst + (src - dst) * a;
+    }
+}
+
+//! worst distance from the float blend, over every channel and a few opacities
+static double blend_error(led_blend_t blend) {
+    const uint8_t opacities[] = { 1, 64, 128, 200, 255 };
+    double max_error = 0;
+
+    for (size_t o = 0; o < sizeof(opacities); o++) {
+        reset();
+        fill_random(&comp.layers[0], false);
+        fill_random(&comp.layers[1], true);
+        led_layer_config(&comp.layers[1], opacities[o], blend, 0, LEDS - 1);
+        led_compositor_flatten(&comp, out);
+
+        const uint8_t *bottom = comp.layers[0].pixels, *top = comp.layers[1].pixels;
+        for (int i = 0; i < LEDS * 3; i++) {
+            const uint8_t *pixel = &top[i - i % 3];
+            bool black = (pixel[0] | pixel[1] | pixel[2]) == 0;
+            double error = fabs(out[i] - reference(blend, bottom[i], top[i], opacities[o], black));
+            if (error > max_error) max_error = error;
+        }
+    }
+    return max_error;
+}
+
+static void test_blend_modes(void) {
+    TEST_ASSERT(blend_error(LED_BLEND_ALPHA) <= 1.0);
+    TEST_ASSERT(blend_error(LED_BLEND_ADD) <= 1.0);
+    TEST_ASSERT(blend_error(LED_BLEND_MAX) <= 1.0);
+    //! scale8 then lerp8, two roundings
+    TEST_ASSERT(blend_error(LED_BLEND_MULTIPLY) <= 2.0);
+}
+
+static void test_exact_ends(void) {
+    reset();
+    fill_random(&comp.layers[0], false);
+    fill_random(&comp.layers[1], false);
+
+    //! full opacity alpha is a copy, multiply by white keeps what's below
+    led_compositor_flatten(&comp, out);
+    TEST_ASSERT(memcmp(out, comp.layers[1].pixels, sizeof(out)) == 0);
+
+    for (int i = 0; i < LEDS; i++) led_layer_set(&comp.layers[1], i, (RGB_t){ 255, 255, 255 });
+    led_layer_config(&comp.layers[1], 255, LED_BLEND_MULTIPLY, 0, LEDS - 1);
+    led_compositor_flatten(&comp, out);
+    TEST_ASSERT(memcmp(out, comp.layers[0].pixels, sizeof(out)) == 0);
+
+    led_layer_config(&comp.layers[1], 0, LED_BLEND_ADD, 0, LEDS - 1);
+    led_compositor_flatten(&comp, out);
+    TEST_ASSERT(memcmp(out, comp.layers[0].pixels, sizeof(out)) == 0);
+}
+
+static void test_range_and_order(void) {
+    reset();
+    RGB_t red = { 200, 0, 0 }, blue = { 0, 0, 200 };
+    for (int i = 0; i < LEDS; i++) {
+        led_layer_set(&comp.layers[0], i, red);
+        led_layer_set(&comp.layers[1], i, blue);
+    }
+    led_layer_config(&comp.layers[1], 255, LED_BLEND_ALPHA, 10, 19);
+    led_compositor_flatten(&comp, out);
+
+    //! GRB bytes, the top layer only inside its range
+    TEST_ASSERT_EQUAL(200, out[9 * 3 + 1]);
+    TEST_ASSERT_EQUAL(0, out[9 * 3 + 2]);
+    TEST_ASSERT_EQUAL(0, out[10 * 3 + 1]);
+    TEST_ASSERT_EQUAL(200, out[10 * 3 + 2]);
+    TEST_ASSERT_EQUAL(200, out[19 * 3 + 2]);
+    TEST_ASSERT_EQUAL(200, out[20 * 3 + 1]);
+
+    //! an end past the strip is clamped
+    led_layer_config(&comp.layers[1], 255, LED_BLEND_ALPHA, 60, 1000);
+    TEST_ASSERT_EQUAL(LEDS - 1, comp.layers[1].end_index);
+    led_compositor_flatten(&comp, out);
+    TEST_ASSERT_EQUAL(200, out[(LEDS - 1) * 3 + 2]);
+}
+
+static void test_dirty_tracking(void) {
+    reset();
+    TEST_ASSERT(led_compositor_flatten(&comp, out));
+    TEST_ASSERT(!led_compositor_flatten(&comp, out));
+
+    //! the same colour again, or clearing a black layer, is no change
+    led_layer_set(&comp.layers[0], 3, rgb_off);
+    led_layer_clear(&comp.layers[1]);
+    TEST_ASSERT(!led_compositor_flatten(&comp, out));
+
+    led_layer_set(&comp.layers[0], 3, (RGB_t){ 1, 2, 3 });
+    TEST_ASSERT(led_compositor_flatten(&comp, out));
+    led_layer_set(&comp.layers[0], 3, (RGB_t){ 1, 2, 3 });
+    TEST_ASSERT(!led_compositor_flatten(&comp, out));
+
+    //! clearing the last LED only is still a change
+    led_layer_set(&comp.layers[1], LEDS - 1, (RGB_t){ 0, 0, 1 });
+    led_compositor_flatten(&comp, out);
+    led_layer_clear(&comp.layers[1]);
+    TEST_ASSERT(comp.layers[1].dirty);
+    TEST_ASSERT(led_compositor_flatten(&comp, out));
+    TEST_ASSERT_EQUAL(0, out[(LEDS - 1) * 3 + 2]);
+}
+
+int main(void) {
+    srand(5);
+    RUN_TEST(test_blend_modes);
+    RUN_TEST(test_exact_ends);
+    RUN_TEST(test_range_and_order);
+    RUN_TEST(test_dirty_tracking);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,165 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "mock_lfs_vfs.h"
+#include "littlefs/littlefs.h"
+
+//# littlefs_readLines over lfs_emubd, see mock_lfs_vfs.h. Every slice the
+//# callback gets is checked against the lines the file was built from,
+//# including its NUL terminator in place.
+
+#define MAX_LINES 512
+
+static char *lines[MAX_LINES];
+static int line_count;
+static int unterminated;
+
+static void on_line(char *file_name, char *buff, size_t len) {
+    if (buff[len] != '\0') unterminated++;
+    if (line_count == MAX_LINES) return;
+    lines[line_count] = malloc(len + 1);
+    memcpy(lines[line_count], buff, len + 1);
+    line_count++;
+}
+
+static void reset(void) {
+    for (int i = 0; i < line_count; i++) free(lines[i]);
+    line_count = unterminated = 0;
+}
+
+static void read_file(const char *content, size_t len) {
+    reset();
+    TEST_ASSERT_EQUAL(0, mock_lfs_write("rules.text", content, len));
+    littlefs_readLines(MOCK_LFS_BASE "/rules.text", "rules.text", on_line);
+    TEST_ASSERT_EQUAL(0, unterminated);
+}
+
+//! a line of len bytes, the index in front so a shifted slice shows
+static size_t make_line(char *out, int index, size_t len) {
+    for (size_t i = 0; i < len; i++) out[i] = 'a' + (index + i) % 26;
+    if (len >= 4) snprintf(out, 5, "%04d", index % 10000), out[4] = 'a' + index % 26;
+    return len;
+}
+
+static void test_empty_file(void) {
+    read_file("", 0);
+    TEST_ASSERT_EQUAL(0, line_count);
+
+    read_file("\n\r\n\n", 4);
+    TEST_ASSERT_EQUAL(0, line_count);
+}
+
+//! line lengths 1..200 put every kind of split onto the 4096 boundaries
+static void test_chunk_boundaries(void) {
+    static char content[64 * 1024];
+    static char expected[MAX_LINES][256];
+    size_t len = 0;
+    int count = 0;
+
+    for (int i = 0; len < 3 * MOCK_LFS_BLOCK_SIZE + 500; i++, count++) {
+        size_t line_len = 1 + (i * 37) % 200;
+        make_line(expected[i], i, line_len);
+        expected[i][line_len] = '\0';
+        memcpy(content + len, expected[i], line_len);
+        len += line_len;
+        content[len++] = '\n';
+    }
+    read_file(content, len);
+
+    TEST_ASSERT_EQUAL(count, line_count);
+    int wrong = 0;
+    for (int i = 0; i < count && i < line_count; i++) wrong += strcmp(expected[i], lines[i]) != 0;
+    TEST_ASSERT_EQUAL(0, wrong);
+}
+
+//! the newline as the last byte of a chunk, and CR and LF on either side of one
+static void test_split_at_boundary(void) {
+    static char content[2 * MOCK_LFS_BLOCK_SIZE];
+    memset(content, 'x', sizeof(content));
+    content[MOCK_LFS_BLOCK_SIZE - 1] = '\n';
+    read_file(content, MOCK_LFS_BLOCK_SIZE);
+    TEST_ASSERT_EQUAL(1, line_count);
+    TEST_ASSERT_EQUAL(MOCK_LFS_BLOCK_SIZE - 1, strlen(lines[0]));
+
+    content[MOCK_LFS_BLOCK_SIZE - 1] = '\r';
+    content[MOCK_LFS_BLOCK_SIZE] = '\n';
+    content[MOCK_LFS_BLOCK_SIZE + 1] = 'y';
+    read_file(content, MOCK_LFS_BLOCK_SIZE + 2);
+    TEST_ASSERT_EQUAL(2, line_count);
+    TEST_ASSERT_EQUAL(MOCK_LFS_BLOCK_SIZE - 1, strlen(lines[0]));
+    TEST_ASSERT(strcmp(lines[1], "y") == 0);
+}
+
+//! one line over two and over four chunks, between short ones
+static void test_long_lines(void) {
+    const size_t long_lens[] = { MOCK_LFS_BLOCK_SIZE + 1, 5000, 3 * MOCK_LFS_BLOCK_SIZE + 123 };
+    static char content[32 * 1024], line[16 * 1024];
+
+    for (size_t l = 0; l < sizeof(long_lens) / sizeof(long_lens[0]); l++) {
+        size_t len = 0;
+        memcpy(content, "first\n", 6);
+        len += 6;
+        make_line(line, 7, long_lens[l]);
+        memcpy(content + len, line, long_lens[l]);
+        len += long_lens[l];
+        memcpy(content + len, "\nlast\n", 6);
+        len += 6;
+
+        read_file(content, len);
+        TEST_ASSERT_EQUAL(3, line_count);
+        if (line_count != 3) continue;
+        TEST_ASSERT(strcmp(lines[0], "first") == 0);
+        TEST_ASSERT_EQUAL(long_lens[l], strlen(lines[1]));
+        TEST_ASSERT(memcmp(lines[1], line, long_lens[l]) == 0);
+        TEST_ASSERT(strcmp(lines[2], "last") == 0);
+    }
+}
+
+static void test_last_line_and_crlf(void) {
+    const char content[] = "33,10,01\r\n\r\n33,20,02\r\nno newline";
+    read_file(content, sizeof(content) - 1);
+    TEST_ASSERT_EQUAL(3, line_count);
+    TEST_ASSERT(strcmp(lines[0], "33,10,01") == 0);
+    TEST_ASSERT(strcmp(lines[1], "33,20,02") == 0);
+    TEST_ASSERT(strcmp(lines[2], "no newline") == 0);
+
+    //! a trailing CR without its LF is still stripped
+    read_file("tail\r", 5);
+    TEST_ASSERT_EQUAL(1, line_count);
+    TEST_ASSERT(strcmp(lines[0], "tail") == 0);
+}
+
+//! one lfs_file_read per block plus the one that sees the end
+static void test_block_reads(void) {
+    static char content[10000];
+    memset(content, 'r', sizeof(content));
+    for (size_t i = 99; i < sizeof(content); i += 100) content[i] = '\n';
+
+    uint32_t before = mock_lfs_file_reads();
+    read_file(content, sizeof(content));
+    TEST_ASSERT_EQUAL(100, line_count);
+    TEST_ASSERT_EQUAL(3 + 1, mock_lfs_file_reads() - before);
+}
+
+static void test_missing_file(void) {
+    reset();
+    littlefs_readLines(MOCK_LFS_BASE "/missing.text", "missing.text", on_line);
+    TEST_ASSERT_EQUAL(0, line_count);
+}
+
+int main(void) {
+    mock_lfs_mount();
+
+    RUN_TEST(test_empty_file);
+    RUN_TEST(test_chunk_boundaries);
+    RUN_TEST(test_split_at_boundary);
+    RUN_TEST(test_long_lines);
+    RUN_TEST(test_last_line_and_crlf);
+    RUN_TEST(test_block_reads);
+    RUN_TEST(test_missing_file);
+
+    reset();
+    mock_lfs_unmount();
+    return TEST_RESULT();
+}
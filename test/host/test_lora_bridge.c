@@ -0,0 +1,182 @@
+#include <string.h>
+
+#include "test.h"
+#include "esp_timer.h"
+#include "mock_lora.h"
+
+//# Two bridges over the mocked radios, see mock_lora.h. Frames tapped on
+//# one side come out of the other side's mesh inject byte for byte.
+
+#define LOOP_US 10000
+#define MAX_INJECTED 16
+
+static const uint8_t near_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+static const uint8_t far_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+static const uint8_t origin_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x10 };
+
+static uint64_t now = 1000000;
+static espnow_message_t injected[MAX_INJECTED];
+static int injected_side[MAX_INJECTED];
+static int injected_count;
+
+static void on_inject(int side, const espnow_message_t *message, uint64_t current_time) {
+    if (injected_count == MAX_INJECTED) return;
+    injected_side[injected_count] = side;
+    injected[injected_count++] = *message;
+}
+
+static void run(uint64_t duration_us) {
+    for (uint64_t end = now + duration_us; now < end; now += LOOP_US) {
+        host_set_time(now);
+        lora_bridge_task(now);
+        far_bridge_task(now);
+    }
+}
+
+//! one pass far ahead refills the duty cycle budget of both sides
+static void idle(void) {
+    now += 1000000000ULL;
+    host_set_time(now);
+    lora_bridge_task(now);
+    far_bridge_task(now);
+}
+
+static void reset(void) {
+    idle();
+    mock_lora_reset(0);
+    injected_count = 0;
+}
+
+static espnow_message_t make_message(uint8_t group_id, uint8_t msg_id, uint8_t data_len) {
+    espnow_message_t message = { .group_id = group_id, .msg_id = msg_id, .time_to_live = 5, .data_len = data_len };
+    memset(message.target_addr, 0xFF, sizeof(message.target_addr));
+    memcpy(message.origin_addr, origin_mac, sizeof(message.origin_addr));
+    for (int i = 0; i < data_len; i++) message.data[i] = msg_id + i;
+    return message;
+}
+
+static void test_full_frame_round_trip(void) {
+    reset();
+    lora_bridge_stats_t before, after;
+    lora_bridge_get_stats(&before);
+
+    espnow_message_t message = make_message(1, 1, ESPNOW_MAX_DATA_LEN);
+    mock_lora_tap(MOCK_LORA_NEAR, &message);
+    run(3000000);
+
+    //! 250 bytes in fragments of LORA_BRIDGE_FRAGMENT_DATA
+    TEST_ASSERT_EQUAL(3, mock_lora_packets(MOCK_LORA_NEAR));
+    TEST_ASSERT_EQUAL(1, injected_count);
+    TEST_ASSERT_EQUAL(MOCK_LORA_FAR, injected_side[0]);
+    TEST_ASSERT(memcmp(&injected[0], &message, sizeof(message)) == 0);
+
+    lora_bridge_get_stats(&after);
+    TEST_ASSERT_EQUAL(1, after.sent - before.sent);
+    TEST_ASSERT_EQUAL(3, after.fragments_sent - before.fragments_sent);
+}
+
+//! the far mesh floods the frame back to its bridge, it must not cross again
+static void test_echo_is_not_bridged_back(void) {
+    reset();
+    lora_bridge_stats_t before, after;
+    far_bridge_get_stats(&before);
+
+    espnow_message_t message = make_message(1, 2, 40);
+    mock_lora_tap(MOCK_LORA_NEAR, &message);
+    run(1000000);
+    TEST_ASSERT_EQUAL(1, injected_count);
+
+    espnow_message_t echo = injected[0];
+    echo.time_to_live--;
+    mock_lora_tap(MOCK_LORA_FAR, &echo);
+    mock_lora_tap(MOCK_LORA_NEAR, &message);
+    run(1000000);
+
+    far_bridge_get_stats(&after);
+    TEST_ASSERT_EQUAL(0, mock_lora_packets(MOCK_LORA_FAR));
+    TEST_ASSERT_EQUAL(1, mock_lora_packets(MOCK_LORA_NEAR));
+    TEST_ASSERT_EQUAL(1, after.duplicates - before.duplicates);
+    TEST_ASSERT_EQUAL(1, injected_count);
+}
+
+static void test_lost_fragment_times_out(void) {
+    reset();
+    lora_bridge_stats_t before, after;
+    far_bridge_get_stats(&before);
+
+    espnow_message_t message = make_message(1, 3, 200);
+    mock_lora_drop_next(MOCK_LORA_NEAR);
+    mock_lora_tap(MOCK_LORA_NEAR, &message);
+    run(LORA_BRIDGE_REASSEMBLY_TIMEOUT_US + 1000000);
+
+    far_bridge_get_stats(&after);
+    TEST_ASSERT_EQUAL(0, injected_count);
+    TEST_ASSERT_EQUAL(1, after.fragments_received - before.fragments_received);
+    TEST_ASSERT_EQUAL(1, after.reassembly_timeouts - before.reassembly_timeouts);
+}
+
+//! a full queue of low priority frames makes room for a high one, which goes first
+static void test_priority(void) {
+    reset();
+    lora_bridge_stats_t before, after;
+    lora_bridge_get_stats(&before);
+
+    for (int i = 0; i < LORA_BRIDGE_QUEUE_SIZE; i++) {
+        espnow_message_t low = make_message(3, 10 + i, 60);
+        mock_lora_tap(MOCK_LORA_NEAR, &low);
+    }
+    espnow_message_t high = make_message(2, 30, 60);
+    mock_lora_tap(MOCK_LORA_NEAR, &high);
+    run(5000000);
+
+    lora_bridge_get_stats(&after);
+    TEST_ASSERT_EQUAL(1, after.queue_dropped - before.queue_dropped);
+    TEST_ASSERT(injected_count > 1);
+    TEST_ASSERT_EQUAL(30, injected[0].msg_id);
+    TEST_ASSERT_EQUAL(11, injected[1].msg_id);                  // 10 was the oldest low one, evicted
+}
+
+//! unbridged groups, unicasts and spent frames stay on their side
+static void test_filters(void) {
+    reset();
+    lora_bridge_stats_t before, after;
+    lora_bridge_get_stats(&before);
+
+    espnow_message_t other_group = make_message(9, 40, 10);
+    espnow_message_t unicast = make_message(1, 41, 10);
+    memcpy(unicast.target_addr, far_mac, sizeof(far_mac));
+    espnow_message_t spent = make_message(1, 42, 10);
+    spent.time_to_live = 1;
+
+    mock_lora_tap(MOCK_LORA_NEAR, &other_group);
+    mock_lora_tap(MOCK_LORA_NEAR, &unicast);
+    mock_lora_tap(MOCK_LORA_NEAR, &spent);
+    run(1000000);
+
+    lora_bridge_get_stats(&after);
+    TEST_ASSERT_EQUAL(0, after.to_lora - before.to_lora);
+    TEST_ASSERT_EQUAL(0, mock_lora_packets(MOCK_LORA_NEAR));
+}
+
+int main(void) {
+    srand(1);
+    host_set_time(now);
+    mock_lora_set_inject_cb(on_inject);
+    lora_bridge_setup(NULL, near_mac);
+    far_bridge_setup(NULL, far_mac);
+
+    lora_bridge_add_group(1, LORA_BRIDGE_PRIO_NORMAL);
+    lora_bridge_add_group(2, LORA_BRIDGE_PRIO_HIGH);
+    lora_bridge_add_group(3, LORA_BRIDGE_PRIO_LOW);
+    far_bridge_add_group(1, LORA_BRIDGE_PRIO_NORMAL);
+    far_bridge_add_group(2, LORA_BRIDGE_PRIO_HIGH);
+    far_bridge_add_group(3, LORA_BRIDGE_PRIO_LOW);
+
+    RUN_TEST(test_full_frame_round_trip);
+    RUN_TEST(test_echo_is_not_bridged_back);
+    RUN_TEST(test_lost_fragment_times_out);
+    RUN_TEST(test_priority);
+    RUN_TEST(test_filters);
+
+    return TEST_RESULT();
+}
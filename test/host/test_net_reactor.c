@@ -0,0 +1,251 @@
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "test.h"
+#include "mock_socket.h"
+#include "net_reactor.h"
+#include "esp_timer.h"
+
+//# The reactor task over two sources whose sockets are mock_socket pairs.
+//# Built with NET_REACTOR_TICK_MS=200 so a turn started by a wakeup or an
+//# event is told apart from the idle tick. Source state is only touched
+//# under net_reactor_lock, like app_network does with the real servers.
+
+#define SOURCE_FDS      4
+#define WAKE_LIMIT_US   50000               // well under the 200 ms tick
+
+typedef struct {
+    int server[SOURCE_FDS];                 // the reactor's ends
+    int client[SOURCE_FDS];
+    int count;
+
+    uint32_t dispatches;
+    uint32_t events;
+    uint64_t event_us;                      // last dispatch that read data
+    const struct pollfd *slice;             // what the last dispatch was handed
+    int slice_count;
+    int slice_fds[NET_REACTOR_MAX_POLLFDS];
+    short slice_revents[NET_REACTOR_MAX_POLLFDS];
+    uint32_t spin_us;                       // next dispatch keeps the reactor busy this long
+} test_source_t;
+
+static test_source_t source_a, source_b;
+
+static int source_fill(void *ctx, struct pollfd *fds, int max) {
+    test_source_t *source = ctx;
+    int count = source->count < max ? source->count : max;
+    for (int i = 0; i < count; i++) fds[i] = (struct pollfd){ .fd = source->server[i], .events = POLLIN };
+    return count;
+}
+
+static void source_dispatch(void *ctx, const struct pollfd *fds, int count, uint64_t current_time) {
+    test_source_t *source = ctx;
+    source->dispatches++;
+    source->slice = fds;
+    source->slice_count = count;
+
+    for (int i = 0; i < count; i++) {
+        source->slice_fds[i] = fds[i].fd;
+        source->slice_revents[i] = fds[i].revents;
+        if (!(fds[i].revents & POLLIN)) continue;
+
+        uint8_t buff[64];
+        while (recv(fds[i].fd, buff, sizeof(buff), MSG_DONTWAIT) > 0) {}
+        source->events++;
+        source->event_us = esp_timer_get_time();
+    }
+
+    if (source->spin_us) {
+        uint64_t until = esp_timer_get_time() + source->spin_us;
+        while (esp_timer_get_time() < until) {}
+        source->spin_us = 0;
+    }
+}
+
+//! a client connects through mock_socket, the source keeps the accepted end
+static void source_connect(test_source_t *source) {
+    int client = mock_socket_connect();
+    int server = accept(-1, NULL, NULL);
+    fcntl(server, F_SETFL, fcntl(server, F_GETFL, 0) | O_NONBLOCK);
+    source->client[source->count] = client;
+    source->server[source->count] = server;
+    source->count++;
+}
+
+static uint32_t source_events(test_source_t *source) {
+    net_reactor_lock();
+    uint32_t events = source->events;
+    net_reactor_unlock();
+    return events;
+}
+
+static bool wait_events(test_source_t *source, uint32_t events, uint32_t timeout_ms) {
+    uint64_t deadline = esp_timer_get_time() + timeout_ms * 1000ull;
+    while (source_events(source) < events) {
+        if (esp_timer_get_time() > deadline) return false;
+        usleep(200);
+    }
+    return true;
+}
+
+static void client_send(int client) {
+    uint8_t byte = 1;
+    TEST_ASSERT_EQUAL(1, send(client, &byte, 1, 0));
+}
+
+//! SECTION pollfd set
+
+//! each source gets its own slice, in registration order after the wakeup slot
+static void test_pollfd_slices(void) {
+    uint32_t events = source_events(&source_b);
+    client_send(source_b.client[2]);
+    TEST_ASSERT(wait_events(&source_b, events + 1, 1000));
+
+    net_reactor_lock();
+    TEST_ASSERT_EQUAL(2, source_a.slice_count);
+    TEST_ASSERT_EQUAL(3, source_b.slice_count);
+    TEST_ASSERT(source_b.slice == source_a.slice + 2);
+    for (int i = 0; i < 2; i++) {
+        TEST_ASSERT_EQUAL(source_a.server[i], source_a.slice_fds[i]);
+        TEST_ASSERT_EQUAL(0, source_a.slice_revents[i]);
+    }
+    for (int i = 0; i < 3; i++) TEST_ASSERT_EQUAL(source_b.server[i], source_b.slice_fds[i]);
+    TEST_ASSERT_EQUAL(0, source_b.slice_revents[0] | source_b.slice_revents[1]);
+    TEST_ASSERT(source_b.slice_revents[2] & POLLIN);
+    net_reactor_unlock();
+}
+
+//! sources without events are dispatched too, their idle timeouts run off the tick
+static void test_idle_dispatch(void) {
+    net_reactor_stats_t before, after;
+    net_reactor_get_stats(&before);
+    net_reactor_lock();
+    uint32_t dispatches = source_a.dispatches;
+    net_reactor_unlock();
+
+    usleep(3 * NET_REACTOR_TICK_MS * 1000 + NET_REACTOR_TICK_MS * 500);
+
+    net_reactor_get_stats(&after);
+    net_reactor_lock();
+    TEST_ASSERT(source_a.dispatches - dispatches >= 3);
+    net_reactor_unlock();
+    TEST_ASSERT(after.timeouts - before.timeouts >= 3);
+    TEST_ASSERT(after.timeouts - before.timeouts <= 4);
+}
+
+//! SECTION wakeup
+
+//! a socket added from another task is polled right after the wakeup, not on the next tick
+static void test_wakeup_picks_up_new_fd(void) {
+    net_reactor_stats_t before, after;
+    usleep(20000);                                      // the reactor is back in poll()
+    net_reactor_get_stats(&before);
+
+    net_reactor_lock();
+    source_connect(&source_a);
+    uint32_t events = source_a.events;
+    net_reactor_unlock();
+    net_reactor_wakeup();
+
+    uint64_t start = esp_timer_get_time();
+    client_send(source_a.client[2]);
+    TEST_ASSERT(wait_events(&source_a, events + 1, 1000));
+
+    net_reactor_lock();
+    TEST_ASSERT(source_a.event_us - start < WAKE_LIMIT_US);
+    TEST_ASSERT_EQUAL(3, source_a.slice_count);
+    net_reactor_unlock();
+    net_reactor_get_stats(&after);
+    TEST_ASSERT(after.wakeups - before.wakeups >= 1);
+}
+
+//! while one wakeup byte is in flight the rest are collapsed
+static void test_wakeups_collapse(void) {
+    net_reactor_stats_t before, after;
+    usleep(20000);
+    net_reactor_get_stats(&before);
+
+    net_reactor_lock();                                 // the reactor cannot drain a second byte
+    for (int i = 0; i < 20; i++) net_reactor_wakeup();
+    net_reactor_unlock();
+    usleep(50000);
+
+    net_reactor_get_stats(&after);
+    TEST_ASSERT(after.wakeups - before.wakeups >= 1);
+    TEST_ASSERT(after.wakeups - before.wakeups <= 2);
+}
+
+//! SECTION lock
+
+//! poll() runs unlocked: an idle reactor never makes another task wait for the lock
+static void test_poll_runs_unlocked(void) {
+    usleep(20000);
+    uint64_t worst = 0;
+    for (int i = 0; i < 20; i++) {
+        uint64_t start = esp_timer_get_time();
+        net_reactor_lock();
+        uint64_t waited = esp_timer_get_time() - start;
+        net_reactor_unlock();
+        if (waited > worst) worst = waited;
+        usleep(5000);
+    }
+    TEST_ASSERT(worst < 5000);
+}
+
+//! dispatch holds the lock: events that arrive while another task has it wait for unlock
+static void test_dispatch_waits_for_lock(void) {
+    net_reactor_lock();
+    uint32_t events = source_b.events;
+    client_send(source_b.client[0]);
+    usleep(50000);
+    TEST_ASSERT_EQUAL(events, source_b.events);
+    uint64_t unlocked = esp_timer_get_time();
+    net_reactor_unlock();
+
+    TEST_ASSERT(wait_events(&source_b, events + 1, 1000));
+    net_reactor_lock();
+    TEST_ASSERT(source_b.event_us >= unlocked);
+    TEST_ASSERT(source_b.event_us - unlocked < WAKE_LIMIT_US);
+    net_reactor_unlock();
+}
+
+//! SECTION stats
+
+//! time in dispatch counts as busy, time in poll() does not
+static void test_busy_time(void) {
+    net_reactor_stats_t before, after;
+    net_reactor_lock();
+    source_b.spin_us = 20000;
+    uint32_t events = source_b.events;
+    net_reactor_unlock();
+    net_reactor_get_stats(&before);
+
+    client_send(source_b.client[1]);
+    TEST_ASSERT(wait_events(&source_b, events + 1, 1000));
+    usleep(2 * NET_REACTOR_TICK_MS * 1000);            // idle ticks add next to nothing
+
+    net_reactor_get_stats(&after);
+    uint64_t busy = after.busy_us - before.busy_us;
+    TEST_ASSERT(busy >= 20000);
+    TEST_ASSERT(busy < 30000);
+    TEST_ASSERT(after.max_dispatch_us >= 20000);
+    TEST_ASSERT(after.loops - before.loops >= 2);
+}
+
+int main(void) {
+    for (int i = 0; i < 2; i++) source_connect(&source_a);
+    for (int i = 0; i < 3; i++) source_connect(&source_b);
+    TEST_ASSERT_EQUAL(0, net_reactor_add(source_fill, source_dispatch, &source_a));
+    TEST_ASSERT_EQUAL(0, net_reactor_add(source_fill, source_dispatch, &source_b));
+    TEST_ASSERT_EQUAL(0, net_reactor_start());
+
+    RUN_TEST(test_pollfd_slices);
+    RUN_TEST(test_idle_dispatch);
+    RUN_TEST(test_wakeup_picks_up_new_fd);
+    RUN_TEST(test_wakeups_collapse);
+    RUN_TEST(test_poll_runs_unlocked);
+    RUN_TEST(test_dispatch_waits_for_lock);
+    RUN_TEST(test_busy_time);
+    return TEST_RESULT();
+}
@@ -0,0 +1,214 @@
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <sys/param.h>
+
+#include "test.h"
+#include "mock_socket.h"
+#include "net_server/net_server.h"
+
+//# net_server on socketpairs. A unix socket reports POLLHUP as soon as the
+//# peer is gone, whatever the events mask, which is the case that used to
+//# spin: rx ring full, handler consuming nothing, peer hung up.
+
+#define MAX_PUMPS   200
+#define STREAM_LEN  (64 * 1024)
+
+static net_server_t server;
+static uint64_t now_us = 1000000;
+static int closes;
+static bool stall;                          // handler leaves everything in the rx ring
+
+//! the tcp_socket echo, whatever fits in the tx ring
+static void on_data(net_server_t *srv, net_conn_t *conn) {
+    if (stall) return;
+
+    uint8_t buffer[256];
+    while (net_conn_rx_available(conn) > 0 && net_conn_tx_free(conn) > 0) {
+        size_t len = net_conn_peek(conn, buffer, MIN(sizeof(buffer), net_conn_tx_free(conn)));
+        net_conn_consume(conn, net_conn_send(conn, buffer, len));
+    }
+}
+
+static void on_close(net_server_t *srv, net_conn_t *conn) {
+    closes++;
+}
+
+static const net_server_handlers_t handlers = {
+    .on_data = on_data,
+    .on_close = on_close,
+};
+
+//! one reactor tick, returns the poll() result
+static int pump(int timeout_ms) {
+    struct pollfd fds[NET_SERVER_MAX_POLLFDS];
+    int count = net_server_fill_pollfds(&server, fds, NET_SERVER_MAX_POLLFDS);
+    int activity = poll(fds, count, timeout_ms);
+    if (mock_socket_pending()) {
+        fds[0].revents |= POLLIN;           // the listener comes first
+        activity++;
+    }
+    net_server_dispatch(&server, fds, count, now_us);
+    return activity;
+}
+
+//! ticks until every connection is closed, returns how many woke up with something to do
+static int pump_until_idle(void) {
+    int busy = 0;
+    for (int i = 0; i < MAX_PUMPS && server.stats.active > 0; i++) {
+        if (pump(5) > 0) busy++;
+    }
+    return busy;
+}
+
+static void write_pattern(int fd, size_t start, size_t len) {
+    uint8_t buff[4096];
+    for (size_t i = 0; i < len; i++) buff[i] = (uint8_t)((start + i) * 31);
+    write(fd, buff, len);
+}
+
+static void test_hangup_with_full_rx_closes(void) {
+    stall = true;
+    closes = 0;
+
+    int fd = mock_socket_connect();
+    pump(0);
+    TEST_ASSERT_EQUAL(1, server.stats.active);
+
+    // more than the rx ring, the handler takes nothing
+    write_pattern(fd, 0, 4096);
+    for (int i = 0; i < 4; i++) pump(0);
+    TEST_ASSERT_EQUAL(NET_CONN_RX_SIZE, net_conn_rx_available(&server.conns[0]));
+
+    close(fd);
+    int busy = pump_until_idle();
+    TEST_ASSERT_EQUAL(0, server.stats.active);
+    TEST_ASSERT_EQUAL(1, closes);
+    TEST_ASSERT(busy <= 2);
+    stall = false;
+}
+
+//! both rings full and the peer done writing, tx progress alone has to keep the echo going
+static void test_backpressure_resumes_after_flush(void) {
+    int fd = mock_socket_connect();
+    pump(0);
+
+    // small socket buffers so the rings fill up instead of the kernel
+    int size = 4096;
+    setsockopt(server.conns[0].fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    //! write until everything backs up, without reading
+    uint8_t buff[1024];
+    size_t sent = 0;
+    for (int idle = 0; idle < 3 && sent < STREAM_LEN;) {
+        for (size_t i = 0; i < sizeof(buff); i++) buff[i] = (uint8_t)((sent + i) * 31);
+        ssize_t n = write(fd, buff, MIN(sizeof(buff), STREAM_LEN - sent));
+        if (n > 0) sent += n;
+        idle = n > 0 ? 0 : idle + 1;
+        pump(0);
+    }
+    TEST_ASSERT_EQUAL(0, net_conn_tx_free(&server.conns[0]));
+    TEST_ASSERT_EQUAL(NET_CONN_RX_SIZE, net_conn_rx_available(&server.conns[0]));
+
+    //! now only read, every byte written has to come back
+    static uint8_t received[STREAM_LEN];
+    size_t got = 0;
+    for (int i = 0; i < 10000 && got < sent; i++) {
+        pump(1);
+        ssize_t n = recv(fd, received + got, sent - got, MSG_DONTWAIT);
+        if (n > 0) got += n;
+    }
+    TEST_ASSERT_EQUAL(sent, got);
+
+    size_t bad = 0;
+    for (size_t i = 0; i < got; i++) bad += received[i] != (uint8_t)(i * 31);
+    TEST_ASSERT_EQUAL(0, bad);
+
+    close(fd);
+    pump_until_idle();
+    TEST_ASSERT_EQUAL(0, server.stats.active);
+}
+
+//! full pool of echo clients, some stalled, all hanging up at random points
+static void test_hangup_stress(void) {
+    srand(7);
+    uint32_t rejected = server.stats.rejected;
+    int total_busy = 0;
+
+    for (int round = 0; round < 200; round++) {
+        int fds[NET_SERVER_MAX_CONNS + 1];
+        for (int i = 0; i <= NET_SERVER_MAX_CONNS; i++) fds[i] = mock_socket_connect();
+        stall = round % 3 == 0;
+        pump(0);
+        TEST_ASSERT_EQUAL(NET_SERVER_MAX_CONNS, server.stats.active);
+
+        //! clients write without reading, echoes back up until both rings are full
+        for (int step = 0; step < 8; step++) {
+            for (int i = 0; i < NET_SERVER_MAX_CONNS; i++) {
+                if (fds[i] >= 0) write_pattern(fds[i], 0, rand() % 4096);
+            }
+            pump(0);
+
+            int victim = rand() % NET_SERVER_MAX_CONNS;
+            if (fds[victim] >= 0 && rand() % 2) {
+                close(fds[victim]);
+                fds[victim] = -1;
+            }
+        }
+
+        for (int i = 0; i <= NET_SERVER_MAX_CONNS; i++) {
+            if (fds[i] >= 0) close(fds[i]);
+        }
+        total_busy += pump_until_idle();
+        TEST_ASSERT_EQUAL(0, server.stats.active);
+        if (server.stats.active) break;
+    }
+
+    TEST_ASSERT_EQUAL(200, server.stats.rejected - rejected);
+    printf("  200 rounds, %d busy ticks to close %d connections\n", total_busy, 200 * NET_SERVER_MAX_CONNS);
+    TEST_ASSERT(total_busy <= 200 * NET_SERVER_MAX_CONNS);
+    stall = false;
+}
+
+//! an echo stream larger than both rings goes through intact
+static void test_echo_stream(void) {
+    int fd = mock_socket_connect();
+    pump(0);
+
+    static uint8_t received[STREAM_LEN];
+    size_t sent = 0, got = 0;
+    for (int i = 0; i < 100000 && got < STREAM_LEN; i++) {
+        if (sent < STREAM_LEN) {
+            size_t n = MIN(1500, STREAM_LEN - sent);
+            write_pattern(fd, sent, n);
+            sent += n;
+        }
+        pump(0);
+        ssize_t n = recv(fd, received + got, STREAM_LEN - got, MSG_DONTWAIT);
+        if (n > 0) got += n;
+    }
+
+    TEST_ASSERT_EQUAL(STREAM_LEN, got);
+    size_t bad = 0;
+    for (size_t i = 0; i < got; i++) bad += received[i] != (uint8_t)(i * 31);
+    TEST_ASSERT_EQUAL(0, bad);
+
+    close(fd);
+    pump_until_idle();
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);               // lwip has no SIGPIPE, sends to a closed peer just fail
+    net_server_init(&server, 3333, &handlers, NULL);
+    if (net_server_start(&server) < 0) return 1;
+
+    RUN_TEST(test_hangup_with_full_rx_closes);
+    RUN_TEST(test_backpressure_resumes_after_flush);
+    RUN_TEST(test_echo_stream);
+    RUN_TEST(test_hangup_stress);
+
+    net_server_stop(&server);
+    return TEST_RESULT();
+}
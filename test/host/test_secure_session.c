@@ -0,0 +1,200 @@
+#include <string.h>
+
+#include "test.h"
+#include "mock_nvs.h"
+#include "secure_session.h"
+
+//# AES-GCM sessions on the software mbedTLS the host links. Frames are
+//# sealed as this node and opened again as if this node were the sender,
+//# so one process covers both ends. Built with a counter reserve of 16.
+
+//! the all-zero MAC with counter 0 and key_id 0 gives the all-zero nonce of GCM test case 2
+static const uint8_t self_mac[6] = { 0 };
+static const uint8_t peer_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+static const uint8_t group_mac[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+static const uint8_t zero_key[SECURE_SESSION_KEY_LEN] = { 0 };
+static const uint8_t aad[] = "header";
+
+typedef struct {
+    uint8_t buff[64];
+    size_t len;
+} frame_t;
+
+static frame_t seal(const uint8_t *key_mac, const char *text) {
+    frame_t frame = { .len = strlen(text) };
+    memcpy(frame.buff, text, frame.len);
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_seal(key_mac, aad, sizeof(aad), frame.buff, frame.len,
+                                                  sizeof(frame.buff), &frame.len));
+    return frame;
+}
+
+//! opens a copy, the frame can be opened again
+static esp_err_t open_copy(const uint8_t *key_mac, const frame_t *frame, char *text) {
+    frame_t copy = *frame;
+    size_t len = 0;
+    esp_err_t err = secure_session_open(key_mac, self_mac, aad, sizeof(aad), copy.buff, copy.len, &len);
+    if (err == ESP_OK && text) {
+        memcpy(text, copy.buff, len);
+        text[len] = 0;
+    }
+    return err;
+}
+
+static void test_known_answer(void) {
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_set_key(group_mac, 0, zero_key));
+
+    uint8_t buff[16 + SECURE_SESSION_OVERHEAD] = { 0 };
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_seal(group_mac, NULL, 0, buff, 16, sizeof(buff), &len));
+    TEST_ASSERT_EQUAL(16 + SECURE_SESSION_OVERHEAD, len);
+
+    static const uint8_t ciphertext[16] = {
+        0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78 };
+    static const uint8_t trailer[SECURE_SESSION_OVERHEAD] = {
+        0x00, 0x00, 0x00, 0x00, 0x00,                           // key_id, counter 0
+        0xab, 0x6e, 0x47, 0xd4, 0x2c, 0xec, 0x13, 0xbd };       // tag cut to 8 bytes
+    TEST_ASSERT(memcmp(buff, ciphertext, 16) == 0);
+    TEST_ASSERT(memcmp(buff + 16, trailer, sizeof(trailer)) == 0);
+}
+
+static void test_round_trip_and_tamper(void) {
+    uint8_t key[SECURE_SESSION_KEY_LEN] = "0123456789abcde";
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_set_key(peer_mac, 3, key));
+
+    frame_t frame = seal(peer_mac, "hello");
+    TEST_ASSERT_EQUAL(5 + SECURE_SESSION_OVERHEAD, frame.len);
+    TEST_ASSERT(memcmp(frame.buff, "hello", 5) != 0);
+    TEST_ASSERT_EQUAL(3, frame.buff[5]);
+
+    //! a flipped bit anywhere fails without moving the window
+    secure_session_stats_t before, after;
+    secure_session_get_stats(&before);
+    for (size_t i = 0; i < frame.len; i++) {
+        if (i == 5) continue;                                   // key_id, that's a missing key
+        frame_t bad = frame;
+        bad.buff[i] ^= 0x10;
+        TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, open_copy(peer_mac, &bad, NULL));
+    }
+    secure_session_get_stats(&after);
+    TEST_ASSERT_EQUAL(frame.len - 1, after.auth_failed - before.auth_failed);
+
+    //! the header is authenticated too
+    frame_t copy = frame;
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, secure_session_open(peer_mac, self_mac, (const uint8_t *)"Header",
+                                                               sizeof(aad), copy.buff, copy.len, &len));
+
+    char text[64];
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &frame, text));
+    TEST_ASSERT(strcmp(text, "hello") == 0);
+
+    frame.buff[5] = 4;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, open_copy(peer_mac, &frame, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, open_copy(peer_mac, &(frame_t){ .len = SECURE_SESSION_OVERHEAD - 1 }, NULL));
+}
+
+static void test_replay_window(void) {
+    frame_t frames[40];
+    for (int i = 0; i < 40; i++) frames[i] = seal(peer_mac, "tick");
+
+    //! out of order within the window is fine, each counter once
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &frames[10], NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &frames[8], NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &frames[9], NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, open_copy(peer_mac, &frames[9], NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, open_copy(peer_mac, &frames[10], NULL));
+
+    //! a forged frame under a fresh counter doesn't burn it
+    frame_t forged = frames[39];
+    forged.buff[0] ^= 1;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, open_copy(peer_mac, &forged, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &frames[39], NULL));
+
+    //! 32 counters back is out of the window
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, open_copy(peer_mac, &frames[7], NULL));
+
+    secure_session_stats_t stats;
+    secure_session_get_stats(&stats);
+    TEST_ASSERT(stats.replayed >= 3);
+}
+
+static void test_rotation(void) {
+    frame_t old_key = seal(peer_mac, "before");
+
+    uint8_t next[SECURE_SESSION_KEY_LEN] = "fedcba987654321";
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_rotate_key(peer_mac, next));
+    frame_t new_key = seal(peer_mac, "after");
+    TEST_ASSERT_EQUAL(4, new_key.buff[5]);
+
+    //! peers that haven't switched yet still open
+    char text[64];
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &new_key, text));
+    TEST_ASSERT(strcmp(text, "after") == 0);
+    TEST_ASSERT_EQUAL(ESP_OK, open_copy(peer_mac, &old_key, text));
+    TEST_ASSERT(strcmp(text, "before") == 0);
+
+    //! a second rotation drops the first key
+    frame_t stale = seal(peer_mac, "stale");
+    stale.buff[5] = 3;
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_rotate_key(peer_mac, zero_key));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, open_copy(peer_mac, &stale, NULL));
+
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_erase_key(peer_mac));
+    uint8_t buff[32];
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, secure_session_seal(peer_mac, aad, sizeof(aad), buff, 4, sizeof(buff), &len));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, secure_session_seal(group_mac, aad, sizeof(aad), buff, 20, sizeof(buff), &len));
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_FOUND, secure_session_rotate_key(peer_mac, next));
+}
+
+//! the counter in NVS always stays above every counter used, one commit per reserve
+static void test_counter_reserve(void) {
+    uint32_t commits = mock_nvs_commits();
+    uint32_t stored_before;
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_get_u32(0, "tx_ctr", &stored_before));
+
+    uint32_t highest = 0;
+    for (int i = 0; i < 3 * SECURE_SESSION_COUNTER_RESERVE; i++) {
+        frame_t frame = seal(group_mac, "x");
+        memcpy(&highest, frame.buff + frame.len - SECURE_SESSION_OVERHEAD + 1, 4);
+
+        uint32_t stored;
+        nvs_get_u32(0, "tx_ctr", &stored);
+        TEST_ASSERT(highest < stored);
+    }
+
+    uint32_t stored_after;
+    nvs_get_u32(0, "tx_ctr", &stored_after);
+    TEST_ASSERT_EQUAL(stored_before + 3 * SECURE_SESSION_COUNTER_RESERVE, stored_after);
+    TEST_ASSERT_EQUAL(commits + 3, mock_nvs_commits());
+}
+
+//! seal_cycles count the cipher, not the NVS commit a reserve blocks on
+static void test_cycles_exclude_reserve(void) {
+    mock_nvs_set_commit_delay(20000);
+
+    secure_session_stats_t before, after;
+    secure_session_get_stats(&before);
+    for (int i = 0; i < 2 * SECURE_SESSION_COUNTER_RESERVE; i++) seal(group_mac, "x");
+    secure_session_get_stats(&after);
+    mock_nvs_set_commit_delay(0);
+
+    uint64_t ns = after.seal_cycles - before.seal_cycles;      // the host cycle counter runs in ns
+    TEST_ASSERT_EQUAL(2 * SECURE_SESSION_COUNTER_RESERVE, after.sealed - before.sealed);
+    TEST_ASSERT(ns < 20000 * 1000);
+}
+
+int main(void) {
+    mock_nvs_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, secure_session_setup(self_mac));
+    TEST_ASSERT_EQUAL(1, mock_nvs_commits());
+
+    RUN_TEST(test_known_answer);
+    RUN_TEST(test_round_trip_and_tamper);
+    RUN_TEST(test_replay_window);
+    RUN_TEST(test_rotation);
+    RUN_TEST(test_counter_reserve);
+    RUN_TEST(test_cycles_exclude_reserve);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,163 @@
+#include <string.h>
+#include <limits.h>
+
+#include "test.h"
+#include "telemetry.h"
+
+//# Encoder round trips through the reference decoder below. Clients reading
+//# the WebSocket stream should follow it: little endian header, then per
+//# channel a varint count and zigzag varint deltas summed with wrap around.
+
+#define MAX_SAMPLES 64
+
+typedef struct {
+    uint8_t version;
+    uint16_t seq;
+    uint32_t timestamp_ms;
+    uint8_t channel_count;
+} telemetry_header_t;
+
+typedef struct {
+    uint8_t ids[8];
+    int32_t values[8][MAX_SAMPLES];
+    uint16_t counts[8];
+    int channels;
+} decoded_t;
+
+static int get_varint(const uint8_t *data, size_t len, size_t *pos, uint32_t *value) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*pos >= len) return -1;
+        uint8_t byte = data[(*pos)++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int32_t zigzag_decode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+//! returns 0 on success, -1 on a malformed frame
+static int telemetry_frame_decode(const uint8_t *data, size_t len, telemetry_header_t *header, decoded_t *out) {
+    if (len < TELEMETRY_HEADER_LEN || data[0] != TELEMETRY_VERSION) return -1;
+
+    header->version = data[0];
+    header->seq = data[1] | (data[2] << 8);
+    header->timestamp_ms = data[3] | (data[4] << 8) | (data[5] << 16) | ((uint32_t)data[6] << 24);
+    header->channel_count = data[7];
+    out->channels = 0;
+
+    size_t pos = TELEMETRY_HEADER_LEN;
+    for (uint8_t ch = 0; ch < header->channel_count; ch++) {
+        if (pos >= len || ch >= 8) return -1;
+        out->ids[ch] = data[pos++];
+
+        uint32_t count;
+        if (get_varint(data, len, &pos, &count) < 0 || count > MAX_SAMPLES) return -1;
+        out->counts[ch] = count;
+
+        int32_t value = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t raw;
+            if (get_varint(data, len, &pos, &raw) < 0) return -1;
+            value = (int32_t)((uint32_t)value + (uint32_t)zigzag_decode(raw));
+            out->values[ch][i] = value;
+        }
+        out->channels++;
+    }
+
+    return pos == len ? 0 : -1;
+}
+
+static void test_round_trip(void) {
+    const int32_t lux[] = { 12345, 12350, 12348, 12348, 12400 };
+    const int32_t accel[] = { -16384, -16380, -16390, 0, 16383 };
+    const int32_t extremes[] = { INT32_MAX, INT32_MIN, 0, INT32_MIN, INT32_MAX, -1 };
+
+    uint8_t buff[256];
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 0xBEEF, 0xDEADBEEF);
+    telemetry_add_channel(&frame, 1, lux, 5);
+    telemetry_add_channel(&frame, 9, accel, 5);
+    telemetry_add_channel(&frame, 17, extremes, 6);
+    telemetry_add_channel(&frame, 2, NULL, 0);
+    size_t len = telemetry_frame_end(&frame);
+    TEST_ASSERT(len > TELEMETRY_HEADER_LEN);
+
+    telemetry_header_t header;
+    static decoded_t decoded;
+    TEST_ASSERT_EQUAL(0, telemetry_frame_decode(buff, len, &header, &decoded));
+    TEST_ASSERT_EQUAL(TELEMETRY_VERSION, header.version);
+    TEST_ASSERT_EQUAL(0xBEEF, header.seq);
+    TEST_ASSERT_EQUAL(0xDEADBEEF, header.timestamp_ms);
+    TEST_ASSERT_EQUAL(4, header.channel_count);
+
+    TEST_ASSERT_EQUAL(1, decoded.ids[0]);
+    TEST_ASSERT(memcmp(decoded.values[0], lux, sizeof(lux)) == 0);
+    TEST_ASSERT_EQUAL(9, decoded.ids[1]);
+    TEST_ASSERT(memcmp(decoded.values[1], accel, sizeof(accel)) == 0);
+    TEST_ASSERT_EQUAL(17, decoded.ids[2]);
+    TEST_ASSERT(memcmp(decoded.values[2], extremes, sizeof(extremes)) == 0);
+    TEST_ASSERT_EQUAL(0, decoded.counts[3]);
+}
+
+//! small steps between readings take one byte each
+static void test_deltas_are_compact(void) {
+    int32_t series[32];
+    for (int i = 0; i < 32; i++) series[i] = 2500 + (i % 5) * 10 - 20;     // +-63 steps
+
+    uint8_t buff[128];
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 0, 0);
+    telemetry_add_channel(&frame, 1, series, 32);
+
+    // header, id, count, 2 byte first sample, one byte per delta
+    TEST_ASSERT_EQUAL(TELEMETRY_HEADER_LEN + 1 + 1 + 2 + 31, telemetry_frame_end(&frame));
+}
+
+static void test_truncated_frames_rejected(void) {
+    const int32_t values[] = { 100000, -5, 300, 70000 };
+    uint8_t buff[64];
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 1, 2);
+    telemetry_add_channel(&frame, 3, values, 4);
+    telemetry_add_channel(&frame, 4, values, 2);
+    size_t len = telemetry_frame_end(&frame);
+
+    telemetry_header_t header;
+    static decoded_t decoded;
+    for (size_t n = 0; n < len; n++) TEST_ASSERT_EQUAL(-1, telemetry_frame_decode(buff, n, &header, &decoded));
+    TEST_ASSERT_EQUAL(0, telemetry_frame_decode(buff, len, &header, &decoded));
+
+    // trailing garbage and a wrong version
+    buff[len] = 0;
+    TEST_ASSERT_EQUAL(-1, telemetry_frame_decode(buff, len + 1, &header, &decoded));
+    buff[0] = TELEMETRY_VERSION + 1;
+    TEST_ASSERT_EQUAL(-1, telemetry_frame_decode(buff, len, &header, &decoded));
+}
+
+static void test_overflow_reports_zero(void) {
+    const int32_t values[8] = { INT32_MIN, INT32_MAX, INT32_MIN, INT32_MAX };
+    uint8_t buff[TELEMETRY_HEADER_LEN + 10];
+
+    telemetry_frame_t frame;
+    telemetry_frame_begin(&frame, buff, sizeof(buff), 0, 0);
+    telemetry_add_channel(&frame, 1, values, 8);
+    TEST_ASSERT_EQUAL(0, telemetry_frame_end(&frame));
+
+    telemetry_frame_begin(&frame, buff, TELEMETRY_HEADER_LEN - 1, 0, 0);
+    TEST_ASSERT_EQUAL(0, telemetry_frame_end(&frame));
+}
+
+int main(void) {
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_deltas_are_compact);
+    RUN_TEST(test_truncated_frames_rejected);
+    RUN_TEST(test_overflow_reports_zero);
+    return TEST_RESULT();
+}
@@ -0,0 +1,128 @@
+#include <string.h>
+
+#include "test.h"
+#include "udp_socket/udp_socket.h"
+
+//# The batching UDP client against a receiver on the loopback interface.
+
+#define BATCH_MAX_LEN   1400                // UDP_BATCH_MAX_LEN
+#define RECORD_LEN      20
+
+static int receiver = -1;
+static uint16_t receiver_port;
+
+static void open_receiver(void) {
+    receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    bind(receiver, (struct sockaddr *)&addr, sizeof(addr));
+
+    socklen_t len = sizeof(addr);
+    getsockname(receiver, (struct sockaddr *)&addr, &len);
+    receiver_port = ntohs(addr.sin_port);
+
+    int size = 4 * 1024 * 1024;
+    setsockopt(receiver, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+//! returns the datagram length, 0 when nothing arrived in time
+static int receive(uint8_t *buff, size_t size, int timeout_ms) {
+    struct pollfd pfd = { .fd = receiver, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+    int len = recv(receiver, buff, size, 0);
+    return len < 0 ? 0 : len;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void test_batches_over_loopback(void) {
+    const int records = 1000;
+    TEST_ASSERT_EQUAL(0, udp_client_setup("127.0.0.1", receiver_port));
+
+    udp_client_stats_t before;
+    udp_client_get_stats(&before);
+
+    uint8_t record[RECORD_LEN];
+    for (int i = 0; i < records; i++) {
+        memset(record, i & 0xFF, sizeof(record));
+        memcpy(record, &i, sizeof(i));
+        TEST_ASSERT_EQUAL(0, udp_client_queue(record, sizeof(record)));
+    }
+    udp_client_close();
+
+    //! datagrams in order, no seq gaps, every record back intact
+    uint8_t buff[2048];
+    int next_record = 0, datagrams = 0, len;
+    uint32_t expected_seq = before.seq;
+    while ((len = receive(buff, sizeof(buff), 200)) > 0) {
+        TEST_ASSERT(len <= BATCH_MAX_LEN);
+        TEST_ASSERT_EQUAL(expected_seq++, read_u32(buff));
+        datagrams++;
+
+        int count = buff[4] | buff[5] << 8;
+        size_t pos = 6;
+        for (int r = 0; r < count; r++) {
+            uint16_t record_len = buff[pos] | buff[pos + 1] << 8;
+            TEST_ASSERT_EQUAL(RECORD_LEN, record_len);
+            int index;
+            memcpy(&index, buff + pos + 2, sizeof(index));
+            TEST_ASSERT_EQUAL(next_record++, index);
+            pos += 2 + record_len;
+        }
+        TEST_ASSERT_EQUAL(len, pos);
+    }
+    TEST_ASSERT_EQUAL(records, next_record);
+
+    // 1394 payload bytes per datagram hold 63 records of 22
+    TEST_ASSERT_EQUAL((records + 62) / 63, datagrams);
+
+    udp_client_stats_t after;
+    udp_client_get_stats(&after);
+    TEST_ASSERT_EQUAL(datagrams, after.datagrams - before.datagrams);
+    TEST_ASSERT_EQUAL(records, after.records - before.records);
+    TEST_ASSERT_EQUAL(0, after.dropped - before.dropped);
+}
+
+//! a partial batch waits for the flush interval
+static void test_partial_batch_on_interval(void) {
+    uint8_t buff[2048];
+    TEST_ASSERT_EQUAL(0, udp_client_setup("127.0.0.1", receiver_port));
+
+    udp_client_socket_send(10000000);
+    udp_client_queue("reading", 7);
+    udp_client_socket_send(10500000);
+    TEST_ASSERT_EQUAL(0, receive(buff, sizeof(buff), 50));
+
+    udp_client_socket_send(11000000);
+    TEST_ASSERT_EQUAL(6 + 2 + 7, receive(buff, sizeof(buff), 200));
+    TEST_ASSERT(memcmp(buff + 8, "reading", 7) == 0);
+
+    // nothing queued, nothing sent
+    udp_client_socket_send(12000000);
+    TEST_ASSERT_EQUAL(0, receive(buff, sizeof(buff), 50));
+    udp_client_close();
+}
+
+static void test_limits(void) {
+    static uint8_t record[BATCH_MAX_LEN];
+    TEST_ASSERT_EQUAL(-1, udp_client_setup("not an address", receiver_port));
+    TEST_ASSERT_EQUAL(-1, udp_client_queue(record, 1));
+
+    TEST_ASSERT_EQUAL(0, udp_client_setup("127.0.0.1", receiver_port));
+    TEST_ASSERT_EQUAL(-1, udp_client_queue(record, BATCH_MAX_LEN - 6 - 2 + 1));
+    TEST_ASSERT_EQUAL(0, udp_client_queue(record, BATCH_MAX_LEN - 6 - 2));
+    udp_client_close();
+
+    uint8_t buff[2048];
+    TEST_ASSERT_EQUAL(BATCH_MAX_LEN, receive(buff, sizeof(buff), 200));
+}
+
+int main(void) {
+    open_receiver();
+    RUN_TEST(test_batches_over_loopback);
+    RUN_TEST(test_partial_batch_on_interval);
+    RUN_TEST(test_limits);
+    close(receiver);
+    return TEST_RESULT();
+}
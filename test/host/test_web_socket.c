@@ -0,0 +1,528 @@
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+
+#include "test.h"
+#include "mock_socket.h"
+#include "web_socket.h"
+#include "ws_frame.h"
+
+//# Conformance cases in the spirit of the Autobahn testsuite, numbered after
+//# its sections: framing, ping/pong, reserved bits and opcodes, fragmentation,
+//# close handling and limits. Every client is a socketpair, the server runs
+//# on this thread through web_socket_dispatch like under the net reactor.
+
+#define MAX_FDS         16
+#define MAX_CLIENTS     10                  // web_socket.c
+#define MAX_MESSAGE     4096                // WS_MAX_MESSAGE_SIZE
+#define READ_TIMEOUT_MS 200
+
+#define FIN             0x80
+#define RSV1            0x40
+
+typedef struct {
+    uint8_t first;                          // fin, rsv and opcode
+    uint8_t data[MAX_MESSAGE + 16];
+    size_t len;
+} frame_t;
+
+static uint64_t now_us = 1000000;
+static uint8_t payload[MAX_MESSAGE + 16];
+static int echo_rejected;
+
+static void echo(int client_sock, uint8_t opcode, uint8_t *data, size_t len) {
+    if (web_socket_send_frame(client_sock, opcode, true, data, len) < 0) echo_rejected++;
+}
+
+//! runs the server until a poll round finds nothing to do
+static void pump(void) {
+    struct pollfd fds[MAX_FDS];
+    for (int round = 0; round < 1000; round++) {
+        int count = web_socket_fill_pollfds(NULL, fds, MAX_FDS);
+        int activity = poll(fds, count, 0);
+        if (mock_socket_pending()) {
+            fds[0].revents |= POLLIN;
+            activity++;
+        }
+        if (activity <= 0) return;
+        web_socket_dispatch(NULL, fds, count, now_us);
+    }
+}
+
+static bool read_exact(int fd, void *buff, size_t len) {
+    uint8_t *ptr = buff;
+    while (len > 0) {
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+        if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) return false;
+        ssize_t n = read(fd, ptr, len);
+        if (n <= 0) return false;
+        ptr += n;
+        len -= n;
+    }
+    return true;
+}
+
+//! true when the server closed its end, nothing else may be pending
+static bool peer_closed(int fd) {
+    uint8_t byte;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) return false;
+
+    // closing with unread input resets the connection, like TCP
+    ssize_t n = read(fd, &byte, 1);
+    return n == 0 || (n < 0 && errno == ECONNRESET);
+}
+
+static bool nothing_received(int fd) {
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    return poll(&pfd, 1, 0) == 0;
+}
+
+static void ws_handshake(int fd) {
+    static const char request[] =
+        "GET /ws HTTP/1.1\r\n"
+        "Host: 192.168.4.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+
+    write(fd, request, strlen(request));
+    pump();
+
+    // RFC 6455 section 1.3 example key
+    char response[256] = "";
+    size_t len = 0;
+    while (len < sizeof(response) - 1 && read_exact(fd, response + len, 1)) {
+        response[++len] = 0;
+        if (strstr(response, "\r\n\r\n")) break;
+    }
+    TEST_ASSERT(strstr(response, "HTTP/1.1 101") == response);
+    TEST_ASSERT(strstr(response, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != NULL);
+}
+
+static int ws_connect(void) {
+    int fd = mock_socket_connect();
+    if (fd < 0) return -1;
+    ws_handshake(fd);
+    return fd;
+}
+
+static void ws_disconnect(int fd) {
+    close(fd);
+    pump();
+}
+
+//! a masked client frame, the 7 bit length field can be forced for malformed cases
+static size_t encode(uint8_t *out, uint8_t first, const uint8_t *data, size_t len, bool masked) {
+    size_t pos = ws_frame_build_header(out, 0, true, len);
+    out[0] = first;
+    if (!masked) {
+        memcpy(out + pos, data, len);
+        return pos + len;
+    }
+
+    out[1] |= 0x80;
+    uint8_t mask[4] = { rand(), rand(), rand(), rand() };
+    memcpy(out + pos, mask, 4);
+    pos += 4;
+    for (size_t i = 0; i < len; i++) out[pos + i] = data[i] ^ mask[i & 3];
+    return pos + len;
+}
+
+//! writes the frame in chunks of chunk bytes with the server running in between
+static void send_chopped(int fd, uint8_t first, const uint8_t *data, size_t len, size_t chunk) {
+    static uint8_t wire[MAX_MESSAGE + 32];
+    size_t wire_len = encode(wire, first, data, len, true);
+    for (size_t pos = 0; pos < wire_len; pos += chunk) {
+        size_t n = wire_len - pos < chunk ? wire_len - pos : chunk;
+        write(fd, wire + pos, n);
+        pump();
+    }
+}
+
+static void send_frame(int fd, uint8_t first, const uint8_t *data, size_t len) {
+    send_chopped(fd, first, data, len, SIZE_MAX);
+}
+
+static bool recv_frame(int fd, frame_t *frame) {
+    uint8_t header[WS_MAX_HEADER_LEN];
+    if (!read_exact(fd, header, 2)) return false;
+
+    size_t extra = (header[1] & 0x7F) == 126 ? 2 : (header[1] & 0x7F) == 127 ? 8 : 0;
+    if (!read_exact(fd, header + 2, extra)) return false;
+
+    ws_frame_header_t parsed;
+    if (ws_frame_parse_header(header, 2 + extra, &parsed) <= 0 || parsed.masked) return false;
+    if (parsed.payload_len > sizeof(frame->data)) return false;
+
+    frame->first = header[0];
+    frame->len = parsed.payload_len;
+    return read_exact(fd, frame->data, frame->len);
+}
+
+static void expect_frame(int fd, uint8_t first, const uint8_t *data, size_t len) {
+    static frame_t frame;
+    TEST_ASSERT(recv_frame(fd, &frame));
+    TEST_ASSERT_EQUAL(first, frame.first);
+    TEST_ASSERT_EQUAL(len, frame.len);
+    TEST_ASSERT(frame.len != len || memcmp(frame.data, data, len) == 0);
+}
+
+static void expect_close(int fd, uint16_t code) {
+    frame_t frame;
+    TEST_ASSERT(recv_frame(fd, &frame));
+    TEST_ASSERT_EQUAL(FIN | WS_OPCODE_CLOSE, frame.first);
+    TEST_ASSERT_EQUAL(2, frame.len);
+    TEST_ASSERT_EQUAL(code, frame.data[0] << 8 | frame.data[1]);
+    TEST_ASSERT(peer_closed(fd));
+}
+
+static void fill_payload(size_t len) {
+    for (size_t i = 0; i < len; i++) payload[i] = 'a' + (i * 7 + len) % 26;
+}
+
+//! 1.x text and binary echo across the 7 bit, 16 bit and rx buffer boundaries
+static void test_1_echo_sizes(void) {
+    const size_t sizes[] = { 0, 1, 125, 126, 127, 1000, 1009, 1010, 1011, 1024, 1500, 2048, 4095, 4096 };
+    int fd = ws_connect();
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fill_payload(sizes[i]);
+        send_frame(fd, FIN | WS_OPCODE_TEXT, payload, sizes[i]);
+        expect_frame(fd, FIN | WS_OPCODE_TEXT, payload, sizes[i]);
+
+        send_frame(fd, FIN | WS_OPCODE_BINARY, payload, sizes[i]);
+        expect_frame(fd, FIN | WS_OPCODE_BINARY, payload, sizes[i]);
+    }
+    ws_disconnect(fd);
+}
+
+//! 9.x style delivery in small pieces, including a header split after its first byte
+static void test_1_chopped_delivery(void) {
+    const size_t chunks[] = { 1, 2, 7, 100, 1000 };
+    int fd = ws_connect();
+
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        fill_payload(3000);
+        send_chopped(fd, FIN | WS_OPCODE_BINARY, payload, 3000, chunks[i]);
+        expect_frame(fd, FIN | WS_OPCODE_BINARY, payload, 3000);
+
+        send_chopped(fd, FIN | WS_OPCODE_TEXT, payload, 20, chunks[i]);
+        expect_frame(fd, FIN | WS_OPCODE_TEXT, payload, 20);
+    }
+
+    // nothing but the first header byte, the server must wait for the rest
+    uint8_t wire[16];
+    size_t wire_len = encode(wire, FIN | WS_OPCODE_TEXT, (const uint8_t *)"hi", 2, true);
+    write(fd, wire, 1);
+    pump();
+    TEST_ASSERT(nothing_received(fd));
+    write(fd, wire + 1, wire_len - 1);
+    pump();
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, (const uint8_t *)"hi", 2);
+
+    ws_disconnect(fd);
+}
+
+//! several frames in one write, the last one larger than the rx buffer
+static void test_1_pipelined(void) {
+    static uint8_t wire[3 * 64 + MAX_MESSAGE + 32];
+    int fd = ws_connect();
+
+    fill_payload(MAX_MESSAGE);
+    size_t len = 0;
+    len += encode(wire + len, FIN | WS_OPCODE_TEXT, (const uint8_t *)"one", 3, true);
+    len += encode(wire + len, FIN | WS_OPCODE_PING, (const uint8_t *)"two", 3, true);
+    len += encode(wire + len, FIN | WS_OPCODE_TEXT, (const uint8_t *)"three", 5, true);
+    len += encode(wire + len, FIN | WS_OPCODE_BINARY, payload, MAX_MESSAGE, true);
+    write(fd, wire, len);
+    pump();
+
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, (const uint8_t *)"one", 3);
+    expect_frame(fd, FIN | WS_OPCODE_PONG, (const uint8_t *)"two", 3);
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, (const uint8_t *)"three", 5);
+    expect_frame(fd, FIN | WS_OPCODE_BINARY, payload, MAX_MESSAGE);
+    ws_disconnect(fd);
+}
+
+//! 2.x ping/pong
+static void test_2_ping_pong(void) {
+    int fd = ws_connect();
+
+    send_frame(fd, FIN | WS_OPCODE_PING, NULL, 0);
+    expect_frame(fd, FIN | WS_OPCODE_PONG, NULL, 0);
+
+    fill_payload(125);
+    send_frame(fd, FIN | WS_OPCODE_PING, payload, 125);
+    expect_frame(fd, FIN | WS_OPCODE_PONG, payload, 125);
+
+    // an unsolicited pong is ignored
+    send_frame(fd, FIN | WS_OPCODE_PONG, payload, 10);
+    TEST_ASSERT(nothing_received(fd));
+    send_frame(fd, FIN | WS_OPCODE_TEXT, payload, 10);
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, payload, 10);
+
+    send_chopped(fd, FIN | WS_OPCODE_PING, payload, 125, 1);
+    expect_frame(fd, FIN | WS_OPCODE_PONG, payload, 125);
+
+    // 126 bytes is over the control frame limit
+    send_frame(fd, FIN | WS_OPCODE_PING, payload, 126);
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+
+    // control frames can't be fragmented
+    fd = ws_connect();
+    send_frame(fd, WS_OPCODE_PING, payload, 4);
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+}
+
+//! 3.x reserved bits without a negotiated extension
+static void test_3_reserved_bits(void) {
+    for (int bit = 0; bit < 3; bit++) {
+        int fd = ws_connect();
+        send_frame(fd, FIN | (RSV1 >> bit) | WS_OPCODE_TEXT, (const uint8_t *)"x", 1);
+        expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+        ws_disconnect(fd);
+    }
+}
+
+//! 4.x reserved opcodes, data 3..7 and control 0xB..0xF
+static void test_4_reserved_opcodes(void) {
+    const uint8_t opcodes[] = { 3, 4, 5, 6, 7, 0xB, 0xC, 0xD, 0xE, 0xF };
+    for (size_t i = 0; i < sizeof(opcodes); i++) {
+        int fd = ws_connect();
+        send_frame(fd, FIN | opcodes[i], NULL, 0);
+        expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+        ws_disconnect(fd);
+    }
+}
+
+//! 5.x fragmentation with control frames in between
+static void test_5_fragmentation(void) {
+    int fd = ws_connect();
+
+    fill_payload(MAX_MESSAGE);
+    send_frame(fd, WS_OPCODE_TEXT, payload, 1500);
+    send_frame(fd, FIN | WS_OPCODE_PING, (const uint8_t *)"mid", 3);
+    expect_frame(fd, FIN | WS_OPCODE_PONG, (const uint8_t *)"mid", 3);
+    send_chopped(fd, WS_OPCODE_CONTINUATION, payload + 1500, 1500, 333);
+    send_frame(fd, WS_OPCODE_CONTINUATION, NULL, 0);
+    TEST_ASSERT(nothing_received(fd));
+    send_frame(fd, FIN | WS_OPCODE_CONTINUATION, payload + 3000, MAX_MESSAGE - 3000);
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, payload, MAX_MESSAGE);
+
+    // one byte per fragment, then empty first and last fragments
+    for (int i = 0; i < 5; i++) {
+        send_frame(fd, (i == 4 ? FIN : 0) | (i == 0 ? WS_OPCODE_BINARY : WS_OPCODE_CONTINUATION), payload + i, 1);
+    }
+    expect_frame(fd, FIN | WS_OPCODE_BINARY, payload, 5);
+
+    send_frame(fd, WS_OPCODE_TEXT, NULL, 0);
+    send_frame(fd, FIN | WS_OPCODE_CONTINUATION, NULL, 0);
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, NULL, 0);
+    ws_disconnect(fd);
+
+    // continuation without a message
+    fd = ws_connect();
+    send_frame(fd, FIN | WS_OPCODE_CONTINUATION, payload, 4);
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+
+    // a new message before the fragmented one is finished
+    fd = ws_connect();
+    send_frame(fd, WS_OPCODE_TEXT, payload, 4);
+    send_frame(fd, FIN | WS_OPCODE_TEXT, payload, 4);
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+}
+
+//! 7.x close handshake
+static void test_7_close(void) {
+    int fd = ws_connect();
+    const uint8_t close_payload[] = { 0x03, 0xE8, 'b', 'y', 'e' };
+    send_frame(fd, FIN | WS_OPCODE_CLOSE, close_payload, sizeof(close_payload));
+    expect_close(fd, WS_CLOSE_NORMAL);
+    ws_disconnect(fd);
+
+    fd = ws_connect();
+    send_frame(fd, FIN | WS_OPCODE_CLOSE, NULL, 0);
+    expect_frame(fd, FIN | WS_OPCODE_CLOSE, NULL, 0);
+    TEST_ASSERT(peer_closed(fd));
+    ws_disconnect(fd);
+}
+
+//! 9.x limits and malformed headers
+static void test_9_limits(void) {
+    fill_payload(MAX_MESSAGE + 1);
+
+    int fd = ws_connect();
+    send_frame(fd, FIN | WS_OPCODE_BINARY, payload, MAX_MESSAGE + 1);
+    expect_close(fd, WS_CLOSE_TOO_BIG);
+    ws_disconnect(fd);
+
+    fd = ws_connect();
+    send_frame(fd, WS_OPCODE_BINARY, payload, MAX_MESSAGE - 100);
+    send_frame(fd, FIN | WS_OPCODE_CONTINUATION, payload, 101);
+    expect_close(fd, WS_CLOSE_TOO_BIG);
+    ws_disconnect(fd);
+
+    // 64 bit length with the most significant bit set
+    fd = ws_connect();
+    const uint8_t huge[] = { FIN | WS_OPCODE_BINARY, 0xFF, 0x80, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4 };
+    write(fd, huge, sizeof(huge));
+    pump();
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+
+    // clients must mask
+    fd = ws_connect();
+    uint8_t wire[16];
+    write(fd, wire, encode(wire, FIN | WS_OPCODE_TEXT, (const uint8_t *)"hi", 2, false));
+    pump();
+    expect_close(fd, WS_CLOSE_PROTOCOL_ERROR);
+    ws_disconnect(fd);
+}
+
+//! every slot filled with clients that connect before a broadcast and handshake after the stall timeout
+static void test_max_clients_slow_handshake(void) {
+    int fds[MAX_CLIENTS + 1];
+    web_socket_broadcast(WS_OPCODE_TEXT, "before", 6);      // ring_head moves away from 0
+
+    for (int i = 0; i < MAX_CLIENTS; i++) fds[i] = mock_socket_connect();
+    pump();
+
+    // one over the limit is turned away
+    fds[MAX_CLIENTS] = mock_socket_connect();
+    pump();
+    TEST_ASSERT(peer_closed(fds[MAX_CLIENTS]));
+    close(fds[MAX_CLIENTS]);
+
+    web_socket_broadcast(WS_OPCODE_TEXT, "during", 6);
+    now_us += 10 * 1000000;                                 // well past WS_SLOW_MAX_STALL_MS
+    pump();
+
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        TEST_ASSERT(nothing_received(fds[i]));
+        ws_handshake(fds[i]);
+    }
+
+    now_us += 10 * 1000000;
+    pump();
+    web_socket_broadcast(WS_OPCODE_TEXT, "after", 5);
+    pump();
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        expect_frame(fds[i], FIN | WS_OPCODE_TEXT, (const uint8_t *)"after", 5);
+        send_frame(fds[i], FIN | WS_OPCODE_TEXT, (const uint8_t *)"echo", 4);
+        expect_frame(fds[i], FIN | WS_OPCODE_TEXT, (const uint8_t *)"echo", 4);
+    }
+
+    for (int i = 0; i < MAX_CLIENTS; i++) ws_disconnect(fds[i]);
+}
+
+//! the server end of the newest client, poll_arr keeps the accept order
+static int server_end(void) {
+    struct pollfd fds[MAX_FDS];
+    int count = web_socket_fill_pollfds(NULL, fds, MAX_FDS);
+    int fd = -1;
+    for (int i = 1; i < count; i++) if (fds[i].fd > fd) fd = fds[i].fd;
+    return fd;
+}
+
+//! replies, pongs and broadcasts to a client that stopped reading are queued, never block the
+//! reactor, and come out whole and in order once it reads again
+static void test_backpressure_never_blocks(void) {
+    #define ROUNDS      12
+    #define BCAST_LEN   400
+    #define ECHO_LEN    900
+
+    static uint8_t stream[64 * 1024];
+    int fd = ws_connect();
+    int sndbuf = 4096;
+    setsockopt(server_end(), SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    echo_rejected = 0;
+    alarm(5);                               // a blocking send would hang here
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        memset(payload, 'B' + i, BCAST_LEN);
+        web_socket_broadcast(WS_OPCODE_BINARY, payload, BCAST_LEN);
+        memset(payload, 'a' + i, ECHO_LEN);
+        send_frame(fd, FIN | WS_OPCODE_TEXT, payload, ECHO_LEN);
+        send_frame(fd, FIN | WS_OPCODE_PING, (const uint8_t *)"p", 1);
+    }
+    uint64_t elapsed_ms = (bench_now_ns() - start) / 1000000;
+    printf("  %d rounds in %llu ms, %d replies refused\n", ROUNDS, (unsigned long long)elapsed_ms, echo_rejected);
+    TEST_ASSERT(echo_rejected > 0);         // more than the kernel buffer and the client queue hold
+
+    // drain, the server moves the rest out on POLLOUT
+    size_t len = 0;
+    for (int idle = 0; idle < 20 && len < sizeof(stream);) {
+        pump();
+        ssize_t n = recv(fd, stream + len, sizeof(stream) - len, MSG_DONTWAIT);
+        if (n > 0) {
+            len += n;
+            idle = 0;
+        } else {
+            idle++;
+        }
+    }
+    alarm(0);
+
+    // every frame whole, each kind in the order it was sent
+    int broadcasts = 0, echoes = 0, pongs = 0;
+    uint8_t last_echo = 0;
+    for (size_t pos = 0; pos < len;) {
+        ws_frame_header_t header;
+        int header_len = ws_frame_parse_header(stream + pos, len - pos, &header);
+        TEST_ASSERT(header_len > 0 && pos + header_len + header.payload_len <= len);
+        if (header_len <= 0) break;
+
+        const uint8_t *data = stream + pos + header_len;
+        for (size_t i = 1; i < header.payload_len; i++) TEST_ASSERT_EQUAL(data[0], data[i]);
+
+        if (header.opcode == WS_OPCODE_BINARY) {
+            TEST_ASSERT_EQUAL(BCAST_LEN, header.payload_len);
+            TEST_ASSERT_EQUAL('B' + broadcasts++, data[0]);
+        } else if (header.opcode == WS_OPCODE_TEXT) {
+            TEST_ASSERT_EQUAL(ECHO_LEN, header.payload_len);
+            TEST_ASSERT(data[0] > last_echo);
+            last_echo = data[0];
+            echoes++;
+        } else {
+            TEST_ASSERT_EQUAL(WS_OPCODE_PONG, header.opcode);
+            pongs++;
+        }
+        pos += header_len + header.payload_len;
+    }
+    TEST_ASSERT_EQUAL(ROUNDS, broadcasts);
+    TEST_ASSERT_EQUAL(ROUNDS * 2, echoes + pongs + echo_rejected);
+
+    // still usable afterwards
+    send_frame(fd, FIN | WS_OPCODE_TEXT, (const uint8_t *)"echo", 4);
+    pump();
+    expect_frame(fd, FIN | WS_OPCODE_TEXT, (const uint8_t *)"echo", 4);
+    ws_disconnect(fd);
+}
+
+int main(void) {
+    signal(SIGPIPE, SIG_IGN);               // lwip has no SIGPIPE, sends to a closed peer just fail
+    srand(1);
+    web_socket_setup();
+    web_socket_on_message(echo);
+
+    RUN_TEST(test_1_echo_sizes);
+    RUN_TEST(test_1_chopped_delivery);
+    RUN_TEST(test_1_pipelined);
+    RUN_TEST(test_2_ping_pong);
+    RUN_TEST(test_3_reserved_bits);
+    RUN_TEST(test_4_reserved_opcodes);
+    RUN_TEST(test_5_fragmentation);
+    RUN_TEST(test_7_close);
+    RUN_TEST(test_9_limits);
+    RUN_TEST(test_max_clients_slow_handshake);
+    RUN_TEST(test_backpressure_never_blocks);
+
+    return TEST_RESULT();
+}
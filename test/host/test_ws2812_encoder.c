@@ -0,0 +1,133 @@
+#include <string.h>
+#include <stdlib.h>
+
+#include "test.h"
+#include "esp_timer.h"
+#include "mock_rmt.h"
+#include "mod_ws2812.h"
+
+//# The table encoder of mod_ws2812.c against the per-bit encoder it
+//# replaced, symbol for symbol, through the simple encoder emulation of
+//# mock_rmt.c. Block sizes cover the ESP32-C3 channel memory, the DMA
+//# buffer and odd sizes that leave less than a byte of room.
+
+#define MAX_BYTES (WS2812_MAX_LEDS * 3)
+#define MAX_SYMBOLS (MAX_BYTES * 8 + 64)
+
+extern const rmt_simple_encoder_config_t simple_encoder_cfg;
+
+//! the encoder before the table, as it was in mod_ws2812.c
+static size_t per_bit_callback(const void *data, size_t data_size,
+                            size_t symbols_written, size_t symbols_free,
+                            rmt_symbol_word_t *symbols, bool *done, void *arg)
+{
+    if (symbols_free < 8) {
+        return 0;
+    }
+
+    size_t data_pos = symbols_written / 8;
+    uint8_t *data_bytes = (uint8_t*)data;
+
+    if (data_pos < data_size) {
+        size_t symbol_pos = 0;
+        for (int bitmask = 0x80; bitmask != 0; bitmask >>= 1) {
+            uint8_t check = data_bytes[data_pos]&bitmask;
+            symbols[symbol_pos++] = check ? ws2812_one : ws2812_zero;
+        }
+        return symbol_pos;
+    } else {
+        symbols[0] = ws2812_reset;
+        *done = 1;
+        return 1;
+    }
+}
+
+static const rmt_simple_encoder_config_t per_bit_cfg = {
+    .callback = per_bit_callback,
+};
+
+static uint8_t data[MAX_BYTES];
+static rmt_symbol_word_t expected[MAX_SYMBOLS], actual[MAX_SYMBOLS];
+static uint64_t now = 1000000;
+
+static bool same_stream(const rmt_symbol_word_t *a, size_t a_len, const rmt_symbol_word_t *b, size_t b_len) {
+    return a_len == b_len && memcmp(a, b, a_len * sizeof(rmt_symbol_word_t)) == 0;
+}
+
+static void test_every_byte_value(void) {
+    for (int i = 0; i < 256; i++) data[i] = i;
+
+    size_t expected_len = mock_rmt_encode(&per_bit_cfg, data, 256, 64, expected, MAX_SYMBOLS, NULL);
+    size_t actual_len = mock_rmt_encode(&simple_encoder_cfg, data, 256, 64, actual, MAX_SYMBOLS, NULL);
+    TEST_ASSERT_EQUAL(256 * 8 + 1, expected_len);
+    TEST_ASSERT(same_stream(expected, expected_len, actual, actual_len));
+
+    //! spot check the table against the symbol definitions, MSB first
+    TEST_ASSERT_EQUAL(ws2812_zero.val, actual[0x01 * 8].val);
+    TEST_ASSERT_EQUAL(ws2812_one.val, actual[0x01 * 8 + 7].val);
+    TEST_ASSERT_EQUAL(ws2812_one.val, actual[0x80 * 8].val);
+    TEST_ASSERT_EQUAL(ws2812_reset.val, actual[256 * 8].val);
+}
+
+static void test_random_frames_all_blocks(void) {
+    const size_t lengths[] = { 0, 1, 3, 5, 27, 432, 3000, MAX_BYTES };
+    const size_t blocks[] = { 1, 7, 9, 26, SOC_RMT_MEM_WORDS_PER_CHANNEL, 64, 100, 1024 };
+
+    srand(7);
+    for (size_t i = 0; i < MAX_BYTES; i++) data[i] = rand();
+
+    int mismatches = 0;
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        for (size_t b = 0; b < sizeof(blocks) / sizeof(blocks[0]); b++) {
+            size_t expected_len = mock_rmt_encode(&per_bit_cfg, data, lengths[l], blocks[b], expected, MAX_SYMBOLS, NULL);
+            size_t actual_len = mock_rmt_encode(&simple_encoder_cfg, data, lengths[l], blocks[b], actual, MAX_SYMBOLS, NULL);
+            if (expected_len != lengths[l] * 8 + 1 || !same_stream(expected, expected_len, actual, actual_len)) {
+                fprintf(stderr, "  %u bytes, block %u: %u symbols, expected %u\n", (unsigned)lengths[l], (unsigned)blocks[b],
+                        (unsigned)actual_len, (unsigned)expected_len);
+                mismatches++;
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+//! a whole frame through ws2812_loop, on both strips, timed by the mock
+static void test_transmitted_frames(void) {
+    ws2812_set_gamma(2.2f, 2.2f, 2.2f);
+    for (int strip = 0; strip < 2; strip++) {
+        ws2812_select_strip(strip);
+        now += 100000;
+        host_set_time(now);
+        mock_rmt_run(now);
+        ws2812_loop(now);
+    }
+
+    for (int i = 0; i < mock_rmt_channels(); i++) {
+        const mock_rmt_tx_t *tx = mock_rmt_last(i);
+        TEST_ASSERT(mock_rmt_transmits(i) > 0);
+
+        size_t expected_len = mock_rmt_encode(&per_bit_cfg, mock_rmt_last_data(i), tx->bytes, SOC_RMT_MEM_WORDS_PER_CHANNEL,
+                                              expected, MAX_SYMBOLS, NULL);
+        TEST_ASSERT(same_stream(expected, expected_len, mock_rmt_last_symbols(i), tx->symbols));
+
+        //! 1.2 us per bit plus the 50 us reset
+        TEST_ASSERT_EQUAL((tx->bytes * 8 * 12 + 500) / 10, tx->end_us - tx->start_us);
+    }
+    TEST_ASSERT_EQUAL(9 * 3, mock_rmt_last(0)->bytes);
+    TEST_ASSERT_EQUAL(144 * 3, mock_rmt_last(1)->bytes);
+}
+
+int main(void) {
+    host_set_time(now);
+    const ws2812_strip_config_t configs[] = {
+        { .gpio_pin = 8, .led_count = 9 },
+        { .gpio_pin = 9, .led_count = 144 },
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, ws2812_setup_strips(configs, 2));
+
+    RUN_TEST(test_every_byte_value);
+    RUN_TEST(test_random_frames_all_blocks);
+    RUN_TEST(test_transmitted_frames);
+
+    return TEST_RESULT();
+}
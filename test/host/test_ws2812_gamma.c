@@ -0,0 +1,106 @@
+#include <math.h>
+
+#include "test.h"
+
+//# The gamma table and correct_frame of mod_ws2812.c, compiled in here to
+//# reach the static table, on a strip that exists only in this test.
+
+#include "mod_ws2812.c"
+
+#define LEDS 256
+
+static uint8_t pixels[LEDS * 3], error[LEDS * 3], out[LEDS * 3];
+static ws2812_strip_t strip = { .led_count = LEDS, .pixels = pixels, .dither_error = error };
+
+static uint16_t expected_entry(int value, float gamma) {
+    return (uint16_t)lround(pow(value / 255.0, gamma) * (255 << 8));
+}
+
+static void test_table_contents(void) {
+    ws2812_set_gamma(2.2f, 1.8f, 2.6f);
+    TEST_ASSERT(gamma_enabled);
+
+    //! strip byte order G R B
+    const float gammas[3] = { 1.8f, 2.2f, 2.6f };
+    int mismatches = 0, falling = 0;
+    for (int channel = 0; channel < 3; channel++) {
+        for (int value = 0; value < 256; value++) {
+            if (abs(gamma_lut[channel][value] - expected_entry(value, gammas[channel])) > 1) mismatches++;
+            if (value > 0 && gamma_lut[channel][value] < gamma_lut[channel][value - 1]) falling++;
+        }
+        TEST_ASSERT_EQUAL(0, gamma_lut[channel][0]);
+        TEST_ASSERT_EQUAL(255 << 8, gamma_lut[channel][255]);
+    }
+    TEST_ASSERT_EQUAL(0, mismatches);
+    TEST_ASSERT_EQUAL(0, falling);
+
+    ws2812_set_gamma(1.0f, 1.0f, 1.0f);
+    TEST_ASSERT(!gamma_enabled);
+    for (int value = 0; value < 256; value++) TEST_ASSERT_EQUAL(value << 8, gamma_lut[1][value]);
+}
+
+static void fill_ramp(void) {
+    for (int i = 0; i < LEDS; i++) pixels[i * 3] = pixels[i * 3 + 1] = pixels[i * 3 + 2] = i;
+}
+
+static void test_identity_is_a_copy(void) {
+    ws2812_set_gamma(1.0f, 1.0f, 1.0f);
+    ws2812_set_dither(false);
+    fill_ramp();
+    correct_frame(&strip, out);
+    TEST_ASSERT(memcmp(out, pixels, sizeof(out)) == 0);
+}
+
+//! without dither every byte is the table entry rounded to 8 bits
+static void test_rounded_output(void) {
+    ws2812_set_gamma(2.2f, 2.2f, 2.2f);
+    ws2812_set_dither(false);
+    fill_ramp();
+    correct_frame(&strip, out);
+
+    int off = 0;
+    for (int i = 0; i < LEDS * 3; i++) {
+        long expected = lround(pow(pixels[i] / 255.0, 2.2) * 255);
+        if (labs(out[i] - expected) > 0) off++;
+    }
+    TEST_ASSERT_EQUAL(0, off);
+    TEST_ASSERT_EQUAL(0, out[1 * 3]);                           // 1 is below half a step at 2.2
+    TEST_ASSERT_EQUAL(255, out[255 * 3]);
+}
+
+//! over n frames the outputs add up to n times the 8.8 entry, less than one step off
+static void test_dither_averages(void) {
+    ws2812_set_gamma(2.2f, 2.2f, 2.2f);
+    ws2812_set_dither(true);
+    memset(error, 0, sizeof(error));
+    fill_ramp();
+
+    const int frames = 256;
+    static uint32_t sums[LEDS * 3];
+    memset(sums, 0, sizeof(sums));
+    for (int f = 0; f < frames; f++) {
+        correct_frame(&strip, out);
+        for (int i = 0; i < LEDS * 3; i++) sums[i] += out[i];
+    }
+
+    int off = 0;
+    for (int i = 0; i < LEDS * 3; i++) {
+        int64_t exact = (int64_t)frames * gamma_lut[i % 3][pixels[i]];
+        if (llabs(exact - ((int64_t)sums[i] << 8)) >= 256) off++;
+    }
+    TEST_ASSERT_EQUAL(0, off);
+
+    //! a level between 0 and 1 lights now and then instead of never
+    TEST_ASSERT(sums[20 * 3] > 0);
+    TEST_ASSERT(sums[20 * 3] < frames);
+    ws2812_set_dither(false);
+}
+
+int main(void) {
+    RUN_TEST(test_table_contents);
+    RUN_TEST(test_identity_is_a_copy);
+    RUN_TEST(test_rounded_output);
+    RUN_TEST(test_dither_averages);
+
+    return TEST_RESULT();
+}
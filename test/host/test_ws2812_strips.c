@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "test.h"
+#include "esp_timer.h"
+#include "mock_rmt.h"
+#include "mod_ws2812.h"
+
+//# Two synced strips, 9 and 1200 LEDs, over the mocked RMT driver, run by
+//# ws2812_loop on the 10 ms tick of main.c. Checks what the strips latch,
+//# when, and that a failed rmt_transmit costs one frame, not the strips.
+
+#define LOOP_US 10000
+#define SHORT_LEDS 9
+#define LONG_LEDS 1200
+
+static uint64_t now = 1000000;
+static int loops;                   // hue_animation steps every strip once per loop
+
+static void tick(void) {
+    now += LOOP_US;
+    host_set_time(now);
+    mock_rmt_run(now);
+    ws2812_loop(now);
+    loops++;
+}
+
+//! one transmitted frame later
+static void next_frame(void) {
+    uint32_t before = mock_rmt_transmits(0);
+    for (int i = 0; i < 10 && mock_rmt_transmits(0) == before; i++) tick();
+}
+
+static void test_synced_start(void) {
+    next_frame();
+    const mock_rmt_tx_t *a = mock_rmt_last(0), *b = mock_rmt_last(1);
+    TEST_ASSERT(!a->held && !b->held);
+    TEST_ASSERT_EQUAL(a->start_us, b->start_us);
+    TEST_ASSERT_EQUAL(SHORT_LEDS * 3, a->bytes);
+    TEST_ASSERT_EQUAL(LONG_LEDS * 3, b->bytes);
+    //! 1.2 us per bit, 1200 LEDs are 34.56 ms plus the reset on air
+    TEST_ASSERT_EQUAL(34610, b->end_us - b->start_us);
+}
+
+//! each strip animates over its own length with its own hue, in step with the loop
+static void test_hue_per_strip(void) {
+    next_frame();
+    uint8_t hue = loops - 1;                                    // drawn before the step
+
+    const uint16_t lengths[2] = { SHORT_LEDS, LONG_LEDS };
+    for (int s = 0; s < 2; s++) {
+        const uint8_t *data = mock_rmt_last_data(s);
+        int wrong = 0;
+        for (int i = 0; i < lengths[s]; i++) {
+            RGB_t rgb;
+            hsv_to_rgb_ints((uint8_t)(hue + (uint8_t)(lengths[s] - 1 - i) * 10), 255, 10, &rgb);
+            if (data[i * 3] != rgb.green || data[i * 3 + 1] != rgb.red || data[i * 3 + 2] != rgb.blue) wrong++;
+        }
+        TEST_ASSERT_EQUAL(0, wrong);
+    }
+}
+
+static void test_failed_transmit_drops_round(void) {
+    next_frame();
+    ws2812_stats_t before, after;
+    ws2812_get_stats(&before);
+    uint32_t sent[2] = { mock_rmt_transmits(0), mock_rmt_transmits(1) };
+
+    //! the first strip is queued and held for the second, which fails
+    mock_rmt_fail_next(1, ESP_FAIL);
+    next_frame();
+    ws2812_get_stats(&after);
+    TEST_ASSERT_EQUAL(sent[0] + 1, mock_rmt_transmits(0));
+    TEST_ASSERT_EQUAL(sent[1], mock_rmt_transmits(1));
+    TEST_ASSERT_EQUAL(1, mock_rmt_flushed(0));
+    TEST_ASSERT_EQUAL(0, mock_rmt_pending(0));
+    TEST_ASSERT_EQUAL(before.frames, after.frames);
+    TEST_ASSERT_EQUAL(1, after.skipped - before.skipped);
+
+    //! the next period sends both again, together
+    next_frame();
+    TEST_ASSERT_EQUAL(sent[0] + 2, mock_rmt_transmits(0));
+    TEST_ASSERT_EQUAL(sent[1] + 1, mock_rmt_transmits(1));
+    TEST_ASSERT_EQUAL(mock_rmt_last(0)->start_us, mock_rmt_last(1)->start_us);
+    ws2812_get_stats(&after);
+    TEST_ASSERT_EQUAL(before.frames + 1, after.frames);
+}
+
+//! the 1200 LED frame outlasts the 30 ms period, the next one goes out on the tick after
+static void test_frame_pacing(void) {
+    next_frame();
+    uint32_t start_count = mock_rmt_transmits(1);
+    uint64_t start = now, last_end = 0;
+    int overlaps = 0;
+
+    while (now < start + 1000000) {
+        uint32_t before = mock_rmt_transmits(1);
+        tick();
+        if (mock_rmt_transmits(1) == before) continue;
+
+        const mock_rmt_tx_t *tx = mock_rmt_last(1);
+        if (tx->start_us < last_end) overlaps++;
+        last_end = tx->end_us;
+    }
+
+    uint32_t frames = mock_rmt_transmits(1) - start_count;
+    TEST_ASSERT_EQUAL(0, overlaps);
+    TEST_ASSERT_EQUAL(25, frames);                              // every 40 ms, 16 or 17 if it waited a period
+}
+
+int main(void) {
+    host_set_time(now);
+    const ws2812_strip_config_t configs[] = {
+        { .gpio_pin = 8, .led_count = SHORT_LEDS },
+        { .gpio_pin = 9, .led_count = LONG_LEDS },
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, ws2812_setup_strips(configs, 2));
+    TEST_ASSERT_EQUAL(2, mock_rmt_channels());
+
+    RUN_TEST(test_synced_start);
+    RUN_TEST(test_hue_per_strip);
+    RUN_TEST(test_failed_transmit_drops_round);
+    RUN_TEST(test_frame_pacing);
+
+    return TEST_RESULT();
+}
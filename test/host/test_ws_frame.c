@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "test.h"
+#include "ws_frame.h"
+
+#define MAX_LEN 4096
+
+static uint8_t reference[MAX_LEN + 8];
+static uint8_t buff[MAX_LEN + 8];
+
+static void unmask_bytewise(uint8_t *data, size_t len, const uint8_t mask[4], size_t offset) {
+    for (size_t i = 0; i < len; i++) data[i] ^= mask[(offset + i) & 3];
+}
+
+//! word path against the byte loop for every length, start alignment and mask phase
+static void test_unmask_matches_bytewise(void) {
+    const uint8_t mask[4] = { 0x37, 0xFA, 0x21, 0x3D };
+    int mismatches = 0;
+
+    for (size_t len = 0; len <= MAX_LEN; len++) {
+        for (size_t align = 0; align < 4; align++) {
+            for (size_t offset = 0; offset < 8; offset++) {
+                for (size_t i = 0; i < len + 8; i++) reference[i] = buff[i] = (uint8_t)(i * 131 + len);
+
+                unmask_bytewise(reference + align, len, mask, offset);
+                ws_frame_unmask(buff + align, len, mask, offset);
+                mismatches += memcmp(reference, buff, len + 8) != 0;     // guard bytes included
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL(0, mismatches);
+}
+
+//! a payload unmasked in arbitrary pieces, like the streamed receive path does
+static void test_unmask_in_pieces(void) {
+    const uint8_t mask[4] = { 0x01, 0x80, 0xFF, 0x5A };
+    const size_t pieces[] = { 1, 3, 5, 64, 1021 };
+
+    for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+        for (size_t i = 0; i < MAX_LEN; i++) reference[i] = buff[i] = (uint8_t)(i * 7);
+        unmask_bytewise(reference, MAX_LEN, mask, 0);
+
+        for (size_t pos = 0; pos < MAX_LEN; pos += pieces[p]) {
+            size_t n = MAX_LEN - pos < pieces[p] ? MAX_LEN - pos : pieces[p];
+            ws_frame_unmask(buff + pos, n, mask, pos);
+        }
+        TEST_ASSERT(memcmp(reference, buff, MAX_LEN) == 0);
+    }
+}
+
+static void test_header_round_trip(void) {
+    const uint64_t lengths[] = { 0, 1, 125, 126, 127, 0xFFFF, 0x10000, 0x7FFFFFFFFFFFFFFFull };
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        uint8_t header[WS_MAX_HEADER_LEN];
+        size_t len = ws_frame_build_header(header, WS_OPCODE_BINARY, true, lengths[i]);
+
+        ws_frame_header_t parsed;
+        TEST_ASSERT_EQUAL(len, ws_frame_parse_header(header, len, &parsed));
+        TEST_ASSERT(parsed.payload_len == lengths[i]);
+        TEST_ASSERT(parsed.fin && !parsed.masked);
+        TEST_ASSERT_EQUAL(WS_OPCODE_BINARY, parsed.opcode);
+
+        // every shorter prefix asks for more bytes
+        for (size_t n = 0; n < len; n++) TEST_ASSERT_EQUAL(0, ws_frame_parse_header(header, n, &parsed));
+    }
+}
+
+int main(void) {
+    RUN_TEST(test_unmask_matches_bytewise);
+    RUN_TEST(test_unmask_in_pieces);
+    RUN_TEST(test_header_round_trip);
+    return TEST_RESULT();
+}